@@ -18,10 +18,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "CUnit/Basic.h"
 
 #include "liblwgeom_internal.h"
 #include "lwgeodetic.h"
+#include "lwgeodetic_tree.h"
 #include "cu_tester.h"
 
 #define RANDOM_TEST 0
@@ -329,6 +331,132 @@ static void test_gserialized_get_gbox_geocentric(void)
 
 }
 
+/* Reproducible coordinates, without depending on the C library */
+static double
+gbox_random(uint32_t *seed, double min, double max)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return min + (max - min) * ((*seed >> 8) & 0xFFFF) / 65535.0;
+}
+
+/*
+* A line of n vertices wandering all over the globe, with steps of
+* up to step degrees, through the poles and across the antimeridian.
+*/
+static LWGEOM* gbox_global_line(uint32_t seed, int n, double step)
+{
+	POINTARRAY *pa = ptarray_construct_empty(0, 0, n);
+	POINT4D pt = {0, 0, 0, 0};
+	LWGEOM *lwg;
+	int i;
+
+	pt.x = gbox_random(&seed, -180, 180);
+	pt.y = gbox_random(&seed, -90, 90);
+	for ( i = 0; i < n; i++ )
+	{
+		ptarray_append_point(pa, &pt, LW_TRUE);
+		pt.x = longitude_degrees_normalize(pt.x + gbox_random(&seed, -step, step));
+		pt.y = FP_MAX(-90, FP_MIN(90, pt.y + gbox_random(&seed, -step, step)));
+	}
+	lwg = lwline_as_lwgeom(lwline_construct(4326, NULL, pa));
+	FLAGS_SET_GEODETIC(lwg->flags, 1);
+	return lwg;
+}
+
+static void gbox_geodetic_compare(const LWGEOM *lwg, double tolerance)
+{
+	GBOX gbox, gbox_slow;
+
+	gbox.flags = gbox_slow.flags = lwg->flags;
+	gbox_geocentric_slow = LW_FALSE;
+	CU_ASSERT_EQUAL(lwgeom_calculate_gbox_geodetic(lwg, &gbox), LW_SUCCESS);
+	gbox_geocentric_slow = LW_TRUE;
+	CU_ASSERT_EQUAL(lwgeom_calculate_gbox_geodetic(lwg, &gbox_slow), LW_SUCCESS);
+	gbox_geocentric_slow = LW_FALSE;
+
+	CU_ASSERT_DOUBLE_EQUAL(gbox.xmin, gbox_slow.xmin, tolerance);
+	CU_ASSERT_DOUBLE_EQUAL(gbox.ymin, gbox_slow.ymin, tolerance);
+	CU_ASSERT_DOUBLE_EQUAL(gbox.zmin, gbox_slow.zmin, tolerance);
+	CU_ASSERT_DOUBLE_EQUAL(gbox.xmax, gbox_slow.xmax, tolerance);
+	CU_ASSERT_DOUBLE_EQUAL(gbox.ymax, gbox_slow.ymax, tolerance);
+	CU_ASSERT_DOUBLE_EQUAL(gbox.zmax, gbox_slow.zmax, tolerance);
+}
+
+static void test_ptarray_calculate_gbox_geodetic(void)
+{
+	LWGEOM *lwg;
+	int i;
+	char wkt[][128] =
+	{
+		"LINESTRING(0 80,180 80)",         /* over the north pole */
+		"LINESTRING(-90 -60,90 -70)",      /* over the south pole */
+		"LINESTRING(179 10,-179 20)",      /* across the antimeridian */
+		"LINESTRING(-170 0,170 0)",        /* along the equator, the short way */
+		"LINESTRING(45 -89,45 89)",        /* along a meridian */
+		"LINESTRING(10 10,10 10,10.000000000001 10)", /* repeated and tiny */
+		"LINESTRING(0 0,179.9 0.05)",      /* close to antipodal */
+		"LINESTRING(-120 30,60 -29.9999)", /* closer still */
+		"POLYGON((-10 -10,-10 10,10 10,10 -10,-10 -10))",
+	};
+
+	for ( i = 0; i < 9; i++ )
+	{
+		lwg = lwgeom_from_wkt(wkt[i], LW_PARSER_CHECK_NONE);
+		FLAGS_SET_GEODETIC(lwg->flags, 1);
+		gbox_geodetic_compare(lwg, 1e-12);
+		lwgeom_free(lwg);
+	}
+
+	/* Long and short edges, anywhere */
+	for ( i = 0; i < 4; i++ )
+	{
+		lwg = gbox_global_line(i + 1, 2000, i % 2 ? 1.0 : 60.0);
+		gbox_geodetic_compare(lwg, 1e-12);
+		lwgeom_free(lwg);
+	}
+}
+
+/*
+* Geocentric box calculation rate, closed form against edge by edge,
+* on dense lines all over the globe. Only run when CU_BENCHMARK is set
+* in the environment.
+*/
+static void test_gbox_geodetic_benchmark(void)
+{
+	double steps[] = {0.01, 1.0, 30.0};
+	int n = 100000, nrep = 20;
+	GBOX gbox;
+	int i, k;
+
+	if (!getenv("CU_BENCHMARK"))
+		return;
+
+	printf("\n");
+	for ( k = 0; k < 3; k++ )
+	{
+		LWGEOM *lwg = gbox_global_line(k + 1, n, steps[k]);
+		clock_t start;
+		double t_fast, t_slow;
+
+		gbox.flags = lwg->flags;
+		start = clock();
+		for ( i = 0; i < nrep; i++ )
+			lwgeom_calculate_gbox_geodetic(lwg, &gbox);
+		t_fast = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		gbox_geocentric_slow = LW_TRUE;
+		start = clock();
+		for ( i = 0; i < nrep; i++ )
+			lwgeom_calculate_gbox_geodetic(lwg, &gbox);
+		t_slow = (double)(clock() - start) / CLOCKS_PER_SEC;
+		gbox_geocentric_slow = LW_FALSE;
+
+		printf("%6g degree steps: closed form %.0f, edge by edge %.0f edges/sec\n",
+		       steps[k], (double)nrep * n / t_fast, (double)nrep * n / t_slow);
+		lwgeom_free(lwg);
+	}
+}
+
 /*
 * Build LWGEOM on top of *aligned* structure so we can use the read-only
 * point access methods on them.
@@ -1167,6 +1295,225 @@ static void test_ptarray_contains_point_sphere_iowa(void)
 	lwgeom_free(lwg);
 }
 
+static void test_ptarray_cart(void)
+{
+	LWGEOM *lwg;
+	LWPOLY *poly;
+	CART_PTARRAY *cpa;
+	GEOGRAPHIC_POINT g;
+	POINT3D p, q;
+	POINT4D pt;
+	POINTARRAY *pta;
+	uint32_t i;
+	int x, y;
+
+	/* Same vectors as geographic_point_init() and geog2cart() */
+	lwg = lwgeom_from_wkt("LINESTRING(0 0,90 45,-180 -30,180 -30,45.5 89.9,-0.000001 -90)", LW_PARSER_CHECK_NONE);
+	cpa = ptarray_cart_new(((LWLINE*)lwg)->points);
+	CU_ASSERT_EQUAL(cpa->npoints, 6);
+	for ( i = 0; i < cpa->npoints; i++ )
+	{
+		const POINT2D *pt2d = getPoint2d_cp(((LWLINE*)lwg)->points, i);
+		geographic_point_init(pt2d->x, pt2d->y, &g);
+		geog2cart(&g, &p);
+		CART_PTARRAY_GET(cpa, i, &q);
+		CU_ASSERT_EQUAL(p.x, q.x);
+		CU_ASSERT_EQUAL(p.y, q.y);
+		CU_ASSERT_EQUAL(p.z, q.z);
+	}
+	/* -180 and 180 are the same place */
+	CU_ASSERT_EQUAL(cpa->y[2], cpa->y[3]);
+	ptarray_cart_free(cpa);
+	lwgeom_free(lwg);
+
+	/* Batch covers agrees with one point at a time */
+	lwg = lwgeom_from_wkt("POLYGON((-10 -10,10 -10,10 10,-10 10,-10 -10),(-5 -5,-5 5,5 5,5 -5,-5 -5))", LW_PARSER_CHECK_NONE);
+	poly = (LWPOLY*)lwg;
+	pta = ptarray_construct_empty(0, 0, 1);
+	for ( x = -12; x <= 12; x++ )
+	{
+		for ( y = -12; y <= 12; y++ )
+		{
+			int covers;
+			pt.x = x;
+			pt.y = y + 0.5;
+			covers = lwpoly_covers_point2d(poly, (POINT2D*)&pt);
+			ptarray_append_point(pta, &pt, LW_TRUE);
+			if ( ! covers )
+			{
+				CU_ASSERT_EQUAL(lwpoly_covers_pointarray(poly, pta), LW_FALSE);
+				ptarray_remove_point(pta, pta->npoints - 1);
+			}
+		}
+	}
+	/* Shell minus hole, points on the meridian edges of either count as on it */
+	CU_ASSERT_EQUAL(pta->npoints, 21 * 20 - 11 * 10);
+	CU_ASSERT_EQUAL(lwpoly_covers_pointarray(poly, pta), LW_TRUE);
+	ptarray_free(pta);
+	lwgeom_free(lwg);
+}
+
+/*
+* Long lines go through throwaway circ trees, which must find the
+* same distance as a visit of every edge pair.
+*/
+static void test_lwgeom_distance_sphere_long(void)
+{
+	SPHEROID s;
+	double offsets[] = {0.0, 0.5, 3.0, 40.0};
+	int k;
+
+	spheroid_init(&s, WGS84_RADIUS, WGS84_RADIUS);
+	for ( k = 0; k < 4; k++ )
+	{
+		POINTARRAY *pa1 = ptarray_construct_empty(0, 0, 50);
+		POINTARRAY *pa2 = ptarray_construct_empty(0, 0, 70);
+		LWGEOM *line1, *line2;
+		GEOGRAPHIC_EDGE e1, e2;
+		POINT3D A1, A2, B1, B2;
+		POINT4D pt = {0, 0, 0, 0};
+		double d, d_min = FLT_MAX;
+		uint32_t i, j;
+
+		/* Two wiggly lines, the second one shifted north */
+		for ( i = 0; i < 50; i++ )
+		{
+			pt.x = -20 + 0.8 * i;
+			pt.y = 2 * sin(i * 0.7);
+			ptarray_append_point(pa1, &pt, LW_TRUE);
+		}
+		for ( i = 0; i < 70; i++ )
+		{
+			pt.x = -25 + 0.7 * i;
+			pt.y = 2.5 + offsets[k] + 1.5 * cos(i * 0.9);
+			ptarray_append_point(pa2, &pt, LW_TRUE);
+		}
+		line1 = (LWGEOM*)lwline_construct(4326, NULL, pa1);
+		line2 = (LWGEOM*)lwline_construct(4326, NULL, pa2);
+
+		for ( i = 0; i + 1 < pa1->npoints; i++ )
+		{
+			const POINT2D *p;
+			p = getPoint2d_cp(pa1, i);
+			geographic_point_init(p->x, p->y, &(e1.start));
+			p = getPoint2d_cp(pa1, i + 1);
+			geographic_point_init(p->x, p->y, &(e1.end));
+			geog2cart(&(e1.start), &A1);
+			geog2cart(&(e1.end), &A2);
+			for ( j = 0; j + 1 < pa2->npoints; j++ )
+			{
+				p = getPoint2d_cp(pa2, j);
+				geographic_point_init(p->x, p->y, &(e2.start));
+				p = getPoint2d_cp(pa2, j + 1);
+				geographic_point_init(p->x, p->y, &(e2.end));
+				geog2cart(&(e2.start), &B1);
+				geog2cart(&(e2.end), &B2);
+				if ( edge_intersects(&A1, &A2, &B1, &B2) )
+					d = 0.0;
+				else
+					d = s.radius * edge_distance_to_edge(&e1, &e2, NULL, NULL);
+				d_min = FP_MIN(d, d_min);
+			}
+		}
+
+		d = lwgeom_distance_spheroid(line1, line2, &s, 0.0);
+		CU_ASSERT_DOUBLE_EQUAL(d, d_min, 0.001);
+		d = lwgeom_distance_spheroid(line2, line1, &s, 0.0);
+		CU_ASSERT_DOUBLE_EQUAL(d, d_min, 0.001);
+		/* The offset is the only thing that moves the lines apart */
+		if ( k == 0 )
+			CU_ASSERT_EQUAL(d_min, 0.0);
+		if ( k == 3 )
+			CU_ASSERT(d_min > 4000000.0);
+
+		lwgeom_free(line1);
+		lwgeom_free(line2);
+	}
+}
+
+/*
+* A ring of n vertices around lon/lat (x, y), each vertex
+* at radius r and r / 2 in turn so edges are not too regular.
+*/
+static POINTARRAY* geodetic_star(int n, double x, double y, double r)
+{
+	POINTARRAY *pa = ptarray_construct_empty(0, 0, n + 1);
+	POINT4D pt = {0, 0, 0, 0};
+	int i;
+
+	for ( i = 0; i < n; i++ )
+	{
+		double a = 2 * M_PI * i / n;
+		double ri = i % 2 ? r / 2 : r;
+		pt.x = x + ri * cos(a);
+		pt.y = y + ri * sin(a);
+		ptarray_append_point(pa, &pt, LW_TRUE);
+	}
+	pt.x = x + r;
+	pt.y = y;
+	ptarray_append_point(pa, &pt, LW_TRUE);
+	return pa;
+}
+
+/*
+* Throughput of the geodetic loops that revisit vertices. Only run
+* when CU_BENCHMARK is set in the environment.
+*/
+static void test_geodetic_cart_benchmark(void)
+{
+	int sizes[] = {100, 1000, 4000};
+	SPHEROID s;
+	int i, k;
+
+	if (!getenv("CU_BENCHMARK"))
+		return;
+
+	spheroid_init(&s, WGS84_RADIUS, WGS84_RADIUS);
+	printf("\n");
+	for ( k = 0; k < 3; k++ )
+	{
+		int n = sizes[k];
+		int nrep = 4000000 / n / n + 1;
+		LWGEOM *line1 = (LWGEOM*)lwline_construct(4326, NULL, geodetic_star(n, 0, 0, 10));
+		LWGEOM *line2 = (LWGEOM*)lwline_construct(4326, NULL, geodetic_star(n, 30, 0, 10));
+		LWPOLY *poly = lwpoly_construct_empty(4326, 0, 0);
+		LWLINE *inner = lwline_construct(4326, NULL, geodetic_star(n, 0, 0, 2));
+		CIRC_NODE *tree;
+		clock_t start;
+		double t_dist, t_covers, t_tree, d = 0;
+		int c = 0;
+
+		lwpoly_add_ring(poly, geodetic_star(n, 0, 0, 10));
+
+		start = clock();
+		for ( i = 0; i < nrep; i++ )
+			d += lwgeom_distance_spheroid(line1, line2, &s, 0.0);
+		t_dist = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		start = clock();
+		for ( i = 0; i < nrep; i++ )
+			c += lwpoly_covers_lwline(poly, inner);
+		t_covers = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		start = clock();
+		for ( i = 0; i < nrep * n; i++ )
+		{
+			tree = lwgeom_calculate_circ_tree(line1);
+			circ_tree_free(tree);
+		}
+		t_tree = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		printf("%5d vertices: distance %.0f, covers %.0f edge pairs/sec, tree %.0f edges/sec (%g %d)\n",
+		       n, (double)nrep * n * n / t_dist, (double)nrep * n * n / t_covers,
+		       (double)nrep * n * n / t_tree, d, c);
+
+		lwgeom_free(line1);
+		lwgeom_free(line2);
+		lwpoly_free(poly);
+		lwline_free(inner);
+	}
+}
+
 
 static void test_lwgeom_distance_sphere(void)
 {
@@ -1332,6 +1679,54 @@ static void test_spheroid_distance(void)
 
 }
 
+static void test_distance_batch(void)
+{
+	GEOGRAPHIC_POINT g, gs[150];
+	double d[150];
+	LWMPOINT *mpt;
+	LWPOINT *pt;
+	SPHEROID s;
+	double tolerances[] = {0.0, 100000.0, 1000000.0};
+	uint32_t i, k;
+
+	spheroid_init(&s, 6378137.0, 6356752.314245179498);
+	point_set(12.5, -41.0, &g);
+	mpt = lwmpoint_construct_empty(4326, 0, 0);
+	for ( i = 0; i < 150; i++ )
+	{
+		/* Near and far, across the antimeridian and up to the poles */
+		double lon = -180 + 2.4 * i;
+		double lat = 89.5 * sin(i * 0.37);
+		point_set(lon, lat, &gs[i]);
+		lwmpoint_add_lwpoint(mpt, lwpoint_make2d(4326, lon, lat));
+	}
+
+	/* Batches answer as the pairwise kernels do */
+	sphere_distance_batch(&g, gs, 150, d);
+	for ( i = 0; i < 150; i++ )
+		CU_ASSERT_DOUBLE_EQUAL(d[i], sphere_distance(&g, &gs[i]), 0.0);
+	spheroid_distance_batch(&g, gs, 150, &s, d);
+	for ( i = 0; i < 150; i++ )
+		CU_ASSERT_DOUBLE_EQUAL(d[i], spheroid_distance(&g, &gs[i], &s), 0.0);
+
+	/* Point/multipoint, against the members one by one */
+	pt = lwpoint_make2d(4326, 12.5, -41.0);
+	for ( k = 0; k < 3; k++ )
+	{
+		double d_min = FLT_MAX;
+		for ( i = 0; i < 150; i++ )
+		{
+			d_min = FP_MIN(d_min, lwgeom_distance_spheroid(lwpoint_as_lwgeom(pt), lwpoint_as_lwgeom(mpt->geoms[i]), &s, tolerances[k]));
+			if ( d_min < tolerances[k] )
+				break;
+		}
+		CU_ASSERT_DOUBLE_EQUAL(lwgeom_distance_spheroid(lwpoint_as_lwgeom(pt), lwmpoint_as_lwgeom(mpt), &s, tolerances[k]), d_min, 1e-6);
+		CU_ASSERT_DOUBLE_EQUAL(lwgeom_distance_spheroid(lwmpoint_as_lwgeom(mpt), lwpoint_as_lwgeom(pt), &s, tolerances[k]), d_min, 1e-6);
+	}
+	lwpoint_free(pt);
+	lwmpoint_free(mpt);
+}
+
 static void test_spheroid_area(void)
 {
 	LWGEOM *lwg;
@@ -1413,6 +1808,62 @@ static void test_spheroid_area(void)
 	lwgeom_free(lwg);
 }
 
+static void test_spheroid_area_authalic(void)
+{
+	LWGEOM *lwg;
+	LWPOLY *poly;
+	POINTARRAY *pa;
+	POINT4D pt;
+	SPHEROID s;
+	double a;
+	int i;
+
+	/* Init to WGS84 */
+	spheroid_init(&s, WGS84_MAJOR_AXIS, WGS84_MINOR_AXIS);
+
+	/* Medford lot test polygon, see test_spheroid_area */
+	lwg = lwgeom_from_wkt("POLYGON((-122.848227067007 42.5007249610493,-122.848309475585 42.5007179884263,-122.848327688675 42.500835880696,-122.848245279942 42.5008428533324,-122.848227067007 42.5007249610493))", LW_PARSER_CHECK_NONE);
+	a = lwgeom_area_spheroid_authalic(lwg, &s);
+	CU_ASSERT_DOUBLE_EQUAL(a, 89.868413479309585, 1e-6);
+	lwgeom_free(lwg);
+
+	/* Lot with a hole, across the equator and the prime meridian */
+	/* Planimeter -E -p 20 -r, outer ring less inner ring */
+	lwg = lwgeom_from_wkt("MULTIPOLYGON(((-0.0005 -0.0004,0.0005 -0.0004,0.0005 0.0004,-0.0005 0.0004,-0.0005 -0.0004),(-0.0001 -0.0001,-0.0001 0.0001,0.0001 0.0001,0.0001 -0.0001,-0.0001 -0.0001)))", LW_PARSER_CHECK_NONE);
+	a = lwgeom_area_spheroid_authalic(lwg, &s);
+	CU_ASSERT_DOUBLE_EQUAL(a, 9354.894780437586, 1e-6);
+	lwgeom_free(lwg);
+
+	/* Lot across the antimeridian, Planimeter -E -p 20 -r */
+	lwg = lwgeom_from_wkt("POLYGON((179.9995 -60.0002,-179.9995 -60.0002,-179.9995 -59.9998,179.9995 -59.9998,179.9995 -60.0002))", LW_PARSER_CHECK_NONE);
+	a = lwgeom_area_spheroid_authalic(lwg, &s);
+	CU_ASSERT_DOUBLE_EQUAL(a, 2486.7223259210587, 1e-6);
+	lwgeom_free(lwg);
+
+	/* Ring of short edges around the north pole, Planimeter -E -p 20 */
+	pa = ptarray_construct_empty(LW_FALSE, LW_FALSE, 3601);
+	for ( i = 0; i <= 3600; i++ )
+	{
+		pt.x = -180.0 + i / 10.0;
+		pt.y = 85.0;
+		ptarray_append_point(pa, &pt, LW_TRUE);
+	}
+	poly = lwpoly_construct_empty(SRID_DEFAULT, LW_FALSE, LW_FALSE);
+	lwpoly_add_ring(poly, pa);
+	a = lwgeom_area_spheroid_authalic(lwpoly_as_lwgeom(poly), &s);
+	CU_ASSERT_DOUBLE_EQUAL(a, 979154705836.1562, 979154705836.1562 * 1e-9);
+	lwpoly_free(poly);
+
+	/* Long edges go to the strip or geodesic polygon code */
+	lwg = lwgeom_from_wkt("POLYGON((8.5 42,8.5 41,9.5 41,9.5 42,8.5 42))", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_EQUAL(lwgeom_area_spheroid_authalic(lwg, &s), lwgeom_area_spheroid(lwg, &s));
+	lwgeom_free(lwg);
+
+	lwg = lwgeom_from_wkt("LINESTRING(0 0,0.001 0.001)", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_EQUAL(lwgeom_area_spheroid_authalic(lwg, &s), 0.0);
+	lwgeom_free(lwg);
+}
+
 static void test_gbox_utils(void)
 {
 	LWGEOM *lwg;
@@ -1528,6 +1979,8 @@ static void test_lwgeom_segmentize_sphere(void)
 	lwl = (LWLINE*)lwg2;
 	// printf("%s\n", lwgeom_to_ewkt(lwg2));
 	CU_ASSERT_EQUAL(lwl->points->npoints, 9);
+	/* Output arrays are sized up front */
+	CU_ASSERT_EQUAL(lwl->points->maxpoints, 9);
 	lwgeom_free(lwg1);
 	lwgeom_free(lwg2);
 	//lwfree(wkt);
@@ -1535,6 +1988,58 @@ static void test_lwgeom_segmentize_sphere(void)
 	return;
 }
 
+static void test_lwgeom_densify_sphere(void)
+{
+	LWGEOM *lwg1, *lwg2;
+	LWLINE *lwl;
+	POINT3D a, b, n, q;
+	GEOGRAPHIC_POINT g;
+	POINT4D p;
+	double max = 1000.0 / WGS84_RADIUS;
+	uint32_t i, npoints;
+
+	/* Meridians and the equator are straight in longitude/latitude */
+	lwg1 = lwgeom_from_wkt("MULTILINESTRING((0 -60,0 60),(-170 0,170 0))", LW_PARSER_CHECK_NONE);
+	lwg2 = lwgeom_densify_sphere(lwg1, max);
+	CU_ASSERT_EQUAL(lwgeom_count_vertices(lwg2), 4);
+	lwgeom_free(lwg1);
+	lwgeom_free(lwg2);
+
+	/* An edge crossing the equator bends both ways; the added */
+	/* vertices are on its great circle and z/m are interpolated */
+	lwg1 = lwgeom_from_wkt("LINESTRING ZM(-30 -40 0 10,60 50 100 20)", LW_PARSER_CHECK_NONE);
+	lwg2 = lwgeom_densify_sphere(lwg1, max);
+	lwl = (LWLINE*)lwg2;
+	npoints = lwl->points->npoints;
+	CU_ASSERT(npoints > 10);
+	geographic_point_init(-30, -40, &g);
+	geog2cart(&g, &a);
+	geographic_point_init(60, 50, &g);
+	geog2cart(&g, &b);
+	unit_normal(&a, &b, &n);
+	for ( i = 0; i < lwl->points->npoints; i++ )
+	{
+		getPoint4d_p(lwl->points, i, &p);
+		geographic_point_init(p.x, p.y, &g);
+		geog2cart(&g, &q);
+		CU_ASSERT_DOUBLE_EQUAL(n.x * q.x + n.y * q.y + n.z * q.z, 0.0, 1e-12);
+		CU_ASSERT(p.z >= 0.0 && p.z <= 100.0);
+		CU_ASSERT_DOUBLE_EQUAL(p.m, 10.0 + p.z / 10.0, 1e-9);
+	}
+	getPoint4d_p(lwl->points, lwl->points->npoints - 1, &p);
+	CU_ASSERT_DOUBLE_EQUAL(p.x, 60.0, 1e-12);
+	CU_ASSERT_DOUBLE_EQUAL(p.y, 50.0, 1e-12);
+
+	lwgeom_free(lwg2);
+
+	/* Looser bounds take fewer vertices */
+	lwg2 = lwgeom_densify_sphere(lwg1, 10 * max);
+	CU_ASSERT(lwgeom_count_vertices(lwg2) > 2);
+	CU_ASSERT(lwgeom_count_vertices(lwg2) < npoints);
+	lwgeom_free(lwg1);
+	lwgeom_free(lwg2);
+}
+
 static void test_lwgeom_area_sphere(void)
 {
 	LWGEOM *lwg;
@@ -1603,22 +2108,30 @@ void geodetic_suite_setup(void)
 	PG_ADD_TEST(suite, test_lwgeom_area_sphere);
 	PG_ADD_TEST(suite, test_gbox_from_spherical_coordinates);
 	PG_ADD_TEST(suite, test_gserialized_get_gbox_geocentric);
+	PG_ADD_TEST(suite, test_ptarray_calculate_gbox_geodetic);
+	PG_ADD_TEST(suite, test_gbox_geodetic_benchmark);
 	PG_ADD_TEST(suite, test_clairaut);
 	PG_ADD_TEST(suite, test_edge_intersection);
 	PG_ADD_TEST(suite, test_edge_intersects);
 	PG_ADD_TEST(suite, test_edge_distance_to_point);
 	PG_ADD_TEST(suite, test_edge_distance_to_edge);
 	PG_ADD_TEST(suite, test_lwgeom_distance_sphere);
+	PG_ADD_TEST(suite, test_lwgeom_distance_sphere_long);
 	PG_ADD_TEST(suite, test_lwgeom_check_geodetic);
 	PG_ADD_TEST(suite, test_gserialized_from_lwgeom);
 	PG_ADD_TEST(suite, test_spheroid_distance);
+	PG_ADD_TEST(suite, test_distance_batch);
 	PG_ADD_TEST(suite, test_spheroid_area);
+	PG_ADD_TEST(suite, test_spheroid_area_authalic);
 	PG_ADD_TEST(suite, test_lwpoly_covers_point2d);
 	PG_ADD_TEST(suite, test_gbox_utils);
 	PG_ADD_TEST(suite, test_vector_angle);
 	PG_ADD_TEST(suite, test_vector_rotate);
 	PG_ADD_TEST(suite, test_lwgeom_segmentize_sphere);
+	PG_ADD_TEST(suite, test_lwgeom_densify_sphere);
 	PG_ADD_TEST(suite, test_ptarray_contains_point_sphere);
 	PG_ADD_TEST(suite, test_ptarray_contains_point_sphere_iowa);
+	PG_ADD_TEST(suite, test_ptarray_cart);
+	PG_ADD_TEST(suite, test_geodetic_cart_benchmark);
 	PG_ADD_TEST(suite, test_gbox_to_string_truncated);
 }
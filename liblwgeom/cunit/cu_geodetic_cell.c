@@ -0,0 +1,272 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "CUnit/Basic.h"
+
+#include "liblwgeom_internal.h"
+#include "lwgeodetic.h"
+#include "lwgeodetic_cell.h"
+#include "cu_tester.h"
+
+/* Whether a leaf cell falls in one of the cells of a covering */
+static int
+cell_in_covering(CELL_ID leaf, const CELL_ID *cells, uint32_t ncells)
+{
+	uint32_t i;
+	for ( i = 0; i < ncells; i++ )
+	{
+		if ( leaf >= cell_range_min(cells[i]) && leaf <= cell_range_max(cells[i]) )
+			return LW_TRUE;
+	}
+	return LW_FALSE;
+}
+
+static void test_cell_ids(void)
+{
+	POINT2D pt;
+	CELL_ID leaf, id;
+	int i, level;
+
+	/* The face cells */
+	pt.x = 0; pt.y = 0;
+	CU_ASSERT_EQUAL(cell_from_point(&pt, 0), UINT64_C(1) << 60);
+	pt.x = 90; pt.y = 0;
+	CU_ASSERT_EQUAL(cell_from_point(&pt, 0), (UINT64_C(1) << 61) | (UINT64_C(1) << 60));
+	pt.x = 0; pt.y = -90;
+	CU_ASSERT_EQUAL(cell_from_point(&pt, 0), (UINT64_C(5) << 61) | (UINT64_C(1) << 60));
+
+	CU_ASSERT_FALSE(cell_is_valid(0));
+	CU_ASSERT_FALSE(cell_is_valid(UINT64_C(6) << 61 | 1));
+	CU_ASSERT_FALSE(cell_is_valid(UINT64_C(1) << 59));
+	CU_ASSERT_FALSE(cell_is_valid(UINT64_C(1) << 62));
+	CU_ASSERT_TRUE(cell_is_valid(UINT64_C(1) << 60));
+
+	/* Parents, children and ranges of the cells of points */
+	for ( i = 0; i < 200; i++ )
+	{
+		pt.x = -180.0 + 360.0 * ((i * 37) % 200) / 200.0;
+		pt.y = 89.9 * sin(i * 0.61);
+		leaf = cell_from_point(&pt, CELL_MAX_LEVEL);
+		CU_ASSERT(cell_is_valid(leaf));
+		CU_ASSERT_EQUAL(cell_level(leaf), CELL_MAX_LEVEL);
+		CU_ASSERT(leaf & 1);
+
+		for ( level = 0; level <= CELL_MAX_LEVEL; level++ )
+		{
+			int k, nchild = 0;
+			id = cell_from_point(&pt, level);
+			CU_ASSERT(cell_is_valid(id));
+			CU_ASSERT_EQUAL(cell_level(id), level);
+			CU_ASSERT_EQUAL(cell_parent(leaf, level), id);
+			CU_ASSERT(leaf >= cell_range_min(id) && leaf <= cell_range_max(id));
+			if ( level == CELL_MAX_LEVEL )
+				continue;
+			for ( k = 0; k < 4; k++ )
+			{
+				CELL_ID child = cell_child(id, k);
+				CU_ASSERT_EQUAL(cell_parent(child, level), id);
+				CU_ASSERT(child >= cell_range_min(id) && child <= cell_range_max(id));
+				if ( child == cell_from_point(&pt, level + 1) )
+					nchild++;
+			}
+			CU_ASSERT_EQUAL(nchild, 1);
+		}
+	}
+}
+
+static void test_cell_geometry(void)
+{
+	SPHEROID s;
+	POINT2D pt;
+	double area = 0.0;
+	int face, level;
+
+	/* The six faces share the sphere */
+	spheroid_init(&s, 1.0, 1.0);
+	for ( face = 0; face < 6; face++ )
+	{
+		LWPOLY *poly = cell_to_lwpoly((UINT64_C(1) << 60) | ((CELL_ID)face << 61), 4326);
+		double a = lwgeom_area_sphere(lwpoly_as_lwgeom(poly), &s);
+		CU_ASSERT_DOUBLE_EQUAL(a, 4.0 * M_PI / 6.0, 1e-9);
+		area += a;
+		lwpoly_free(poly);
+	}
+	CU_ASSERT_DOUBLE_EQUAL(area, 4.0 * M_PI, 1e-9);
+
+	/* A cell holds its centre, and its children split its area */
+	pt.x = 23.4;
+	pt.y = 61.2;
+	for ( level = 0; level < 16; level += 3 )
+	{
+		CELL_ID id = cell_from_point(&pt, level);
+		LWPOLY *poly = cell_to_lwpoly(id, 4326);
+		double a = lwgeom_area_sphere(lwpoly_as_lwgeom(poly), &s);
+		double a_children = 0.0;
+		POINT2D center;
+		int k;
+
+		cell_center(id, &center);
+		CU_ASSERT_EQUAL(cell_from_point(&center, level), id);
+		CU_ASSERT(lwpoly_covers_point2d(poly, &center));
+		for ( k = 0; k < 4; k++ )
+		{
+			LWPOLY *child = cell_to_lwpoly(cell_child(id, k), 4326);
+			a_children += lwgeom_area_sphere(lwpoly_as_lwgeom(child), &s);
+			lwpoly_free(child);
+		}
+		CU_ASSERT_DOUBLE_EQUAL(a_children, a, a * 1e-6);
+		lwpoly_free(poly);
+	}
+}
+
+static void test_cell_covering(void)
+{
+	LWGEOM *g;
+	CELL_ID *cells, *interior;
+	uint32_t ncells, ninterior, i;
+	int j;
+
+	/* A polygon with a hole */
+	g = lwgeom_from_wkt("POLYGON((-5 40,10 40,10 52,-5 52,-5 40),(0 44,4 44,4 48,0 48,0 44))", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 7, 0, LW_FALSE, &cells, &ncells), LW_SUCCESS);
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 7, 0, LW_TRUE, &interior, &ninterior), LW_SUCCESS);
+	CU_ASSERT(ninterior > 0);
+	CU_ASSERT(ncells > ninterior);
+
+	/* Sorted, of levels up to 7 */
+	for ( i = 0; i < ncells; i++ )
+	{
+		CU_ASSERT(cell_level(cells[i]) <= 7);
+		if ( i )
+			CU_ASSERT(cell_range_max(cells[i - 1]) < cell_range_min(cells[i]));
+	}
+
+	/* Interior cells are in the covering and inside the polygon */
+	for ( i = 0; i < ninterior; i++ )
+	{
+		LWPOLY *poly = cell_to_lwpoly(interior[i], 4326);
+		uint32_t k;
+		CU_ASSERT(cell_in_covering(interior[i], cells, ncells));
+		for ( k = 0; k < 4; k++ )
+			CU_ASSERT(lwpoly_covers_point2d((LWPOLY*)g, getPoint2d_cp(poly->rings[0], k)));
+		lwpoly_free(poly);
+	}
+
+	/* Points of the polygon are covered, points in the interior */
+	/* covering are in the polygon */
+	for ( j = 0; j < 2000; j++ )
+	{
+		POINT2D pt;
+		CELL_ID leaf;
+		pt.x = -8.0 + 21.0 * ((j * 53) % 2000) / 2000.0;
+		pt.y = 37.0 + 18.0 * ((j * 31) % 2000) / 2000.0;
+		leaf = cell_from_point(&pt, CELL_MAX_LEVEL);
+		if ( lwpoly_covers_point2d((LWPOLY*)g, &pt) )
+			CU_ASSERT(cell_in_covering(leaf, cells, ncells));
+		if ( cell_in_covering(leaf, interior, ninterior) )
+			CU_ASSERT(lwpoly_covers_point2d((LWPOLY*)g, &pt));
+	}
+	lwfree(cells);
+	lwfree(interior);
+	lwgeom_free(g);
+
+	/* Lines have no interior */
+	g = lwgeom_from_wkt("LINESTRING(-170 10,170 12,175 60)", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 9, 0, LW_TRUE, &cells, &ncells), LW_SUCCESS);
+	CU_ASSERT_EQUAL(ncells, 0);
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 9, 0, LW_FALSE, &cells, &ncells), LW_SUCCESS);
+	for ( i = 0; i < 3; i++ )
+	{
+		const POINT2D *pt = getPoint2d_cp(((LWLINE*)g)->points, i);
+		CU_ASSERT(cell_in_covering(cell_from_point(pt, CELL_MAX_LEVEL), cells, ncells));
+	}
+	for ( i = 0; i < ncells; i++ )
+		CU_ASSERT_EQUAL(cell_level(cells[i]), 9);
+	lwfree(cells);
+	lwgeom_free(g);
+
+	/* Points get the cells they are in */
+	g = lwgeom_from_wkt("MULTIPOINT(1 1,1.0001 1.0001,-120 -45)", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 12, 0, LW_FALSE, &cells, &ncells), LW_SUCCESS);
+	CU_ASSERT_EQUAL(ncells, 2);
+	for ( i = 0; i < 3; i++ )
+	{
+		const POINT2D *pt = getPoint2d_cp(((LWMPOINT*)g)->geoms[i]->point, 0);
+		CU_ASSERT(cell_in_covering(cell_from_point(pt, CELL_MAX_LEVEL), cells, ncells));
+	}
+	lwfree(cells);
+	lwgeom_free(g);
+
+	g = lwgeom_from_wkt("POLYGON EMPTY", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 12, 0, LW_FALSE, &cells, &ncells), LW_SUCCESS);
+	CU_ASSERT_EQUAL(ncells, 0);
+	CU_ASSERT_PTR_NULL(cells);
+	lwgeom_free(g);
+}
+
+static void test_cell_covering_max_cells(void)
+{
+	LWGEOM *g;
+	CELL_ID *cells, *capped;
+	uint32_t ncells, ncapped, i;
+	int j;
+
+	g = lwgeom_from_wkt("POLYGON((-5 40,10 40,10 52,-5 52,-5 40),(0 44,4 44,4 48,0 48,0 44))", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 12, 0, LW_FALSE, &cells, &ncells), LW_SUCCESS);
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 12, 50, LW_FALSE, &capped, &ncapped), LW_SUCCESS);
+	CU_ASSERT(ncells > 50);
+	CU_ASSERT(ncapped > 0);
+	CU_ASSERT(ncapped <= 50);
+
+	/* Coarser cells, still sorted and covering every point */
+	for ( i = 1; i < ncapped; i++ )
+		CU_ASSERT(cell_range_max(capped[i - 1]) < cell_range_min(capped[i]));
+	for ( i = 0; i < ncells; i++ )
+		CU_ASSERT(cell_in_covering(cells[i], capped, ncapped));
+	for ( j = 0; j < 2000; j++ )
+	{
+		POINT2D pt;
+		pt.x = -8.0 + 21.0 * ((j * 53) % 2000) / 2000.0;
+		pt.y = 37.0 + 18.0 * ((j * 31) % 2000) / 2000.0;
+		if ( lwpoly_covers_point2d((LWPOLY*)g, &pt) )
+			CU_ASSERT(cell_in_covering(cell_from_point(&pt, CELL_MAX_LEVEL), capped, ncapped));
+	}
+	lwfree(cells);
+	lwfree(capped);
+
+	/* Interior cells past the budget are dropped */
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 12, 50, LW_TRUE, &capped, &ncapped), LW_SUCCESS);
+	CU_ASSERT(ncapped <= 50);
+	lwfree(capped);
+
+	/* Interrupted */
+	lwgeom_request_interrupt();
+	CU_ASSERT_EQUAL(lwgeom_cell_covering(g, 12, 0, LW_FALSE, &cells, &ncells), LW_FAILURE);
+	CU_ASSERT_PTR_NULL(cells);
+	CU_ASSERT_EQUAL(ncells, 0);
+	lwgeom_free(g);
+}
+
+/*
+** Used by test harness to register the tests in this file.
+*/
+void geodetic_cell_suite_setup(void);
+void geodetic_cell_suite_setup(void)
+{
+	CU_pSuite suite = CU_add_suite("geodetic_cell", NULL, NULL);
+	PG_ADD_TEST(suite, test_cell_ids);
+	PG_ADD_TEST(suite, test_cell_geometry);
+	PG_ADD_TEST(suite, test_cell_covering);
+	PG_ADD_TEST(suite, test_cell_covering_max_cells);
+}
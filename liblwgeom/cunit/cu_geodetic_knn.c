@@ -0,0 +1,262 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "CUnit/Basic.h"
+
+#include "liblwgeom_internal.h"
+#include "lwgeodetic.h"
+#include "lwgeodetic_tree.h"
+#include "lwgeodetic_knn.h"
+#include "cu_tester.h"
+
+#define KNN_NGEOMS 300
+
+/* Reproducible coordinates, without depending on the C library */
+static double
+knn_random(uint32_t *seed, double min, double max)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return min + (max - min) * ((*seed >> 8) & 0xFFFF) / 65535.0;
+}
+
+/* Points, short lines and small squares, all over the sphere, with an empty */
+static LWGEOM**
+knn_geoms(uint32_t seed, uint32_t n)
+{
+	LWGEOM **geoms = lwalloc(sizeof(LWGEOM*) * n);
+	char wkt[256];
+	uint32_t i;
+
+	for ( i = 0; i < n; i++ )
+	{
+		double x = knn_random(&seed, -179, 179);
+		double y = knn_random(&seed, -89, 89);
+		if ( i == 7 )
+			snprintf(wkt, sizeof(wkt), "POINT EMPTY");
+		else if ( i % 5 == 1 )
+			snprintf(wkt, sizeof(wkt), "LINESTRING(%g %g,%g %g)", x, y, x + 0.5, y + 0.5);
+		else if ( i % 5 == 2 )
+			snprintf(wkt, sizeof(wkt), "POLYGON((%g %g,%g %g,%g %g,%g %g,%g %g))", x, y, x + 0.5, y, x + 0.5, y + 0.5, x, y + 0.5, x, y);
+		else
+			snprintf(wkt, sizeof(wkt), "POINT(%g %g)", x, y);
+		geoms[i] = lwgeom_from_wkt(wkt, LW_PARSER_CHECK_NONE);
+	}
+	return geoms;
+}
+
+static void
+knn_geoms_free(LWGEOM **geoms, uint32_t n)
+{
+	uint32_t i;
+	for ( i = 0; i < n; i++ )
+		lwgeom_free(geoms[i]);
+	lwfree(geoms);
+}
+
+static int
+knn_pair_cmp(const void *a, const void *b)
+{
+	const CIRC_KNN_PAIR *pa = (const CIRC_KNN_PAIR*)a;
+	const CIRC_KNN_PAIR *pb = (const CIRC_KNN_PAIR*)b;
+	if ( pa->distance != pb->distance )
+		return pa->distance < pb->distance ? -1 : 1;
+	return pa->candidate < pb->candidate ? -1 : pa->candidate > pb->candidate;
+}
+
+/* The k nearest geometries, the slow way */
+static uint32_t
+knn_brute_force(LWGEOM **geoms, uint32_t ngeoms, const CIRC_NODE *tree, uint32_t k, double max_distance, CIRC_KNN_PAIR *pairs)
+{
+	CIRC_KNN_PAIR *all = lwalloc(sizeof(CIRC_KNN_PAIR) * ngeoms);
+	SPHEROID s;
+	uint32_t i, n = 0;
+
+	spheroid_init(&s, 1.0, 1.0);
+	for ( i = 0; i < ngeoms; i++ )
+	{
+		CIRC_NODE *t = lwgeom_calculate_circ_tree(geoms[i]);
+		if ( ! t )
+			continue;
+		all[n].candidate = i;
+		all[n].distance = circ_tree_distance_tree(tree, t, &s, 0.0);
+		circ_tree_free(t);
+		if ( max_distance < 0.0 || all[n].distance <= max_distance )
+			n++;
+	}
+	qsort(all, n, sizeof(CIRC_KNN_PAIR), knn_pair_cmp);
+	if ( n > k )
+		n = k;
+	memcpy(pairs, all, sizeof(CIRC_KNN_PAIR) * n);
+	lwfree(all);
+	return n;
+}
+
+static void test_knn_index_nearest(void)
+{
+	LWGEOM **geoms = knn_geoms(1, KNN_NGEOMS);
+	LWGEOM **probes = knn_geoms(2, 50);
+	CIRC_KNN_INDEX *index = circ_knn_index_new((const LWGEOM**)geoms, KNN_NGEOMS);
+	CIRC_KNN_PAIR found[10], expected[10];
+	uint32_t ks[] = {1, 3, 10};
+	double max_distances[] = {-1.0, 0.05};
+	uint32_t i, j, m, n, nexp;
+
+	for ( i = 0; i < 50; i++ )
+	{
+		CIRC_NODE *tree = lwgeom_calculate_circ_tree(probes[i]);
+		if ( ! tree )
+			continue;
+		for ( j = 0; j < 3; j++ )
+		{
+			for ( m = 0; m < 2; m++ )
+			{
+				n = circ_knn_index_nearest(index, tree, ks[j], max_distances[m], found);
+				nexp = knn_brute_force(geoms, KNN_NGEOMS, tree, ks[j], max_distances[m], expected);
+				CU_ASSERT_EQUAL(n, nexp);
+				if ( n == nexp )
+				{
+					uint32_t p;
+					for ( p = 0; p < n; p++ )
+					{
+						CU_ASSERT_EQUAL(found[p].candidate, expected[p].candidate);
+						CU_ASSERT_DOUBLE_EQUAL(found[p].distance, expected[p].distance, 1e-15);
+					}
+				}
+			}
+		}
+		circ_tree_free(tree);
+	}
+
+	circ_knn_index_free(index);
+	knn_geoms_free(geoms, KNN_NGEOMS);
+	knn_geoms_free(probes, 50);
+}
+
+static void test_knn_join(void)
+{
+	LWGEOM **geoms = knn_geoms(3, KNN_NGEOMS);
+	LWGEOM **probes = knn_geoms(4, 100);
+	CIRC_KNN_INDEX *index = circ_knn_index_new((const LWGEOM**)geoms, KNN_NGEOMS);
+	CIRC_KNN_PAIR *pairs, expected[4];
+	uint32_t i, p, n, nexp, npairs;
+
+	CU_ASSERT_EQUAL(circ_knn_join(index, (const LWGEOM**)probes, 100, 4, -1.0, &pairs, &npairs), LW_SUCCESS);
+	/* The empty probe has no neighbours */
+	CU_ASSERT_EQUAL(npairs, 99 * 4);
+
+	/* Searches seeded with the neighbours of another probe find the same */
+	n = 0;
+	for ( i = 0; i < 100; i++ )
+	{
+		CIRC_NODE *tree = lwgeom_calculate_circ_tree(probes[i]);
+		nexp = tree ? knn_brute_force(geoms, KNN_NGEOMS, tree, 4, -1.0, expected) : 0;
+		for ( p = 0; p < nexp && n < npairs; p++, n++ )
+		{
+			CU_ASSERT_EQUAL(pairs[n].probe, i);
+			CU_ASSERT_EQUAL(pairs[n].candidate, expected[p].candidate);
+			CU_ASSERT_DOUBLE_EQUAL(pairs[n].distance, expected[p].distance, 1e-15);
+		}
+		if ( tree )
+			circ_tree_free(tree);
+	}
+	CU_ASSERT_EQUAL(n, npairs);
+	lwfree(pairs);
+
+	/* Within a limit, some probes have fewer neighbours */
+	CU_ASSERT_EQUAL(circ_knn_join(index, (const LWGEOM**)probes, 100, 4, 0.02, &pairs, &npairs), LW_SUCCESS);
+	n = 0;
+	for ( i = 0; i < 100; i++ )
+	{
+		CIRC_NODE *tree = lwgeom_calculate_circ_tree(probes[i]);
+		nexp = tree ? knn_brute_force(geoms, KNN_NGEOMS, tree, 4, 0.02, expected) : 0;
+		for ( p = 0; p < nexp && n < npairs; p++, n++ )
+		{
+			CU_ASSERT_EQUAL(pairs[n].probe, i);
+			CU_ASSERT_EQUAL(pairs[n].candidate, expected[p].candidate);
+		}
+		if ( tree )
+			circ_tree_free(tree);
+	}
+	CU_ASSERT_EQUAL(n, npairs);
+	CU_ASSERT(npairs < 99 * 4);
+	if ( npairs )
+		lwfree(pairs);
+
+	/* More neighbours asked for than there are */
+	CU_ASSERT_EQUAL(circ_knn_join(index, (const LWGEOM**)probes, 1, 1000, -1.0, &pairs, &npairs), LW_SUCCESS);
+	CU_ASSERT_EQUAL(npairs, KNN_NGEOMS - 1);
+	lwfree(pairs);
+
+	/* Interrupted */
+	lwgeom_request_interrupt();
+	CU_ASSERT_EQUAL(circ_knn_join(index, (const LWGEOM**)probes, 100, 4, -1.0, &pairs, &npairs), LW_FAILURE);
+	CU_ASSERT_PTR_NULL(pairs);
+	CU_ASSERT_EQUAL(npairs, 0);
+	circ_knn_index_free(index);
+	lwgeom_request_interrupt();
+	CU_ASSERT_PTR_NULL(circ_knn_index_new((const LWGEOM**)geoms, KNN_NGEOMS));
+
+	knn_geoms_free(geoms, KNN_NGEOMS);
+	knn_geoms_free(probes, 100);
+}
+
+static void test_knn_edge_cases(void)
+{
+	LWGEOM *geoms[3];
+	LWGEOM *probe;
+	CIRC_KNN_INDEX *index;
+	CIRC_KNN_PAIR *pairs;
+	uint32_t npairs;
+
+	/* Nothing to find */
+	geoms[0] = lwgeom_from_wkt("POINT EMPTY", LW_PARSER_CHECK_NONE);
+	probe = lwgeom_from_wkt("POINT(0 0)", LW_PARSER_CHECK_NONE);
+	index = circ_knn_index_new((const LWGEOM**)geoms, 1);
+	CU_ASSERT_EQUAL(circ_knn_join(index, (const LWGEOM**)&probe, 1, 1, -1.0, &pairs, &npairs), LW_SUCCESS);
+	CU_ASSERT_EQUAL(npairs, 0);
+	CU_ASSERT_PTR_NULL(pairs);
+	circ_knn_index_free(index);
+	lwgeom_free(geoms[0]);
+
+	/* Inside a polygon is closer than near its rings */
+	geoms[0] = lwgeom_from_wkt("POINT(1 1)", LW_PARSER_CHECK_NONE);
+	geoms[1] = lwgeom_from_wkt("LINESTRING(-1 -1,-1 1)", LW_PARSER_CHECK_NONE);
+	geoms[2] = lwgeom_from_wkt("POLYGON((-20 -20,20 -20,20 20,-20 20,-20 -20))", LW_PARSER_CHECK_NONE);
+	index = circ_knn_index_new((const LWGEOM**)geoms, 3);
+	CU_ASSERT_EQUAL(circ_knn_join(index, (const LWGEOM**)&probe, 1, 3, -1.0, &pairs, &npairs), LW_SUCCESS);
+	CU_ASSERT_EQUAL(npairs, 3);
+	CU_ASSERT_EQUAL(pairs[0].candidate, 2);
+	CU_ASSERT_DOUBLE_EQUAL(pairs[0].distance, 0.0, 1e-15);
+	CU_ASSERT_EQUAL(pairs[1].candidate, 1);
+	CU_ASSERT_DOUBLE_EQUAL(pairs[1].distance, deg2rad(1.0), 1e-9);
+	CU_ASSERT_EQUAL(pairs[2].candidate, 0);
+	lwfree(pairs);
+	circ_knn_index_free(index);
+	lwgeom_free(geoms[0]);
+	lwgeom_free(geoms[1]);
+	lwgeom_free(geoms[2]);
+	lwgeom_free(probe);
+}
+
+/*
+** Used by test harness to register the tests in this file.
+*/
+void geodetic_knn_suite_setup(void);
+void geodetic_knn_suite_setup(void)
+{
+	CU_pSuite suite = CU_add_suite("geodetic_knn", NULL, NULL);
+	PG_ADD_TEST(suite, test_knn_index_nearest);
+	PG_ADD_TEST(suite, test_knn_join);
+	PG_ADD_TEST(suite, test_knn_edge_cases);
+}
@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
 #include "CUnit/Basic.h"
 
 #include "lwgeom_geos.h"
@@ -158,6 +160,107 @@ static void test_geos_subdivide(void)
 #endif
 }
 
+/*
+* Point arrays through GEOS coordinate sequences and back: Z kept,
+* M dropped, and rings closed on the way when asked to.
+*/
+static void
+test_geos_coordseq(void)
+{
+	struct {
+		const char *wkt;
+		uint8_t fix_ring;
+		const char *expected;
+	} cases[] = {
+		{ "LINESTRING(0 0,1 2.5,3 -1)", 0, "LINESTRING(0 0,1 2.5,3 -1)" },
+		{ "LINESTRING Z (0 0 1,1 2.5 2,3 -1 3)", 0, "LINESTRING Z (0 0 1,1 2.5 2,3 -1 3)" },
+		{ "LINESTRING M (0 0 1,1 2.5 2)", 0, "LINESTRING(0 0,1 2.5)" },
+		{ "LINESTRING ZM (0 0 1 5,1 2.5 2 6)", 0, "LINESTRING Z (0 0 1,1 2.5 2)" },
+		{ "LINESTRING(0 0,1 0,1 1,0 0)", 1, "LINESTRING(0 0,1 0,1 1,0 0)" },
+		{ "LINESTRING(0 0,1 0,1 1,0 1)", 1, "LINESTRING(0 0,1 0,1 1,0 1,0 0)" },
+		{ "LINESTRING Z (0 0 1,1 1 2)", 1, "LINESTRING Z (0 0 1,1 1 2,0 0 1,0 0 1)" },
+		{ "LINESTRING M (0 0 1,1 0 2,1 1 3)", 1, "LINESTRING(0 0,1 0,1 1,0 0)" }
+	};
+	size_t i;
+
+	initGEOS(lwnotice, lwgeom_geos_error);
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		LWLINE *line = (LWLINE*)lwgeom_from_wkt(cases[i].wkt, LW_PARSER_CHECK_NONE);
+		GEOSCoordSeq sq = ptarray_to_GEOSCoordSeq(line->points, cases[i].fix_ring);
+		POINTARRAY *pa = ptarray_from_GEOSCoordSeq(sq, FLAGS_GET_Z(line->points->flags));
+		LWLINE *out = lwline_construct(SRID_UNKNOWN, NULL, pa);
+		char *out_wkt = lwgeom_to_wkt((LWGEOM*)out, WKT_ISO, 15, NULL);
+
+		ASSERT_STRING_EQUAL(out_wkt, cases[i].expected);
+
+		lwfree(out_wkt);
+		lwline_free(out);
+		GEOSCoordSeq_destroy(sq);
+		lwline_free(line);
+	}
+}
+
+/*
+* Throughput of the conversions of a large polygon to GEOS and
+* back. Only run when CU_BENCHMARK is set in the environment.
+*/
+static void
+test_geos_conversion_benchmark(void)
+{
+	int npoints = 1000000;
+	int runs = 10;
+	int hasz, i, r;
+
+	if (!getenv("CU_BENCHMARK"))
+		return;
+
+	printf("\n");
+	for (hasz = 0; hasz < 2; hasz++)
+	{
+		POINTARRAY **rings = lwalloc(sizeof(POINTARRAY*));
+		POINT4D pt = {0, 0, 0, 0};
+		LWGEOM *geom, *back = NULL;
+		GEOSGeometry *g = NULL;
+		clock_t start;
+		double t_to = 0, t_from = 0;
+
+		rings[0] = ptarray_construct_empty(hasz, 0, npoints + 1);
+		for (i = 0; i < npoints; i++)
+		{
+			double a = 2 * M_PI * i / npoints;
+			pt.x = cos(a) * (1000 + (i % 7));
+			pt.y = sin(a) * (1000 + (i % 7));
+			pt.z = i;
+			ptarray_append_point(rings[0], &pt, LW_TRUE);
+		}
+		getPoint4d_p(rings[0], 0, &pt);
+		ptarray_append_point(rings[0], &pt, LW_TRUE);
+		geom = (LWGEOM*)lwpoly_construct(SRID_UNKNOWN, NULL, 1, rings);
+
+		initGEOS(lwnotice, lwgeom_geos_error);
+		for (r = 0; r < runs; r++)
+		{
+			start = clock();
+			g = LWGEOM2GEOS(geom, 0);
+			t_to += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+			start = clock();
+			back = GEOS2LWGEOM(g, hasz);
+			t_from += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+			CU_ASSERT_EQUAL(lwgeom_count_vertices(back), npoints + 1);
+			lwgeom_free(back);
+			GEOSGeom_destroy(g);
+		}
+		printf("%s polygon, %d vertices: to GEOS %.0f, from GEOS %.0f points/sec\n",
+		       hasz ? "3D" : "2D", npoints + 1,
+		       runs * (npoints + 1) / t_to, runs * (npoints + 1) / t_from);
+		lwgeom_free(geom);
+	}
+}
+
 /*
 ** Used by test harness to register the tests in this file.
 */
@@ -170,4 +273,6 @@ void geos_suite_setup(void)
 	PG_ADD_TEST(suite, test_geos_linemerge);
 	PG_ADD_TEST(suite, test_geos_offsetcurve);
 	PG_ADD_TEST(suite, test_geos_makevalid);
+	PG_ADD_TEST(suite, test_geos_coordseq);
+	PG_ADD_TEST(suite, test_geos_conversion_benchmark);
 }
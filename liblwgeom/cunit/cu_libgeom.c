@@ -358,6 +358,47 @@ static void test_gserialized_is_empty(void)
 	}
 }
 
+static void test_gserialized_peek_first_point(void)
+{
+	LWGEOM *lw;
+	GSERIALIZED *g;
+	POINT4D pt;
+
+	/* Coordinates past a box */
+	lw = lwgeom_from_wkt("POINT ZM (1 2 3 4)", LW_PARSER_CHECK_NONE);
+	lwgeom_add_bbox(lw);
+	g = gserialized_from_lwgeom(lw, 0);
+	CU_ASSERT(gserialized_has_bbox(g));
+	CU_ASSERT_EQUAL(gserialized_peek_first_point(g, &pt), LW_SUCCESS);
+	CU_ASSERT_DOUBLE_EQUAL(pt.x, 1, 0);
+	CU_ASSERT_DOUBLE_EQUAL(pt.y, 2, 0);
+	CU_ASSERT_DOUBLE_EQUAL(pt.z, 3, 0);
+	CU_ASSERT_DOUBLE_EQUAL(pt.m, 4, 0);
+	lwgeom_free(lw);
+	lwfree(g);
+
+	lw = lwgeom_from_wkt("POINT M (-5 6 7)", LW_PARSER_CHECK_NONE);
+	g = gserialized_from_lwgeom(lw, 0);
+	CU_ASSERT_EQUAL(gserialized_peek_first_point(g, &pt), LW_SUCCESS);
+	CU_ASSERT_DOUBLE_EQUAL(pt.x, -5, 0);
+	CU_ASSERT_DOUBLE_EQUAL(pt.y, 6, 0);
+	CU_ASSERT_DOUBLE_EQUAL(pt.m, 7, 0);
+	lwgeom_free(lw);
+	lwfree(g);
+
+	lw = lwgeom_from_wkt("POINT EMPTY", LW_PARSER_CHECK_NONE);
+	g = gserialized_from_lwgeom(lw, 0);
+	CU_ASSERT_EQUAL(gserialized_peek_first_point(g, &pt), LW_FAILURE);
+	lwgeom_free(lw);
+	lwfree(g);
+
+	lw = lwgeom_from_wkt("MULTIPOINT(1 2)", LW_PARSER_CHECK_NONE);
+	g = gserialized_from_lwgeom(lw, 0);
+	CU_ASSERT_EQUAL(gserialized_peek_first_point(g, &pt), LW_FAILURE);
+	lwgeom_free(lw);
+	lwfree(g);
+}
+
 
 static void test_geometry_type_from_string(void)
 {
@@ -1202,6 +1243,46 @@ void test_gserialized_peek_gbox_p_fails_for_unsupported_cases(void)
 	}
 }
 
+/*
+* Geography points compare by the key of their geocentric box, like
+* every other geography, so mixing them with lines stays transitive.
+*/
+static void test_gserialized_cmp_geodetic(void)
+{
+	char *wkt[] = { "POINT(166 1)", "POINT(72 8)", "LINESTRING(114 51,114.5 51)" };
+	GSERIALIZED *g[3];
+	uint64_t hash[2];
+	int i, j, k;
+
+	for ( i = 0; i < 3; i++ )
+	{
+		LWGEOM *geom = lwgeom_from_wkt(wkt[i], LW_PARSER_CHECK_NONE);
+		lwgeom_set_geodetic(geom, LW_TRUE);
+		g[i] = gserialized_from_lwgeom(geom, NULL);
+		lwgeom_free(geom);
+	}
+
+	for ( i = 0; i < 3; i++ )
+	for ( j = 0; j < 3; j++ )
+	for ( k = 0; k < 3; k++ )
+	{
+		if ( gserialized_cmp(g[i], g[j]) < 0 && gserialized_cmp(g[j], g[k]) < 0 )
+			CU_ASSERT(gserialized_cmp(g[i], g[k]) < 0);
+	}
+
+	/* The points sort by the key of their box */
+	for ( i = 0; i < 2; i++ )
+	{
+		GBOX box;
+		gserialized_get_gbox_p(g[i], &box);
+		hash[i] = gbox_get_sortable_hash(&box);
+	}
+	CU_ASSERT_EQUAL(gserialized_cmp(g[0], g[1]) < 0, hash[0] < hash[1]);
+
+	for ( i = 0; i < 3; i++ )
+		lwfree(g[i]);
+}
+
 void test_signum_macro(void);
 void test_signum_macro(void)
 {
@@ -1241,9 +1322,11 @@ void libgeom_suite_setup(void)
 	PG_ADD_TEST(suite, test_lwgeom_as_curve);
 	PG_ADD_TEST(suite, test_lwgeom_scale);
 	PG_ADD_TEST(suite, test_gserialized_is_empty);
+	PG_ADD_TEST(suite, test_gserialized_peek_first_point);
 	PG_ADD_TEST(suite, test_gserialized_peek_gbox_p_no_box_when_empty);
 	PG_ADD_TEST(suite, test_gserialized_peek_gbox_p_gets_correct_box);
 	PG_ADD_TEST(suite, test_gserialized_peek_gbox_p_fails_for_unsupported_cases);
 	PG_ADD_TEST(suite, test_gbox_same_2d);
 	PG_ADD_TEST(suite, test_signum_macro);
+	PG_ADD_TEST(suite, test_gserialized_cmp_geodetic);
 }
@@ -418,6 +418,66 @@ static void test_rect_tree_intersects_tree(void)
 		"GEOMETRYCOLLECTION(MULTILINESTRING((1.5 4.1, 1.6 2)),POINT(1 3.5))"),
 		LW_TRUE
 		);
+
+	/* Lines touching end to end */
+	CU_ASSERT_EQUAL(tree_inter(
+		"LINESTRING(0 0, 1 1)",
+		"LINESTRING(1 1, 2 0)"),
+		LW_TRUE
+		);
+
+	/* Line end touching the inside of another */
+	CU_ASSERT_EQUAL(tree_inter(
+		"LINESTRING(0 0, 2 0)",
+		"LINESTRING(1 1, 1 0)"),
+		LW_TRUE
+		);
+
+	/* Overlapping collinear lines */
+	CU_ASSERT_EQUAL(tree_inter(
+		"LINESTRING(0 0, 2 0)",
+		"LINESTRING(1 0, 3 0)"),
+		LW_TRUE
+		);
+
+	/* Line in a gap of another */
+	CU_ASSERT_EQUAL(tree_inter(
+		"LINESTRING(0 0, 1 0, 1 1, 2 1, 2 0, 3 0)",
+		"LINESTRING(1.5 0, 1.5 0.5)"),
+		LW_FALSE
+		);
+
+	/* Contained second component, first one outside */
+	CU_ASSERT_EQUAL(tree_inter(
+		"POLYGON((0 0, 10 0, 10 10, 0 10, 0 0))",
+		"MULTILINESTRING((20 20, 30 30),(2 2, 3 3))"),
+		LW_TRUE
+		);
+	CU_ASSERT_EQUAL(tree_inter(
+		"MULTIPOLYGON(((20 20, 21 20, 21 21, 20 20)),((2 2, 3 2, 3 3, 2 2)))",
+		"POLYGON((0 0, 10 0, 10 10, 0 10, 0 0))"),
+		LW_TRUE
+		);
+
+	/* In the hole of a single polygon multipolygon */
+	CU_ASSERT_EQUAL(tree_inter(
+		"MULTIPOLYGON(((0 0, 10 0, 10 10, 0 10, 0 0),(2 2, 8 2, 8 8, 2 8, 2 2)))",
+		"LINESTRING(4 4, 5 5)"),
+		LW_FALSE
+		);
+	CU_ASSERT_EQUAL(tree_inter(
+		"MULTIPOLYGON(((0 0, 10 0, 10 10, 0 10, 0 0)))",
+		"LINESTRING(4 4, 5 5)"),
+		LW_TRUE
+		);
+
+	/* Interrupted walk */
+	lwgeom_request_interrupt();
+	CU_ASSERT_EQUAL(tree_inter(
+		"LINESTRING(0 0, 10 10)",
+		"LINESTRING(0 10, 10 0)"),
+		-1
+		);
 }
 
 
@@ -466,6 +526,9 @@ test_rect_tree_distance_tree(void)
 	TDT("LINESTRING(-1e-8 0, -0.2 0)", "POINT(-1e-8 0)", 0);
 	TDT("LINESTRING(-0.2 0, -1e-8 0)", "POINT(-1e-8 0)", 0);
 
+	TDT("POLYGON((0 0, 10 0, 10 10, 0 10, 0 0))", "MULTILINESTRING((20 20, 30 30),(2 2, 3 3))", 0);
+	TDT("MULTIPOLYGON(((0 0, 10 0, 10 10, 0 10, 0 0),(2 2, 8 2, 8 8, 2 8, 2 2)))", "POINT(5 4)", 2);
+
 	wkt = "CURVEPOLYGON(COMPOUNDCURVE(CIRCULARSTRING(1 6, 6 1, 9 7),(9 7, 3 13, 1 6)),COMPOUNDCURVE((3 6, 5 4, 7 4, 7 6),CIRCULARSTRING(7 6,5 8,3 6)))";
 	TDT(wkt, "POINT(3 14)", 1);
 	TDT(wkt, "POINT(3 8)", 0);
@@ -504,6 +567,10 @@ test_rect_tree_distance_tree(void)
 	wkt = "POLYGON((0 0,0 10,10 10,10 0,0 0), (4 4,4 6,6 6,6 4,4 4))";
 	TDT(wkt, "POINT(5 5)", 1);
 	TDT(wkt, "POLYGON((5 5,5 5.5,5.5 5.5,5.5 5, 5 5))", 0.5);
+
+	/* Interrupted walk */
+	lwgeom_request_interrupt();
+	TDT("LINESTRING(0 0,10 0)", "LINESTRING(0 1,10 1)", -1.0);
 }
 
 
@@ -0,0 +1,333 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "CUnit/Basic.h"
+
+#include "liblwgeom_internal.h"
+#include "lwpip.h"
+#include "lwtree.h"
+#include "cu_tester.h"
+
+static int
+pip_locate(const char *wkt, double x, double y)
+{
+	LWGEOM *g = lwgeom_from_wkt(wkt, LW_PARSER_CHECK_NONE);
+	PIP_INDEX *index = pip_index_from_lwgeom(g);
+	POINT2D pt;
+	int rv;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(index);
+	pt.x = x;
+	pt.y = y;
+	rv = pip_index_contains_point(index, &pt);
+	pip_index_free(index);
+	lwgeom_free(g);
+	return rv;
+}
+
+/* Location of a point with respect to a polygon, the slow way */
+static int
+pip_reference_poly(const LWPOLY *poly, const POINT2D *pt)
+{
+	uint32_t i;
+	int rv = ptarray_contains_point(poly->rings[0], pt);
+	if (rv != LW_INSIDE)
+		return rv;
+	for (i = 1; i < poly->nrings; i++)
+	{
+		rv = ptarray_contains_point(poly->rings[i], pt);
+		if (rv == LW_INSIDE)
+			return LW_OUTSIDE;
+		if (rv == LW_BOUNDARY)
+			return LW_BOUNDARY;
+	}
+	return LW_INSIDE;
+}
+
+/* A star with a square hole, a worst case for crossing counts */
+static LWGEOM *
+pip_star(int npoints)
+{
+	POINTARRAY **rings = lwalloc(sizeof(POINTARRAY*) * 2);
+	POINT4D p;
+	int i;
+
+	rings[0] = ptarray_construct_empty(0, 0, npoints + 1);
+	for (i = 0; i < npoints; i++)
+	{
+		double a = 2.0 * M_PI * i / npoints;
+		double r = (i % 2) ? 400 : 1000;
+		p.x = rint(r * cos(a));
+		p.y = rint(r * sin(a));
+		ptarray_append_point(rings[0], &p, LW_TRUE);
+	}
+	p.x = 1000; p.y = 0;
+	ptarray_append_point(rings[0], &p, LW_TRUE);
+
+	rings[1] = ptarray_construct_empty(0, 0, 5);
+	p.x = -50; p.y = -50; ptarray_append_point(rings[1], &p, LW_TRUE);
+	p.x = 50; p.y = -50; ptarray_append_point(rings[1], &p, LW_TRUE);
+	p.x = 50; p.y = 50; ptarray_append_point(rings[1], &p, LW_TRUE);
+	p.x = -50; p.y = 50; ptarray_append_point(rings[1], &p, LW_TRUE);
+	p.x = -50; p.y = -50; ptarray_append_point(rings[1], &p, LW_TRUE);
+
+	return lwpoly_as_lwgeom(lwpoly_construct(SRID_UNKNOWN, NULL, 2, rings));
+}
+
+static void test_pip_polygon(void)
+{
+	const char *square = "POLYGON((0 0,10 0,10 10,0 10,0 0))";
+	const char *holed = "POLYGON((0 0,10 0,10 10,0 10,0 0),(2 2,2 8,8 8,8 2,2 2))";
+
+	CU_ASSERT_EQUAL(pip_locate(square, 5, 5), LW_INSIDE);
+	CU_ASSERT_EQUAL(pip_locate(square, 0.001, 9.999), LW_INSIDE);
+	CU_ASSERT_EQUAL(pip_locate(square, 11, 5), LW_OUTSIDE);
+	CU_ASSERT_EQUAL(pip_locate(square, -1, -1), LW_OUTSIDE);
+	CU_ASSERT_EQUAL(pip_locate(square, 10, 5), LW_BOUNDARY);
+	CU_ASSERT_EQUAL(pip_locate(square, 5, 0), LW_BOUNDARY);
+	CU_ASSERT_EQUAL(pip_locate(square, 0, 0), LW_BOUNDARY);
+	CU_ASSERT_EQUAL(pip_locate(square, 10, 10), LW_BOUNDARY);
+
+	CU_ASSERT_EQUAL(pip_locate(holed, 1, 1), LW_INSIDE);
+	CU_ASSERT_EQUAL(pip_locate(holed, 5, 5), LW_OUTSIDE);
+	CU_ASSERT_EQUAL(pip_locate(holed, 2, 5), LW_BOUNDARY);
+	CU_ASSERT_EQUAL(pip_locate(holed, 8, 8), LW_BOUNDARY);
+	CU_ASSERT_EQUAL(pip_locate(holed, 9, 5), LW_INSIDE);
+
+	/* Ray through vertices */
+	CU_ASSERT_EQUAL(pip_locate("POLYGON((0 0,5 5,10 0,10 10,0 10,0 0))", 2, 5), LW_INSIDE);
+	CU_ASSERT_EQUAL(pip_locate("POLYGON((0 0,5 5,10 0,10 10,0 10,0 0))", 5, 1), LW_OUTSIDE);
+	CU_ASSERT_EQUAL(pip_locate("POLYGON((0 0,5 5,10 0,10 10,0 10,0 0))", 5, 5), LW_BOUNDARY);
+}
+
+static void test_pip_multipolygon(void)
+{
+	const char *mpoly = "MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(2 2,2 8,8 8,8 2,2 2)),((3 3,7 3,7 7,3 7,3 3)),((20 0,30 0,25 10,20 0)))";
+
+	CU_ASSERT_EQUAL(pip_locate(mpoly, 1, 1), LW_INSIDE);
+	CU_ASSERT_EQUAL(pip_locate(mpoly, 2.5, 2.5), LW_OUTSIDE);
+	CU_ASSERT_EQUAL(pip_locate(mpoly, 5, 5), LW_INSIDE);
+	CU_ASSERT_EQUAL(pip_locate(mpoly, 3, 5), LW_BOUNDARY);
+	CU_ASSERT_EQUAL(pip_locate(mpoly, 25, 5), LW_INSIDE);
+	CU_ASSERT_EQUAL(pip_locate(mpoly, 15, 5), LW_OUTSIDE);
+	CU_ASSERT_EQUAL(pip_locate(mpoly, 25, 10), LW_BOUNDARY);
+}
+
+static void test_pip_degenerate(void)
+{
+	LWGEOM *g;
+
+	/* Collapsed polygons only have a boundary */
+	CU_ASSERT_EQUAL(pip_locate("POLYGON((0 0,10 0,10 0,0 0))", 5, 0), LW_BOUNDARY);
+	CU_ASSERT_EQUAL(pip_locate("POLYGON((0 0,10 0,10 0,0 0))", 5, 1), LW_OUTSIDE);
+	CU_ASSERT_EQUAL(pip_locate("POLYGON((0 0,0 10,0 0))", 0, 5), LW_BOUNDARY);
+	CU_ASSERT_EQUAL(pip_locate("POLYGON((0 0,0 10,0 0))", 1, 5), LW_OUTSIDE);
+
+	/* No index on empty, pointlike or non-areal input */
+	g = lwgeom_from_wkt("POLYGON EMPTY", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_PTR_NULL(pip_index_from_lwgeom(g));
+	lwgeom_free(g);
+	g = lwgeom_from_wkt("POLYGON((5 5,5 5,5 5,5 5))", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_PTR_NULL(pip_index_from_lwgeom(g));
+	lwgeom_free(g);
+	g = lwgeom_from_wkt("LINESTRING(0 0,10 10)", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_PTR_NULL(pip_index_from_lwgeom(g));
+	lwgeom_free(g);
+}
+
+static void test_pip_random(void)
+{
+	LWGEOM *g = pip_star(500);
+	PIP_INDEX *index = pip_index_from_lwgeom(g);
+	POINT2D pt;
+	int i;
+
+	srand(17);
+	for (i = 0; i < 100000; i++)
+	{
+		/* Lattice points, to land on vertices and edges too */
+		if (i % 2)
+		{
+			pt.x = -1100 + rand() % 2201;
+			pt.y = -1100 + rand() % 2201;
+		}
+		else
+		{
+			pt.x = -1100 + 2200.0 * rand() / RAND_MAX;
+			pt.y = -1100 + 2200.0 * rand() / RAND_MAX;
+		}
+		if (pip_index_contains_point(index, &pt) != pip_reference_poly((LWPOLY*)g, &pt))
+		{
+			printf("point (%g %g): got %d, expected %d\n", pt.x, pt.y,
+			       pip_index_contains_point(index, &pt), pip_reference_poly((LWPOLY*)g, &pt));
+			CU_FAIL_FATAL("pip index disagrees with ring scan");
+		}
+	}
+
+	pip_index_free(index);
+	lwgeom_free(g);
+}
+
+static void test_pip_batch(void)
+{
+	const char *mpoly = "MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(2 2,2 8,8 8,8 2,2 2)),((3 3,7 3,7 7,3 7,3 3)),((20 0,30 0,25 10,20 0)))";
+	LWGEOM *g = lwgeom_from_wkt(mpoly, LW_PARSER_CHECK_NONE);
+	LWGEOM *star = pip_star(500);
+	LWGEOM *line = lwgeom_from_wkt("LINESTRING(0 0,10 10)", LW_PARSER_CHECK_NONE);
+	PIP_INDEX *index = pip_index_from_lwgeom(star);
+	POINTARRAY *pts;
+	POINT4D p;
+	int *locations, *expected;
+	uint32_t i, n, sizes[] = {1, 17, PIP_BATCH_INDEX_THRESHOLD, 1000};
+	int s;
+
+	/* Lattice points over the multipolygon, below the index threshold */
+	pts = ptarray_construct_empty(0, 0, 40);
+	p.z = p.m = 0;
+	for (i = 0; i < 40; i++)
+	{
+		p.x = -1 + (i * 7) % 33;
+		p.y = -1 + (i * 3) % 13;
+		ptarray_append_point(pts, &p, LW_TRUE);
+	}
+	locations = lwalloc(sizeof(int) * 1000);
+	expected = lwalloc(sizeof(int) * 1000);
+	CU_ASSERT_EQUAL(pip_locate_points(g, pts, locations), LW_SUCCESS);
+	for (i = 0; i < pts->npoints; i++)
+	{
+		const POINT2D *pt = getPoint2d_cp(pts, i);
+		CU_ASSERT_EQUAL(locations[i], pip_locate(mpoly, pt->x, pt->y));
+	}
+	CU_ASSERT_EQUAL(pip_locate_points(line, pts, locations), LW_FAILURE);
+	ptarray_free(pts);
+
+	/* Kernel and temporary index against the prepared index */
+	srand(17);
+	for (s = 0; s < 4; s++)
+	{
+		n = sizes[s];
+		pts = ptarray_construct_empty(0, 0, n);
+		for (i = 0; i < n; i++)
+		{
+			p.x = -1100 + rand() % 2201;
+			p.y = -1100 + rand() % 2201;
+			ptarray_append_point(pts, &p, LW_TRUE);
+		}
+		pip_index_locate_points(index, pts, expected);
+		CU_ASSERT_EQUAL(pip_locate_points(star, pts, locations), LW_SUCCESS);
+		for (i = 0; i < n; i++)
+			CU_ASSERT_EQUAL(locations[i], expected[i]);
+		ptarray_free(pts);
+	}
+
+	lwfree(locations);
+	lwfree(expected);
+	pip_index_free(index);
+	lwgeom_free(star);
+	lwgeom_free(line);
+	lwgeom_free(g);
+}
+
+/*
+* Throughput of the grid index against the rect-tree and the plain
+* ring scan. Only run when CU_BENCHMARK is set in the environment.
+*/
+static void test_pip_benchmark(void)
+{
+	int sizes[] = {100, 1000, 10000};
+	int npts = 1000000;
+	POINT2D *pts;
+	POINTARRAY *batch;
+	int *locations;
+	int i, s;
+
+	if (!getenv("CU_BENCHMARK"))
+		return;
+
+	pts = lwalloc(sizeof(POINT2D) * npts);
+	locations = lwalloc(sizeof(int) * PIP_BATCH_INDEX_THRESHOLD);
+	batch = ptarray_construct_reference_data(0, 0, 0, (uint8_t*)pts);
+	srand(17);
+	for (i = 0; i < npts; i++)
+	{
+		pts[i].x = -1100 + 2200.0 * rand() / RAND_MAX;
+		pts[i].y = -1100 + 2200.0 * rand() / RAND_MAX;
+	}
+
+	printf("\n");
+	for (s = 0; s < 3; s++)
+	{
+		LWGEOM *g = pip_star(sizes[s]);
+		PIP_INDEX *index;
+		RECT_NODE *tree;
+		clock_t start;
+		double t_pip, t_tree, t_scan;
+		int nscan = npts / sizes[s];
+		int n = 0;
+
+		start = clock();
+		index = pip_index_from_lwgeom(g);
+		for (i = 0; i < npts; i++)
+			n += pip_index_contains_point(index, &pts[i]);
+		t_pip = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		start = clock();
+		tree = rect_tree_from_lwgeom(g);
+		for (i = 0; i < npts; i++)
+			n += rect_tree_contains_point(tree, &pts[i]);
+		t_tree = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		start = clock();
+		for (i = 0; i < nscan; i++)
+			n += lwpoly_contains_point((LWPOLY*)g, &pts[i]);
+		t_scan = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		printf("%6d vertices: pip %.0f, rect tree %.0f, scan %.0f points/sec (%d)\n",
+		       sizes[s], npts / t_pip, npts / t_tree, nscan / t_scan, n);
+
+		/* Unindexed batches just under the index threshold */
+		start = clock();
+		for (i = 0; i + PIP_BATCH_INDEX_THRESHOLD <= nscan; i += PIP_BATCH_INDEX_THRESHOLD - 1)
+		{
+			batch->npoints = PIP_BATCH_INDEX_THRESHOLD - 1;
+			batch->serialized_pointlist = (uint8_t*)&pts[i];
+			pip_locate_points(g, batch, locations);
+		}
+		t_scan = (double)(clock() - start) / CLOCKS_PER_SEC;
+		printf("%6d vertices: batch scan %.0f points/sec\n", sizes[s], i / t_scan);
+
+		pip_index_free(index);
+		rect_tree_free(tree);
+		lwgeom_free(g);
+	}
+	ptarray_free(batch);
+	lwfree(locations);
+	lwfree(pts);
+}
+
+/*
+** Used by test harness to register the tests in this file.
+*/
+void pip_suite_setup(void);
+void pip_suite_setup(void)
+{
+	CU_pSuite suite = CU_add_suite("point_in_polygon_index", NULL, NULL);
+	PG_ADD_TEST(suite, test_pip_polygon);
+	PG_ADD_TEST(suite, test_pip_multipolygon);
+	PG_ADD_TEST(suite, test_pip_degenerate);
+	PG_ADD_TEST(suite, test_pip_random);
+	PG_ADD_TEST(suite, test_pip_batch);
+	PG_ADD_TEST(suite, test_pip_benchmark);
+}
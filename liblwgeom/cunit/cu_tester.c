@@ -35,6 +35,8 @@ extern void clean_suite_setup();
 extern void clip_by_rect_suite_setup();
 extern void force_sfs_suite_setup(void);
 extern void geodetic_suite_setup(void);
+extern void geodetic_cell_suite_setup(void);
+extern void geodetic_knn_suite_setup(void);
 extern void geos_suite_setup(void);
 extern void geos_cluster_suite_setup(void);
 extern void unionfind_suite_setup(void);
@@ -59,6 +61,7 @@ extern void out_kml_suite_setup(void);
 extern void out_svg_suite_setup(void);
 extern void twkb_out_suite_setup(void);
 extern void out_x3d_suite_setup(void);
+extern void pip_suite_setup(void);
 extern void ptarray_suite_setup(void);
 #if HAVE_SFCGAL
 extern void sfcgal_suite_setup(void);
@@ -85,6 +88,8 @@ PG_SuiteSetup setupfuncs[] =
 	clip_by_rect_suite_setup,
 	force_sfs_suite_setup,
 	geodetic_suite_setup,
+	geodetic_cell_suite_setup,
+	geodetic_knn_suite_setup,
 	geos_suite_setup,
 	geos_cluster_suite_setup,
 	unionfind_suite_setup,
@@ -110,6 +115,7 @@ PG_SuiteSetup setupfuncs[] =
 	out_kml_suite_setup,
 	out_svg_suite_setup,
 	out_x3d_suite_setup,
+	pip_suite_setup,
 	ptarray_suite_setup,
 	print_suite_setup,
 #if HAVE_SFCGAL
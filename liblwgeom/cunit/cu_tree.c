@@ -378,6 +378,223 @@ static void test_tree_circ_distance_threshold(void)
 
 }
 
+static void circ_tree_assert_equal(const CIRC_NODE *c1, const CIRC_NODE *c2)
+{
+	uint32_t i;
+	CU_ASSERT_EQUAL(c1->num_nodes, c2->num_nodes);
+	CU_ASSERT_EQUAL(c1->geom_type, c2->geom_type);
+	CU_ASSERT_DOUBLE_EQUAL(c1->center.lon, c2->center.lon, 0.0);
+	CU_ASSERT_DOUBLE_EQUAL(c1->center.lat, c2->center.lat, 0.0);
+	CU_ASSERT_DOUBLE_EQUAL(c1->radius, c2->radius, 0.0);
+	CU_ASSERT_DOUBLE_EQUAL(c1->pt_outside.x, c2->pt_outside.x, 0.0);
+	CU_ASSERT_DOUBLE_EQUAL(c1->pt_outside.y, c2->pt_outside.y, 0.0);
+	if ( c1->num_nodes == 0 && c2->num_nodes == 0 )
+	{
+		CU_ASSERT_DOUBLE_EQUAL(c1->p1->x, c2->p1->x, 0.0);
+		CU_ASSERT_DOUBLE_EQUAL(c1->p1->y, c2->p1->y, 0.0);
+		CU_ASSERT_DOUBLE_EQUAL(c1->p2->x, c2->p2->x, 0.0);
+		CU_ASSERT_DOUBLE_EQUAL(c1->p2->y, c2->p2->y, 0.0);
+	}
+	for ( i = 0; i < c1->num_nodes && i < c2->num_nodes; i++ )
+		circ_tree_assert_equal(c1->nodes[i], c2->nodes[i]);
+}
+
+static void test_tree_circ_packed(void)
+{
+	static const char *wkt[] = {
+		"LINESTRING(0 0,1 1,1 1,2 0,3 5)",
+		"LINESTRING Z(0 0 1,0 0 2)",
+		"POLYGON((0 0,10 0,10 10,0 10,0 0),(2 2,2 3,3 3,3 2,2 2))",
+		"MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0)),((20 20,21 20,21 21,20 21,20 20)),((-5 -5,-4 -5,-4 -4,-5 -5)))",
+		"MULTIPOINT(1 1,2 2,50 50)",
+		"GEOMETRYCOLLECTION(POINT(-10 -10),LINESTRING(30 30,31 32),POLYGON((40 40,41 40,41 41,40 40)))"
+	};
+	LWGEOM *lwg, *lwg_other;
+	GSERIALIZED *g, *g_indexed, *g_plain;
+	CIRC_NODE *c1, *c2, *c_other;
+	SPHEROID s;
+	size_t size;
+	int i;
+
+	spheroid_init(&s, WGS84_MAJOR_AXIS, WGS84_MINOR_AXIS);
+	lwg_other = lwgeom_from_wkt("LINESTRING(5 -1,15 5)", LW_PARSER_CHECK_NONE);
+	lwgeom_set_geodetic(lwg_other, LW_TRUE);
+	c_other = lwgeom_calculate_circ_tree(lwg_other);
+
+	for ( i = 0; i < (int)(sizeof(wkt)/sizeof(char*)); i++ )
+	{
+		lwg = lwgeom_from_wkt(wkt[i], LW_PARSER_CHECK_NONE);
+		lwgeom_set_geodetic(lwg, LW_TRUE);
+		g = gserialized_from_lwgeom(lwg, &size);
+		lwgeom_free(lwg);
+
+		g_indexed = gserialized_add_index(g);
+		CU_ASSERT(FLAGS_GET_INDEXED(g_indexed->flags));
+		CU_ASSERT(gserialized_index_size(g_indexed) > 0);
+		CU_ASSERT_EQUAL(SIZE_GET(g_indexed->size), size + gserialized_index_size(g_indexed));
+		CU_ASSERT_EQUAL(gserialized_index_size(g_indexed) % 8, 0);
+
+		/* Same value as the plain serialization */
+		CU_ASSERT_EQUAL(gserialized_cmp(g, g_indexed), 0);
+		CU_ASSERT_EQUAL(gserialized_cmp(g_indexed, g), 0);
+
+		/* Deserialization leaves the index behind */
+		lwg = lwgeom_from_gserialized(g_indexed);
+		CU_ASSERT(! FLAGS_GET_INDEXED(lwg->flags));
+		g_plain = gserialized_from_lwgeom(lwg, NULL);
+		CU_ASSERT_EQUAL(SIZE_GET(g_plain->size), size);
+		CU_ASSERT_EQUAL(memcmp(g, g_plain, size), 0);
+		lwfree(g_plain);
+
+		/* The stored tree is the one we would build */
+		c1 = lwgeom_calculate_circ_tree(lwg);
+		c2 = gserialized_get_circ_tree(g_indexed, lwg);
+		circ_tree_assert_equal(c1, c2);
+		CU_ASSERT_DOUBLE_EQUAL(circ_tree_distance_tree(c1, c_other, &s, 0.0),
+		                       circ_tree_distance_tree(c2, c_other, &s, 0.0), 0.0);
+		circ_tree_free(c2);
+
+		/* Dropping the index gives back the plain serialization */
+		g_plain = gserialized_drop_index(g_indexed);
+		CU_ASSERT(! FLAGS_GET_INDEXED(g_plain->flags));
+		CU_ASSERT_EQUAL(SIZE_GET(g_plain->size), size);
+		CU_ASSERT_EQUAL(memcmp(g, g_plain, size), 0);
+		lwfree(g_plain);
+
+		/* An unknown kind of index is not used */
+		circ_tree_free(c1);
+		c1 = lwgeom_calculate_circ_tree(lwg);
+		((GSERIALIZED_INDEX_TRAILER*)((uint8_t*)g_indexed + SIZE_GET(g_indexed->size) - sizeof(GSERIALIZED_INDEX_TRAILER)))->type = 99;
+		c2 = gserialized_get_circ_tree(g_indexed, lwg);
+		circ_tree_assert_equal(c1, c2);
+		circ_tree_free(c2);
+
+		circ_tree_free(c1);
+		lwgeom_free(lwg);
+		lwfree(g_indexed);
+		lwfree(g);
+	}
+
+	/* Planar geometries and points are not indexed */
+	lwg = lwgeom_from_wkt("LINESTRING(0 0,1 1)", LW_PARSER_CHECK_NONE);
+	g = gserialized_from_lwgeom(lwg, &size);
+	g_indexed = gserialized_add_index(g);
+	CU_ASSERT(! FLAGS_GET_INDEXED(g_indexed->flags));
+	CU_ASSERT_EQUAL(SIZE_GET(g_indexed->size), size);
+	lwfree(g_indexed);
+	lwfree(g);
+	lwgeom_free(lwg);
+
+	circ_tree_free(c_other);
+	lwgeom_free(lwg_other);
+}
+
+/* Star shaped ring of n vertices around (x, y) */
+static POINTARRAY* star_ring(double x, double y, double r, int n, int clockwise)
+{
+	POINTARRAY *pa = ptarray_construct_empty(LW_FALSE, LW_FALSE, n + 1);
+	POINT4D pt;
+	int i;
+	for ( i = 0; i <= n; i++ )
+	{
+		double a = 2.0 * M_PI * (i % n) / n * (clockwise ? -1.0 : 1.0);
+		double ri = r * (i % 2 ? 0.6 : 1.0);
+		pt.x = x + ri * cos(a);
+		pt.y = y + ri * sin(a);
+		ptarray_append_point(pa, &pt, LW_TRUE);
+	}
+	return pa;
+}
+
+static void test_tree_circ_covers(void)
+{
+	LWPOLY *poly, *inner;
+	LWLINE *line;
+	POINTARRAY *pa;
+	CIRC_NODE *tree;
+	POINT2D pt, pt_outside;
+	POINT4D p4;
+	GBOX gbox;
+	int i, j, all = LW_TRUE;
+
+	/* Star with a star shaped hole */
+	poly = lwpoly_construct_empty(SRID_DEFAULT, LW_FALSE, LW_FALSE);
+	lwpoly_add_ring(poly, star_ring(10.0, 45.0, 5.0, 400, LW_FALSE));
+	lwpoly_add_ring(poly, star_ring(10.5, 45.0, 1.0, 100, LW_TRUE));
+	gbox.flags = gflags(0, 0, 1);
+	lwgeom_calculate_gbox_geodetic(lwpoly_as_lwgeom(poly), &gbox);
+	gbox_pt_outside(&gbox, &pt_outside);
+
+	/* Ring trees answer like ring scans, on the rings too */
+	tree = circ_tree_new(poly->rings[0]);
+	for ( i = 0; i < 40; i++ )
+	{
+		for ( j = 0; j < 40; j++ )
+		{
+			pt.x = 4.0 + 12.0 * i / 40;
+			pt.y = 39.0 + 12.0 * j / 40;
+			CU_ASSERT_EQUAL(circ_tree_ring_covers_point(tree, &pt, &pt_outside),
+			                ptarray_contains_point_sphere(poly->rings[0], &pt_outside, &pt));
+		}
+	}
+	for ( i = 0; i < 400; i += 7 )
+	{
+		pt = *getPoint2d_cp(poly->rings[0], i);
+		CU_ASSERT_EQUAL(circ_tree_ring_covers_point(tree, &pt, &pt_outside), LW_TRUE);
+	}
+	circ_tree_free(tree);
+
+	/* Many points at once go through the trees */
+	pa = ptarray_construct_empty(LW_FALSE, LW_FALSE, 200);
+	for ( i = 0; i < 200; i++ )
+	{
+		p4.x = 6.0 + 8.0 * ((i * 37) % 200) / 200;
+		p4.y = 41.0 + 8.0 * ((i * 91) % 200) / 200;
+		pt.x = p4.x;
+		pt.y = p4.y;
+		all = all && lwpoly_covers_point2d(poly, &pt);
+		ptarray_append_point(pa, &p4, LW_TRUE);
+	}
+	CU_ASSERT_FALSE(all);
+	CU_ASSERT_EQUAL(lwpoly_covers_pointarray(poly, pa), all);
+	ptarray_free(pa);
+
+	/* Inner star, then shifted across the hole, and across the outer ring */
+	inner = lwpoly_construct_empty(SRID_DEFAULT, LW_FALSE, LW_FALSE);
+	lwpoly_add_ring(inner, star_ring(8.0, 45.0, 0.8, 300, LW_FALSE));
+	CU_ASSERT_TRUE(lwpoly_covers_lwpoly(poly, inner));
+	lwpoly_free(inner);
+	inner = lwpoly_construct_empty(SRID_DEFAULT, LW_FALSE, LW_FALSE);
+	lwpoly_add_ring(inner, star_ring(9.0, 45.0, 1.0, 300, LW_FALSE));
+	CU_ASSERT_FALSE(lwpoly_covers_lwpoly(poly, inner));
+	lwpoly_free(inner);
+	inner = lwpoly_construct_empty(SRID_DEFAULT, LW_FALSE, LW_FALSE);
+	lwpoly_add_ring(inner, star_ring(13.0, 45.0, 1.0, 300, LW_FALSE));
+	CU_ASSERT_FALSE(lwpoly_covers_lwpoly(poly, inner));
+	lwpoly_free(inner);
+
+	/* Edge crossings of trees, on the long outer ring and the short hole */
+	line = lwgeom_as_lwline(lwgeom_from_wkt("LINESTRING(3 40,8 44,8.5 46)", LW_PARSER_CHECK_NONE));
+	tree = circ_tree_new(line->points);
+	for ( i = 0; i < 2; i++ )
+	{
+		CIRC_NODE *ring_tree = circ_tree_new(poly->rings[i]);
+		LWPOLY *ring = lwpoly_construct_empty(SRID_DEFAULT, LW_FALSE, LW_FALSE);
+		lwpoly_add_ring(ring, ptarray_clone_deep(poly->rings[i]));
+		/* The line crosses the outer ring, and stays clear of the hole */
+		CU_ASSERT_EQUAL(circ_tree_edges_cross(ring_tree, tree), i == 0);
+		CU_ASSERT_EQUAL(lwpoly_intersects_line(ring, line->points), i == 0);
+		circ_tree_free(ring_tree);
+		lwpoly_free(ring);
+	}
+	CU_ASSERT_TRUE(lwpoly_intersects_line(poly, line->points));
+	CU_ASSERT_FALSE(lwpoly_covers_lwline(poly, line));
+	circ_tree_free(tree);
+	lwline_free(line);
+
+	lwpoly_free(poly);
+}
+
 /*
 ** Used by test harness to register the tests in this file.
 */
@@ -388,6 +605,8 @@ void tree_suite_setup(void)
 	PG_ADD_TEST(suite, test_tree_circ_create);
 	PG_ADD_TEST(suite, test_tree_circ_pip);
 	PG_ADD_TEST(suite, test_tree_circ_pip2);
+	PG_ADD_TEST(suite, test_tree_circ_covers);
 	PG_ADD_TEST(suite, test_tree_circ_distance);
 	PG_ADD_TEST(suite, test_tree_circ_distance_threshold);
+	PG_ADD_TEST(suite, test_tree_circ_packed);
 }
@@ -27,6 +27,7 @@
 #include "liblwgeom_internal.h"
 #include "lwgeom_log.h"
 #include "lwgeodetic.h"
+#include "lwgeodetic_tree.h"
 
 /***********************************************************************
 * GSERIALIZED metadata utility functions.
@@ -147,6 +148,115 @@ GSERIALIZED* gserialized_copy(const GSERIALIZED *g)
 	return g_out;
 }
 
+size_t gserialized_index_size(const GSERIALIZED *g)
+{
+	const GSERIALIZED_INDEX_TRAILER *trailer;
+	size_t size = SIZE_GET(g->size);
+
+	if ( ! FLAGS_GET_INDEXED(g->flags) || size < 8 + sizeof(GSERIALIZED_INDEX_TRAILER) )
+		return 0;
+
+	trailer = (const GSERIALIZED_INDEX_TRAILER*)((const uint8_t*)g + size - sizeof(GSERIALIZED_INDEX_TRAILER));
+
+	/* Never let a damaged trailer point outside of the datum */
+	if ( trailer->size < sizeof(GSERIALIZED_INDEX_TRAILER) || trailer->size > size - 8 )
+		return 0;
+
+	return trailer->size;
+}
+
+const uint8_t* gserialized_get_geometry_data(const GSERIALIZED *g, size_t *size)
+{
+	const uint8_t *data = (const uint8_t*)g->data;
+
+	if ( FLAGS_GET_BBOX(g->flags) )
+		data += gbox_serialized_size(g->flags);
+
+	if ( size )
+		*size = SIZE_GET(g->size) - gserialized_index_size(g) - (data - (const uint8_t*)g);
+
+	return data;
+}
+
+const uint8_t* gserialized_get_index(const GSERIALIZED *g, uint32_t *type, size_t *size)
+{
+	const uint8_t *end = (const uint8_t*)g + SIZE_GET(g->size);
+	const GSERIALIZED_INDEX_TRAILER *trailer;
+	size_t index_size = gserialized_index_size(g);
+
+	if ( ! index_size )
+		return NULL;
+
+	trailer = (const GSERIALIZED_INDEX_TRAILER*)(end - sizeof(GSERIALIZED_INDEX_TRAILER));
+	if ( type )
+		*type = trailer->type;
+	if ( size )
+		*size = index_size - sizeof(GSERIALIZED_INDEX_TRAILER);
+
+	return end - index_size;
+}
+
+GSERIALIZED* gserialized_drop_index(const GSERIALIZED *g)
+{
+	size_t size = SIZE_GET(g->size) - gserialized_index_size(g);
+	GSERIALIZED *g_out = (GSERIALIZED*)lwalloc(size);
+
+	memcpy((uint8_t*)g_out, (uint8_t*)g, size);
+	g_out->size = SIZE_SET(g_out->size, size);
+	FLAGS_SET_INDEXED(g_out->flags, 0);
+	return g_out;
+}
+
+/*
+* The index section follows the geometry, which always ends on a
+* double boundary, and is made of the packed tree of the geometry
+* edges followed by a GSERIALIZED_INDEX_TRAILER. Tree leaves refer
+* to the edge points by their offset from the geometry data start,
+* so that adding or dropping a box in the header leaves them valid.
+*/
+GSERIALIZED* gserialized_add_index(const GSERIALIZED *g)
+{
+	GSERIALIZED *plain, *g_out;
+	GSERIALIZED_INDEX_TRAILER trailer;
+	LWGEOM *lwgeom;
+	CIRC_NODE *tree;
+	size_t size;
+	uint8_t *ptr;
+
+	plain = gserialized_drop_index(g);
+	/* A point is its own tree */
+	if ( ! FLAGS_GET_GEODETIC(plain->flags) || gserialized_is_empty(plain) ||
+	     gserialized_get_type(plain) == POINTTYPE )
+		return plain;
+
+	/* The deserialized point arrays refer to the coordinates of plain */
+	lwgeom = lwgeom_from_gserialized(plain);
+	tree = lwgeom_calculate_circ_tree(lwgeom);
+	if ( ! tree )
+	{
+		lwgeom_free(lwgeom);
+		return plain;
+	}
+
+	size = SIZE_GET(plain->size);
+	trailer.size = circ_tree_packed_size(tree) + sizeof(GSERIALIZED_INDEX_TRAILER);
+	trailer.type = GSERIALIZED_INDEX_CIRC;
+
+	g_out = (GSERIALIZED*)lwalloc(size + trailer.size);
+	memcpy((uint8_t*)g_out, (uint8_t*)plain, size);
+	ptr = (uint8_t*)g_out + size;
+	ptr = circ_tree_pack(tree, gserialized_get_geometry_data(plain, NULL), ptr);
+	memcpy(ptr, &trailer, sizeof(GSERIALIZED_INDEX_TRAILER));
+
+	g_out->size = SIZE_SET(g_out->size, size + trailer.size);
+	FLAGS_SET_INDEXED(g_out->flags, 1);
+
+	circ_tree_free(tree);
+	lwgeom_free(lwgeom);
+	lwfree(plain);
+	return g_out;
+}
+
 static size_t gserialized_is_empty_recurse(const uint8_t *p, int *isempty);
 static size_t gserialized_is_empty_recurse(const uint8_t *p, int *isempty)
 {
@@ -189,6 +299,23 @@ int gserialized_is_empty(const GSERIALIZED *g)
 	return isempty;
 }
 
+int gserialized_peek_first_point(const GSERIALIZED *g, POINT4D *out_point)
+{
+	const uint32_t *iptr = (const uint32_t*)gserialized_get_geometry_data(g, NULL);
+	const double *dptr = (const double*)(iptr + 2); /* Past <pointtype><npoints> */
+	int i = 0;
+
+	/* Empty points have npoints == 0 */
+	if ( iptr[0] != POINTTYPE || iptr[1] == 0 )
+		return LW_FAILURE;
+
+	out_point->x = dptr[i++];
+	out_point->y = dptr[i++];
+	out_point->z = FLAGS_GET_Z(g->flags) ? dptr[i++] : 0.0;
+	out_point->m = FLAGS_GET_M(g->flags) ? dptr[i++] : 0.0;
+	return LW_SUCCESS;
+}
+
 char* gserialized_to_string(const GSERIALIZED *g)
 {
 	return lwgeom_to_wkt(lwgeom_from_gserialized(g), WKT_ISO, 12, 0);
@@ -295,20 +422,26 @@ int gserialized_cmp(const GSERIALIZED *g1, const GSERIALIZED *g2)
 	int g1_is_empty, g2_is_empty, cmp;
 	GBOX box1, box2;
 	uint64_t hash1, hash2;
-	size_t sz1 = SIZE_GET(g1->size);
-	size_t sz2 = SIZE_GET(g2->size);
+	/* An acceleration index is not part of the value */
+	size_t sz1 = SIZE_GET(g1->size) - gserialized_index_size(g1);
+	size_t sz2 = SIZE_GET(g2->size) - gserialized_index_size(g2);
 	union floatuint x, y;
 
 	/*
 	* For two non-same points, we can skip a lot of machinery.
+	* The key is the one gbox_get_sortable_hash gives a planar point,
+	* so the order is the same as from the full comparison. Geodetic
+	* keys come from the geocentric box, so they take the long way.
 	*/
 	if (
 		sz1 > 16 && // 16 is size of EMPTY, if it's larger - it has coordinates
 		sz2 > 16 &&
 		!FLAGS_GET_BBOX(g1->flags) &&
 		!FLAGS_GET_BBOX(g2->flags) &&
-		*(uint32_t*)(g1+8) == POINTTYPE &&
-		*(uint32_t*)(g2+8) == POINTTYPE
+		!FLAGS_GET_GEODETIC(g1->flags) &&
+		!FLAGS_GET_GEODETIC(g2->flags) &&
+		gserialized_get_type(g1) == POINTTYPE &&
+		gserialized_get_type(g2) == POINTTYPE
 	)
 	{
 		double *dptr = (double*)(g1->data + sizeof(double));
@@ -1233,6 +1366,7 @@ GSERIALIZED* gserialized_from_lwgeom(LWGEOM *geom, size_t *size)
 	gserialized_set_srid(g, geom->srid);
 
 	g->flags = geom->flags;
+	FLAGS_SET_INDEXED(g->flags, 0);
 
 	return g;
 }
@@ -1537,6 +1671,8 @@ LWGEOM* lwgeom_from_gserialized(const GSERIALIZED *g)
 
 	g_srid = gserialized_get_srid(g);
 	g_flags = g->flags;
+	/* The index section, if any, is left behind */
+	FLAGS_SET_INDEXED(g_flags, 0);
 	g_type = gserialized_get_type(g);
 	LWDEBUGF(4, "Got type %d (%s), srid=%d", g_type, lwtype_name(g_type), g_srid);
 
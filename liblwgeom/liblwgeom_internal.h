@@ -281,6 +281,35 @@ double lwtriangle_area(const LWTRIANGLE *triangle);
 */
 int gserialized_read_gbox_p(const GSERIALIZED *g, GBOX *gbox);
 
+/**
+* Kinds of acceleration index stored in indexed #GSERIALIZED.
+*/
+#define GSERIALIZED_INDEX_CIRC 1
+
+/**
+* Trailer of the index section of an indexed #GSERIALIZED, taking its
+* last bytes, so that the section is found from the end of the datum.
+*/
+typedef struct
+{
+	uint32_t size; /* Bytes of the index section, trailer included */
+	uint32_t type; /* GSERIALIZED_INDEX_CIRC */
+} GSERIALIZED_INDEX_TRAILER;
+
+/**
+* Return the start of the geometry data (the type number of the top
+* geometry) of a #GSERIALIZED, past its header and box, and set size
+* to the bytes it takes, not counting any index section.
+*/
+const uint8_t* gserialized_get_geometry_data(const GSERIALIZED *g, size_t *size);
+
+/**
+* Return the index data of an indexed #GSERIALIZED, setting type and
+* size to its kind and to its bytes, trailer excluded. Return NULL if
+* there is no index.
+*/
+const uint8_t* gserialized_get_index(const GSERIALIZED *g, uint32_t *type, size_t *size);
+
 /*
 * Length calculations
 */
@@ -26,12 +26,13 @@
 
 #include "liblwgeom_internal.h"
 #include "lwgeodetic.h"
+#include "lwgeodetic_tree.h"
 #include "lwgeom_log.h"
 
 /**
 * For testing geodetic bounding box, we have a magic global variable.
-* When this is true (when the cunit tests set it), use the slow, but
-* guaranteed correct, algorithm. Otherwise use the regular one.
+* When this is true (when the cunit tests set it), use the slower,
+* edge by edge, algorithm. Otherwise use the regular one.
 */
 int gbox_geocentric_slow = LW_FALSE;
 
@@ -399,6 +400,42 @@ void ll2cart(const POINT2D *g, POINT3D *p)
 	p->z = sin(y_rad);
 }
 
+/**
+* Convert every vertex of a point array to cartesian coordinates on
+* the unit sphere, the way geographic_point_init() and geog2cart() would.
+* Free the result with ptarray_cart_free().
+*/
+CART_PTARRAY* ptarray_cart_new(const POINTARRAY *pa)
+{
+	CART_PTARRAY *cpa = lwalloc(sizeof(CART_PTARRAY));
+	GEOGRAPHIC_POINT g;
+	POINT3D p;
+	uint32_t i;
+
+	cpa->npoints = pa->npoints;
+	cpa->x = lwalloc(3 * sizeof(double) * (pa->npoints ? pa->npoints : 1));
+	cpa->y = cpa->x + pa->npoints;
+	cpa->z = cpa->y + pa->npoints;
+
+	for ( i = 0; i < pa->npoints; i++ )
+	{
+		const POINT2D *pt = getPoint2d_cp(pa, i);
+		geographic_point_init(pt->x, pt->y, &g);
+		geog2cart(&g, &p);
+		cpa->x[i] = p.x;
+		cpa->y[i] = p.y;
+		cpa->z[i] = p.z;
+	}
+	return cpa;
+}
+
+void ptarray_cart_free(CART_PTARRAY *cpa)
+{
+	if ( ! cpa ) return;
+	lwfree(cpa->x);
+	lwfree(cpa);
+}
+
 /**
 * Convert cartesian coordinates on unit sphere to lon/lat coordinates
 static void cart2ll(const POINT3D *p, POINT2D *g)
@@ -930,6 +967,32 @@ double sphere_distance(const GEOGRAPHIC_POINT *s, const GEOGRAPHIC_POINT *e)
 	return atan2(a, b);
 }
 
+/**
+* Distances in radians from s to each of the n points of e, into d.
+* Gives the same results as sphere_distance(), with the trigonometry
+* of s done once for the whole batch.
+*/
+void sphere_distance_batch(const GEOGRAPHIC_POINT *s, const GEOGRAPHIC_POINT *e, uint32_t n, double *d)
+{
+	double cos_lat_s = cos(s->lat);
+	double sin_lat_s = sin(s->lat);
+	uint32_t i;
+
+	for ( i = 0; i < n; i++ )
+	{
+		double d_lon = e[i].lon - s->lon;
+		double cos_d_lon = cos(d_lon);
+		double cos_lat_e = cos(e[i].lat);
+		double sin_lat_e = sin(e[i].lat);
+
+		double a1 = POW2(cos_lat_e * sin(d_lon));
+		double a2 = POW2(cos_lat_s * sin_lat_e - sin_lat_s * cos_lat_e * cos_d_lon);
+		double a = sqrt(a1 + a2);
+		double b = sin_lat_s * sin_lat_e + cos_lat_s * cos_lat_e * cos_d_lon;
+		d[i] = atan2(a, b);
+	}
+}
+
 /**
 * Given two unit vectors, calculate their distance apart in radians.
 */
@@ -1184,10 +1247,42 @@ int edge_intersection(const GEOGRAPHIC_EDGE *e1, const GEOGRAPHIC_EDGE *e2, GEOG
 	return LW_FALSE;
 }
 
-double edge_distance_to_point(const GEOGRAPHIC_EDGE *e, const GEOGRAPHIC_POINT *gp, GEOGRAPHIC_POINT *closest)
+/**
+* The edge_point_in_cone() and edge_point_on_plane() tests of
+* edge_contains_point(), for an edge with cartesian ends vs and ve
+* and unit normal n already at hand.
+*/
+static int edge_contains_point_cart(const POINT3D *vs, const POINT3D *ve, const POINT3D *n, const GEOGRAPHIC_POINT *p)
+{
+	POINT3D vcp, vp;
+	double vs_dot_vcp, vp_dot_vcp;
+
+	geog2cart(p, &vp);
+
+	/* Antipodal case, everything is inside the cone. */
+	if ( ! (vs->x == -1.0 * ve->x && vs->y == -1.0 * ve->y && vs->z == -1.0 * ve->z) )
+	{
+		vector_sum(vs, ve, &vcp);
+		normalize(&vcp);
+		vs_dot_vcp = dot_product(vs, &vcp);
+		vp_dot_vcp = dot_product(&vp, &vcp);
+		if ( ! (vp_dot_vcp > vs_dot_vcp || fabs(vp_dot_vcp - vs_dot_vcp) < 2e-16) )
+			return LW_FALSE;
+	}
+
+	return FP_IS_ZERO(dot_product(n, &vp));
+}
+
+/**
+* Core of edge_distance_to_point(). The vs and ve are the ends of e
+* and p is gp in cartesian form, n is the unit normal of e as given
+* by robust_cross_product(). Loops over many edge pairs work these
+* out once per vertex and edge, rather than once per pair.
+*/
+static double edge_distance_to_point_cart(const GEOGRAPHIC_EDGE *e, const POINT3D *vs, const POINT3D *ve, const POINT3D *n, const GEOGRAPHIC_POINT *gp, const POINT3D *p, GEOGRAPHIC_POINT *closest)
 {
 	double d1 = 1000000000.0, d2, d3, d_nearest;
-	POINT3D n, p, k;
+	POINT3D np, k;
 	GEOGRAPHIC_POINT gk, g_nearest;
 
 	/* Zero length edge, */
@@ -1197,14 +1292,12 @@ double edge_distance_to_point(const GEOGRAPHIC_EDGE *e, const GEOGRAPHIC_POINT *
 		return sphere_distance(&(e->start), gp);
 	}
 
-	robust_cross_product(&(e->start), &(e->end), &n);
-	normalize(&n);
-	geog2cart(gp, &p);
-	vector_scale(&n, dot_product(&p, &n));
-	vector_difference(&p, &n, &k);
+	np = *n;
+	vector_scale(&np, dot_product(p, &np));
+	vector_difference(p, &np, &k);
 	normalize(&k);
 	cart2geog(&k, &gk);
-	if ( edge_contains_point(e, &gk) )
+	if ( edge_contains_point_cart(vs, ve, n, &gk) )
 	{
 		d1 = sphere_distance(gp, &gk);
 	}
@@ -1230,19 +1323,42 @@ double edge_distance_to_point(const GEOGRAPHIC_EDGE *e, const GEOGRAPHIC_POINT *
 	return d_nearest;
 }
 
+static void edge_normal(const GEOGRAPHIC_EDGE *e, POINT3D *n)
+{
+	robust_cross_product(&(e->start), &(e->end), n);
+	normalize(n);
+}
+
+double edge_distance_to_point(const GEOGRAPHIC_EDGE *e, const GEOGRAPHIC_POINT *gp, GEOGRAPHIC_POINT *closest)
+{
+	POINT3D vs, ve, n, p;
+
+	/* Zero length edge, */
+	if ( geographic_point_equals(&(e->start), &(e->end)) )
+	{
+		*closest = e->start;
+		return sphere_distance(&(e->start), gp);
+	}
+
+	geog2cart(&(e->start), &vs);
+	geog2cart(&(e->end), &ve);
+	edge_normal(e, &n);
+	geog2cart(gp, &p);
+	return edge_distance_to_point_cart(e, &vs, &ve, &n, gp, &p, closest);
+}
+
 /**
-* Calculate the distance between two edges.
-* IMPORTANT: this test does not check for edge intersection!!! (distance == 0)
-* You have to check for intersection before calling this function.
+* Core of edge_distance_to_edge(), for edges with their cartesian
+* ends and unit normals at hand. See edge_distance_to_point_cart().
 */
-double edge_distance_to_edge(const GEOGRAPHIC_EDGE *e1, const GEOGRAPHIC_EDGE *e2, GEOGRAPHIC_POINT *closest1, GEOGRAPHIC_POINT *closest2)
+static double edge_distance_to_edge_cart(const GEOGRAPHIC_EDGE *e1, const POINT3D *A1, const POINT3D *A2, const POINT3D *n1, const GEOGRAPHIC_EDGE *e2, const POINT3D *B1, const POINT3D *B2, const POINT3D *n2, GEOGRAPHIC_POINT *closest1, GEOGRAPHIC_POINT *closest2)
 {
 	double d;
 	GEOGRAPHIC_POINT gcp1s, gcp1e, gcp2s, gcp2e, c1, c2;
-	double d1s = edge_distance_to_point(e1, &(e2->start), &gcp1s);
-	double d1e = edge_distance_to_point(e1, &(e2->end), &gcp1e);
-	double d2s = edge_distance_to_point(e2, &(e1->start), &gcp2s);
-	double d2e = edge_distance_to_point(e2, &(e1->end), &gcp2e);
+	double d1s = edge_distance_to_point_cart(e1, A1, A2, n1, &(e2->start), B1, &gcp1s);
+	double d1e = edge_distance_to_point_cart(e1, A1, A2, n1, &(e2->end), B2, &gcp1e);
+	double d2s = edge_distance_to_point_cart(e2, B1, B2, n2, &(e1->start), A1, &gcp2s);
+	double d2e = edge_distance_to_point_cart(e2, B1, B2, n2, &(e1->end), A2, &gcp2e);
 
 	d = d1s;
 	c1 = gcp1s;
@@ -1275,6 +1391,24 @@ double edge_distance_to_edge(const GEOGRAPHIC_EDGE *e1, const GEOGRAPHIC_EDGE *e
 	return d;
 }
 
+/**
+* Calculate the distance between two edges.
+* IMPORTANT: this test does not check for edge intersection!!! (distance == 0)
+* You have to check for intersection before calling this function.
+*/
+double edge_distance_to_edge(const GEOGRAPHIC_EDGE *e1, const GEOGRAPHIC_EDGE *e2, GEOGRAPHIC_POINT *closest1, GEOGRAPHIC_POINT *closest2)
+{
+	POINT3D A1, A2, B1, B2, n1, n2;
+
+	geog2cart(&(e1->start), &A1);
+	geog2cart(&(e1->end), &A2);
+	geog2cart(&(e2->start), &B1);
+	geog2cart(&(e2->end), &B2);
+	edge_normal(e1, &n1);
+	edge_normal(e2, &n2);
+	return edge_distance_to_edge_cart(e1, &A1, &A2, &n1, e2, &B1, &B2, &n2, closest1, closest2);
+}
+
 
 /**
 * Given a starting location r, a distance and an azimuth
@@ -1549,33 +1683,28 @@ static int ptarray_segmentize_sphere_edge_recursive (
 	double d, double max_seg_length, /* current segment length and segment limit */
 	POINTARRAY *pa) /* write out results here */
 {
-	GEOGRAPHIC_POINT g;
 	/* Reached the terminal leaf in recursion. Add */
 	/* the left-most point to the pointarray here */
 	/* We recurse down the left side first, so outputs should */
 	/* end up added to the array in order this way */
 	if (d <= max_seg_length)
 	{
-		POINT4D p;
-		cart2geog(p1, &g);
-		p.x = v1->x;
-		p.y = v1->y;
-		p.z = v1->z;
-		p.m = v1->m;
-		return ptarray_append_point(pa, &p, LW_FALSE);
+		return ptarray_append_point(pa, v1, LW_FALSE);
 	}
 	/* Find the mid-point and recurse on the left and then the right */
 	else
 	{
-		/* Calculate mid-point */
+		GEOGRAPHIC_POINT g;
 		POINT3D mid;
+		POINT4D midv;
+
+		/* Calculate mid-point */
 		mid.x = (p1->x + p2->x) / 2.0;
 		mid.y = (p1->y + p2->y) / 2.0;
 		mid.z = (p1->z + p2->z) / 2.0;
 		normalize(&mid);
 
 		/* Calculate z/m mid-values */
-		POINT4D midv;
 		cart2geog(&mid, &g);
 		midv.x = rad2deg(g.lon);
 		midv.y = rad2deg(g.lat);
@@ -1602,6 +1731,8 @@ ptarray_segmentize_sphere(const POINTARRAY *pa_in, double max_seg_length)
 	POINT4D p1, p2;
 	POINT3D q1, q2;
 	GEOGRAPHIC_POINT g1, g2;
+	double *lengths;
+	double npoints = 1;
 	uint32_t i;
 
 	/* Just crap out on crazy input */
@@ -1610,26 +1741,53 @@ ptarray_segmentize_sphere(const POINTARRAY *pa_in, double max_seg_length)
 	if ( max_seg_length <= 0.0 )
 		lwerror("%s: maximum segment length must be positive", __func__);
 
-	/* Empty starting array */
-	pa_out = ptarray_construct_empty(hasz, hasm, pa_in->npoints);
-
-	/* Simple loop per edge */
+	/* Edge lengths, and from them the size of the output: */
+	/* an edge is halved until its parts are short enough */
+	lengths = lwalloc(sizeof(double) * pa_in->npoints);
 	for (i = 1; i < pa_in->npoints; i++)
 	{
+		double d, n = 1;
 		getPoint4d_p(pa_in, i-1, &p1);
 		getPoint4d_p(pa_in, i, &p2);
+
+		/* Skip duplicate points (except in case of 2-point lines!) */
+		if ((pa_in->npoints > 2) && p4d_same(&p1, &p2))
+			continue;
+
 		geographic_point_init(p1.x, p1.y, &g1);
 		geographic_point_init(p2.x, p2.y, &g2);
+		lengths[i] = d = sphere_distance(&g1, &g2);
+		for (; d > max_seg_length; d /= 2.0)
+			n *= 2;
+		npoints += n;
+	}
+	if ( npoints > UINT32_MAX )
+	{
+		lwfree(lengths);
+		lwerror("%s: maximum segment length is too short", __func__);
+		return NULL;
+	}
+
+	/* Empty starting array, large enough for all the output */
+	pa_out = ptarray_construct_empty(hasz, hasm, (uint32_t)npoints);
+
+	/* Simple loop per edge */
+	for (i = 1; i < pa_in->npoints; i++)
+	{
+		getPoint4d_p(pa_in, i-1, &p1);
+		getPoint4d_p(pa_in, i, &p2);
 
 		/* Skip duplicate points (except in case of 2-point lines!) */
 		if ((pa_in->npoints > 2) && p4d_same(&p1, &p2))
 			continue;
 
 		/* How long is this edge? */
-		double d = sphere_distance(&g1, &g2);
+		double d = lengths[i];
 
 		if (d > max_seg_length)
 		{
+			geographic_point_init(p1.x, p1.y, &g1);
+			geographic_point_init(p2.x, p2.y, &g2);
 			geog2cart(&g1, &q1);
 			geog2cart(&g2, &q2);
 			/* 3-d end points, XYZM end point, current edge size, min edge size */
@@ -1643,17 +1801,161 @@ ptarray_segmentize_sphere(const POINTARRAY *pa_in, double max_seg_length)
 	}
 	/* Always add the last point */
 	ptarray_append_point(pa_out, &p2, LW_TRUE);
+	lwfree(lengths);
 	return pa_out;
 }
 
 /**
-* Create a new, densified geometry where no segment is longer than max_seg_length.
-* Input geometry is not altered, output geometry must be freed by caller.
-* @param lwg_in = input geometry
-* @param max_seg_length = maximum segment length in radians
+* Distance, in radians, between the point at fraction t of the straight
+* line joining two vertices in longitude/latitude, taking the shorter
+* way around in longitude, and a point of the great circle arc.
 */
-LWGEOM*
-lwgeom_segmentize_sphere(const LWGEOM *lwg_in, double max_seg_length)
+static double
+edge_deviation_sphere_at(const POINT3D *q, const POINT4D *v1, const POINT4D *v2, double t)
+{
+	GEOGRAPHIC_POINT g;
+	POINT3D p;
+	double dlon = v2->x - v1->x;
+
+	if ( dlon > 180.0 )
+		dlon -= 360.0;
+	else if ( dlon < -180.0 )
+		dlon += 360.0;
+
+	geographic_point_init(v1->x + dlon * t, v1->y + (v2->y - v1->y) * t, &g);
+	geog2cart(&g, &p);
+	return sphere_distance_cartesian(q, &p);
+}
+
+/**
+* How far a drawing of an edge on a plate carree map strays from the
+* great circle arc, measured at the quarter points and the middle of
+* the arc. Checking the middle only would miss edges crossing the
+* equator, whose drawings swing to both sides of the arc.
+*/
+static double
+edge_deviation_sphere(const POINT3D *p1, const POINT3D *p2, const POINT3D *mid, const POINT4D *v1, const POINT4D *v2)
+{
+	POINT3D q1, q3;
+	double d = edge_deviation_sphere_at(mid, v1, v2, 0.5);
+
+	vector_sum(p1, mid, &q1);
+	normalize(&q1);
+	vector_sum(mid, p2, &q3);
+	normalize(&q3);
+	d = FP_MAX(d, edge_deviation_sphere_at(&q1, v1, v2, 0.25));
+	return FP_MAX(d, edge_deviation_sphere_at(&q3, v1, v2, 0.75));
+}
+
+static int ptarray_densify_sphere_edge_recursive (
+	const POINT3D *p1, const POINT3D *p2, /* 3-space points we are interpolating between */
+	const POINT4D *v1, const POINT4D *v2, /* real values and z/m values */
+	double max_deviation, /* limit on the deviation of the edges */
+	POINTARRAY *pa) /* write out results here */
+{
+	GEOGRAPHIC_POINT g;
+	POINT3D mid;
+	POINT4D midv;
+
+	/* A tiny deviation asks for more vertices than an array holds */
+	if ( pa->npoints >= UINT32_MAX - 1 )
+		return LW_FAILURE;
+
+	mid.x = (p1->x + p2->x) / 2.0;
+	mid.y = (p1->y + p2->y) / 2.0;
+	mid.z = (p1->z + p2->z) / 2.0;
+	normalize(&mid);
+
+	/* Straight enough, or so short that the whole edge and its */
+	/* drawing lie within the deviation of its start point: add */
+	/* the start point, the end point comes with the next edge */
+	if ( edge_deviation_sphere(p1, p2, &mid, v1, v2) <= max_deviation ||
+	     sphere_distance_cartesian(p1, p2) <= max_deviation )
+	{
+		LW_ON_INTERRUPT(return LW_FAILURE);
+		return ptarray_append_point(pa, v1, LW_FALSE);
+	}
+
+	cart2geog(&mid, &g);
+	midv.x = rad2deg(g.lon);
+	midv.y = rad2deg(g.lat);
+	midv.z = (v1->z + v2->z) / 2.0;
+	midv.m = (v1->m + v2->m) / 2.0;
+	/* Recurse on the left first */
+	if ( ptarray_densify_sphere_edge_recursive(p1, &mid, v1, &midv, max_deviation, pa) == LW_FAILURE )
+		return LW_FAILURE;
+	return ptarray_densify_sphere_edge_recursive(&mid, p2, &midv, v2, max_deviation, pa);
+}
+
+/**
+* Create a new point array whose edges, drawn as straight lines in
+* longitude/latitude, stray less than max_deviation (in radians) from
+* the great circle arcs between their vertices. Edges are halved only
+* where they need it: meridians and the equator are left alone, while
+* long edges at high latitudes get many vertices.
+* @param pa_in - input point array pointer
+* @param max_deviation - maximum deviation in radians
+*/
+static POINTARRAY*
+ptarray_densify_sphere(const POINTARRAY *pa_in, double max_deviation)
+{
+	POINTARRAY *pa_out;
+	POINT4D p1, p2;
+	POINT3D q1, q2;
+	GEOGRAPHIC_POINT g;
+	uint32_t i;
+
+	if ( ! pa_in )
+		lwerror("%s: null input pointarray", __func__);
+	/* Written so as to turn away NaN, which no edge would ever meet */
+	if ( ! (max_deviation > 0.0) )
+	{
+		lwerror("%s: maximum deviation must be positive", __func__);
+		return NULL;
+	}
+
+	/* The output is at least as large as the input */
+	pa_out = ptarray_construct_empty(ptarray_has_z(pa_in), ptarray_has_m(pa_in), pa_in->npoints);
+	if ( ! pa_in->npoints )
+		return pa_out;
+
+	getPoint4d_p(pa_in, 0, &p2);
+	geographic_point_init(p2.x, p2.y, &g);
+	geog2cart(&g, &q2);
+	for (i = 1; i < pa_in->npoints; i++)
+	{
+		p1 = p2;
+		q1 = q2;
+		getPoint4d_p(pa_in, i, &p2);
+		geographic_point_init(p2.x, p2.y, &g);
+		geog2cart(&g, &q2);
+
+		/* Skip duplicate points (except in case of 2-point lines!) */
+		if ((pa_in->npoints > 2) && p4d_same(&p1, &p2))
+			continue;
+
+		if ( ptarray_densify_sphere_edge_recursive(&q1, &q2, &p1, &p2, max_deviation, pa_out) == LW_FAILURE )
+		{
+			int full = pa_out->npoints >= UINT32_MAX - 1;
+			ptarray_free(pa_out);
+			if ( full )
+				lwerror("%s: maximum deviation is too small", __func__);
+			else
+				lwerror("%s: interrupted", __func__);
+			return NULL;
+		}
+	}
+	/* Always add the last point */
+	ptarray_append_point(pa_out, &p2, LW_TRUE);
+	return pa_out;
+}
+
+/*
+* Apply a point array densifier to all the lines and rings of a
+* geometry.
+*/
+static LWGEOM*
+lwgeom_densify_sphere_ptarrays(const LWGEOM *lwg_in, POINTARRAY* (*ptarray_func)(const POINTARRAY*, double), double param)
 {
 	POINTARRAY *pa_out;
 	LWLINE *lwline;
@@ -1677,7 +1979,9 @@ lwgeom_segmentize_sphere(const LWGEOM *lwg_in, double max_seg_length)
 		break;
 	case LINETYPE:
 		lwline = lwgeom_as_lwline(lwg_in);
-		pa_out = ptarray_segmentize_sphere(lwline->points, max_seg_length);
+		pa_out = ptarray_func(lwline->points, param);
+		if ( ! pa_out )
+			return NULL;
 		return lwline_as_lwgeom(lwline_construct(lwg_in->srid, NULL, pa_out));
 		break;
 	case POLYGONTYPE:
@@ -1685,7 +1989,12 @@ lwgeom_segmentize_sphere(const LWGEOM *lwg_in, double max_seg_length)
 		lwpoly_out = lwpoly_construct_empty(lwg_in->srid, lwgeom_has_z(lwg_in), lwgeom_has_m(lwg_in));
 		for ( i = 0; i < lwpoly_in->nrings; i++ )
 		{
-			pa_out = ptarray_segmentize_sphere(lwpoly_in->rings[i], max_seg_length);
+			pa_out = ptarray_func(lwpoly_in->rings[i], param);
+			if ( ! pa_out )
+			{
+				lwpoly_free(lwpoly_out);
+				return NULL;
+			}
 			lwpoly_add_ring(lwpoly_out, pa_out);
 		}
 		return lwpoly_as_lwgeom(lwpoly_out);
@@ -1697,20 +2006,52 @@ lwgeom_segmentize_sphere(const LWGEOM *lwg_in, double max_seg_length)
 		lwcol_out = lwcollection_construct_empty(lwg_in->type, lwg_in->srid, lwgeom_has_z(lwg_in), lwgeom_has_m(lwg_in));
 		for ( i = 0; i < lwcol_in->ngeoms; i++ )
 		{
-			lwcollection_add_lwgeom(lwcol_out, lwgeom_segmentize_sphere(lwcol_in->geoms[i], max_seg_length));
+			LWGEOM *lwg_out = lwgeom_densify_sphere_ptarrays(lwcol_in->geoms[i], ptarray_func, param);
+			if ( ! lwg_out )
+			{
+				lwcollection_free(lwcol_out);
+				return NULL;
+			}
+			lwcollection_add_lwgeom(lwcol_out, lwg_out);
 		}
 		return lwcollection_as_lwgeom(lwcol_out);
 		break;
 	default:
-		lwerror("lwgeom_segmentize_sphere: unsupported input geometry type: %d - %s",
-		        lwg_in->type, lwtype_name(lwg_in->type));
+		lwerror("%s: unsupported input geometry type: %d - %s",
+		        __func__, lwg_in->type, lwtype_name(lwg_in->type));
 		break;
 	}
 
-	lwerror("lwgeom_segmentize_sphere got to the end of the function, should not happen");
+	lwerror("%s got to the end of the function, should not happen", __func__);
 	return NULL;
 }
 
+/**
+* Create a new, densified geometry where no segment is longer than max_seg_length.
+* Input geometry is not altered, output geometry must be freed by caller.
+* @param lwg_in = input geometry
+* @param max_seg_length = maximum segment length in radians
+*/
+LWGEOM*
+lwgeom_segmentize_sphere(const LWGEOM *lwg_in, double max_seg_length)
+{
+	return lwgeom_densify_sphere_ptarrays(lwg_in, ptarray_segmentize_sphere, max_seg_length);
+}
+
+/**
+* Create a new, densified geometry where no segment, drawn as a straight
+* line in longitude/latitude, strays more than max_deviation from the
+* great circle arc it stands for.
+* Input geometry is not altered, output geometry must be freed by caller.
+* @param lwg_in = input geometry
+* @param max_deviation = maximum deviation in radians
+*/
+LWGEOM*
+lwgeom_densify_sphere(const LWGEOM *lwg_in, double max_deviation)
+{
+	return lwgeom_densify_sphere_ptarrays(lwg_in, ptarray_densify_sphere, max_deviation);
+}
+
 
 /**
 * Returns the area of the ring (ring must be closed) in square radians (surface of
@@ -1745,69 +2086,209 @@ ptarray_area_sphere(const POINTARRAY *pa)
 }
 
 
-static double ptarray_distance_spheroid(const POINTARRAY *pa1, const POINTARRAY *pa2, const SPHEROID *s, double tolerance, int check_intersection)
+/**
+* From this many vertex pairs on, ptarray_distance_spheroid() runs on
+* circ trees of the two lines rather than on every pair of edges.
+*/
+#define DISTANCE_SPHEROID_TREE_PAIRS 1024
+
+/**
+* Unit normals of the edges of a point array, as edge_distance_to_edge()
+* works them out, so the ith edge has its normal in slot i.
+*/
+static POINT3D* ptarray_edge_normals(const POINTARRAY *pa)
+{
+	POINT3D *normals = lwalloc(sizeof(POINT3D) * (pa->npoints ? pa->npoints : 1));
+	GEOGRAPHIC_EDGE e;
+	const POINT2D *p;
+	uint32_t i;
+
+	if ( pa->npoints == 0 )
+		return normals;
+
+	p = getPoint2d_cp(pa, 0);
+	geographic_point_init(p->x, p->y, &(e.start));
+	for ( i = 1; i < pa->npoints; i++ )
+	{
+		p = getPoint2d_cp(pa, i);
+		geographic_point_init(p->x, p->y, &(e.end));
+		edge_normal(&e, &(normals[i-1]));
+		e.start = e.end;
+	}
+	return normals;
+}
+
+/**
+* Line/line case of ptarray_distance_spheroid(), reading the end points
+* of the edges in cartesian form from the cpa1 and cpa2 arrays, and the
+* normals of the edges of pa2 from normals2.
+*/
+static double ptarray_distance_spheroid_lines(const POINTARRAY *pa1, const CART_PTARRAY *cpa1, const POINTARRAY *pa2, const CART_PTARRAY *cpa2, const POINT3D *normals2, const SPHEROID *s, double tolerance, int check_intersection)
 {
 	GEOGRAPHIC_EDGE e1, e2;
 	GEOGRAPHIC_POINT g1, g2;
 	GEOGRAPHIC_POINT nearest1, nearest2;
-	POINT3D A1, A2, B1, B2;
+	POINT3D A1, A2, B1, B2, N1;
 	const POINT2D *p;
-	double distance;
+	double distance = FLT_MAX;
 	uint32_t i, j;
 	int use_sphere = (s->a == s->b ? 1 : 0);
 
-	/* Make result really big, so that everything will be smaller than it */
-	distance = FLT_MAX;
+	/* Initialize start of line 1 */
+	p = getPoint2d_cp(pa1, 0);
+	geographic_point_init(p->x, p->y, &(e1.start));
+	CART_PTARRAY_GET(cpa1, 0, &A1);
 
-	/* Empty point arrays? Return negative */
-	if ( pa1->npoints == 0 || pa2->npoints == 0 )
-		return -1.0;
 
-	/* Handle point/point case here */
-	if ( pa1->npoints == 1 && pa2->npoints == 1 )
+	/* Handle line/line case */
+	for ( i = 1; i < pa1->npoints; i++ )
 	{
-		p = getPoint2d_cp(pa1, 0);
-		geographic_point_init(p->x, p->y, &g1);
-		p = getPoint2d_cp(pa2, 0);
-		geographic_point_init(p->x, p->y, &g2);
-		/* Sphere special case, axes equal */
-		distance = s->radius * sphere_distance(&g1, &g2);
-		if ( use_sphere )
-			return distance;
-		/* Below tolerance, actual distance isn't of interest */
-		else if ( distance < 0.95 * tolerance )
-			return distance;
-		/* Close or greater than tolerance, get the real answer to be sure */
-		else
-			return spheroid_distance(&g1, &g2, s);
-	}
+		p = getPoint2d_cp(pa1, i);
+		geographic_point_init(p->x, p->y, &(e1.end));
+		CART_PTARRAY_GET(cpa1, i, &A2);
+		edge_normal(&e1, &N1);
 
-	/* Handle point/line case here */
-	if ( pa1->npoints == 1 || pa2->npoints == 1 )
-	{
-		/* Handle one/many case here */
-		uint32_t i;
-		const POINTARRAY *pa_one;
-		const POINTARRAY *pa_many;
+		/* Initialize start of line 2 */
+		p = getPoint2d_cp(pa2, 0);
+		geographic_point_init(p->x, p->y, &(e2.start));
+		CART_PTARRAY_GET(cpa2, 0, &B1);
 
-		if ( pa1->npoints == 1 )
-		{
-			pa_one = pa1;
-			pa_many = pa2;
-		}
-		else
+		for ( j = 1; j < pa2->npoints; j++ )
 		{
-			pa_one = pa2;
-			pa_many = pa1;
+			double d;
+
+			p = getPoint2d_cp(pa2, j);
+			geographic_point_init(p->x, p->y, &(e2.end));
+			CART_PTARRAY_GET(cpa2, j, &B2);
+
+			LWDEBUGF(4, "e1.start == GPOINT(%.6g %.6g) ", e1.start.lat, e1.start.lon);
+			LWDEBUGF(4, "e1.end == GPOINT(%.6g %.6g) ", e1.end.lat, e1.end.lon);
+			LWDEBUGF(4, "e2.start == GPOINT(%.6g %.6g) ", e2.start.lat, e2.start.lon);
+			LWDEBUGF(4, "e2.end == GPOINT(%.6g %.6g) ", e2.end.lat, e2.end.lon);
+
+			if ( check_intersection && edge_intersects(&A1, &A2, &B1, &B2) )
+			{
+				LWDEBUG(4,"edge intersection! returning 0.0");
+				return 0.0;
+			}
+			d = s->radius * edge_distance_to_edge_cart(&e1, &A1, &A2, &N1, &e2, &B1, &B2, &(normals2[j-1]), &g1, &g2);
+			LWDEBUGF(4,"got edge_distance_to_edge %.8g", d);
+
+			if ( d < distance )
+			{
+				distance = d;
+				nearest1 = g1;
+				nearest2 = g2;
+			}
+			if ( d < tolerance )
+			{
+				if ( use_sphere )
+				{
+					return d;
+				}
+				else
+				{
+					d = spheroid_distance(&nearest1, &nearest2, s);
+					if ( d < tolerance )
+						return d;
+				}
+			}
+
+			/* Copy end to start to allow a new end value in next iteration */
+			e2.start = e2.end;
+			B1 = B2;
+		}
+
+		/* Copy end to start to allow a new end value in next iteration */
+		e1.start = e1.end;
+		A1 = A2;
+		LW_ON_INTERRUPT(return -1.0);
+	}
+	LWDEBUGF(4,"finished all loops, returning %.8g", distance);
+
+	if ( use_sphere )
+		return distance;
+	else
+		return spheroid_distance(&nearest1, &nearest2, s);
+}
+
+/**
+* Distance on the sphere, unless the spheroid is not a sphere and
+* the sphere distance is near or over tolerance.
+*/
+static inline double point_distance_spheroid(const GEOGRAPHIC_POINT *g1, const GEOGRAPHIC_POINT *g2, double sphere_distance, const SPHEROID *s, double tolerance)
+{
+	double distance = s->radius * sphere_distance;
+	/* Sphere special case, axes equal */
+	if ( s->a == s->b )
+		return distance;
+	/* Below tolerance, actual distance isn't of interest */
+	else if ( distance < 0.95 * tolerance )
+		return distance;
+	/* Close or greater than tolerance, get the real answer to be sure */
+	else
+		return spheroid_distance(g1, g2, s);
+}
+
+double point2d_distance_spheroid(const POINT2D *p1, const POINT2D *p2, const SPHEROID *s, double tolerance)
+{
+	GEOGRAPHIC_POINT g1, g2;
+	geographic_point_init(p1->x, p1->y, &g1);
+	geographic_point_init(p2->x, p2->y, &g2);
+	return point_distance_spheroid(&g1, &g2, sphere_distance(&g1, &g2), s, tolerance);
+}
+
+static double ptarray_distance_spheroid(const POINTARRAY *pa1, const POINTARRAY *pa2, const SPHEROID *s, double tolerance, int check_intersection)
+{
+	GEOGRAPHIC_EDGE e1;
+	GEOGRAPHIC_POINT g1, g2;
+	GEOGRAPHIC_POINT nearest2;
+	CART_PTARRAY *cpa1, *cpa2;
+	POINT3D *normals2;
+	POINT3D A1, A2, N1, P;
+	const POINT2D *p;
+	double distance;
+	int use_sphere = (s->a == s->b ? 1 : 0);
+
+	/* Make result really big, so that everything will be smaller than it */
+	distance = FLT_MAX;
+
+	/* Empty point arrays? Return negative */
+	if ( pa1->npoints == 0 || pa2->npoints == 0 )
+		return -1.0;
+
+	/* Handle point/point case here */
+	if ( pa1->npoints == 1 && pa2->npoints == 1 )
+		return point2d_distance_spheroid(getPoint2d_cp(pa1, 0), getPoint2d_cp(pa2, 0), s, tolerance);
+
+	/* Handle point/line case here */
+	if ( pa1->npoints == 1 || pa2->npoints == 1 )
+	{
+		/* Handle one/many case here */
+		uint32_t i;
+		const POINTARRAY *pa_one;
+		const POINTARRAY *pa_many;
+
+		if ( pa1->npoints == 1 )
+		{
+			pa_one = pa1;
+			pa_many = pa2;
+		}
+		else
+		{
+			pa_one = pa2;
+			pa_many = pa1;
 		}
 
 		/* Initialize our point */
 		p = getPoint2d_cp(pa_one, 0);
 		geographic_point_init(p->x, p->y, &g1);
+		geog2cart(&g1, &P);
 
 		/* Initialize start of line */
 		p = getPoint2d_cp(pa_many, 0);
 		geographic_point_init(p->x, p->y, &(e1.start));
+		geog2cart(&(e1.start), &A1);
 
 		/* Iterate through the edges in our line */
 		for ( i = 1; i < pa_many->npoints; i++ )
@@ -1815,8 +2296,10 @@ static double ptarray_distance_spheroid(const POINTARRAY *pa1, const POINTARRAY
 			double d;
 			p = getPoint2d_cp(pa_many, i);
 			geographic_point_init(p->x, p->y, &(e1.end));
+			geog2cart(&(e1.end), &A2);
+			edge_normal(&e1, &N1);
 			/* Get the spherical distance between point and edge */
-			d = s->radius * edge_distance_to_point(&e1, &g1, &g2);
+			d = s->radius * edge_distance_to_point_cart(&e1, &A1, &A2, &N1, &g1, &P, &g2);
 			/* New shortest distance! Record this distance / location */
 			if ( d < distance )
 			{
@@ -1846,6 +2329,7 @@ static double ptarray_distance_spheroid(const POINTARRAY *pa1, const POINTARRAY
 				}
 			}
 			e1.start = e1.end;
+			A1 = A2;
 		}
 
 		/* On sphere, return answer */
@@ -1857,81 +2341,28 @@ static double ptarray_distance_spheroid(const POINTARRAY *pa1, const POINTARRAY
 
 	}
 
-	/* Initialize start of line 1 */
-	p = getPoint2d_cp(pa1, 0);
-	geographic_point_init(p->x, p->y, &(e1.start));
-	geog2cart(&(e1.start), &A1);
-
-
-	/* Handle line/line case */
-	for ( i = 1; i < pa1->npoints; i++ )
+	/* Long line/line case, build throwaway trees so that distant */
+	/* edge pairs get pruned instead of visited */
+	if ( (uint64_t)pa1->npoints * pa2->npoints >= DISTANCE_SPHEROID_TREE_PAIRS )
 	{
-		p = getPoint2d_cp(pa1, i);
-		geographic_point_init(p->x, p->y, &(e1.end));
-		geog2cart(&(e1.end), &A2);
-
-		/* Initialize start of line 2 */
-		p = getPoint2d_cp(pa2, 0);
-		geographic_point_init(p->x, p->y, &(e2.start));
-		geog2cart(&(e2.start), &B1);
-
-		for ( j = 1; j < pa2->npoints; j++ )
-		{
-			double d;
-
-			p = getPoint2d_cp(pa2, j);
-			geographic_point_init(p->x, p->y, &(e2.end));
-			geog2cart(&(e2.end), &B2);
-
-			LWDEBUGF(4, "e1.start == GPOINT(%.6g %.6g) ", e1.start.lat, e1.start.lon);
-			LWDEBUGF(4, "e1.end == GPOINT(%.6g %.6g) ", e1.end.lat, e1.end.lon);
-			LWDEBUGF(4, "e2.start == GPOINT(%.6g %.6g) ", e2.start.lat, e2.start.lon);
-			LWDEBUGF(4, "e2.end == GPOINT(%.6g %.6g) ", e2.end.lat, e2.end.lon);
-
-			if ( check_intersection && edge_intersects(&A1, &A2, &B1, &B2) )
-			{
-				LWDEBUG(4,"edge intersection! returning 0.0");
-				return 0.0;
-			}
-			d = s->radius * edge_distance_to_edge(&e1, &e2, &g1, &g2);
-			LWDEBUGF(4,"got edge_distance_to_edge %.8g", d);
-
-			if ( d < distance )
-			{
-				distance = d;
-				nearest1 = g1;
-				nearest2 = g2;
-			}
-			if ( d < tolerance )
-			{
-				if ( use_sphere )
-				{
-					return d;
-				}
-				else
-				{
-					d = spheroid_distance(&nearest1, &nearest2, s);
-					if ( d < tolerance )
-						return d;
-				}
-			}
-
-			/* Copy end to start to allow a new end value in next iteration */
-			e2.start = e2.end;
-			B1 = B2;
-		}
-
-		/* Copy end to start to allow a new end value in next iteration */
-		e1.start = e1.end;
-		A1 = A2;
-		LW_ON_INTERRUPT(return -1.0);
+		CIRC_NODE *tree1 = circ_tree_new(pa1);
+		CIRC_NODE *tree2 = circ_tree_new(pa2);
+		distance = circ_tree_distance_tree(tree1, tree2, s, tolerance);
+		circ_tree_free(tree1);
+		circ_tree_free(tree2);
+		return distance;
 	}
-	LWDEBUGF(4,"finished all loops, returning %.8g", distance);
 
-	if ( use_sphere )
-		return distance;
-	else
-		return spheroid_distance(&nearest1, &nearest2, s);
+	/* Line/line case visits every edge of line 2 once per edge of */
+	/* line 1, so work out their cartesian ends and normals up front */
+	cpa1 = ptarray_cart_new(pa1);
+	cpa2 = ptarray_cart_new(pa2);
+	normals2 = ptarray_edge_normals(pa2);
+	distance = ptarray_distance_spheroid_lines(pa1, cpa1, pa2, cpa2, normals2, s, tolerance, check_intersection);
+	ptarray_cart_free(cpa1);
+	ptarray_cart_free(cpa2);
+	lwfree(normals2);
+	return distance;
 }
 
 
@@ -2091,6 +2522,72 @@ double lwgeom_azumith_spheroid(const LWPOINT *r, const LWPOINT *s, const SPHEROI
 	return spheroid_direction(&g1, &g2, spheroid);
 }
 
+/**
+* Number of multipoint members lwmpoint_distance_spheroid() takes
+* through the batch kernels at a time.
+*/
+#define DISTANCE_SPHEROID_BATCH 64
+
+/**
+* Point/multipoint case of lwgeom_distance_spheroid(), a batch of
+* members at a time. Answers as the recursion into the members does,
+* up to the rounding of swapped arguments. Returns LW_FAILURE on
+* multipoints with empty members, which are left to the recursion.
+*/
+static int lwmpoint_distance_spheroid(const LWPOINT *lwpt, const LWMPOINT *lwmpt, const SPHEROID *spheroid, double tolerance, double *distance)
+{
+	GEOGRAPHIC_POINT g, gs[DISTANCE_SPHEROID_BATCH], gfar[DISTANCE_SPHEROID_BATCH];
+	double d[DISTANCE_SPHEROID_BATCH], dfar[DISTANCE_SPHEROID_BATCH];
+	uint32_t far[DISTANCE_SPHEROID_BATCH];
+	const POINT2D *p;
+	uint32_t i, j, n, nfar;
+
+	for ( i = 0; i < lwmpt->ngeoms; i++ )
+	{
+		if ( lwpoint_is_empty(lwmpt->geoms[i]) )
+			return LW_FAILURE;
+	}
+
+	p = getPoint2d_cp(lwpt->point, 0);
+	geographic_point_init(p->x, p->y, &g);
+
+	*distance = FLT_MAX;
+	for ( i = 0; i < lwmpt->ngeoms; i += n )
+	{
+		n = FP_MIN(lwmpt->ngeoms - i, DISTANCE_SPHEROID_BATCH);
+		for ( j = 0; j < n; j++ )
+		{
+			p = getPoint2d_cp(lwmpt->geoms[i + j]->point, 0);
+			geographic_point_init(p->x, p->y, &gs[j]);
+		}
+		sphere_distance_batch(&g, gs, n, d);
+
+		/* Members near or over tolerance get their spheroid distance */
+		nfar = 0;
+		for ( j = 0; j < n; j++ )
+		{
+			d[j] *= spheroid->radius;
+			if ( spheroid->a != spheroid->b && d[j] >= 0.95 * tolerance )
+			{
+				far[nfar] = j;
+				gfar[nfar++] = gs[j];
+			}
+		}
+		spheroid_distance_batch(&g, gfar, nfar, spheroid, dfar);
+		for ( j = 0; j < nfar; j++ )
+			d[far[j]] = dfar[j];
+
+		for ( j = 0; j < n; j++ )
+		{
+			if ( d[j] < *distance )
+				*distance = d[j];
+			if ( *distance < tolerance )
+				return LW_SUCCESS;
+		}
+	}
+	return LW_SUCCESS;
+}
+
 /**
 * Calculate the distance between two LWGEOMs, using the coordinates are
 * longitude and latitude. Return immediately when the calculated distance drops
@@ -2121,6 +2618,20 @@ double lwgeom_distance_spheroid(const LWGEOM *lwgeom1, const LWGEOM *lwgeom2, co
 	type1 = lwgeom1->type;
 	type2 = lwgeom2->type;
 
+	/* Point/multipoint needs no boxes, the members go through in batches */
+	if ( type1 == POINTTYPE && type2 == MULTIPOINTTYPE )
+	{
+		double distance;
+		if ( lwmpoint_distance_spheroid((LWPOINT*)lwgeom1, (LWMPOINT*)lwgeom2, spheroid, tolerance, &distance) )
+			return distance;
+	}
+	else if ( type1 == MULTIPOINTTYPE && type2 == POINTTYPE )
+	{
+		double distance;
+		if ( lwmpoint_distance_spheroid((LWPOINT*)lwgeom2, (LWMPOINT*)lwgeom1, spheroid, tolerance, &distance) )
+			return distance;
+	}
+
 	/* Make sure we have boxes */
 	if ( lwgeom1->bbox )
 		gbox1 = *(lwgeom1->bbox);
@@ -2423,6 +2934,84 @@ int lwgeom_covers_lwgeom_sphere(const LWGEOM *lwgeom1, const LWGEOM *lwgeom2)
 
 }
 
+/**
+* Core of lwpoly_covers_point2d(), for a polygon with a known gbox and
+* outside point. The rings array holds the cartesian form of each ring,
+* filled in on first use, so callers testing many points against the
+* same polygon convert its rings only once.
+*/
+static int lwpoly_covers_point2d_cart(const LWPOLY *poly, CART_PTARRAY **rings, const GBOX *gbox, const POINT2D *pt_outside, const POINT2D *pt_to_test)
+{
+	uint32_t i;
+	int in_hole_count = 0;
+	POINT3D p, S2;
+	GEOGRAPHIC_POINT gpt_to_test;
+
+	/* Point not in box? Done! */
+	geographic_point_init(pt_to_test->x, pt_to_test->y, &gpt_to_test);
+	geog2cart(&gpt_to_test, &p);
+	if ( ! gbox_contains_point3d(gbox, &p) )
+	{
+		LWDEBUG(4, "the point is not in the box!");
+		return LW_FALSE;
+	}
+
+	/* Stab line, from the test point to the outside point */
+	ll2cart(pt_to_test, &p);
+	ll2cart(pt_outside, &S2);
+
+	LWDEBUGF(4, "pt_outside POINT(%.18g %.18g)", pt_outside->x, pt_outside->y);
+	LWDEBUGF(4, "pt_to_test POINT(%.18g %.18g)", pt_to_test->x, pt_to_test->y);
+
+	/* Not in outer ring? We're done! */
+	if ( ! rings[0] )
+		rings[0] = ptarray_cart_new(poly->rings[0]);
+	if ( ! ptarray_cart_contains_point_sphere(rings[0], &p, &S2) )
+	{
+		LWDEBUG(4,"returning false, point is outside ring");
+		return LW_FALSE;
+	}
+
+	LWDEBUGF(4, "testing %d rings", poly->nrings);
+
+	/* But maybe point is in a hole... */
+	for ( i = 1; i < poly->nrings; i++ )
+	{
+		LWDEBUGF(4, "ring test loop %d", i);
+		if ( ! rings[i] )
+			rings[i] = ptarray_cart_new(poly->rings[i]);
+		/* Count up hole containment. Odd => outside boundary. */
+		if ( ptarray_cart_contains_point_sphere(rings[i], &p, &S2) )
+			in_hole_count++;
+	}
+
+	LWDEBUGF(4, "in_hole_count == %d", in_hole_count);
+
+	if ( in_hole_count % 2 )
+	{
+		LWDEBUG(4,"returning false, inner ring containment count is odd");
+		return LW_FALSE;
+	}
+
+	LWDEBUG(4,"returning true, inner ring containment count is even");
+	return LW_TRUE;
+}
+
+static CART_PTARRAY** lwpoly_cart_rings_new(const LWPOLY *poly)
+{
+	CART_PTARRAY **rings = lwalloc(sizeof(CART_PTARRAY*) * poly->nrings);
+	memset(rings, 0, sizeof(CART_PTARRAY*) * poly->nrings);
+	return rings;
+}
+
+static void lwpoly_cart_rings_free(const LWPOLY *poly, CART_PTARRAY **rings)
+{
+	uint32_t i;
+	for ( i = 0; i < poly->nrings; i++ )
+		ptarray_cart_free(rings[i]);
+	lwfree(rings);
+}
+
 /**
 * Given a polygon (lon/lat decimal degrees) and point (lon/lat decimal degrees) and
 * a guaranteed outside point (lon/lat decimal degrees) (calculate with gbox_pt_outside())
@@ -2430,12 +3019,10 @@ int lwgeom_covers_lwgeom_sphere(const LWGEOM *lwgeom1, const LWGEOM *lwgeom2)
 */
 int lwpoly_covers_point2d(const LWPOLY *poly, const POINT2D *pt_to_test)
 {
-	uint32_t i;
-	int in_hole_count = 0;
-	POINT3D p;
-	GEOGRAPHIC_POINT gpt_to_test;
+	CART_PTARRAY **rings;
 	POINT2D pt_outside;
 	GBOX gbox;
+	int rv;
 #if POSTGIS_DEBUG_LEVEL >= 4
 	char *geom_ewkt;
 #endif
@@ -2454,20 +3041,9 @@ int lwpoly_covers_point2d(const LWPOLY *poly, const POINT2D *pt_to_test)
 	else
 		lwgeom_calculate_gbox_geodetic((LWGEOM*)poly, &gbox);
 
-	/* Point not in box? Done! */
-	geographic_point_init(pt_to_test->x, pt_to_test->y, &gpt_to_test);
-	geog2cart(&gpt_to_test, &p);
-	if ( ! gbox_contains_point3d(&gbox, &p) )
-	{
-		LWDEBUG(4, "the point is not in the box!");
-		return LW_FALSE;
-	}
-
 	/* Calculate our outside point from the gbox */
 	gbox_pt_outside(&gbox, &pt_outside);
 
-	LWDEBUGF(4, "pt_outside POINT(%.18g %.18g)", pt_outside.x, pt_outside.y);
-	LWDEBUGF(4, "pt_to_test POINT(%.18g %.18g)", pt_to_test->x, pt_to_test->y);
 #if POSTGIS_DEBUG_LEVEL >= 4
 	geom_ewkt = lwgeom_to_ewkt((LWGEOM*)poly);
 	LWDEBUGF(4, "polygon %s", geom_ewkt);
@@ -2477,34 +3053,177 @@ int lwpoly_covers_point2d(const LWPOLY *poly, const POINT2D *pt_to_test)
 	lwfree(geom_ewkt);
 #endif
 
-	/* Not in outer ring? We're done! */
-	if ( ! ptarray_contains_point_sphere(poly->rings[0], &pt_outside, pt_to_test) )
-	{
-		LWDEBUG(4,"returning false, point is outside ring");
+	rings = lwpoly_cart_rings_new(poly);
+	rv = lwpoly_covers_point2d_cart(poly, rings, &gbox, &pt_outside, pt_to_test);
+	lwpoly_cart_rings_free(poly, rings);
+	return rv;
+}
+
+/**
+* From this many pairs of polygon vertices and tested vertices on, the
+* polygon covers tests run on circ trees of the polygon rings, visiting
+* only the edges near each stab line or tested edge.
+*/
+#define COVERS_SPHERE_TREE_PAIRS 1024
+
+/**
+* Trees of the rings of a polygon when it is to be tested against
+* npoints vertices, or NULL when that is too few to pay for them.
+*/
+static CIRC_NODE** lwpoly_ring_trees_new(const LWPOLY *poly, uint32_t npoints)
+{
+	CIRC_NODE **trees;
+	uint32_t i;
+
+	if ( (uint64_t)lwgeom_count_vertices((LWGEOM*)poly) * npoints < COVERS_SPHERE_TREE_PAIRS )
+		return NULL;
+
+	trees = lwalloc(sizeof(CIRC_NODE*) * poly->nrings);
+	for ( i = 0; i < poly->nrings; i++ )
+		trees[i] = circ_tree_new(poly->rings[i]);
+	return trees;
+}
+
+static void lwpoly_ring_trees_free(const LWPOLY *poly, CIRC_NODE **trees)
+{
+	uint32_t i;
+	if ( ! trees )
+		return;
+	for ( i = 0; i < poly->nrings; i++ )
+		circ_tree_free(trees[i]);
+	lwfree(trees);
+}
+
+/**
+* Tree form of lwpoly_covers_point2d_cart(), same answers.
+*/
+static int lwpoly_covers_point2d_tree(const LWPOLY *poly, CIRC_NODE **trees, const GBOX *gbox, const POINT2D *pt_outside, const POINT2D *pt_to_test)
+{
+	uint32_t i;
+	int in_hole_count = 0;
+	POINT3D p;
+	GEOGRAPHIC_POINT gpt_to_test;
+
+	/* Point not in box? Done! */
+	geographic_point_init(pt_to_test->x, pt_to_test->y, &gpt_to_test);
+	geog2cart(&gpt_to_test, &p);
+	if ( ! gbox_contains_point3d(gbox, &p) )
 		return LW_FALSE;
-	}
 
-	LWDEBUGF(4, "testing %d rings", poly->nrings);
+	/* Not in outer ring? We're done! */
+	if ( poly->rings[0]->npoints < 4 || ! circ_tree_ring_covers_point(trees[0], pt_to_test, pt_outside) )
+		return LW_FALSE;
 
-	/* But maybe point is in a hole... */
+	/* Count up hole containment. Odd => outside boundary. */
 	for ( i = 1; i < poly->nrings; i++ )
 	{
-		LWDEBUGF(4, "ring test loop %d", i);
-		/* Count up hole containment. Odd => outside boundary. */
-		if ( ptarray_contains_point_sphere(poly->rings[i], &pt_outside, pt_to_test) )
+		if ( poly->rings[i]->npoints >= 4 && circ_tree_ring_covers_point(trees[i], pt_to_test, pt_outside) )
 			in_hole_count++;
 	}
 
-	LWDEBUGF(4, "in_hole_count == %d", in_hole_count);
+	return in_hole_count % 2 ? LW_FALSE : LW_TRUE;
+}
 
-	if ( in_hole_count % 2 )
+/**
+* Core of lwpoly_covers_pointarray(), on the ring trees of the polygon
+* when there are any.
+*/
+static int lwpoly_covers_pointarray_trees(const LWPOLY* lwpoly, CIRC_NODE **trees, const POINTARRAY* pta)
+{
+	uint32_t i;
+	CART_PTARRAY **rings = NULL;
+	POINT2D pt_outside;
+	GBOX gbox;
+	int rv = LW_TRUE;
+
+	/* Box and outside point are shared by all the points, and so */
+	/* are rings or trees */
+	gbox.flags = 0;
+	if ( lwpoly->bbox )
+		gbox = *(lwpoly->bbox);
+	else
+		lwgeom_calculate_gbox_geodetic((LWGEOM*)lwpoly, &gbox);
+	gbox_pt_outside(&gbox, &pt_outside);
+	if ( ! trees )
+		rings = lwpoly_cart_rings_new(lwpoly);
+
+	for (i = 0; i < pta->npoints; i++) {
+		const POINT2D* pt_to_test = getPoint2d_cp(pta, i);
+		int covers = trees ?
+			lwpoly_covers_point2d_tree(lwpoly, trees, &gbox, &pt_outside, pt_to_test) :
+			lwpoly_covers_point2d_cart(lwpoly, rings, &gbox, &pt_outside, pt_to_test);
+
+		if ( LW_FALSE == covers ) {
+			LWDEBUG(4,"returning false, geometry2 has point outside of geometry1");
+			rv = LW_FALSE;
+			break;
+		}
+	}
+
+	if ( rings )
+		lwpoly_cart_rings_free(lwpoly, rings);
+	return rv;
+}
+
+/**
+* Core of lwpoly_intersects_line(), on the ring trees of the polygon
+* when there are any.
+*/
+static int lwpoly_intersects_line_trees(const LWPOLY* lwpoly, CIRC_NODE **trees, const POINTARRAY* line)
+{
+	uint32_t i, j, k;
+	POINT3D pa1, pa2, pb1, pb2;
+	CART_PTARRAY *cline, *cring;
+	int rv = LW_FALSE;
+
+	/* Only the edge pairs whose circles overlap get tested */
+	if ( trees )
 	{
-		LWDEBUG(4,"returning false, inner ring containment count is odd");
-		return LW_FALSE;
+		CIRC_NODE *tline = circ_tree_new(line);
+		for (i = 0; i < lwpoly->nrings && tline && ! rv; i++)
+		{
+			if ( trees[i] && circ_tree_edges_cross(trees[i], tline) )
+				rv = LW_TRUE;
+		}
+		circ_tree_free(tline);
+		return rv;
 	}
 
-	LWDEBUG(4,"returning true, inner ring containment count is even");
-	return LW_TRUE;
+	/* Every line vertex is visited once per ring edge, convert them once */
+	cline = ptarray_cart_new(line);
+
+	for (i = 0; i < lwpoly->nrings && ! rv; i++)
+	{
+		cring = ptarray_cart_new(lwpoly->rings[i]);
+		for (j = 0; j + 1 < cring->npoints && ! rv; j++)
+		{
+			/* Set up our stab line */
+			CART_PTARRAY_GET(cring, j, &pa1);
+			CART_PTARRAY_GET(cring, j+1, &pa2);
+
+			for (k = 0; k + 1 < cline->npoints; k++)
+			{
+				int inter;
+
+				CART_PTARRAY_GET(cline, k, &pb1);
+				CART_PTARRAY_GET(cline, k+1, &pb2);
+
+				inter = edge_intersects(&pa1, &pa2, &pb1, &pb2);
+
+				/* ignore same edges */
+				if (inter & PIR_INTERSECTS
+					&& !(inter & PIR_B_TOUCH_RIGHT || inter & PIR_COLINEAR) )
+				{
+					rv = LW_TRUE;
+					break;
+				}
+			}
+		}
+		ptarray_cart_free(cring);
+	}
+
+	ptarray_cart_free(cline);
+	return rv;
 }
 
 /**
@@ -2515,6 +3234,8 @@ int lwpoly_covers_point2d(const LWPOLY *poly, const POINT2D *pt_to_test)
 int lwpoly_covers_lwpoly(const LWPOLY *poly1, const LWPOLY *poly2)
 {
 	uint32_t i;
+	CIRC_NODE **trees;
+	int rv = LW_TRUE;
 
 	/* Nulls and empties don't contain anything! */
 	if ( ! poly1 || lwgeom_is_empty((LWGEOM*)poly1) )
@@ -2530,41 +3251,45 @@ int lwpoly_covers_lwpoly(const LWPOLY *poly1, const LWPOLY *poly2)
 		return LW_FALSE;
 	}
 
+	/* All rings of poly2 get tested against the same trees of poly1 */
+	trees = lwpoly_ring_trees_new(poly1, lwgeom_count_vertices((LWGEOM*)poly2));
+
 	/* check if all vertices of poly2 are inside poly1 */
-	for (i = 0; i < poly2->nrings; i++)
+	for (i = 0; i < poly2->nrings && rv; i++)
 	{
 
 		/* every other ring is a hole, check if point is inside the actual polygon */
 		if ( i % 2 == 0)
 		{
-			if (LW_FALSE == lwpoly_covers_pointarray(poly1, poly2->rings[i]))
+			if (LW_FALSE == lwpoly_covers_pointarray_trees(poly1, trees, poly2->rings[i]))
 			{
 				LWDEBUG(4,"returning false, geometry2 has point outside of geometry1");
-				return LW_FALSE;
+				rv = LW_FALSE;
 			}
 		}
 		else
 		{
-			if (LW_TRUE == lwpoly_covers_pointarray(poly1, poly2->rings[i]))
+			if (LW_TRUE == lwpoly_covers_pointarray_trees(poly1, trees, poly2->rings[i]))
 			{
 				LWDEBUG(4,"returning false, geometry2 has point inside a hole of geometry1");
-				return LW_FALSE;
+				rv = LW_FALSE;
 			}
 		}
 	}
 
 	/* check for any edge intersections, so nothing is partially outside of poly1 */
-	for (i = 0; i < poly2->nrings; i++)
+	for (i = 0; i < poly2->nrings && rv; i++)
 	{
-		if (LW_TRUE == lwpoly_intersects_line(poly1, poly2->rings[i]))
+		if (LW_TRUE == lwpoly_intersects_line_trees(poly1, trees, poly2->rings[i]))
 		{
 			LWDEBUG(4,"returning false, geometry2 is partially outside of geometry1");
-			return LW_FALSE;
+			rv = LW_FALSE;
 		}
 	}
 
 	/* no abort condition found, so the poly2 should be completly inside poly1 */
-	return LW_TRUE;
+	lwpoly_ring_trees_free(poly1, trees);
+	return rv;
 }
 
 /**
@@ -2572,6 +3297,9 @@ int lwpoly_covers_lwpoly(const LWPOLY *poly1, const LWPOLY *poly2)
  */
 int lwpoly_covers_lwline(const LWPOLY *poly, const LWLINE *line)
 {
+   CIRC_NODE **trees;
+   int rv = LW_TRUE;
+
    /* Nulls and empties don't contain anything! */
    if ( ! poly || lwgeom_is_empty((LWGEOM*)poly) )
    {
@@ -2586,21 +3314,24 @@ int lwpoly_covers_lwline(const LWPOLY *poly, const LWLINE *line)
 	   return LW_FALSE;
    }
 
-   if (LW_FALSE == lwpoly_covers_pointarray(poly, line->points))
+   trees = lwpoly_ring_trees_new(poly, line->points->npoints);
+
+   if (LW_FALSE == lwpoly_covers_pointarray_trees(poly, trees, line->points))
    {
 	   LWDEBUG(4,"returning false, geometry2 has point outside of geometry1");
-	   return LW_FALSE;
+	   rv = LW_FALSE;
    }
 
    /* check for any edge intersections, so nothing is partially outside of poly1 */
-   if (LW_TRUE == lwpoly_intersects_line(poly, line->points))
+   else if (LW_TRUE == lwpoly_intersects_line_trees(poly, trees, line->points))
    {
 	   LWDEBUG(4,"returning false, geometry2 is partially outside of geometry1");
-	   return LW_FALSE;
+	   rv = LW_FALSE;
    }
 
    /* no abort condition found, so the poly2 should be completely inside poly1 */
-   return LW_TRUE;
+   lwpoly_ring_trees_free(poly, trees);
+   return rv;
 }
 
 /**
@@ -2608,17 +3339,17 @@ int lwpoly_covers_lwline(const LWPOLY *poly, const LWLINE *line)
  */
 int lwpoly_covers_pointarray(const LWPOLY* lwpoly, const POINTARRAY* pta)
 {
-	uint32_t i;
-	for (i = 0; i < pta->npoints; i++) {
-		const POINT2D* pt_to_test = getPoint2d_cp(pta, i);
+	CIRC_NODE **trees;
+	int rv;
 
-		if ( LW_FALSE == lwpoly_covers_point2d(lwpoly, pt_to_test) ) {
-			LWDEBUG(4,"returning false, geometry2 has point outside of geometry1");
-			return LW_FALSE;
-		}
-	}
+	/* Nulls and empties don't contain anything! */
+	if ( ! lwpoly || lwgeom_is_empty((LWGEOM*)lwpoly) )
+		return pta->npoints ? LW_FALSE : LW_TRUE;
 
-	return LW_TRUE;
+	trees = lwpoly_ring_trees_new(lwpoly, pta->npoints);
+	rv = lwpoly_covers_pointarray_trees(lwpoly, trees, pta);
+	lwpoly_ring_trees_free(lwpoly, trees);
+	return rv;
 }
 
 /**
@@ -2627,41 +3358,10 @@ int lwpoly_covers_pointarray(const LWPOLY* lwpoly, const POINTARRAY* pta)
  */
 int lwpoly_intersects_line(const LWPOLY* lwpoly, const POINTARRAY* line)
 {
-	uint32_t i, j, k;
-	POINT3D pa1, pa2, pb1, pb2;
-	for (i = 0; i < lwpoly->nrings; i++)
-	{
-		for (j = 0; j < lwpoly->rings[i]->npoints - 1; j++)
-		{
-			const POINT2D* a1 = getPoint2d_cp(lwpoly->rings[i], j);
-			const POINT2D* a2 = getPoint2d_cp(lwpoly->rings[i], j+1);
-
-			/* Set up our stab line */
-			ll2cart(a1, &pa1);
-			ll2cart(a2, &pa2);
-
-			for (k = 0; k < line->npoints - 1; k++)
-			{
-				const POINT2D* b1 = getPoint2d_cp(line, k);
-				const POINT2D* b2 = getPoint2d_cp(line, k+1);
-
-				/* Set up our stab line */
-				ll2cart(b1, &pb1);
-				ll2cart(b2, &pb2);
-
-				int inter = edge_intersects(&pa1, &pa2, &pb1, &pb2);
-
-				/* ignore same edges */
-				if (inter & PIR_INTERSECTS
-					&& !(inter & PIR_B_TOUCH_RIGHT || inter & PIR_COLINEAR) )
-				{
-					return LW_TRUE;
-				}
-			}
-		}
-	}
-
-	return LW_FALSE;
+	CIRC_NODE **trees = lwpoly_ring_trees_new(lwpoly, line->npoints);
+	int rv = lwpoly_intersects_line_trees(lwpoly, trees, line);
+	lwpoly_ring_trees_free(lwpoly, trees);
+	return rv;
 }
 
 /**
@@ -2798,56 +3498,117 @@ int getPoint2d_p_ro(const POINTARRAY *pa, uint32_t n, POINT2D **point)
 	return LW_SUCCESS;
 }
 
-int ptarray_calculate_gbox_geodetic(const POINTARRAY *pa, GBOX *gbox)
+/*
+* Merge the minor arc from A1 to A2 into a box already holding A1.
+*
+* On the great circle of normal N, a coordinate reaches its extremes
+* where the circle meets the plane of N and of that axis: at plus and
+* minus the axis projected on the circle, where its value is
+* sqrt(1 - N_i^2 / |N|^2). The arc goes through such a point P when
+* (A1 x P).N and (P x A2).N are positive, which for the projected
+* axis boils down to the signs of component i of N x A1 and A2 x N.
+* That is the same box edge_calculate_gbox finds, without building
+* a frame for the edge, normalizing or testing six sides. Coincident
+* and antipodal edges, which have no plane, go the old way.
+*/
+static inline int
+edge_merge_gbox(const POINT3D *A1, const POINT3D *A2, GBOX *gbox)
 {
-	uint32_t i;
-	int first = LW_TRUE;
-	const POINT2D *p;
-	POINT3D A1, A2;
-	GBOX edge_gbox;
+	double d = dot_product(A1, A2);
+	double nn;
+	POINT3D D, N, B1, B2;
 
-	assert(gbox);
-	assert(pa);
-
-	gbox_init(&edge_gbox);
-	edge_gbox.flags = gbox->flags;
-
-	if ( pa->npoints == 0 ) return LW_FAILURE;
+	gbox_merge_point3d(A2, gbox);
 
-	if ( pa->npoints == 1 )
+	/* Cross with the difference or the sum of the ends for a sharp normal */
+	if ( d > 0.95 )
 	{
-		p = getPoint2d_cp(pa, 0);
-		ll2cart(p, &A1);
-		gbox->xmin = gbox->xmax = A1.x;
-		gbox->ymin = gbox->ymax = A1.y;
-		gbox->zmin = gbox->zmax = A1.z;
-		return LW_SUCCESS;
+		if ( p3d_same(A1, A2) )
+			return LW_SUCCESS;
+		vector_difference(A2, A1, &D);
+		cross_product(A1, &D, &N);
+	}
+	else if ( d < 0 )
+	{
+		if ( FP_EQUALS(A1->x, -1*A2->x) && FP_EQUALS(A1->y, -1*A2->y) && FP_EQUALS(A1->z, -1*A2->z) )
+		{
+			GBOX edge_gbox;
+			edge_gbox.flags = gbox->flags;
+			if ( edge_calculate_gbox(A1, A2, &edge_gbox) == LW_FAILURE )
+				return LW_FAILURE;
+			return gbox_merge(&edge_gbox, gbox);
+		}
+		vector_sum(A1, A2, &D);
+		cross_product(A1, &D, &N);
+	}
+	else
+	{
+		cross_product(A1, A2, &N);
 	}
 
-	p = getPoint2d_cp(pa, 0);
-	ll2cart(p, &A1);
+	nn = dot_product(&N, &N);
+	cross_product(&N, A1, &B1);
+	cross_product(A2, &N, &B2);
+
+#define EDGE_MERGE_EXTREMES(c) \
+	if ( B1.c >= 0.0 && B2.c >= 0.0 ) \
+	{ \
+		double e = sqrt(FP_MAX(0.0, 1.0 - N.c * N.c / nn)); \
+		if ( gbox->c##max < e ) gbox->c##max = e; \
+	} \
+	if ( B1.c <= 0.0 && B2.c <= 0.0 ) \
+	{ \
+		double e = -1 * sqrt(FP_MAX(0.0, 1.0 - N.c * N.c / nn)); \
+		if ( gbox->c##min > e ) gbox->c##min = e; \
+	}
 
-	for ( i = 1; i < pa->npoints; i++ )
-	{
+	EDGE_MERGE_EXTREMES(x)
+	EDGE_MERGE_EXTREMES(y)
+	EDGE_MERGE_EXTREMES(z)
 
-		p = getPoint2d_cp(pa, i);
-		ll2cart(p, &A2);
+#undef EDGE_MERGE_EXTREMES
 
-		edge_calculate_gbox(&A1, &A2, &edge_gbox);
+	return LW_SUCCESS;
+}
 
-		/* Initialize the box */
-		if ( first )
-		{
-			gbox_duplicate(&edge_gbox, gbox);
-			first = LW_FALSE;
-		}
-		/* Expand the box where necessary */
-		else
+/* Points converted to geocentric at a time, in ptarray_calculate_gbox_geodetic */
+#define GBOX_GEODETIC_CHUNK 256
+
+int ptarray_calculate_gbox_geodetic(const POINTARRAY *pa, GBOX *gbox)
+{
+	uint32_t i, j, n;
+	POINT3D pts[GBOX_GEODETIC_CHUNK + 1];
+
+	assert(gbox);
+	assert(pa);
+
+	if ( pa->npoints == 0 ) return LW_FAILURE;
+
+	ll2cart(getPoint2d_cp(pa, 0), &(pts[0]));
+	gbox_init_point3d(&(pts[0]), gbox);
+
+	/* Convert a run of points, then merge the edges between them */
+	for ( i = 1; i < pa->npoints; i += n )
+	{
+		n = FP_MIN(GBOX_GEODETIC_CHUNK, pa->npoints - i);
+		for ( j = 0; j < n; j++ )
+			ll2cart(getPoint2d_cp(pa, i + j), &(pts[j + 1]));
+		for ( j = 0; j < n; j++ )
 		{
-			gbox_merge(&edge_gbox, gbox);
+			if ( gbox_geocentric_slow )
+			{
+				GBOX edge_gbox;
+				edge_gbox.flags = gbox->flags;
+				if ( edge_calculate_gbox(&(pts[j]), &(pts[j + 1]), &edge_gbox) == LW_FAILURE )
+					return LW_FAILURE;
+				gbox_merge(&edge_gbox, gbox);
+			}
+			else if ( edge_merge_gbox(&(pts[j]), &(pts[j + 1]), gbox) == LW_FAILURE )
+			{
+				return LW_FAILURE;
+			}
 		}
-
-		A1 = A2;
+		pts[0] = pts[n];
 	}
 
 	return LW_SUCCESS;
@@ -3395,7 +4156,7 @@ point_in_cone(const POINT3D *A1, const POINT3D *A2, const POINT3D *P)
 /**
 * Utility function for ptarray_contains_point_sphere()
 */
-static int
+int
 point3d_equals(const POINT3D *p1, const POINT3D *p2)
 {
 	return FP_EQUALS(p1->x, p2->x) && FP_EQUALS(p1->y, p2->y) && FP_EQUALS(p1->z, p2->z);
@@ -3529,9 +4290,8 @@ edge_intersects(const POINT3D *A1, const POINT3D *A2, const POINT3D *B1, const P
 int ptarray_contains_point_sphere(const POINTARRAY *pa, const POINT2D *pt_outside, const POINT2D *pt_to_test)
 {
 	POINT3D S1, S2; /* Stab line end points */
-	POINT3D E1, E2; /* Edge end points (3-space) */
-	POINT2D p; /* Edge end points (lon/lat) */
-	uint32_t count = 0, i, inter;
+	CART_PTARRAY *cpa;
+	int rv;
 
 	/* Null input, not enough points for a ring? You ain't closed! */
 	if ( ! pa || pa->npoints < 4 )
@@ -3541,19 +4301,37 @@ int ptarray_contains_point_sphere(const POINTARRAY *pa, const POINT2D *pt_outsid
 	ll2cart(pt_to_test, &S1);
 	ll2cart(pt_outside, &S2);
 
+	cpa = ptarray_cart_new(pa);
+	rv = ptarray_cart_contains_point_sphere(cpa, &S1, &S2);
+	ptarray_cart_free(cpa);
+	return rv;
+}
+
+/**
+* As ptarray_contains_point_sphere(), for a ring already converted with
+* ptarray_cart_new() and a stab line running from S1, the point to test,
+* to S2, the outside point. Callers testing many points against the same
+* ring convert it once.
+*/
+int ptarray_cart_contains_point_sphere(const CART_PTARRAY *cpa, const POINT3D *S1, const POINT3D *S2)
+{
+	POINT3D E1, E2; /* Edge end points (3-space) */
+	uint32_t count = 0, i, inter;
+
+	/* Null input, not enough points for a ring? You ain't closed! */
+	if ( ! cpa || cpa->npoints < 4 )
+		return LW_FALSE;
+
 	/* Initialize first point */
-	getPoint2d_p(pa, 0, &p);
-	ll2cart(&p, &E1);
+	CART_PTARRAY_GET(cpa, 0, &E1);
 
 	/* Walk every edge and see if the stab line hits it */
-	for ( i = 1; i < pa->npoints; i++ )
+	for ( i = 1; i < cpa->npoints; i++ )
 	{
 		LWDEBUGF(4, "testing edge (%d)", i);
-		LWDEBUGF(4, "  start point == POINT(%.12g %.12g)", p.x, p.y);
 
 		/* Read next point. */
-		getPoint2d_p(pa, i, &p);
-		ll2cart(&p, &E2);
+		CART_PTARRAY_GET(cpa, i, &E2);
 
 		/* Skip over too-short edges. */
 		if ( point3d_equals(&E1, &E2) )
@@ -3562,13 +4340,13 @@ int ptarray_contains_point_sphere(const POINTARRAY *pa, const POINT2D *pt_outsid
 		}
 
 		/* Our test point is on an edge end! Point is "in ring" by our definition */
-		if ( point3d_equals(&S1, &E1) )
+		if ( point3d_equals(S1, &E1) )
 		{
 			return LW_TRUE;
 		}
 
 		/* Calculate relationship between stab line and edge */
-		inter = edge_intersects(&S1, &S2, &E1, &E2);
+		inter = edge_intersects(S1, S2, &E1, &E2);
 
 		/* We have some kind of interaction... */
 		if ( inter & PIR_INTERSECTS )
@@ -68,6 +68,25 @@ typedef struct
 	uint32_t index;
 } DISTANCE_ORDER;
 
+/**
+* Unit sphere cartesian coordinates of the vertices of a point array,
+* kept as separate x, y and z arrays. Loops that visit the vertices
+* many times read these instead of redoing the trigonometry.
+*/
+typedef struct
+{
+	uint32_t npoints;
+	double *x;
+	double *y;
+	double *z;
+} CART_PTARRAY;
+
+#define CART_PTARRAY_GET(cpa, n, p) do { \
+	(p)->x = (cpa)->x[n]; \
+	(p)->y = (cpa)->y[n]; \
+	(p)->z = (cpa)->z[n]; \
+} while (0)
+
 /**
 * Conversion functions
 */
@@ -103,6 +122,7 @@ double z_to_latitude(double z, int top);
 int clairaut_cartesian(const POINT3D *start, const POINT3D *end, GEOGRAPHIC_POINT *g_top, GEOGRAPHIC_POINT *g_bottom);
 int clairaut_geographic(const GEOGRAPHIC_POINT *start, const GEOGRAPHIC_POINT *end, GEOGRAPHIC_POINT *g_top, GEOGRAPHIC_POINT *g_bottom);
 double sphere_distance(const GEOGRAPHIC_POINT *s, const GEOGRAPHIC_POINT *e);
+void sphere_distance_batch(const GEOGRAPHIC_POINT *s, const GEOGRAPHIC_POINT *e, uint32_t n, double *d);
 double sphere_distance_cartesian(const POINT3D *s, const POINT3D *e);
 int sphere_project(const GEOGRAPHIC_POINT *r, double distance, double azimuth, GEOGRAPHIC_POINT *n);
 int edge_calculate_gbox_slow(const GEOGRAPHIC_EDGE *e, GBOX *gbox);
@@ -138,11 +158,16 @@ void normalize(POINT3D *p);
 void unit_normal(const POINT3D *P1, const POINT3D *P2, POINT3D *normal);
 double sphere_direction(const GEOGRAPHIC_POINT *s, const GEOGRAPHIC_POINT *e, double d);
 void ll2cart(const POINT2D *g, POINT3D *p);
+int point3d_equals(const POINT3D *p1, const POINT3D *p2);
+CART_PTARRAY* ptarray_cart_new(const POINTARRAY *pa);
+void ptarray_cart_free(CART_PTARRAY *cpa);
+int ptarray_cart_contains_point_sphere(const CART_PTARRAY *cpa, const POINT3D *S1, const POINT3D *S2);
 
 /*
 ** Prototypes for spheroid functions.
 */
 double spheroid_distance(const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, const SPHEROID *spheroid);
+void spheroid_distance_batch(const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, uint32_t n, const SPHEROID *spheroid, double *d);
 double spheroid_direction(const GEOGRAPHIC_POINT *r, const GEOGRAPHIC_POINT *s, const SPHEROID *spheroid);
 int spheroid_project(const GEOGRAPHIC_POINT *r, const SPHEROID *spheroid, double distance, double azimuth, GEOGRAPHIC_POINT *g);
 
@@ -0,0 +1,596 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#include "liblwgeom_internal.h"
+#include "lwgeodetic_tree.h"
+#include "lwgeodetic_cell.h"
+#include "lwgeom_log.h"
+
+/* Bits above the position of a cell hold its face */
+#define CELL_FACE_SHIFT 61
+#define CELL_POS_MASK ((UINT64_C(1) << CELL_FACE_SHIFT) - 1)
+
+/* Leaf cells along the side of a face */
+#define CELL_LEAF_SIDE ((uint32_t)1 << CELL_MAX_LEVEL)
+
+/* Marker bit of the cells of a level */
+#define CELL_LSB(level) (UINT64_C(1) << (2 * (CELL_MAX_LEVEL - (level))))
+
+/*
+* Normal, u and v axes of the six faces of the cube. A point is on
+* the face of the largest of its coordinates, +x, +y, +z, -x, -y, -z.
+*/
+static const POINT3D cell_face_axes[6][3] =
+{
+	{ { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+	{ { 0, 1, 0 }, {-1, 0, 0 }, { 0, 0, 1 } },
+	{ { 0, 0, 1 }, { 0, 1, 0 }, {-1, 0, 0 } },
+	{ {-1, 0, 0 }, { 0,-1, 0 }, { 0, 0, 1 } },
+	{ { 0,-1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+	{ { 0, 0,-1 }, { 0, 1, 0 }, { 1, 0, 0 } }
+};
+
+/* Spread the 30 low bits of i over the even bits of a word */
+static uint64_t
+cell_spread(uint32_t i)
+{
+	uint64_t x = i;
+	x = (x | (x << 16)) & UINT64_C(0x0000FFFF0000FFFF);
+	x = (x | (x << 8))  & UINT64_C(0x00FF00FF00FF00FF);
+	x = (x | (x << 4))  & UINT64_C(0x0F0F0F0F0F0F0F0F);
+	x = (x | (x << 2))  & UINT64_C(0x3333333333333333);
+	x = (x | (x << 1))  & UINT64_C(0x5555555555555555);
+	return x;
+}
+
+/* Gather the even bits of a word, inverse of cell_spread */
+static uint32_t
+cell_compact(uint64_t x)
+{
+	x &= UINT64_C(0x5555555555555555);
+	x = (x | (x >> 1))  & UINT64_C(0x3333333333333333);
+	x = (x | (x >> 2))  & UINT64_C(0x0F0F0F0F0F0F0F0F);
+	x = (x | (x >> 4))  & UINT64_C(0x00FF00FF00FF00FF);
+	x = (x | (x >> 8))  & UINT64_C(0x0000FFFF0000FFFF);
+	x = (x | (x >> 16)) & UINT64_C(0x00000000FFFFFFFF);
+	return (uint32_t)x;
+}
+
+/* Face coordinate in [-1,1] to and from its stretched value in [0,1] */
+static double
+cell_u_to_s(double u)
+{
+	return 0.5 * (1.0 + atan(u) / M_PI_4);
+}
+
+static double
+cell_s_to_u(double s)
+{
+	return tan(M_PI_4 * (2.0 * s - 1.0));
+}
+
+static double
+cell_dot(const POINT3D *p1, const POINT3D *p2)
+{
+	return p1->x * p2->x + p1->y * p2->y + p1->z * p2->z;
+}
+
+static void
+cell_point_to_face_st(const POINT3D *p, int *face, double *s, double *t)
+{
+	double ax = fabs(p->x);
+	double ay = fabs(p->y);
+	double az = fabs(p->z);
+	double n;
+
+	if ( ax >= ay && ax >= az )
+		*face = p->x >= 0 ? 0 : 3;
+	else if ( ay >= az )
+		*face = p->y >= 0 ? 1 : 4;
+	else
+		*face = p->z >= 0 ? 2 : 5;
+
+	n = cell_dot(p, &cell_face_axes[*face][0]);
+	*s = cell_u_to_s(cell_dot(p, &cell_face_axes[*face][1]) / n);
+	*t = cell_u_to_s(cell_dot(p, &cell_face_axes[*face][2]) / n);
+}
+
+static void
+cell_face_st_to_point(int face, double s, double t, POINT3D *p)
+{
+	const POINT3D *axes = cell_face_axes[face];
+	double u = cell_s_to_u(s);
+	double v = cell_s_to_u(t);
+
+	p->x = axes[0].x + u * axes[1].x + v * axes[2].x;
+	p->y = axes[0].y + u * axes[1].y + v * axes[2].y;
+	p->z = axes[0].z + u * axes[1].z + v * axes[2].z;
+	normalize(p);
+}
+
+static uint32_t
+cell_st_to_leaf(double s)
+{
+	if ( s <= 0.0 )
+		return 0;
+	if ( s >= 1.0 )
+		return CELL_LEAF_SIDE - 1;
+	return FP_MIN((uint32_t)(s * CELL_LEAF_SIDE), CELL_LEAF_SIDE - 1);
+}
+
+static CELL_ID
+cell_from_face_leaf(int face, uint32_t i, uint32_t j, int level)
+{
+	uint64_t pos = (cell_spread(i) << 1) | cell_spread(j);
+	CELL_ID lsb = CELL_LSB(level);
+	CELL_ID id = ((CELL_ID)face << CELL_FACE_SHIFT) | (pos << 1) | 1;
+	return (id & (~lsb + 1)) | lsb;
+}
+
+/* Face and position (i, j) of a cell among the cells of its level */
+static int
+cell_to_face_ij(CELL_ID id, uint32_t *i, uint32_t *j)
+{
+	int level = cell_level(id);
+	uint64_t pos = (id & CELL_POS_MASK) >> (1 + 2 * (CELL_MAX_LEVEL - level));
+	*i = cell_compact(pos >> 1);
+	*j = cell_compact(pos);
+	return (int)(id >> CELL_FACE_SHIFT);
+}
+
+CELL_ID
+cell_from_point(const POINT2D *pt, int level)
+{
+	GEOGRAPHIC_POINT g;
+	POINT3D p;
+	double s, t;
+	int face;
+
+	geographic_point_init(pt->x, pt->y, &g);
+	geog2cart(&g, &p);
+	cell_point_to_face_st(&p, &face, &s, &t);
+	return cell_from_face_leaf(face, cell_st_to_leaf(s), cell_st_to_leaf(t), level);
+}
+
+int
+cell_is_valid(CELL_ID id)
+{
+	CELL_ID lsb = id & (~id + 1);
+
+	if ( (id >> CELL_FACE_SHIFT) > 5 || ! lsb )
+		return LW_FALSE;
+	/* The marker is on an even bit, no lower than the leaf level */
+	return (lsb & UINT64_C(0x1555555555555555)) ? LW_TRUE : LW_FALSE;
+}
+
+int
+cell_level(CELL_ID id)
+{
+	int level = CELL_MAX_LEVEL;
+
+	while ( ! (id & 1) && level > 0 )
+	{
+		id >>= 2;
+		level--;
+	}
+	return level;
+}
+
+CELL_ID
+cell_parent(CELL_ID id, int level)
+{
+	CELL_ID lsb = CELL_LSB(level);
+	return (id & (~lsb + 1)) | lsb;
+}
+
+CELL_ID
+cell_child(CELL_ID id, int k)
+{
+	CELL_ID lsb = id & (~id + 1);
+	CELL_ID child_lsb = lsb >> 2;
+	return id - lsb + (2 * k + 1) * child_lsb;
+}
+
+CELL_ID
+cell_range_min(CELL_ID id)
+{
+	CELL_ID lsb = id & (~id + 1);
+	return id - (lsb - 1);
+}
+
+CELL_ID
+cell_range_max(CELL_ID id)
+{
+	CELL_ID lsb = id & (~id + 1);
+	return id + (lsb - 1);
+}
+
+/*
+* Corners of a cell, in order around it, and its centre.
+*/
+static void
+cell_vertices(CELL_ID id, GEOGRAPHIC_POINT *corners, GEOGRAPHIC_POINT *center)
+{
+	static const int corner_di[4] = { 0, 1, 1, 0 };
+	static const int corner_dj[4] = { 0, 0, 1, 1 };
+	int level = cell_level(id);
+	double size = 1.0 / ((uint32_t)1 << level);
+	uint32_t i, j;
+	int face = cell_to_face_ij(id, &i, &j);
+	POINT3D p;
+	int k;
+
+	for ( k = 0; k < 4; k++ )
+	{
+		cell_face_st_to_point(face, (i + corner_di[k]) * size, (j + corner_dj[k]) * size, &p);
+		cart2geog(&p, &corners[k]);
+	}
+	cell_face_st_to_point(face, (i + 0.5) * size, (j + 0.5) * size, &p);
+	cart2geog(&p, center);
+}
+
+void
+cell_center(CELL_ID id, POINT2D *pt)
+{
+	GEOGRAPHIC_POINT corners[4], center;
+	cell_vertices(id, corners, &center);
+	pt->x = rad2deg(center.lon);
+	pt->y = rad2deg(center.lat);
+}
+
+/* Closed ring of the corners of a cell, in degrees */
+static POINTARRAY*
+cell_ring(const GEOGRAPHIC_POINT *corners)
+{
+	POINTARRAY *pa = ptarray_construct_empty(0, 0, 5);
+	POINT4D pt = {0, 0, 0, 0};
+	int k;
+
+	for ( k = 0; k < 5; k++ )
+	{
+		pt.x = rad2deg(corners[k % 4].lon);
+		pt.y = rad2deg(corners[k % 4].lat);
+		ptarray_append_point(pa, &pt, LW_TRUE);
+	}
+	return pa;
+}
+
+LWPOLY*
+cell_to_lwpoly(CELL_ID id, int srid)
+{
+	GEOGRAPHIC_POINT corners[4], center;
+	POINTARRAY **rings = lwalloc(sizeof(POINTARRAY*));
+	LWPOLY *poly;
+
+	cell_vertices(id, corners, &center);
+	rings[0] = cell_ring(corners);
+	poly = lwpoly_construct(srid, NULL, 1, rings);
+	lwgeom_set_geodetic(lwpoly_as_lwgeom(poly), LW_TRUE);
+	return poly;
+}
+
+
+/*
+* State of a covering: the geometry, its tree, and the leaf cells of
+* the first vertex of each of its parts, sorted, which tell the cells
+* holding whole parts of the geometry.
+*/
+typedef struct
+{
+	CIRC_NODE *tree;
+	int polygonal;
+	POINT2D pt_outside;
+	CELL_ID *starts;
+	uint32_t nstarts;
+	SPHEROID sphere;
+	int max_level;
+	uint32_t max_cells;
+	int interior;
+	CELL_ID *cells;
+	uint32_t ncells;
+	uint32_t maxcells;
+} CELL_COVERING;
+
+static void
+cell_covering_add_starts(CELL_COVERING *cover, const LWGEOM *geom, uint32_t *maxstarts)
+{
+	uint32_t i;
+	const POINTARRAY *pa = NULL;
+
+	if ( lwgeom_is_collection(geom) )
+	{
+		const LWCOLLECTION *col = (const LWCOLLECTION*)geom;
+		for ( i = 0; i < col->ngeoms; i++ )
+			cell_covering_add_starts(cover, col->geoms[i], maxstarts);
+		return;
+	}
+	if ( lwgeom_is_empty(geom) )
+		return;
+
+	for ( i = 0; ; i++ )
+	{
+		if ( geom->type == POLYGONTYPE )
+		{
+			const LWPOLY *poly = (const LWPOLY*)geom;
+			if ( i == poly->nrings )
+				return;
+			pa = poly->rings[i];
+		}
+		else if ( i == 0 )
+			pa = geom->type == POINTTYPE ? ((const LWPOINT*)geom)->point : ((const LWLINE*)geom)->points;
+		else
+			return;
+
+		if ( cover->nstarts == *maxstarts )
+		{
+			*maxstarts *= 2;
+			cover->starts = lwrealloc(cover->starts, *maxstarts * sizeof(CELL_ID));
+		}
+		cover->starts[cover->nstarts++] = cell_from_point(getPoint2d_cp(pa, 0), CELL_MAX_LEVEL);
+	}
+}
+
+static int
+cell_id_cmp(const void *a, const void *b)
+{
+	CELL_ID ia = *((const CELL_ID*)a);
+	CELL_ID ib = *((const CELL_ID*)b);
+	return ia < ib ? -1 : (ia > ib ? 1 : 0);
+}
+
+/* Whether a part of the geometry starts in the cell */
+static int
+cell_covering_holds_start(const CELL_COVERING *cover, CELL_ID id)
+{
+	CELL_ID lo = cell_range_min(id);
+	CELL_ID hi = cell_range_max(id);
+	uint32_t l = 0, r = cover->nstarts;
+
+	/* First start at or above lo */
+	while ( l < r )
+	{
+		uint32_t m = (l + r) / 2;
+		if ( cover->starts[m] < lo )
+			l = m + 1;
+		else
+			r = m;
+	}
+	return l < cover->nstarts && cover->starts[l] <= hi;
+}
+
+/*
+* Locate a cell with respect to the geometry: LW_OUTSIDE if they are
+* disjoint, LW_INSIDE if the cell is within the polygonal geometry,
+* LW_BOUNDARY otherwise.
+*/
+static int
+cell_covering_relate(const CELL_COVERING *cover, CELL_ID id)
+{
+	GEOGRAPHIC_POINT corners[4], center;
+	POINTARRAY *ring;
+	CIRC_NODE *cell_tree;
+	double radius = 0.0;
+	double d;
+	int k;
+
+	cell_vertices(id, corners, &center);
+
+	/* Bounding caps apart, nothing else to look at */
+	for ( k = 0; k < 4; k++ )
+		radius = FP_MAX(radius, sphere_distance(&center, &corners[k]));
+	if ( sphere_distance(&center, &(cover->tree->center)) > radius + cover->tree->radius + FP_TOLERANCE )
+		return LW_OUTSIDE;
+
+	/* Boundaries crossing or touching */
+	ring = cell_ring(corners);
+	cell_tree = circ_tree_new(ring);
+	d = circ_tree_distance_tree(cell_tree, cover->tree, &(cover->sphere), 0.0);
+	circ_tree_free(cell_tree);
+	ptarray_free(ring);
+	if ( d <= FP_TOLERANCE )
+		return LW_BOUNDARY;
+
+	/* Boundaries apart, so each part of the geometry is either */
+	/* wholly inside the cell or wholly outside it */
+	if ( cell_covering_holds_start(cover, id) )
+		return LW_BOUNDARY;
+
+	if ( cover->polygonal )
+	{
+		POINT2D pt;
+		pt.x = rad2deg(center.lon);
+		pt.y = rad2deg(center.lat);
+		if ( circ_tree_contains_point(cover->tree, &pt, &(cover->pt_outside), NULL) )
+			return LW_INSIDE;
+	}
+	return LW_OUTSIDE;
+}
+
+static void
+cell_covering_append(CELL_COVERING *cover, CELL_ID id)
+{
+	if ( cover->ncells == cover->maxcells )
+	{
+		cover->maxcells *= 2;
+		cover->cells = lwrealloc(cover->cells, cover->maxcells * sizeof(CELL_ID));
+	}
+	cover->cells[cover->ncells++] = id;
+}
+
+/* Keep a cell that is not split any further */
+static void
+cell_covering_keep(CELL_COVERING *cover, CELL_ID id)
+{
+	if ( ! cover->interior )
+		cell_covering_append(cover, id);
+}
+
+/*
+* Split the cells crossing the boundary level by level, coarsest
+* first, as the S2 region coverer does. A cell is split while its
+* parts fit in the max_cells budget, counting the cells kept so far
+* and the ones still waiting to be split; otherwise, and at max_level,
+* it is kept whole. Takes ownership of cands.
+*/
+static int
+cell_covering_refine(CELL_COVERING *cover, CELL_ID *cands, uint32_t ncands)
+{
+	int level = 0;
+
+	while ( ncands )
+	{
+		CELL_ID *next = lwalloc(4 * ncands * sizeof(CELL_ID));
+		uint32_t nnext = 0;
+		uint32_t i;
+
+		for ( i = 0; i < ncands; i++ )
+		{
+			CELL_ID children[4];
+			int rel[4];
+			uint32_t nparts = 0;
+			int k;
+
+			LW_ON_INTERRUPT(lwfree(next); lwfree(cands); return LW_FAILURE);
+
+			/* Boundary cells are cut down to the finest level */
+			if ( level == cover->max_level )
+			{
+				cell_covering_keep(cover, cands[i]);
+				continue;
+			}
+
+			for ( k = 0; k < 4; k++ )
+			{
+				children[k] = cell_child(cands[i], k);
+				rel[k] = cell_covering_relate(cover, children[k]);
+				if ( rel[k] != LW_OUTSIDE )
+					nparts++;
+			}
+
+			/* Over budget, the cell stays whole */
+			if ( cover->max_cells && nparts > 1 &&
+			     cover->ncells + (ncands - i - 1) + nnext + nparts > cover->max_cells )
+			{
+				cell_covering_keep(cover, cands[i]);
+				continue;
+			}
+
+			for ( k = 0; k < 4; k++ )
+			{
+				if ( rel[k] == LW_INSIDE )
+					cell_covering_append(cover, children[k]);
+				else if ( rel[k] == LW_BOUNDARY )
+					next[nnext++] = children[k];
+			}
+		}
+		lwfree(cands);
+		cands = next;
+		ncands = nnext;
+		level++;
+	}
+	lwfree(cands);
+	return LW_SUCCESS;
+}
+
+int
+lwgeom_cell_covering(const LWGEOM *geom, int max_level, uint32_t max_cells, int interior, CELL_ID **cells, uint32_t *ncells)
+{
+	CELL_COVERING cover;
+	uint32_t maxstarts = 8;
+	CELL_ID *cands;
+	uint32_t ncands = 0;
+	int face, rv;
+
+	*cells = NULL;
+	*ncells = 0;
+
+	if ( max_level < 0 || max_level > CELL_MAX_LEVEL )
+	{
+		lwerror("%s: level %d is not between 0 and %d", __func__, max_level, CELL_MAX_LEVEL);
+		return LW_FAILURE;
+	}
+	if ( lwgeom_is_empty(geom) )
+		return LW_SUCCESS;
+
+	memset(&cover, 0, sizeof(CELL_COVERING));
+	cover.tree = lwgeom_calculate_circ_tree(geom);
+	if ( ! cover.tree )
+		return LW_FAILURE;
+
+	/* Only polygons have cells inside them */
+	cover.polygonal = (geom->type == POLYGONTYPE || geom->type == MULTIPOLYGONTYPE);
+	if ( cover.polygonal )
+	{
+		GBOX gbox;
+		gbox_init(&gbox);
+		lwgeom_calculate_gbox_geodetic(geom, &gbox);
+		gbox_pt_outside(&gbox, &(cover.pt_outside));
+	}
+	else if ( interior )
+	{
+		circ_tree_free(cover.tree);
+		return LW_SUCCESS;
+	}
+
+	cover.starts = lwalloc(maxstarts * sizeof(CELL_ID));
+	cell_covering_add_starts(&cover, geom, &maxstarts);
+	qsort(cover.starts, cover.nstarts, sizeof(CELL_ID), cell_id_cmp);
+
+	/* Distances come out in radians */
+	spheroid_init(&(cover.sphere), 1.0, 1.0);
+	cover.max_level = max_level;
+	cover.interior = interior;
+	cover.max_cells = max_cells;
+	cover.maxcells = 64;
+	cover.cells = lwalloc(cover.maxcells * sizeof(CELL_ID));
+
+	/* Faces inside are kept, faces on the boundary are split */
+	cands = lwalloc(6 * sizeof(CELL_ID));
+	for ( face = 0; face < 6; face++ )
+	{
+		CELL_ID id = cell_from_face_leaf(face, 0, 0, 0);
+		switch ( cell_covering_relate(&cover, id) )
+		{
+			case LW_OUTSIDE:
+				break;
+			case LW_INSIDE:
+				cell_covering_append(&cover, id);
+				break;
+			default:
+				cands[ncands++] = id;
+		}
+	}
+	rv = cell_covering_refine(&cover, cands, ncands);
+
+	circ_tree_free(cover.tree);
+	lwfree(cover.starts);
+
+	if ( rv == LW_FAILURE || ! cover.ncells )
+	{
+		lwfree(cover.cells);
+		return rv;
+	}
+
+	/* Cells come out level by level */
+	qsort(cover.cells, cover.ncells, sizeof(CELL_ID), cell_id_cmp);
+	*cells = cover.cells;
+	*ncells = cover.ncells;
+	return LW_SUCCESS;
+}
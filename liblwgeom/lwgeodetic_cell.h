@@ -0,0 +1,85 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#ifndef _LWGEODETIC_CELL_H
+#define _LWGEODETIC_CELL_H 1
+
+#include "lwgeodetic.h"
+
+/*
+* Hierarchical cells on the sphere.
+*
+* The sphere is projected from its centre onto the six faces of the
+* circumscribed cube, and each face is cut as a quadtree down to
+* CELL_MAX_LEVEL. A tangent stretch of the face coordinates keeps
+* the cells of a level close to the same area. The projection is
+* gnomonic, so cell edges are great circle arcs and a cell is an
+* ordinary geodetic polygon.
+*
+* A cell id packs, from the most significant bit, the face (3 bits),
+* the position of the cell on its face (2 bits per level, i and j
+* interleaved), a marker bit and zeros. The ids of the descendants
+* of a cell therefore make up the contiguous range from
+* cell_range_min() to cell_range_max(), and leaf cells follow the
+* quadtree (Z) order.
+*/
+
+typedef uint64_t CELL_ID;
+
+#define CELL_MAX_LEVEL 30
+
+/**
+* Cell of the given level holding a lon/lat point, in degrees.
+*/
+CELL_ID cell_from_point(const POINT2D *pt, int level);
+
+/**
+* Whether id is the id of a cell, of any level.
+*/
+int cell_is_valid(CELL_ID id);
+
+int cell_level(CELL_ID id);
+CELL_ID cell_parent(CELL_ID id, int level);
+CELL_ID cell_child(CELL_ID id, int k);
+CELL_ID cell_range_min(CELL_ID id);
+CELL_ID cell_range_max(CELL_ID id);
+
+/**
+* Centre of a cell as a lon/lat point, in degrees.
+*/
+void cell_center(CELL_ID id, POINT2D *pt);
+
+/**
+* Geodetic polygon of the boundary of a cell.
+*/
+LWPOLY *cell_to_lwpoly(CELL_ID id, int srid);
+
+/**
+* Cells covering a geometry, sorted by id. Cells inside a polygonal
+* geometry are kept whole, at the coarsest level they are inside;
+* cells crossing its boundary are cut down to max_level. Cells are
+* not split once the covering would grow past max_cells, 0 for no
+* limit; a geometry still gets a cell per face it touches. With
+* interior set, only the cells inside are returned. The caller
+* frees *cells with lwfree.
+*/
+int lwgeom_cell_covering(const LWGEOM *geom, int max_level, uint32_t max_cells, int interior, CELL_ID **cells, uint32_t *ncells);
+
+#endif /* _LWGEODETIC_CELL_H */
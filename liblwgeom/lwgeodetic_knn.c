@@ -0,0 +1,516 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#include "liblwgeom_internal.h"
+#include "lwgeodetic_tree.h"
+#include "lwgeodetic_cell.h"
+#include "lwgeodetic_knn.h"
+#include "lwgeom_log.h"
+
+/* Bounding circle of a group of geometries, or of a single one */
+typedef struct
+{
+	POINT3D center;
+	double radius;
+} CIRC_KNN_NODE;
+
+struct circ_knn_index
+{
+	uint32_t ngeoms;       /* indexed geometries, empties included */
+	uint32_t nleaves;      /* non-empty ones */
+	CIRC_NODE **trees;     /* trees of the non-empty ones, in cell order */
+	uint32_t *nums;        /* positions of the trees in the input */
+	uint32_t nlevels;      /* levels of nodes, the first for the trees */
+	uint32_t *level_start; /* first node of each level */
+	uint32_t *level_size;  /* nodes of each level */
+	CIRC_KNN_NODE *nodes;
+};
+
+/* Node of a level to visit, and how close it may be */
+typedef struct
+{
+	double d;
+	uint32_t level;
+	uint32_t i;
+} CIRC_KNN_ENTRY;
+
+/* Working memory of searches, kept from one to the next */
+typedef struct
+{
+	const CIRC_KNN_INDEX *index;
+	SPHEROID sphere;
+	CIRC_KNN_ENTRY *heap;
+	uint32_t nheap;
+	uint32_t maxheap;
+} CIRC_KNN_SEARCH;
+
+typedef struct
+{
+	CELL_ID key;
+	uint32_t num;
+} CIRC_KNN_KEY;
+
+static int
+circ_knn_key_cmp(const void *a, const void *b)
+{
+	const CIRC_KNN_KEY *ka = (const CIRC_KNN_KEY*)a;
+	const CIRC_KNN_KEY *kb = (const CIRC_KNN_KEY*)b;
+	if ( ka->key != kb->key )
+		return ka->key < kb->key ? -1 : 1;
+	return ka->num < kb->num ? -1 : ka->num > kb->num;
+}
+
+/* Leaf cell of the centre of a tree, its place along the curve */
+static CELL_ID
+circ_knn_tree_key(const CIRC_NODE *tree)
+{
+	POINT2D pt;
+	pt.x = rad2deg(tree->center.lon);
+	pt.y = rad2deg(tree->center.lat);
+	return cell_from_point(&pt, CELL_MAX_LEVEL);
+}
+
+/*
+* Radius of a circle around the centre of a tree holding all of its
+* geometry. The circle of a polygon holds its rings, but holds its
+* interior only as long as the interior does not hold the antipode
+* of the centre: the rings do not reach the far side of the circle,
+* so the interior then takes in all of it.
+*/
+static double
+circ_knn_tree_radius(const CIRC_NODE *tree)
+{
+	uint32_t i;
+
+	if ( tree->geom_type == POLYGONTYPE )
+	{
+		POINT2D pt;
+		pt.x = rad2deg(longitude_radians_normalize(tree->center.lon + M_PI));
+		pt.y = rad2deg(-1.0 * tree->center.lat);
+		if ( circ_tree_contains_point(tree, &pt, &(tree->pt_outside), NULL) )
+			return M_PI;
+	}
+	else if ( tree->geom_type && lwtype_is_collection(tree->geom_type) )
+	{
+		for ( i = 0; i < tree->num_nodes; i++ )
+		{
+			if ( circ_knn_tree_radius(tree->nodes[i]) == M_PI )
+				return M_PI;
+		}
+	}
+	return tree->radius;
+}
+
+static void
+circ_knn_node_init(CIRC_KNN_NODE *node, const CIRC_NODE *tree)
+{
+	geog2cart(&(tree->center), &(node->center));
+	node->radius = circ_knn_tree_radius(tree);
+}
+
+/*
+* Circle around a group of circles, centred on the mean of their
+* centres. It is no smallest circle, but grows little for groups of
+* nearby circles, which cell order makes them.
+*/
+static void
+circ_knn_node_merge(CIRC_KNN_NODE *node, const CIRC_KNN_NODE *children, uint32_t nchildren)
+{
+	uint32_t i;
+	double r;
+
+	node->center = children[0].center;
+	for ( i = 1; i < nchildren; i++ )
+		vector_sum(&(node->center), &(children[i].center), &(node->center));
+	normalize(&(node->center));
+
+	/* Centres all around the sphere may leave no mean */
+	if ( FP_IS_ZERO(node->center.x) && FP_IS_ZERO(node->center.y) && FP_IS_ZERO(node->center.z) )
+	{
+		node->center = children[0].center;
+		node->radius = M_PI;
+		return;
+	}
+
+	node->radius = 0.0;
+	for ( i = 0; i < nchildren; i++ )
+	{
+		r = vector_angle(&(node->center), &(children[i].center)) + children[i].radius;
+		if ( r > node->radius )
+			node->radius = r;
+	}
+	if ( node->radius > M_PI )
+		node->radius = M_PI;
+}
+
+CIRC_KNN_INDEX*
+circ_knn_index_new(const LWGEOM **geoms, uint32_t ngeoms)
+{
+	CIRC_KNN_INDEX *index = lwalloc(sizeof(CIRC_KNN_INDEX));
+	CIRC_NODE **trees = lwalloc(sizeof(CIRC_NODE*) * (ngeoms ? ngeoms : 1));
+	CIRC_KNN_KEY *keys = lwalloc(sizeof(CIRC_KNN_KEY) * (ngeoms ? ngeoms : 1));
+	uint32_t i, j, l, n = 0, size, total;
+
+	for ( i = 0; i < ngeoms; i++ )
+	{
+		LW_ON_INTERRUPT(
+			for ( j = 0; j < n; j++ )
+				circ_tree_free(trees[keys[j].num]);
+			lwfree(trees);
+			lwfree(keys);
+			lwfree(index);
+			return NULL
+		);
+		trees[i] = geoms[i] ? lwgeom_calculate_circ_tree(geoms[i]) : NULL;
+		if ( ! trees[i] )
+			continue;
+		keys[n].key = circ_knn_tree_key(trees[i]);
+		keys[n].num = i;
+		n++;
+	}
+	qsort(keys, n, sizeof(CIRC_KNN_KEY), circ_knn_key_cmp);
+
+	index->ngeoms = ngeoms;
+	index->nleaves = n;
+	index->trees = lwalloc(sizeof(CIRC_NODE*) * (n ? n : 1));
+	index->nums = lwalloc(sizeof(uint32_t) * (n ? n : 1));
+	for ( i = 0; i < n; i++ )
+	{
+		index->trees[i] = trees[keys[i].num];
+		index->nums[i] = keys[i].num;
+	}
+	lwfree(trees);
+	lwfree(keys);
+
+	/* Count the levels, up to a single root */
+	index->nlevels = 0;
+	total = 0;
+	for ( size = n; size; size = (size + CIRC_NODE_SIZE - 1) / CIRC_NODE_SIZE )
+	{
+		index->nlevels++;
+		total += size;
+		if ( size == 1 )
+			break;
+	}
+
+	index->level_start = lwalloc(sizeof(uint32_t) * (index->nlevels + 1));
+	index->level_size = lwalloc(sizeof(uint32_t) * (index->nlevels + 1));
+	index->nodes = lwalloc(sizeof(CIRC_KNN_NODE) * (total ? total : 1));
+
+	for ( i = 0; i < n; i++ )
+		circ_knn_node_init(&(index->nodes[i]), index->trees[i]);
+
+	size = n;
+	total = 0;
+	for ( l = 0; l < index->nlevels; l++ )
+	{
+		index->level_start[l] = total;
+		index->level_size[l] = size;
+		if ( l > 0 )
+		{
+			const CIRC_KNN_NODE *children = index->nodes + index->level_start[l-1];
+			uint32_t nchildren = index->level_size[l-1];
+			for ( j = 0; j < size; j++ )
+			{
+				uint32_t first = j * CIRC_NODE_SIZE;
+				uint32_t count = FP_MIN(CIRC_NODE_SIZE, nchildren - first);
+				circ_knn_node_merge(index->nodes + total + j, children + first, count);
+			}
+		}
+		total += size;
+		size = (size + CIRC_NODE_SIZE - 1) / CIRC_NODE_SIZE;
+	}
+
+	LWDEBUGF(3, "indexed %d trees of %d geometries in %d levels", n, ngeoms, index->nlevels);
+	return index;
+}
+
+void
+circ_knn_index_free(CIRC_KNN_INDEX *index)
+{
+	uint32_t i;
+	if ( ! index )
+		return;
+	for ( i = 0; i < index->nleaves; i++ )
+		circ_tree_free(index->trees[i]);
+	lwfree(index->trees);
+	lwfree(index->nums);
+	lwfree(index->level_start);
+	lwfree(index->level_size);
+	lwfree(index->nodes);
+	lwfree(index);
+}
+
+static void
+circ_knn_search_init(CIRC_KNN_SEARCH *s, const CIRC_KNN_INDEX *index)
+{
+	s->index = index;
+	spheroid_init(&(s->sphere), 1.0, 1.0);
+	s->nheap = 0;
+	s->maxheap = 2 * CIRC_NODE_SIZE;
+	s->heap = lwalloc(sizeof(CIRC_KNN_ENTRY) * s->maxheap);
+}
+
+static void
+circ_knn_heap_push(CIRC_KNN_SEARCH *s, double d, uint32_t level, uint32_t i)
+{
+	uint32_t c, p;
+	CIRC_KNN_ENTRY e;
+
+	if ( s->nheap == s->maxheap )
+	{
+		s->maxheap *= 2;
+		s->heap = lwrealloc(s->heap, sizeof(CIRC_KNN_ENTRY) * s->maxheap);
+	}
+
+	e.d = d;
+	e.level = level;
+	e.i = i;
+	for ( c = s->nheap++; c > 0; c = p )
+	{
+		p = (c - 1) / 2;
+		if ( s->heap[p].d <= d )
+			break;
+		s->heap[c] = s->heap[p];
+	}
+	s->heap[c] = e;
+}
+
+static CIRC_KNN_ENTRY
+circ_knn_heap_pop(CIRC_KNN_SEARCH *s)
+{
+	CIRC_KNN_ENTRY top = s->heap[0];
+	CIRC_KNN_ENTRY last = s->heap[--s->nheap];
+	uint32_t p = 0, c;
+
+	while ( (c = 2 * p + 1) < s->nheap )
+	{
+		if ( c + 1 < s->nheap && s->heap[c+1].d < s->heap[c].d )
+			c++;
+		if ( last.d <= s->heap[c].d )
+			break;
+		s->heap[p] = s->heap[c];
+		p = c;
+	}
+	if ( s->nheap )
+		s->heap[p] = last;
+	return top;
+}
+
+/*
+* Add a tree at distance d to the k best, sorted by distance, then
+* position in the input, unless it comes after all of them.
+*/
+static uint32_t
+circ_knn_best_add(const CIRC_KNN_INDEX *index, CIRC_KNN_PAIR *best, uint32_t nbest, uint32_t k, uint32_t leaf, double d)
+{
+	uint32_t i;
+
+#define CIRC_KNN_BEFORE(d, leaf, pair) \
+	( (d) < (pair).distance || ( (d) == (pair).distance && index->nums[leaf] < index->nums[(pair).candidate] ) )
+
+	if ( nbest == k && ! CIRC_KNN_BEFORE(d, leaf, best[k-1]) )
+		return nbest;
+
+	i = nbest < k ? nbest++ : k - 1;
+	for ( ; i > 0 && CIRC_KNN_BEFORE(d, leaf, best[i-1]); i-- )
+		best[i] = best[i-1];
+	best[i].candidate = leaf;
+	best[i].distance = d;
+	return nbest;
+
+#undef CIRC_KNN_BEFORE
+}
+
+/*
+* Best first search of the k trees nearest to a tree. Results hold
+* tree numbers, in index order. Seeds, the results of a previous
+* search, go in first to set the bound.
+*/
+static uint32_t
+circ_knn_search(CIRC_KNN_SEARCH *s, const CIRC_NODE *tree, uint32_t k, double max_distance, const CIRC_KNN_PAIR *seeds, uint32_t nseeds, CIRC_KNN_PAIR *best)
+{
+	const CIRC_KNN_INDEX *index = s->index;
+	uint32_t nbest = 0, i, j, l;
+	double bound = max_distance < 0.0 ? FLT_MAX : max_distance;
+	double d, radius;
+	POINT3D center;
+
+	if ( ! tree || ! index->nlevels || ! k )
+		return 0;
+
+	geog2cart(&(tree->center), &center);
+	radius = circ_knn_tree_radius(tree);
+
+	for ( i = 0; i < nseeds; i++ )
+	{
+		d = circ_tree_distance_tree(tree, index->trees[seeds[i].candidate], &(s->sphere), 0.0);
+		if ( d <= bound )
+		{
+			nbest = circ_knn_best_add(index, best, nbest, k, seeds[i].candidate, d);
+			if ( nbest == k )
+				bound = best[k-1].distance;
+		}
+	}
+
+	s->nheap = 0;
+	circ_knn_heap_push(s, 0.0, index->nlevels - 1, 0);
+	while ( s->nheap )
+	{
+		CIRC_KNN_ENTRY e = circ_knn_heap_pop(s);
+
+		/* Nothing left can be closer */
+		if ( e.d > bound )
+			break;
+
+		if ( e.level == 0 )
+		{
+			for ( j = 0; j < nseeds; j++ )
+			{
+				if ( seeds[j].candidate == e.i )
+					break;
+			}
+			if ( j < nseeds )
+				continue;
+
+			d = circ_tree_distance_tree(tree, index->trees[e.i], &(s->sphere), 0.0);
+			if ( d <= bound )
+			{
+				nbest = circ_knn_best_add(index, best, nbest, k, e.i, d);
+				if ( nbest == k )
+					bound = best[k-1].distance;
+			}
+			continue;
+		}
+
+		/* Queue the children close enough to matter */
+		l = e.level - 1;
+		for ( i = e.i * CIRC_NODE_SIZE; i < index->level_size[l] && i < (e.i + 1) * CIRC_NODE_SIZE; i++ )
+		{
+			const CIRC_KNN_NODE *node = index->nodes + index->level_start[l] + i;
+			d = vector_angle(&center, &(node->center)) - radius - node->radius;
+			if ( d < 0.0 )
+				d = 0.0;
+			if ( d <= bound )
+				circ_knn_heap_push(s, d, l, i);
+		}
+	}
+
+	return nbest;
+}
+
+uint32_t
+circ_knn_index_nearest(const CIRC_KNN_INDEX *index, const CIRC_NODE *tree, uint32_t k, double max_distance, CIRC_KNN_PAIR *pairs)
+{
+	CIRC_KNN_SEARCH s;
+	uint32_t i, n;
+
+	circ_knn_search_init(&s, index);
+	n = circ_knn_search(&s, tree, k, max_distance, NULL, 0, pairs);
+	lwfree(s.heap);
+
+	for ( i = 0; i < n; i++ )
+		pairs[i].candidate = index->nums[pairs[i].candidate];
+	return n;
+}
+
+int
+circ_knn_join(const CIRC_KNN_INDEX *index, const LWGEOM **probes, uint32_t nprobes, uint32_t k, double max_distance, CIRC_KNN_PAIR **pairs, uint32_t *npairs)
+{
+	CIRC_KNN_SEARCH s;
+	CIRC_NODE **trees;
+	CIRC_KNN_KEY *keys;
+	CIRC_KNN_PAIR *slots, *seeds = NULL;
+	uint32_t *counts;
+	uint32_t i, j, n = 0, nseeds = 0, total = 0;
+
+	*pairs = NULL;
+	*npairs = 0;
+	if ( k > index->nleaves )
+		k = index->nleaves;
+	if ( ! k || ! nprobes )
+		return LW_SUCCESS;
+
+	if ( (size_t)nprobes * k > UINT32_MAX )
+		lwerror("%s: too many neighbours to return (%u probes, %u each)", __func__, nprobes, k);
+
+	/* Search for the probes in cell order, nearby ones one after the other */
+	trees = lwalloc(sizeof(CIRC_NODE*) * nprobes);
+	keys = lwalloc(sizeof(CIRC_KNN_KEY) * nprobes);
+	for ( i = 0; i < nprobes; i++ )
+	{
+		trees[i] = probes[i] ? lwgeom_calculate_circ_tree(probes[i]) : NULL;
+		if ( ! trees[i] )
+			continue;
+		keys[n].key = circ_knn_tree_key(trees[i]);
+		keys[n].num = i;
+		n++;
+	}
+	qsort(keys, n, sizeof(CIRC_KNN_KEY), circ_knn_key_cmp);
+
+	slots = lwalloc(sizeof(CIRC_KNN_PAIR) * nprobes * k);
+	counts = lwalloc(sizeof(uint32_t) * nprobes);
+	memset(counts, 0, sizeof(uint32_t) * nprobes);
+
+	circ_knn_search_init(&s, index);
+	for ( i = 0; i < n; i++ )
+	{
+		uint32_t p = keys[i].num;
+		CIRC_KNN_PAIR *best = slots + (size_t)p * k;
+		LW_ON_INTERRUPT(
+			for ( j = i; j < n; j++ )
+				circ_tree_free(trees[keys[j].num]);
+			lwfree(s.heap);
+			lwfree(trees);
+			lwfree(keys);
+			lwfree(slots);
+			lwfree(counts);
+			return LW_FAILURE
+		);
+		counts[p] = circ_knn_search(&s, trees[p], k, max_distance, seeds, nseeds, best);
+		total += counts[p];
+		seeds = best;
+		nseeds = counts[p];
+		circ_tree_free(trees[p]);
+	}
+	lwfree(s.heap);
+	lwfree(trees);
+	lwfree(keys);
+
+	/* Back to probe order, and to positions in the input */
+	if ( total )
+	{
+		CIRC_KNN_PAIR *pair = *pairs = lwalloc(sizeof(CIRC_KNN_PAIR) * total);
+		for ( i = 0; i < nprobes; i++ )
+		{
+			for ( j = 0; j < counts[i]; j++ )
+			{
+				pair->probe = i;
+				pair->candidate = index->nums[slots[(size_t)i * k + j].candidate];
+				pair->distance = slots[(size_t)i * k + j].distance;
+				pair++;
+			}
+		}
+	}
+	lwfree(slots);
+	lwfree(counts);
+	*npairs = total;
+	return LW_SUCCESS;
+}
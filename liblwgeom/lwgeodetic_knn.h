@@ -0,0 +1,76 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#ifndef _LWGEODETIC_KNN_H
+#define _LWGEODETIC_KNN_H 1
+
+#include "lwgeodetic_tree.h"
+
+/*
+* Nearest neighbour searches among a set of geodetic geometries.
+*
+* The edge trees of the geometries are sorted by the leaf cell of
+* their centres, along the curve of lwgeodetic_cell.h, and grouped
+* CIRC_NODE_SIZE at a time under bounding circles, level after level
+* up to a single root. A search visits the groups nearest first and
+* stops when none can hold anything closer than the k best
+* geometries found so far.
+*
+* A join runs the searches for its probes in the same cell order,
+* and seeds each with the answers to the previous, nearby, probe:
+* their distances bound the search before it even starts.
+*
+* Distances are in radians, on the sphere.
+*/
+
+typedef struct circ_knn_index CIRC_KNN_INDEX;
+
+typedef struct
+{
+	uint32_t probe;     /* position of the probe in its array */
+	uint32_t candidate; /* position of the neighbour in the indexed array */
+	double distance;
+} CIRC_KNN_PAIR;
+
+/**
+* Index an array of geometries. Empty or NULL geometries take their
+* place in the numbering but are never found, nor have neighbours
+* as probes. Returns NULL when interrupted.
+*/
+CIRC_KNN_INDEX* circ_knn_index_new(const LWGEOM **geoms, uint32_t ngeoms);
+void circ_knn_index_free(CIRC_KNN_INDEX *index);
+
+/**
+* The k geometries of the index nearest to a tree, no farther than
+* max_distance (a negative one for no limit), closest first and by
+* position on ties. Returns their number, written to pairs, whose
+* probe member is left alone.
+*/
+uint32_t circ_knn_index_nearest(const CIRC_KNN_INDEX *index, const CIRC_NODE *tree, uint32_t k, double max_distance, CIRC_KNN_PAIR *pairs);
+
+/**
+* The k nearest geometries of the index to each of the probes, as
+* circ_knn_index_nearest finds them. The *npairs pairs are written
+* to a new array in *pairs, by probe, then distance. Returns
+* LW_FAILURE, with no pairs, when interrupted.
+*/
+int circ_knn_join(const CIRC_KNN_INDEX *index, const LWGEOM **probes, uint32_t nprobes, uint32_t k, double max_distance, CIRC_KNN_PAIR **pairs, uint32_t *npairs);
+
+#endif /* _LWGEODETIC_KNN_H */
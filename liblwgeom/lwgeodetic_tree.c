@@ -64,9 +64,10 @@ circ_tree_free(CIRC_NODE* node)
 
 /**
 * Create a new leaf node, storing pointers back to the end points for later.
+* The cpa holds the vertices of pa already converted to X/Y/Z.
 */
 static CIRC_NODE*
-circ_node_leaf_new(const POINTARRAY* pa, int i)
+circ_node_leaf_new(const POINTARRAY* pa, const CART_PTARRAY* cpa, int i)
 {
 	POINT2D *p1, *p2;
 	POINT3D q1, q2, c;
@@ -92,9 +93,9 @@ circ_node_leaf_new(const POINTARRAY* pa, int i)
 	node->p1 = p1;
 	node->p2 = p2;
 
-	/* Convert ends to X/Y/Z, sum, and normalize to get mid-point */
-	geog2cart(&g1, &q1);
-	geog2cart(&g2, &q2);
+	/* Ends in X/Y/Z, sum, and normalize to get mid-point */
+	CART_PTARRAY_GET(cpa, i, &q1);
+	CART_PTARRAY_GET(cpa, i+1, &q2);
 	vector_sum(&q1, &q2, &c);
 	normalize(&c);
 	cart2geog(&c, &gc);
@@ -359,6 +360,7 @@ circ_tree_new(const POINTARRAY* pa)
 	CIRC_NODE **nodes;
 	CIRC_NODE *node;
 	CIRC_NODE *tree;
+	CART_PTARRAY *cpa;
 
 	/* Can't do anything with no points */
 	if ( pa->npoints < 1 )
@@ -369,15 +371,19 @@ circ_tree_new(const POINTARRAY* pa)
 		return circ_node_leaf_point_new(pa);
 
 	/* First create a flat list of nodes, one per edge. */
+	/* Inner vertices end one edge and start the next, */
+	/* so convert them all to X/Y/Z once. */
 	num_edges = pa->npoints - 1;
 	nodes = lwalloc(sizeof(CIRC_NODE*) * pa->npoints);
+	cpa = ptarray_cart_new(pa);
 	j = 0;
 	for ( i = 0; i < num_edges; i++ )
 	{
-		node = circ_node_leaf_new(pa, i);
+		node = circ_node_leaf_new(pa, cpa, i);
 		if ( node ) /* Not zero length? */
 			nodes[j++] = node;
 	}
+	ptarray_cart_free(cpa);
 
 	/* Special case: only zero-length edges. Make a point node. */
 	if ( j == 0 ) {
@@ -558,6 +564,128 @@ int circ_tree_contains_point(const CIRC_NODE* node, const POINT2D* pt, const POI
 	return 0;
 }
 
+/**
+* Add up the crossings of the stab line S1-S2 with the edges under node,
+* by the rules of ptarray_cart_contains_point_sphere(). Returns LW_TRUE
+* as soon as S1 turns out to be on an edge or vertex.
+*/
+static int
+circ_node_ring_crossings(const CIRC_NODE* node, const GEOGRAPHIC_EDGE* stab_edge, const POINT3D* S1, const POINT3D* S2, uint32_t* count)
+{
+	GEOGRAPHIC_POINT closest;
+	uint32_t i;
+
+	/* Stab line out of reach of the node? No crossings here. */
+	if ( ! FP_LTEQ(edge_distance_to_point(stab_edge, &(node->center), &closest), node->radius) )
+		return LW_FALSE;
+
+	if ( circ_node_is_leaf(node) )
+	{
+		POINT3D E1, E2;
+		int inter;
+
+		/* Point nodes have no edges */
+		if ( node->p1 == node->p2 )
+			return LW_FALSE;
+
+		ll2cart(node->p1, &E1);
+		ll2cart(node->p2, &E2);
+
+		/* On a vertex is on the ring */
+		if ( point3d_equals(S1, &E1) )
+			return LW_TRUE;
+
+		inter = edge_intersects(S1, S2, &E1, &E2);
+		if ( inter & PIR_INTERSECTS )
+		{
+			/* Stab line touching the edge, the point is on it */
+			if ( (inter & PIR_A_TOUCH_RIGHT) || (inter & PIR_A_TOUCH_LEFT) )
+				return LW_TRUE;
+
+			/* Disregard left-side touches and co-linear runs, to avoid double counts */
+			if ( ! (inter & PIR_B_TOUCH_RIGHT || inter & PIR_COLINEAR) )
+				(*count)++;
+		}
+		return LW_FALSE;
+	}
+
+	for ( i = 0; i < node->num_nodes; i++ )
+	{
+		if ( circ_node_ring_crossings(node->nodes[i], stab_edge, S1, S2, count) )
+			return LW_TRUE;
+	}
+	return LW_FALSE;
+}
+
+/**
+* Whether the ring whose tree is node covers pt, that is has it inside
+* or on its boundary, with the answers of ptarray_contains_point_sphere()
+* but visiting only the edges near the stab line to pt_outside.
+*/
+int circ_tree_ring_covers_point(const CIRC_NODE* node, const POINT2D* pt, const POINT2D* pt_outside)
+{
+	GEOGRAPHIC_EDGE stab_edge;
+	POINT3D S1, S2;
+	uint32_t count = 0;
+
+	geographic_point_init(pt->x, pt->y, &(stab_edge.start));
+	geographic_point_init(pt_outside->x, pt_outside->y, &(stab_edge.end));
+	ll2cart(pt, &S1);
+	ll2cart(pt_outside, &S2);
+
+	if ( circ_node_ring_crossings(node, &stab_edge, &S1, &S2, &count) )
+		return LW_TRUE;
+
+	/* An odd number of crossings implies containment! */
+	return count % 2 ? LW_TRUE : LW_FALSE;
+}
+
+/**
+* Whether an edge under n1 crosses an edge under n2, by the rules of
+* lwpoly_intersects_line(): touches on the right side of n2 edges and
+* co-linear runs do not count. Only the pairs of nodes whose circles
+* overlap are visited.
+*/
+int circ_tree_edges_cross(const CIRC_NODE* n1, const CIRC_NODE* n2)
+{
+	uint32_t i;
+
+	if ( sphere_distance(&(n1->center), &(n2->center)) > n1->radius + n2->radius + FP_TOLERANCE )
+		return LW_FALSE;
+
+	if ( circ_node_is_leaf(n1) && circ_node_is_leaf(n2) )
+	{
+		POINT3D A1, A2, B1, B2;
+		int inter;
+
+		/* Point nodes have no edges */
+		if ( n1->p1 == n1->p2 || n2->p1 == n2->p2 )
+			return LW_FALSE;
+
+		ll2cart(n1->p1, &A1);
+		ll2cart(n1->p2, &A2);
+		ll2cart(n2->p1, &B1);
+		ll2cart(n2->p2, &B2);
+		inter = edge_intersects(&A1, &A2, &B1, &B2);
+		return (inter & PIR_INTERSECTS) && ! (inter & PIR_B_TOUCH_RIGHT || inter & PIR_COLINEAR);
+	}
+
+	/* Open up the bigger of the two nodes */
+	if ( circ_node_is_leaf(n2) || ( ! circ_node_is_leaf(n1) && n1->radius >= n2->radius ) )
+	{
+		for ( i = 0; i < n1->num_nodes; i++ )
+			if ( circ_tree_edges_cross(n1->nodes[i], n2) )
+				return LW_TRUE;
+	}
+	else
+	{
+		for ( i = 0; i < n2->num_nodes; i++ )
+			if ( circ_tree_edges_cross(n1, n2->nodes[i]) )
+				return LW_TRUE;
+	}
+	return LW_FALSE;
+}
+
 static double
 circ_node_min_distance(const CIRC_NODE* n1, const CIRC_NODE* n2)
 {
@@ -663,8 +791,9 @@ circ_tree_distance_tree_internal(const CIRC_NODE* n1, const CIRC_NODE* n2, doubl
 	if( *min_dist < threshold || *min_dist == 0.0 )
 		return *min_dist;
 
-	/* If your minimum is greater than anyone's maximum, you can't hold the winner */
-	if( circ_node_min_distance(n1, n2) > *max_dist )
+	/* If your minimum is greater than anyone's maximum, or than the */
+	/* best distance found so far, you can't hold the winner */
+	if( circ_node_min_distance(n1, n2) > FP_MIN(*max_dist, *min_dist) )
 	{
 		LWDEBUGF(4, "pruning pair %p, %p", n1, n2);
 		return FLT_MAX;
@@ -997,3 +1126,171 @@ lwgeom_calculate_circ_tree(const LWGEOM* lwgeom)
 	}
 
 }
+
+/*
+* Packed form of a CIRC_NODE, as stored in the index section of
+* indexed serialized geographies. Nodes are written in preorder,
+* each one followed by its children. Polygon nodes are followed
+* by their pt_outside.
+*/
+typedef struct
+{
+	double lon;
+	double lat;
+	double radius;
+	uint32_t info;   /* Number of children and geometry type */
+	uint32_t offset; /* Leaves: offset of the first point from the geometry data start */
+} CIRC_NODE_PACKED;
+
+#define CIRC_PACKED_INFO(num_nodes, geom_type) ((num_nodes) | ((geom_type) << 4))
+#define CIRC_PACKED_NUM_NODES(info) ((info) & 0x0F)
+#define CIRC_PACKED_GEOM_TYPE(info) (((info) >> 4) & 0xFF)
+
+size_t
+circ_tree_packed_size(const CIRC_NODE* node)
+{
+	size_t size = sizeof(CIRC_NODE_PACKED);
+	uint32_t i;
+
+	if ( node->geom_type == POLYGONTYPE )
+		size += sizeof(POINT2D);
+	for ( i = 0; i < node->num_nodes; i++ )
+		size += circ_tree_packed_size(node->nodes[i]);
+	return size;
+}
+
+uint8_t*
+circ_tree_pack(const CIRC_NODE* node, const uint8_t* data, uint8_t* buf)
+{
+	CIRC_NODE_PACKED* packed = (CIRC_NODE_PACKED*)buf;
+	uint32_t i;
+
+	packed->lon = node->center.lon;
+	packed->lat = node->center.lat;
+	packed->radius = node->radius;
+	packed->info = CIRC_PACKED_INFO(node->num_nodes, node->geom_type);
+	packed->offset = circ_node_is_leaf(node) ? (uint32_t)((const uint8_t*)(node->p1) - data) : 0;
+	buf += sizeof(CIRC_NODE_PACKED);
+
+	if ( node->geom_type == POLYGONTYPE )
+	{
+		memcpy(buf, &(node->pt_outside), sizeof(POINT2D));
+		buf += sizeof(POINT2D);
+	}
+
+	for ( i = 0; i < node->num_nodes; i++ )
+		buf = circ_tree_pack(node->nodes[i], data, buf);
+
+	return buf;
+}
+
+/*
+* Map the packed node at *buf, and its children, moving *buf past
+* them. Returns NULL if the packed nodes do not fit in the buffer
+* or refer to points outside of the geometry data.
+*/
+static CIRC_NODE*
+circ_node_from_packed(const uint8_t** buf, const uint8_t* buf_end, const uint8_t* data, size_t data_size, size_t point_size)
+{
+	const CIRC_NODE_PACKED* packed = (const CIRC_NODE_PACKED*)(*buf);
+	CIRC_NODE* node;
+	uint32_t i, num_nodes;
+
+	if ( *buf + sizeof(CIRC_NODE_PACKED) > buf_end )
+		return NULL;
+	*buf += sizeof(CIRC_NODE_PACKED);
+
+	node = lwalloc(sizeof(CIRC_NODE));
+	node->center.lon = packed->lon;
+	node->center.lat = packed->lat;
+	node->radius = packed->radius;
+	node->geom_type = CIRC_PACKED_GEOM_TYPE(packed->info);
+	node->num_nodes = 0;
+	node->nodes = NULL;
+	node->pt_outside.x = 0.0;
+	node->pt_outside.y = 0.0;
+	node->p1 = NULL;
+	node->p2 = NULL;
+
+	if ( node->geom_type == POLYGONTYPE )
+	{
+		if ( *buf + sizeof(POINT2D) > buf_end )
+		{
+			lwfree(node);
+			return NULL;
+		}
+		memcpy(&(node->pt_outside), *buf, sizeof(POINT2D));
+		*buf += sizeof(POINT2D);
+	}
+
+	num_nodes = CIRC_PACKED_NUM_NODES(packed->info);
+
+	/* Leaf, pointing at its edge in the geometry. Edge numbers */
+	/* are only used in debugging output and are not stored. */
+	if ( num_nodes == 0 )
+	{
+		/* Point nodes are the only ones of zero radius */
+		size_t edge_size = node->radius == 0.0 ? point_size : 2 * point_size;
+		if ( packed->offset + edge_size > data_size )
+		{
+			lwfree(node);
+			return NULL;
+		}
+		node->p1 = (POINT2D*)(data + packed->offset);
+		node->p2 = node->radius == 0.0 ? node->p1 : (POINT2D*)(data + packed->offset + point_size);
+		node->edge_num = 0;
+		return node;
+	}
+
+	node->edge_num = -1;
+	node->nodes = lwalloc(sizeof(CIRC_NODE*) * num_nodes);
+	for ( i = 0; i < num_nodes; i++ )
+	{
+		CIRC_NODE* child = circ_node_from_packed(buf, buf_end, data, data_size, point_size);
+		if ( ! child )
+		{
+			circ_tree_free(node);
+			return NULL;
+		}
+		node->nodes[node->num_nodes++] = child;
+	}
+	return node;
+}
+
+CIRC_NODE*
+circ_tree_from_packed(const uint8_t* buf, size_t size, const uint8_t* data, size_t data_size, int ndims)
+{
+	const uint8_t* buf_end = buf + size;
+	CIRC_NODE* tree = circ_node_from_packed(&buf, buf_end, data, data_size, ndims * sizeof(double));
+
+	/* Trailing garbage means we did not read what was written */
+	if ( tree && buf != buf_end )
+	{
+		circ_tree_free(tree);
+		return NULL;
+	}
+	return tree;
+}
+
+CIRC_NODE*
+gserialized_get_circ_tree(const GSERIALIZED* g, const LWGEOM* lwgeom)
+{
+	const uint8_t* index;
+	const uint8_t* data;
+	size_t index_size, data_size;
+	uint32_t index_type;
+	CIRC_NODE* tree = NULL;
+
+	index = gserialized_get_index(g, &index_type, &index_size);
+	if ( index && index_type == GSERIALIZED_INDEX_CIRC )
+	{
+		data = gserialized_get_geometry_data(g, &data_size);
+		tree = circ_tree_from_packed(index, index_size, data, data_size, FLAGS_NDIMS(g->flags));
+	}
+
+	/* No index, or not one we can read, build the tree */
+	if ( ! tree )
+		tree = lwgeom_calculate_circ_tree(lwgeom);
+
+	return tree;
+}
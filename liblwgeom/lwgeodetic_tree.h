@@ -51,10 +51,29 @@ void circ_tree_print(const CIRC_NODE* node, int depth);
 CIRC_NODE* circ_tree_new(const POINTARRAY* pa);
 void circ_tree_free(CIRC_NODE* node);
 int circ_tree_contains_point(const CIRC_NODE* node, const POINT2D* pt, const POINT2D* pt_outside, int* on_boundary);
+int circ_tree_ring_covers_point(const CIRC_NODE* node, const POINT2D* pt, const POINT2D* pt_outside);
+int circ_tree_edges_cross(const CIRC_NODE* n1, const CIRC_NODE* n2);
 double circ_tree_distance_tree(const CIRC_NODE* n1, const CIRC_NODE* n2, const SPHEROID *spheroid, double threshold);
 CIRC_NODE* lwgeom_calculate_circ_tree(const LWGEOM* lwgeom);
 int circ_tree_get_point(const CIRC_NODE* node, POINT2D* pt);
 
+/**
+* Size, writer and reader of the packed form of a tree, as stored
+* in the index section of indexed serialized geographies. Leaves
+* refer to their points as offsets from data, the start of the
+* serialized geometry data the tree was built on.
+*/
+size_t circ_tree_packed_size(const CIRC_NODE* node);
+uint8_t* circ_tree_pack(const CIRC_NODE* node, const uint8_t* data, uint8_t* buf);
+CIRC_NODE* circ_tree_from_packed(const uint8_t* buf, size_t size, const uint8_t* data, size_t data_size, int ndims);
+
+/**
+* Return the tree stored in an indexed serialized geography, with
+* leaves pointing into g, or else calculate it from lwgeom, the
+* deserialized g. Either way, free it with circ_tree_free.
+*/
+CIRC_NODE* gserialized_get_circ_tree(const GSERIALIZED* g, const LWGEOM* lwgeom);
+
 #endif /* _LWGEODETIC_TREE_H */
 
 
@@ -54,6 +54,9 @@ lwgeom_geos_error(const char* fmt, ...)
 **
 ** Default conversion creates a GEOS point array, then iterates through the
 ** PostGIS points, setting each value in the GEOS array one at a time.
+** With GEOS 3.8+ a point takes one call rather than one per ordinate, and
+** with GEOS 3.10+ whole point arrays are copied to and from the GEOS
+** coordinate sequences in one call, straight from the POINTARRAY buffer.
 **
 */
 
@@ -62,9 +65,12 @@ POINTARRAY*
 ptarray_from_GEOSCoordSeq(const GEOSCoordSequence* cs, uint8_t want3d)
 {
 	uint32_t dims = 2;
-	uint32_t size, i;
+	uint32_t size;
 	POINTARRAY* pa;
+#if POSTGIS_GEOS_VERSION < 310
+	uint32_t i;
 	POINT4D point;
+#endif
 
 	LWDEBUG(2, "ptarray_fromGEOSCoordSeq called");
 
@@ -86,13 +92,26 @@ ptarray_from_GEOSCoordSeq(const GEOSCoordSequence* cs, uint8_t want3d)
 
 	pa = ptarray_construct((dims == 3), 0, size);
 
+#if POSTGIS_GEOS_VERSION >= 310
+	/* The POINTARRAY buffer has the XY(Z) layout GEOS writes */
+	if (size && !GEOSCoordSeq_copyToBuffer(cs, (double*)pa->serialized_pointlist, (dims == 3), 0))
+		lwerror("Exception thrown");
+#else
 	for (i = 0; i < size; i++)
 	{
+#if POSTGIS_GEOS_VERSION >= 38
+		if (dims >= 3)
+			GEOSCoordSeq_getXYZ(cs, i, &(point.x), &(point.y), &(point.z));
+		else
+			GEOSCoordSeq_getXY(cs, i, &(point.x), &(point.y));
+#else
 		GEOSCoordSeq_getX(cs, i, &(point.x));
 		GEOSCoordSeq_getY(cs, i, &(point.y));
 		if (dims >= 3) GEOSCoordSeq_getZ(cs, i, &(point.z));
+#endif
 		ptarray_set_point4d(pa, i, &point);
 	}
+#endif
 
 	return pa;
 }
@@ -178,7 +197,34 @@ GEOS2LWGEOM(const GEOSGeometry* geom, uint8_t want3d)
 	}
 }
 
-GEOSCoordSeq ptarray_to_GEOSCoordSeq(const POINTARRAY*, uint8_t fix_ring);
+/* Set point i of a GEOS coordinate sequence from point n of a POINTARRAY */
+static inline void
+coordseq_set_point(GEOSCoordSeq sq, uint32_t i, const POINTARRAY* pa, uint32_t n, uint32_t dims)
+{
+	if (dims == 3)
+	{
+		const POINT3DZ* p3d = getPoint3dz_cp(pa, n);
+		LWDEBUGF(4, "Point: %g,%g,%g", p3d->x, p3d->y, p3d->z);
+#if POSTGIS_GEOS_VERSION >= 38
+		GEOSCoordSeq_setXYZ(sq, i, p3d->x, p3d->y, p3d->z);
+#else
+		GEOSCoordSeq_setX(sq, i, p3d->x);
+		GEOSCoordSeq_setY(sq, i, p3d->y);
+		GEOSCoordSeq_setZ(sq, i, p3d->z);
+#endif
+	}
+	else
+	{
+		const POINT2D* p2d = getPoint2d_cp(pa, n);
+		LWDEBUGF(4, "Point: %g,%g", p2d->x, p2d->y);
+#if POSTGIS_GEOS_VERSION >= 38
+		GEOSCoordSeq_setXY(sq, i, p2d->x, p2d->y);
+#else
+		GEOSCoordSeq_setX(sq, i, p2d->x);
+		GEOSCoordSeq_setY(sq, i, p2d->y);
+#endif
+	}
+}
 
 GEOSCoordSeq
 ptarray_to_GEOSCoordSeq(const POINTARRAY* pa, uint8_t fix_ring)
@@ -186,8 +232,6 @@ ptarray_to_GEOSCoordSeq(const POINTARRAY* pa, uint8_t fix_ring)
 	uint32_t dims = 2;
 	uint32_t i;
 	int append_points = 0;
-	const POINT3DZ* p3d;
-	const POINT2D* p2d;
 	GEOSCoordSeq sq;
 
 	if (FLAGS_GET_Z(pa->flags)) dims = 3;
@@ -206,6 +250,18 @@ ptarray_to_GEOSCoordSeq(const POINTARRAY* pa, uint8_t fix_ring)
 		}
 	}
 
+#if POSTGIS_GEOS_VERSION >= 310
+	/* Copy the whole buffer, GEOS skips the M ordinates if any */
+	if (!append_points)
+	{
+		sq = GEOSCoordSeq_copyFromBuffer((const double*)pa->serialized_pointlist, pa->npoints,
+		                                 FLAGS_GET_Z(pa->flags), FLAGS_GET_M(pa->flags));
+		if (!sq)
+			lwerror("Error creating GEOS Coordinate Sequence");
+		return sq;
+	}
+#endif
+
 	if (!(sq = GEOSCoordSeq_create(pa->npoints + append_points, dims)))
 	{
 		lwerror("Error creating GEOS Coordinate Sequence");
@@ -213,42 +269,11 @@ ptarray_to_GEOSCoordSeq(const POINTARRAY* pa, uint8_t fix_ring)
 	}
 
 	for (i = 0; i < pa->npoints; i++)
-	{
-		if (dims == 3)
-		{
-			p3d = getPoint3dz_cp(pa, i);
-			p2d = (const POINT2D*)p3d;
-			LWDEBUGF(4, "Point: %g,%g,%g", p3d->x, p3d->y, p3d->z);
-		}
-		else
-		{
-			p2d = getPoint2d_cp(pa, i);
-			LWDEBUGF(4, "Point: %g,%g", p2d->x, p2d->y);
-		}
-
-		GEOSCoordSeq_setX(sq, i, p2d->x);
-		GEOSCoordSeq_setY(sq, i, p2d->y);
+		coordseq_set_point(sq, i, pa, i, dims);
 
-		if (dims == 3) GEOSCoordSeq_setZ(sq, i, p3d->z);
-	}
-
-	if (append_points)
-	{
-		if (dims == 3)
-		{
-			p3d = getPoint3dz_cp(pa, 0);
-			p2d = (const POINT2D*)p3d;
-		}
-		else
-			p2d = getPoint2d_cp(pa, 0);
-		for (i = pa->npoints; i < pa->npoints + append_points; i++)
-		{
-			GEOSCoordSeq_setX(sq, i, p2d->x);
-			GEOSCoordSeq_setY(sq, i, p2d->y);
-
-			if (dims == 3) GEOSCoordSeq_setZ(sq, i, p3d->z);
-		}
-	}
+	/* Close the ring on its first point */
+	for (i = pa->npoints; i < pa->npoints + append_points; i++)
+		coordseq_set_point(sq, i, pa, 0, dims);
 
 	return sq;
 }
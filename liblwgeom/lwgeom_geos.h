@@ -45,6 +45,7 @@ int cluster_within_distance(LWGEOM **geoms, uint32_t num_geoms, double tolerance
 int union_dbscan(LWGEOM **geoms, uint32_t num_geoms, UNIONFIND *uf, double eps, uint32_t min_points, char **is_in_cluster_ret);
 
 POINTARRAY* ptarray_from_GEOSCoordSeq(const GEOSCoordSequence* cs, uint8_t want3d);
+GEOSCoordSeq ptarray_to_GEOSCoordSeq(const POINTARRAY* pa, uint8_t fix_ring);
 
 extern char lwgeom_geos_errmsg[];
 extern void lwgeom_geos_error(const char* fmt, ...);
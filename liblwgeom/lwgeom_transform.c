@@ -45,6 +45,60 @@ to_dec(POINT4D *pt)
 	pt->y *= 180.0/M_PI;
 }
 
+/**
+ * Transform the whole coordinate list of a POINTARRAY in one call to
+ * the projection library. On failure the coordinates are left as
+ * they were and LW_FAILURE returned, without reporting an error.
+ */
+static int
+ptarray_transform_bulk(POINTARRAY *pa, projPJ inpj, projPJ outpj)
+{
+	uint32_t i;
+	size_t stride = FLAGS_NDIMS(pa->flags);
+	size_t size = (size_t)pa->npoints * ptarray_point_size(pa);
+	double *x = (double*)(pa->serialized_pointlist);
+	double *z = FLAGS_GET_Z(pa->flags) ? x + 2 : NULL;
+	double *orig = lwalloc(size);
+	int failed;
+
+	memcpy(orig, x, size);
+
+	if ( pj_is_latlong(inpj) )
+	{
+		for ( i = 0; i < pa->npoints; i++ )
+		{
+			x[i * stride] *= M_PI/180.0;
+			x[i * stride + 1] *= M_PI/180.0;
+		}
+	}
+
+	/* Points the library cannot handle may only come back as HUGE_VAL */
+	failed = pj_transform(inpj, outpj, pa->npoints, stride, x, x + 1, z) != 0;
+	for ( i = 0; i < pa->npoints && ! failed; i++ )
+	{
+		if ( x[i * stride] == HUGE_VAL || x[i * stride + 1] == HUGE_VAL )
+			failed = LW_TRUE;
+	}
+
+	if ( failed )
+	{
+		memcpy(x, orig, size);
+		lwfree(orig);
+		return LW_FAILURE;
+	}
+	lwfree(orig);
+
+	if ( pj_is_latlong(outpj) )
+	{
+		for ( i = 0; i < pa->npoints; i++ )
+		{
+			x[i * stride] *= 180.0/M_PI;
+			x[i * stride + 1] *= 180.0/M_PI;
+		}
+	}
+	return LW_SUCCESS;
+}
+
 /**
  * Transform given POINTARRAY
  * from inpj projection to outpj projection
@@ -55,6 +109,11 @@ ptarray_transform(POINTARRAY *pa, projPJ inpj, projPJ outpj)
 	uint32_t i;
 	POINT4D p;
 
+	/* Transform all the points at once, unless one of them fails */
+	if ( pa->npoints > 1 && ptarray_transform_bulk(pa, inpj, outpj) )
+		return LW_SUCCESS;
+
+	/* Go point by point to find and report the one that fails */
 	for ( i = 0; i < pa->npoints; i++ )
 	{
 		getPoint4d_p(pa, i, &p);
@@ -0,0 +1,496 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "liblwgeom_internal.h"
+#include "lwgeom_log.h"
+#include "lwpip.h"
+
+/*
+* Cells are tested against the edges with their bounds pushed out
+* by this fraction of the cell size, so that rounding can never let
+* an edge slip into a cell classified as free of edges.
+*/
+#define PIP_CELL_MARGIN 0.01
+
+typedef struct
+{
+	double x;
+	uint32_t poly;
+} PIP_CROSSING;
+
+static inline uint32_t
+pip_index_row(const PIP_INDEX *index, double y)
+{
+	double r;
+	if (index->cell_height <= 0.0) return 0;
+	r = floor((y - index->ymin) / index->cell_height);
+	if (r < 0.0) return 0;
+	if (r >= index->nrows) return index->nrows - 1;
+	return (uint32_t)r;
+}
+
+static inline uint32_t
+pip_index_col(const PIP_INDEX *index, double x)
+{
+	double c;
+	if (index->cell_width <= 0.0) return 0;
+	c = floor((x - index->xmin) / index->cell_width);
+	if (c < 0.0) return 0;
+	if (c >= index->ncols) return index->ncols - 1;
+	return (uint32_t)c;
+}
+
+static int
+pip_crossing_cmp(const void *a, const void *b)
+{
+	double xa = ((const PIP_CROSSING*)a)->x;
+	double xb = ((const PIP_CROSSING*)b)->x;
+	return xa < xb ? -1 : (xa > xb ? 1 : 0);
+}
+
+/*
+* Copy the edges of the rings of a polygon, tagged with the
+* polygon number, and return the number of edges added. Repeated
+* points do not make an edge.
+*/
+static uint32_t
+pip_index_add_poly(PIP_EDGE *edges, const LWPOLY *poly, uint32_t polynum)
+{
+	uint32_t i, j, n = 0;
+	for (i = 0; i < poly->nrings; i++)
+	{
+		const POINTARRAY *pa = poly->rings[i];
+		for (j = 1; j < pa->npoints; j++)
+		{
+			const POINT2D *p1 = getPoint2d_cp(pa, j-1);
+			const POINT2D *p2 = getPoint2d_cp(pa, j);
+			if (p1->x == p2->x && p1->y == p2->y)
+				continue;
+			if (edges)
+			{
+				edges[n].x1 = p1->x; edges[n].y1 = p1->y;
+				edges[n].x2 = p2->x; edges[n].y2 = p2->y;
+				edges[n].poly = polynum;
+			}
+			n++;
+		}
+	}
+	return n;
+}
+
+/*
+* Mark as boundary every cell that an edge, clipped to each row it
+* spans, comes within the cell margin of.
+*/
+static void
+pip_index_mark_boundary(PIP_INDEX *index)
+{
+	double mx = index->cell_width * PIP_CELL_MARGIN;
+	double my = index->cell_height * PIP_CELL_MARGIN;
+	uint32_t e, r, c;
+
+	for (e = 0; e < index->nedges; e++)
+	{
+		const PIP_EDGE *edge = &(index->edges[e]);
+		uint32_t r0 = pip_index_row(index, FP_MIN(edge->y1, edge->y2) - my);
+		uint32_t r1 = pip_index_row(index, FP_MAX(edge->y1, edge->y2) + my);
+
+		for (r = r0; r <= r1; r++)
+		{
+			double ya = index->ymin + r * index->cell_height - my;
+			double yb = ya + index->cell_height + 2 * my;
+			double xa, xb;
+			uint32_t c0, c1;
+
+			if (edge->y1 == edge->y2)
+			{
+				xa = FP_MIN(edge->x1, edge->x2);
+				xb = FP_MAX(edge->x1, edge->x2);
+			}
+			else
+			{
+				double ta = (ya - edge->y1) / (edge->y2 - edge->y1);
+				double tb = (yb - edge->y1) / (edge->y2 - edge->y1);
+				double tlo = FP_MAX(0.0, FP_MIN(ta, tb));
+				double thi = FP_MIN(1.0, FP_MAX(ta, tb));
+				if (tlo > thi) continue;
+				xa = edge->x1 + tlo * (edge->x2 - edge->x1);
+				xb = edge->x1 + thi * (edge->x2 - edge->x1);
+				if (xa > xb) { double t = xa; xa = xb; xb = t; }
+			}
+
+			c0 = pip_index_col(index, xa - mx);
+			c1 = pip_index_col(index, xb + mx);
+			for (c = c0; c <= c1; c++)
+				index->cells[r * index->ncols + c] = PIP_CELL_BOUNDARY;
+		}
+	}
+}
+
+/*
+* Classify the cells free of edges, sweeping a line through the
+* middle of each row and counting, per polygon, the edges crossed
+* on the way to each cell center. A cell is inside if it is inside
+* an odd number of rings of some polygon.
+*/
+static void
+pip_index_classify_cells(PIP_INDEX *index)
+{
+	PIP_CROSSING *crossings;
+	uint8_t *parity;
+	uint32_t r, c, i;
+
+	crossings = lwalloc(sizeof(PIP_CROSSING) * (index->nedges ? index->nedges : 1));
+	parity = lwalloc(index->npolys);
+
+	for (r = 0; r < index->nrows; r++)
+	{
+		double yc = index->ymin + (r + 0.5) * index->cell_height;
+		uint32_t ncrossings = 0, next = 0, odd = 0;
+
+		for (i = index->row_start[r]; i < index->row_start[r+1]; i++)
+		{
+			const PIP_EDGE *edge = &(index->edges[index->row_edges[i]]);
+			if ((edge->y1 > yc) != (edge->y2 > yc))
+			{
+				crossings[ncrossings].x = edge->x1 + (yc - edge->y1) * (edge->x2 - edge->x1) / (edge->y2 - edge->y1);
+				crossings[ncrossings].poly = edge->poly;
+				ncrossings++;
+			}
+		}
+		qsort(crossings, ncrossings, sizeof(PIP_CROSSING), pip_crossing_cmp);
+		memset(parity, 0, index->npolys);
+
+		for (c = 0; c < index->ncols; c++)
+		{
+			double xc = index->xmin + (c + 0.5) * index->cell_width;
+			uint8_t *cell = &(index->cells[r * index->ncols + c]);
+
+			while (next < ncrossings && crossings[next].x < xc)
+			{
+				uint32_t p = crossings[next++].poly;
+				parity[p] ^= 1;
+				if (parity[p]) odd++; else odd--;
+			}
+			if (*cell != PIP_CELL_BOUNDARY)
+				*cell = odd ? PIP_CELL_INSIDE : PIP_CELL_OUTSIDE;
+		}
+	}
+
+	lwfree(parity);
+	lwfree(crossings);
+}
+
+PIP_INDEX *
+pip_index_from_lwgeom(const LWGEOM *geom)
+{
+	PIP_INDEX *index;
+	const LWMPOLY *mpoly = NULL;
+	const LWPOLY *poly = NULL;
+	uint32_t i, r, nedges = 0, npolys;
+	uint32_t *row_fill;
+	double my;
+
+	if (!geom || lwgeom_is_empty(geom))
+		return NULL;
+
+	if (geom->type == POLYGONTYPE)
+	{
+		poly = (const LWPOLY*)geom;
+		npolys = 1;
+		nedges = pip_index_add_poly(NULL, poly, 0);
+	}
+	else if (geom->type == MULTIPOLYGONTYPE)
+	{
+		mpoly = (const LWMPOLY*)geom;
+		npolys = mpoly->ngeoms;
+		for (i = 0; i < mpoly->ngeoms; i++)
+			nedges += pip_index_add_poly(NULL, mpoly->geoms[i], i);
+	}
+	else
+	{
+		return NULL;
+	}
+
+	if (nedges == 0)
+		return NULL;
+
+	index = lwalloc(sizeof(PIP_INDEX));
+	memset(index, 0, sizeof(PIP_INDEX));
+	index->npolys = npolys;
+	index->nedges = nedges;
+	index->edges = lwalloc(sizeof(PIP_EDGE) * nedges);
+	if (poly)
+	{
+		pip_index_add_poly(index->edges, poly, 0);
+	}
+	else
+	{
+		uint32_t n = 0;
+		for (i = 0; i < mpoly->ngeoms; i++)
+			n += pip_index_add_poly(index->edges + n, mpoly->geoms[i], i);
+	}
+
+	/* Bounds */
+	index->xmin = index->xmax = index->edges[0].x1;
+	index->ymin = index->ymax = index->edges[0].y1;
+	for (i = 0; i < nedges; i++)
+	{
+		const PIP_EDGE *e = &(index->edges[i]);
+		index->xmin = FP_MIN(index->xmin, FP_MIN(e->x1, e->x2));
+		index->xmax = FP_MAX(index->xmax, FP_MAX(e->x1, e->x2));
+		index->ymin = FP_MIN(index->ymin, FP_MIN(e->y1, e->y2));
+		index->ymax = FP_MAX(index->ymax, FP_MAX(e->y1, e->y2));
+	}
+
+	/* Grid size: a few edges per row, about as many columns as */
+	/* edges per column, within fixed bounds */
+	index->nrows = (nedges + 3) / 4;
+	if (index->nrows > PIP_GRID_MAX_ROWS) index->nrows = PIP_GRID_MAX_ROWS;
+	index->ncols = (uint32_t)ceil(sqrt((double)nedges));
+	if (index->ncols > PIP_GRID_MAX_COLUMNS) index->ncols = PIP_GRID_MAX_COLUMNS;
+	if (index->ymax <= index->ymin) index->nrows = 1;
+	if (index->xmax <= index->xmin) index->ncols = 1;
+	index->cell_width = (index->xmax - index->xmin) / index->ncols;
+	index->cell_height = (index->ymax - index->ymin) / index->nrows;
+
+	/* Edge lists of the rows. Edges are added in order, so each */
+	/* list comes out sorted by polygon. */
+	my = index->cell_height * PIP_CELL_MARGIN;
+	index->row_start = lwalloc(sizeof(uint32_t) * (index->nrows + 1));
+	memset(index->row_start, 0, sizeof(uint32_t) * (index->nrows + 1));
+	for (i = 0; i < nedges; i++)
+	{
+		const PIP_EDGE *e = &(index->edges[i]);
+		uint32_t r0 = pip_index_row(index, FP_MIN(e->y1, e->y2) - my);
+		uint32_t r1 = pip_index_row(index, FP_MAX(e->y1, e->y2) + my);
+		for (r = r0; r <= r1; r++)
+			index->row_start[r+1]++;
+	}
+	for (r = 0; r < index->nrows; r++)
+		index->row_start[r+1] += index->row_start[r];
+
+	index->row_edges = lwalloc(sizeof(uint32_t) * (index->row_start[index->nrows] ? index->row_start[index->nrows] : 1));
+	row_fill = lwalloc(sizeof(uint32_t) * index->nrows);
+	memcpy(row_fill, index->row_start, sizeof(uint32_t) * index->nrows);
+	for (i = 0; i < nedges; i++)
+	{
+		const PIP_EDGE *e = &(index->edges[i]);
+		uint32_t r0 = pip_index_row(index, FP_MIN(e->y1, e->y2) - my);
+		uint32_t r1 = pip_index_row(index, FP_MAX(e->y1, e->y2) + my);
+		for (r = r0; r <= r1; r++)
+			index->row_edges[row_fill[r]++] = i;
+	}
+	lwfree(row_fill);
+
+	/* Cells */
+	index->cells = lwalloc(index->nrows * index->ncols);
+	memset(index->cells, PIP_CELL_OUTSIDE, index->nrows * index->ncols);
+	pip_index_mark_boundary(index);
+	pip_index_classify_cells(index);
+
+	LWDEBUGF(3, "pip index on %d edges, %dx%d grid", nedges, index->ncols, index->nrows);
+	return index;
+}
+
+int
+pip_index_contains_point(const PIP_INDEX *index, const POINT2D *pt)
+{
+	uint32_t r, i;
+	uint32_t poly = 0;
+	int parity = 0, inside = 0;
+	uint8_t cell;
+
+	if (pt->x < index->xmin || pt->x > index->xmax ||
+	    pt->y < index->ymin || pt->y > index->ymax)
+		return LW_OUTSIDE;
+
+	r = pip_index_row(index, pt->y);
+	cell = index->cells[r * index->ncols + pip_index_col(index, pt->x)];
+	if (cell == PIP_CELL_INSIDE)
+		return LW_INSIDE;
+	if (cell == PIP_CELL_OUTSIDE)
+		return LW_OUTSIDE;
+
+	/* Near the boundary, count the row edges crossed by a ray */
+	/* going right from the point, polygon by polygon */
+	for (i = index->row_start[r]; i < index->row_start[r+1]; i++)
+	{
+		const PIP_EDGE *e = &(index->edges[index->row_edges[i]]);
+		double side;
+
+		if (e->poly != poly)
+		{
+			inside |= parity;
+			parity = 0;
+			poly = e->poly;
+		}
+
+		side = (e->x2 - e->x1) * (pt->y - e->y1) - (e->y2 - e->y1) * (pt->x - e->x1);
+
+		/* On the edge */
+		if (side == 0.0 &&
+		    FP_MIN(e->x1, e->x2) <= pt->x && pt->x <= FP_MAX(e->x1, e->x2) &&
+		    FP_MIN(e->y1, e->y2) <= pt->y && pt->y <= FP_MAX(e->y1, e->y2))
+			return LW_BOUNDARY;
+
+		/* Edge straddles the ray line and the point is on its left */
+		/* (rising edge) or on its right (falling edge) */
+		if ((e->y1 > pt->y) != (e->y2 > pt->y))
+		{
+			if (e->y2 > e->y1 ? side > 0.0 : side < 0.0)
+				parity ^= 1;
+		}
+	}
+	inside |= parity;
+
+	return inside ? LW_INSIDE : LW_OUTSIDE;
+}
+
+void
+pip_index_locate_points(const PIP_INDEX *index, const POINTARRAY *pts, int *locations)
+{
+	uint32_t i;
+	for (i = 0; i < pts->npoints; i++)
+		locations[i] = pip_index_contains_point(index, getPoint2d_cp(pts, i));
+}
+
+/*
+* Crossing count of a batch of points against the edges of one ring,
+* with the points in the inner loop. The loop body has no branches,
+* so that the compiler can turn it into vector instructions.
+*/
+static void
+pip_ring_locate_points(const POINTARRAY *ring, uint32_t npts, const double *xs, const double *ys, uint8_t *parity, uint8_t *boundary)
+{
+	uint32_t i, j;
+
+	for (j = 1; j < ring->npoints; j++)
+	{
+		const POINT2D *p1 = getPoint2d_cp(ring, j-1);
+		const POINT2D *p2 = getPoint2d_cp(ring, j);
+		double x1 = p1->x, y1 = p1->y, x2 = p2->x, y2 = p2->y;
+		double dx = x2 - x1, dy = y2 - y1;
+		double xmin = FP_MIN(x1, x2), xmax = FP_MAX(x1, x2);
+		double ymin = FP_MIN(y1, y2), ymax = FP_MAX(y1, y2);
+		double dir = y2 > y1 ? 1.0 : -1.0;
+
+		if (dx == 0.0 && dy == 0.0)
+			continue;
+
+		for (i = 0; i < npts; i++)
+		{
+			double side = dx * (ys[i] - y1) - dy * (xs[i] - x1);
+			parity[i] ^= ((y1 > ys[i]) != (y2 > ys[i])) & (dir * side > 0.0);
+			boundary[i] |= (side == 0.0) &
+			               (xs[i] >= xmin) & (xs[i] <= xmax) &
+			               (ys[i] >= ymin) & (ys[i] <= ymax);
+		}
+	}
+}
+
+int
+pip_locate_points(const LWGEOM *geom, const POINTARRAY *pts, int *locations)
+{
+	const LWPOLY *single[1];
+	const LWPOLY * const *polys;
+	uint32_t npolys, npts = pts->npoints;
+	uint32_t i, p, r;
+	double *xs, *ys;
+	uint8_t *parity, *inside, *boundary;
+
+	if (geom->type == POLYGONTYPE)
+	{
+		single[0] = (const LWPOLY*)geom;
+		polys = single;
+		npolys = 1;
+	}
+	else if (geom->type == MULTIPOLYGONTYPE)
+	{
+		polys = (const LWPOLY * const *)((const LWMPOLY*)geom)->geoms;
+		npolys = ((const LWMPOLY*)geom)->ngeoms;
+	}
+	else
+	{
+		return LW_FAILURE;
+	}
+
+	if (npts == 0)
+		return LW_SUCCESS;
+
+	if (npts >= PIP_BATCH_INDEX_THRESHOLD)
+	{
+		PIP_INDEX *index = pip_index_from_lwgeom(geom);
+		if (index)
+		{
+			pip_index_locate_points(index, pts, locations);
+			pip_index_free(index);
+			return LW_SUCCESS;
+		}
+	}
+
+	/* Coordinates in separate arrays for the inner loop */
+	xs = lwalloc(sizeof(double) * npts);
+	ys = lwalloc(sizeof(double) * npts);
+	for (i = 0; i < npts; i++)
+	{
+		const POINT2D *pt = getPoint2d_cp(pts, i);
+		xs[i] = pt->x;
+		ys[i] = pt->y;
+	}
+	parity = lwalloc(npts);
+	inside = lwalloc(npts);
+	boundary = lwalloc(npts);
+	memset(inside, 0, npts);
+	memset(boundary, 0, npts);
+
+	for (p = 0; p < npolys; p++)
+	{
+		memset(parity, 0, npts);
+		for (r = 0; r < polys[p]->nrings; r++)
+			pip_ring_locate_points(polys[p]->rings[r], npts, xs, ys, parity, boundary);
+		for (i = 0; i < npts; i++)
+			inside[i] |= parity[i];
+	}
+
+	for (i = 0; i < npts; i++)
+		locations[i] = boundary[i] ? LW_BOUNDARY : (inside[i] ? LW_INSIDE : LW_OUTSIDE);
+
+	lwfree(xs);
+	lwfree(ys);
+	lwfree(parity);
+	lwfree(inside);
+	lwfree(boundary);
+	return LW_SUCCESS;
+}
+
+void
+pip_index_free(PIP_INDEX *index)
+{
+	if (!index) return;
+	lwfree(index->edges);
+	lwfree(index->row_start);
+	lwfree(index->row_edges);
+	lwfree(index->cells);
+	lwfree(index);
+}
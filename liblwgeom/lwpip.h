@@ -0,0 +1,98 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#ifndef _LWPIP_H
+#define _LWPIP_H 1
+
+/*
+* Prepared point-in-polygon index.
+*
+* The bounding box of a (multi)polygon is cut into a grid. Cells
+* crossed by no edge are classified once, at build time, as inside
+* or outside, so that most points are answered by a single cell
+* lookup. Each row of the grid also keeps the list of the edges
+* overlapping it, ordered by polygon, which answers points in the
+* cells crossed by the boundary with a crossing count along the row.
+*/
+
+/* Cell classification */
+#define PIP_CELL_OUTSIDE  0
+#define PIP_CELL_INSIDE   1
+#define PIP_CELL_BOUNDARY 2
+
+/* Upper bounds of the grid size */
+#define PIP_GRID_MAX_COLUMNS 256
+#define PIP_GRID_MAX_ROWS 1024
+
+/* Batches at least this large get a temporary index */
+#define PIP_BATCH_INDEX_THRESHOLD 64
+
+typedef struct
+{
+	double x1, y1, x2, y2;
+	uint32_t poly;  /* Polygon the edge belongs to */
+} PIP_EDGE;
+
+typedef struct
+{
+	double xmin, xmax, ymin, ymax;
+	double cell_width, cell_height;
+	uint32_t ncols, nrows;
+	uint32_t npolys;
+	uint32_t nedges;
+	PIP_EDGE *edges;
+	uint32_t *row_start;  /* nrows+1 offsets into row_edges */
+	uint32_t *row_edges;  /* Edge numbers of each row, in polygon order */
+	uint8_t *cells;       /* nrows*ncols classifications, row major */
+} PIP_INDEX;
+
+/**
+* Build an index on a Polygon or MultiPolygon. Returns NULL for
+* other types and for empty geometries. The index holds its own
+* copy of the edges, the geometry can be freed.
+*/
+PIP_INDEX *pip_index_from_lwgeom(const LWGEOM *geom);
+
+/**
+* Locate a point with respect to the indexed area. Returns
+* LW_INSIDE, LW_BOUNDARY or LW_OUTSIDE.
+*/
+int pip_index_contains_point(const PIP_INDEX *index, const POINT2D *pt);
+
+/**
+* Locate every point of a point array with respect to the indexed
+* area, writing LW_INSIDE, LW_BOUNDARY or LW_OUTSIDE in locations.
+*/
+void pip_index_locate_points(const PIP_INDEX *index, const POINTARRAY *pts, int *locations);
+
+/**
+* Locate every point of a point array with respect to a Polygon or
+* MultiPolygon, without a prepared index. Small batches run a
+* crossing count with the points in the inner loop, larger ones go
+* through a temporary PIP_INDEX. Returns LW_FAILURE on other types.
+*/
+int pip_locate_points(const LWGEOM *geom, const POINTARRAY *pts, int *locations);
+
+/**
+* Free the index memory
+*/
+void pip_index_free(PIP_INDEX *index);
+
+#endif /* _LWPIP_H */
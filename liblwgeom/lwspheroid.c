@@ -89,6 +89,27 @@ double spheroid_distance(const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, c
 	return s12;
 }
 
+/**
+* Spheroidal distances from a to each of the n points of b, into d.
+* Same as spheroid_distance(), with the geodesic set up once for the
+* whole batch.
+*/
+void spheroid_distance_batch(const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, uint32_t n, const SPHEROID *spheroid, double *d)
+{
+	struct geod_geodesic gd;
+	double lat1 = a->lat * 180.0 / M_PI;
+	double lon1 = a->lon * 180.0 / M_PI;
+	uint32_t i;
+
+	geod_init(&gd, spheroid->a, spheroid->f);
+	for ( i = 0; i < n; i++ )
+	{
+		double lat2 = b[i].lat * 180.0 / M_PI;
+		double lon2 = b[i].lon * 180.0 / M_PI;
+		geod_inverse(&gd, lat1, lon1, lat2, lon2, &d[i], 0, 0);
+	}
+}
+
 /**
 * Computes the forward azimuth of the geodesic joining two points on
 * the spheroid, using the inverse geodesic problem (Karney 2013).
@@ -266,6 +287,17 @@ double spheroid_distance(const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, c
 	return distance;
 }
 
+/**
+* Spheroidal distances from a to each of the n points of b, into d.
+* Same as spheroid_distance(), one pair at a time.
+*/
+void spheroid_distance_batch(const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, uint32_t n, const SPHEROID *spheroid, double *d)
+{
+	uint32_t i;
+	for ( i = 0; i < n; i++ )
+		d[i] = spheroid_distance(a, &b[i], spheroid);
+}
+
 /**
 * Computes the direction of the geodesic joining two points on
 * the spheroid. Based on Vincenty's formula for the geodetic
@@ -696,5 +728,178 @@ double lwgeom_area_spheroid(const LWGEOM *lwgeom, const SPHEROID *spheroid)
 	return 0.0;
 }
 
+/**
+* Edges longer than this, in degrees, bend too far from the great
+* circles of the authalic sphere for ptarray_area_authalic(): rings
+* holding one go to ptarray_area_spheroid() instead. Up to this
+* length the two areas agree to about 1e-8 relative.
+*/
+#define AREA_AUTHALIC_MAX_EDGE 0.1
+
+/**
+* Authalic sphere of a spheroid: the sphere of the same area, onto
+* which lon/lat points map by their authalic latitude so that every
+* region keeps its area.
+*/
+typedef struct
+{
+	double e;	/* first eccentricity */
+	double qp;	/* authalic_q() at the pole */
+	double r2;	/* squared radius of the authalic sphere */
+}
+AUTHALIC;
+
+static double authalic_q(double sinlat, const AUTHALIC *au)
+{
+	double es = au->e * sinlat;
+
+	/* On a sphere q is twice the sine of the latitude */
+	if ( au->e == 0.0 )
+		return 2.0 * sinlat;
+
+	return (1.0 - au->e * au->e) * (sinlat / (1.0 - es * es) - log((1.0 - es) / (1.0 + es)) / (2.0 * au->e));
+}
+
+static void authalic_init(AUTHALIC *au, const SPHEROID *spheroid)
+{
+	au->e = sqrt(spheroid->e_sq);
+	au->qp = authalic_q(1.0, au);
+	au->r2 = spheroid->a * spheroid->a * au->qp / 2.0;
+}
+
+/**
+* Area of a ring on the authalic sphere. Each vertex is moved to its
+* authalic latitude once, and each edge then adds the spherical
+* excess of the trapezoid between it and the equator,
+*
+*   tan(E/2) = tan(dlon/2) (t1 + t2) / (1 + t1 t2),  t = tan(lat/2)
+*
+* Returns LW_FAILURE, leaving *area alone, when an edge is longer
+* than AREA_AUTHALIC_MAX_EDGE.
+*/
+static int ptarray_area_authalic(const POINTARRAY *pa, const AUTHALIC *au, double *area)
+{
+	uint32_t i, n = pa->npoints;
+	double *lon, *t;
+	double prev_cos = 0.0, sum = 0.0, dlon_sum = 0.0;
+	const POINT2D *p, *prev = NULL;
+
+	/* Return zero on nonsensical inputs */
+	if ( n < 4 )
+	{
+		*area = 0.0;
+		return LW_SUCCESS;
+	}
+
+	lon = lwalloc(2 * n * sizeof(double));
+	t = lon + n;
+
+	for ( i = 0; i < n; i++ )
+	{
+		double sinb, cosb;
+
+		p = getPoint2d_cp(pa, i);
+		sinb = authalic_q(sin(deg2rad(p->y)), au) / au->qp;
+		if ( sinb > 1.0 ) sinb = 1.0;
+		if ( sinb < -1.0 ) sinb = -1.0;
+		cosb = sqrt(1.0 - sinb * sinb);
+
+		/* A planar estimate of the edge length is all that is needed */
+		if ( prev )
+		{
+			double dx = fabs(p->x - prev->x);
+			double dy = p->y - prev->y;
+			if ( dx > 180.0 )
+				dx = 360.0 - dx;
+			dx *= FP_MAX(cosb, prev_cos);
+			if ( dx * dx + dy * dy > AREA_AUTHALIC_MAX_EDGE * AREA_AUTHALIC_MAX_EDGE )
+			{
+				lwfree(lon);
+				return LW_FAILURE;
+			}
+		}
+		prev = p;
+		prev_cos = cosb;
+
+		lon[i] = deg2rad(p->x);
+		t[i] = sinb / (1.0 + cosb);
+	}
+
+	for ( i = 1; i < n; i++ )
+	{
+		double dlon = lon[i] - lon[i-1];
+		if ( dlon > M_PI )
+			dlon -= 2.0 * M_PI;
+		else if ( dlon < -M_PI )
+			dlon += 2.0 * M_PI;
+		dlon_sum += dlon;
+		sum += 2.0 * atan2(tan(dlon / 2.0) * (t[i-1] + t[i]), 1.0 + t[i-1] * t[i]);
+	}
+	lwfree(lon);
+
+	/* A ring around a pole measures from the pole rather than the equator */
+	if ( dlon_sum > M_PI )
+		sum = 2.0 * M_PI - sum;
+	else if ( dlon_sum < -M_PI )
+		sum = -2.0 * M_PI - sum;
+
+	/* Like geod_polygon_compute(), take the smaller side of the ring */
+	sum = fmod(fabs(sum), 4.0 * M_PI);
+	if ( sum > 2.0 * M_PI )
+		sum = 4.0 * M_PI - sum;
+
+	*area = sum * au->r2;
+	return LW_SUCCESS;
+}
+
+static double lwgeom_area_authalic(const LWGEOM *lwgeom, const SPHEROID *spheroid, const AUTHALIC *au)
+{
+	uint32_t i;
+	double area = 0.0;
+
+	if ( lwgeom_is_empty(lwgeom) )
+		return 0.0;
+
+	if ( lwgeom->type == POLYGONTYPE )
+	{
+		LWPOLY *poly = (LWPOLY*)lwgeom;
+		for ( i = 0; i < poly->nrings; i++ )
+		{
+			double ring_area;
+			if ( ptarray_area_authalic(poly->rings[i], au, &ring_area) == LW_FAILURE )
+				ring_area = ptarray_area_spheroid(poly->rings[i], spheroid);
+			/* Subtract areas of inner rings */
+			area += i ? -ring_area : ring_area;
+		}
+		return area;
+	}
+
+	if ( lwgeom->type == MULTIPOLYGONTYPE || lwgeom->type == COLLECTIONTYPE )
+	{
+		LWCOLLECTION *col = (LWCOLLECTION*)lwgeom;
+		for ( i = 0; i < col->ngeoms; i++ )
+			area += lwgeom_area_authalic(col->geoms[i], spheroid, au);
+		return area;
+	}
+
+	/* Anything but polygons and collections has no area */
+	return 0.0;
+}
+
+/**
+* Calculate the area of an LWGEOM like lwgeom_area_spheroid(), on the
+* authalic sphere of the spheroid. Rings with edges longer than
+* AREA_AUTHALIC_MAX_EDGE fall back to lwgeom_area_spheroid().
+*/
+double lwgeom_area_spheroid_authalic(const LWGEOM *lwgeom, const SPHEROID *spheroid)
+{
+	AUTHALIC au;
+
+	assert(lwgeom);
+
+	authalic_init(&au, spheroid);
+	return lwgeom_area_authalic(lwgeom, spheroid, &au);
+}
+
 
 
@@ -81,6 +81,26 @@ rect_tree_free(RECT_NODE *node)
 	lwfree(node);
 }
 
+/*
+* Closed segment intersection test. Unlike lw_segment_intersects(),
+* which counts crossings and ignores touches by the second end
+* points, any shared point counts. Only called on leaves whose
+* boxes overlap, so collinear segments always share a point.
+*/
+static inline int
+rect_leaf_segments_intersect(const POINT2D *p1, const POINT2D *p2, const POINT2D *q1, const POINT2D *q2)
+{
+	/* End points of q on the same side of p? */
+	if (lw_segment_side(p1, p2, q1) * lw_segment_side(p1, p2, q2) > 0)
+		return LW_FALSE;
+
+	/* End points of p on the same side of q? */
+	if (lw_segment_side(q1, q2, p1) * lw_segment_side(q1, q2, p2) > 0)
+		return LW_FALSE;
+
+	return LW_TRUE;
+}
+
 static int
 rect_leaf_node_intersects(RECT_NODE_LEAF *n1, RECT_NODE_LEAF *n2)
 {
@@ -134,7 +154,7 @@ rect_leaf_node_intersects(RECT_NODE_LEAF *n1, RECT_NODE_LEAF *n2)
 				case RECT_NODE_SEG_LINEAR:
 					q1 = getPoint2d_cp(n2->pa, n2->seg_num);
 					q2 = getPoint2d_cp(n2->pa, n2->seg_num+1);
-					return lw_segment_intersects(p1, p2, q1, q2) > 0;
+					return rect_leaf_segments_intersect(p1, p2, q1, q2);
 
 				case RECT_NODE_SEG_CIRCULAR:
 					q1 = getPoint2d_cp(n2->pa, n2->seg_num*2);
@@ -195,6 +215,14 @@ rect_leaf_node_segment_side(RECT_NODE_LEAF *node, const POINT2D *q, int *on_boun
 	const POINT2D *p1, *p2, *p3;
 	switch (node->seg_type)
 	{
+		/* Ring collapsed to a point, no crossing */
+		case RECT_NODE_SEG_POINT:
+		{
+			p1 = getPoint2d_cp(node->pa, node->seg_num);
+			if (p2d_same(p1, q))
+				*on_boundary = LW_TRUE;
+			return 0;
+		}
 		case RECT_NODE_SEG_LINEAR:
 		{
 			int side;
@@ -433,6 +461,7 @@ rect_tree_is_area(const RECT_NODE *node)
 	{
 		case POLYGONTYPE:
 		case CURVEPOLYTYPE:
+		case MULTIPOLYGONTYPE:
 		case MULTISURFACETYPE:
 			return LW_TRUE;
 
@@ -651,7 +680,7 @@ rect_tree_from_ptarray(const POINTARRAY *pa, int geom_type)
 	}
 
 	/* First create a flat list of nodes, one per edge. */
-	nodes = lwalloc(sizeof(RECT_NODE*) * num_edges);
+	nodes = lwalloc(sizeof(RECT_NODE*) * FP_MAX(num_edges, 1));
 	for (i = 0; i < num_edges; i++)
 	{
 		RECT_NODE *node = rect_node_leaf_new(pa, i, geom_type);
@@ -659,6 +688,15 @@ rect_tree_from_ptarray(const POINTARRAY *pa, int geom_type)
 			nodes[j++] = node;
 	}
 
+	/* Only zero length edges, the array stands for a point */
+	if (j == 0)
+	{
+		tree = rect_node_leaf_new(pa, 0, POINTTYPE);
+		tree->geom_type = geom_type;
+		lwfree(nodes);
+		return tree;
+	}
+
 	/* Merge the list into a tree */
 	tree = rect_nodes_merge(nodes, j);
 
@@ -752,10 +790,24 @@ rect_tree_from_lwpoly(const LWGEOM *lwgeom)
 		RECT_NODE *node = rect_tree_from_ptarray(lwpoly->rings[i], lwgeom->type);
 		if (node)
 		{
+			/* A ring with a single non-zero edge arrives as a leaf, */
+			/* which has no room for a ring type */
+			if (node->type == RECT_NODE_LEAF_TYPE)
+			{
+				RECT_NODE *internal = rect_node_internal_new(node);
+				rect_node_internal_add_node(internal, node);
+				node = internal;
+			}
 			node->i.ring_type = i ? RECT_NODE_RING_INTERIOR : RECT_NODE_RING_EXTERIOR;
 			nodes[j++] = node;
 		}
 	}
+	/* Nothing but zero length edges */
+	if (j < 1)
+	{
+		lwfree(nodes);
+		return NULL;
+	}
 	tree = rect_nodes_merge(nodes, j);
 	tree->geom_type = lwgeom->type;
 	lwfree(nodes);
@@ -844,7 +896,22 @@ rect_tree_from_lwcollection(const LWGEOM *lwgeom)
 	if (lwgeom->type != COMPOUNDTYPE)
 		qsort(nodes, j, sizeof(RECT_NODE*), rect_node_cmp);
 
-	tree = rect_nodes_merge(nodes, j);
+	if (j < 1)
+	{
+		lwfree(nodes);
+		return NULL;
+	}
+	/* A single sub-geometry keeps its own top node under the */
+	/* collection one, so that its type is not overwritten */
+	else if (j == 1)
+	{
+		tree = rect_node_internal_new(nodes[0]);
+		rect_node_internal_add_node(tree, nodes[0]);
+	}
+	else
+	{
+		tree = rect_nodes_merge(nodes, j);
+	}
 
 	tree->geom_type = lwgeom->type;
 	lwfree(nodes);
@@ -883,20 +950,6 @@ rect_tree_from_lwgeom(const LWGEOM *lwgeom)
 	return NULL;
 }
 
-/*
-* Get an actual coordinate point from a tree to use
-* for point-in-polygon testing.
-*/
-static const POINT2D *
-rect_tree_get_point(const RECT_NODE *node)
-{
-	if (!node) return NULL;
-	if (rect_node_is_leaf(node))
-		return getPoint2d_cp(node->l.pa, 0);
-	else
-		return rect_tree_get_point(node->i.nodes[0]);
-}
-
 static inline int
 rect_node_intersects(const RECT_NODE *n1, const RECT_NODE *n2)
 {
@@ -911,6 +964,73 @@ rect_node_intersects(const RECT_NODE *n1, const RECT_NODE *n2)
 	}
 }
 
+/*
+* Test whether area tree n1 contains a point of any component
+* (point, line, ring) of tree n2. A component that crosses no edge
+* of n1 is either fully inside or fully outside of it, so one point
+* per component is enough, and only components in the bounds of n1
+* need a test. Leaves of a component are contiguous in the tree, so
+* the point array of the last tested leaf is enough to skip the
+* other leaves of the same component. Returns -1 when interrupted.
+*/
+static int
+rect_tree_contains_component(RECT_NODE *n1, RECT_NODE *n2, const POINTARRAY **last_pa)
+{
+	int i, rv;
+
+	if (!rect_node_intersects(n1, n2))
+		return LW_FALSE;
+
+	LW_ON_INTERRUPT(return -1);
+
+	if (rect_node_is_leaf(n2))
+	{
+		const RECT_NODE_LEAF *leaf = &n2->l;
+		int pt_num = leaf->seg_type == RECT_NODE_SEG_CIRCULAR ? 2 * leaf->seg_num : leaf->seg_num;
+
+		if (leaf->pa == *last_pa)
+			return LW_FALSE;
+		*last_pa = leaf->pa;
+		return rect_tree_contains_point(n1, getPoint2d_cp(leaf->pa, pt_num));
+	}
+
+	for (i = 0; i < n2->i.num_nodes; i++)
+	{
+		rv = rect_tree_contains_component(n1, n2->i.nodes[i], last_pa);
+		if (rv)
+			return rv;
+	}
+	return LW_FALSE;
+}
+
+/*
+* Either tree an area holding some component of the other one?
+* Returns -1 when interrupted.
+*/
+static int
+rect_tree_contains_either(RECT_NODE *n1, RECT_NODE *n2)
+{
+	const POINTARRAY *last_pa = NULL;
+	int rv;
+
+	if (rect_tree_is_area(n1))
+	{
+		rv = rect_tree_contains_component(n1, n2, &last_pa);
+		if (rv)
+			return rv;
+	}
+
+	last_pa = NULL;
+	if (rect_tree_is_area(n2))
+	{
+		rv = rect_tree_contains_component(n2, n1, &last_pa);
+		if (rv)
+			return rv;
+	}
+
+	return LW_FALSE;
+}
+
 #if POSTGIS_DEBUG_LEVEL >= 4
 static char *
 rect_node_to_str(const RECT_NODE *n)
@@ -925,11 +1045,12 @@ rect_node_to_str(const RECT_NODE *n)
 /*
 * Work down to leaf nodes, until we find a pair of leaf nodes
 * that intersect. Prune branches that do not intersect.
+* Returns -1 when interrupted.
 */
 static int
 rect_tree_intersects_tree_recursive(RECT_NODE *n1, RECT_NODE *n2)
 {
-	int i, j;
+	int i, j, rv;
 #if POSTGIS_DEBUG_LEVEL >= 4
 	char *n1_str = rect_node_to_str(n1);
 	char *n2_str = rect_node_to_str(n2);
@@ -941,6 +1062,7 @@ rect_tree_intersects_tree_recursive(RECT_NODE *n1, RECT_NODE *n2)
 	if (rect_node_intersects(n1, n2))
 	{
 		LWDEBUG(4," interaction found");
+		LW_ON_INTERRUPT(return -1);
 		/* We can only test for a true intersection if the nodes are both leaf nodes */
 		if (rect_node_is_leaf(n1) && rect_node_is_leaf(n2))
 		{
@@ -952,16 +1074,18 @@ rect_tree_intersects_tree_recursive(RECT_NODE *n1, RECT_NODE *n2)
 		{
 			for (i = 0; i < n1->i.num_nodes; i++)
 			{
-				if (rect_tree_intersects_tree_recursive(n1->i.nodes[i], n2))
-					return LW_TRUE;
+				rv = rect_tree_intersects_tree_recursive(n1->i.nodes[i], n2);
+				if (rv)
+					return rv;
 			}
 		}
 		else if (rect_node_is_leaf(n1) && !rect_node_is_leaf(n2))
 		{
 			for (i = 0; i < n2->i.num_nodes; i++)
 			{
-				if (rect_tree_intersects_tree_recursive(n2->i.nodes[i], n1))
-					return LW_TRUE;
+				rv = rect_tree_intersects_tree_recursive(n2->i.nodes[i], n1);
+				if (rv)
+					return rv;
 			}
 		}
 		else
@@ -970,8 +1094,9 @@ rect_tree_intersects_tree_recursive(RECT_NODE *n1, RECT_NODE *n2)
 			{
 				for (i = 0; i < n2->i.num_nodes; i++)
 				{
-					if (rect_tree_intersects_tree_recursive(n2->i.nodes[i], n1->i.nodes[j]))
-						return LW_TRUE;
+					rv = rect_tree_intersects_tree_recursive(n2->i.nodes[i], n1->i.nodes[j]);
+					if (rv)
+						return rv;
 				}
 			}
 		}
@@ -983,23 +1108,17 @@ rect_tree_intersects_tree_recursive(RECT_NODE *n1, RECT_NODE *n2)
 int
 rect_tree_intersects_tree(RECT_NODE *n1, RECT_NODE *n2)
 {
+	int rv;
+
 	/*
 	* It is possible for an area to intersect another object
 	* without any edges intersecting, if the object is fully contained.
-	* If that is so, then any point in the object will be contained,
-	* so we do a quick point-in-poly test first for those cases
+	* If that is so, then any point of a contained component will be
+	* contained, so we do quick point-in-poly tests first for those cases
 	*/
-	if (rect_tree_is_area(n1) &&
-		rect_tree_contains_point(n1, rect_tree_get_point(n2)))
-	{
-		return LW_TRUE;
-	}
-
-	if (rect_tree_is_area(n2) &&
-		rect_tree_contains_point(n2, rect_tree_get_point(n1)))
-	{
-		return LW_TRUE;
-	}
+	rv = rect_tree_contains_either(n1, n2);
+	if (rv)
+		return rv;
 
 	/*
 	* Not contained, so intersection can only happen if
@@ -1289,6 +1408,9 @@ rect_tree_distance_tree_recursive(RECT_NODE *n1, RECT_NODE *n2, RECT_TREE_DISTAN
 	if (state->min_dist < state->threshold || state->min_dist == 0.0)
 		return state->min_dist;
 
+	/* A negative minimum short circuits all the other pairs as well */
+	LW_ON_INTERRUPT(state->min_dist = -1.0; return -1.0);
+
 	/* If your minimum is greater than anyone's maximum, you can't hold the winner */
 	min = rect_node_min_distance(n1, n2);
 	if (min > state->max_dist)
@@ -1349,29 +1471,24 @@ double rect_tree_distance_tree(RECT_NODE *n1, RECT_NODE *n2, double threshold)
 {
 	double distance;
 	RECT_TREE_DISTANCE_STATE state;
+	int rv;
 
 	/*
 	* It is possible for an area to intersect another object
 	* without any edges intersecting, if the object is fully contained.
-	* If that is so, then any point in the object will be contained,
-	* so we do a quick point-in-poly test first for those cases
+	* If that is so, then any point of a contained component will be
+	* contained, so we do quick point-in-poly tests first for those cases
 	*/
-	if (rect_tree_is_area(n1) &&
-		rect_tree_contains_point(n1, rect_tree_get_point(n2)))
-	{
-		return 0.0;
-	}
-
-	if (rect_tree_is_area(n2) &&
-		rect_tree_contains_point(n2, rect_tree_get_point(n1)))
-	{
-		return 0.0;
-	}
+	rv = rect_tree_contains_either(n1, n2);
+	if (rv)
+		return rv < 0 ? -1.0 : 0.0;
 
 	state.threshold = threshold;
 	state.min_dist = FLT_MAX;
 	state.max_dist = FLT_MAX;
 	distance = rect_tree_distance_tree_recursive(n1, n2, &state);
+	if (state.min_dist < 0.0)
+		return -1.0;
 	// *p1 = state.p1;
 	// *p2 = state.p2;
 	return distance;
@@ -94,11 +94,13 @@ RECT_NODE * rect_tree_from_lwgeom(const LWGEOM *geom);
 
 /**
 * Test if two RECT_NODE trees intersect one another.
+* Returns -1 when interrupted.
 */
 int rect_tree_intersects_tree(RECT_NODE *tree1, RECT_NODE *tree2);
 
 /**
 * Return the distance between two RECT_NODE trees.
+* Returns -1.0 when interrupted.
 */
 double rect_tree_distance_tree(RECT_NODE *n1, RECT_NODE *n2, double threshold);
 
@@ -12,6 +12,12 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "access/hash.h"
+#include "access/tuptoaster.h"
+#include "lib/ilist.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
 
 #include "../postgis_config.h"
 #include "lwgeom_cache.h"
@@ -21,7 +27,7 @@
 * the following kinds of objects:
 *
 *   geometries-with-trees
-*      PreparedGeometry, RTree, CIRC_TREE, RECT_TREE
+*      PreparedGeometry, PIP_INDEX, CIRC_TREE, RECT_TREE
 *   srids-with-projections
 *      projPJ
 *
@@ -47,6 +53,95 @@ typedef struct {
 	GenericCache* entry[NUM_CACHE_ENTRIES];
 } GenericCacheCollection;
 
+/*
+* The geometries-with-trees slots hold a small array of
+* GeomCache entries rather than a single one, so that a
+* call site alternating between a handful of geometries
+* (the outer side of a spatial join) keeps their trees warm.
+* The entries are kept in recency order, most recently used
+* first, and the last one is recycled when the list is full.
+*/
+typedef struct {
+	int type;
+	int size;
+	int count;
+	uint32 varlena_args; /* Bit mask of the varlena arguments of the call */
+	GeomCache* entry[1];
+} GeomCacheList;
+
+/*
+* An argument being looked up in the cache, with the TOAST
+* identity of the datum it was read from, if any.
+*/
+typedef struct {
+	const GSERIALIZED* geom;
+	size_t size;
+	Oid toastrelid;
+	Oid valueid;
+} GeomCacheArg;
+
+/*
+* Maximum number of GeomCache entries per call site and
+* tree type (postgis.geom_cache_size).
+*/
+int postgis_geom_cache_size = GEOM_CACHE_SIZE_DEFAULT;
+
+/*
+* Hit/miss/eviction counters, for the whole backend.
+*/
+static GeomCacheCounters GeomCacheStats[NUM_CACHE_ENTRIES];
+
+/*
+* Session-wide cache of prepared/indexed geometries. The call
+* site caches above live as long as one execution of a statement,
+* so a statement run over and over with the same geometry
+* parameter would rebuild its tree every time. When enabled, the
+* trees are built here instead and outlive the statements, keyed
+* by the content hash of their geometry, until the least recently
+* used ones are evicted to stay within postgis.session_geom_cache_mem.
+* The call site entries remember the id of the session entry they
+* were matched with, so that only the first lookup of a statement
+* compares the geometry bytes.
+*/
+int postgis_session_geom_cache_mem = 0;
+
+typedef struct {
+	int type;
+	uint64 hash;
+} SessionGeomCacheTag;
+
+typedef struct {
+	SessionGeomCacheTag tag; /* Hash key, must be first */
+	uint64 id;
+	const GeomCacheMethods* methods;
+	MemoryContext context;   /* Holds the geometry, the cache object and its tree */
+	GSERIALIZED* geom;
+	GeomCache* cache;
+	Size charge;
+	dlist_node lru;
+} SessionGeomCacheEntry;
+
+#define SESSION_GEOM_CACHE_HASH_SIZE 64
+
+static MemoryContext SessionGeomCacheContext = NULL;
+static HTAB* SessionGeomCacheHash = NULL;
+static dlist_head SessionGeomCacheLRU = DLIST_STATIC_INIT(SessionGeomCacheLRU);
+static Size SessionGeomCacheCharge = 0;
+static int SessionGeomCacheEntries = 0;
+static uint64 SessionGeomCacheNextId = 1;
+static GeomCacheCounters SessionGeomCacheStats;
+
+/*
+* Session entry handed out by the last lookup, and the one a
+* call holds while looking up its other argument, which must not
+* be evicted to make room. Entries are known by id, so that a
+* lookup left unfinished by an error can't leave a dangling pin.
+*/
+static uint64 SessionGeomCacheReturnedId = 0;
+static Size SessionGeomCacheReturnedCharge = 0;
+static uint64 SessionGeomCachePinnedId = 0;
+static Size SessionGeomCachePinnedCharge = 0;
+
 /**
 * Utility function to read the upper memory context off a function call
 * info data.
@@ -114,76 +209,551 @@ GetPROJ4SRSCache(FunctionCallInfoData* fcinfo)
 	return cache;
 }
 
+/**
+* Find which arguments of the call are varlena values, the
+* only ones that can be TOAST pointers. We need the call
+* expression to know, without it no argument is flagged.
+*/
+static uint32
+GeomCacheVarlenaArgs(FunctionCallInfoData* fcinfo)
+{
+	uint32 mask = 0;
+	int i;
+
+	for ( i = 0; i < PG_NARGS() && i < 32; i++ )
+	{
+		Oid typid = get_fn_expr_argtype(fcinfo->flinfo, i);
+		if ( OidIsValid(typid) && get_typlen(typid) == -1 )
+			mask |= (1u << i);
+	}
+	return mask;
+}
+
+/**
+* Hash the whole serialized geometry, to find its tree in the
+* session cache. Before PostgreSQL 11 only a 32 bits hash is
+* available, which is still enough to spread the entries.
+*/
+static uint64
+GeomCacheHash(const GSERIALIZED* g, size_t size)
+{
+#if POSTGIS_PGSQL_VERSION >= 110
+	return DatumGetUInt64(hash_any_extended((const unsigned char*)g, size, 0));
+#else
+	return (uint64)DatumGetUInt32(hash_any((const unsigned char*)g, size));
+#endif
+}
+
+/**
+* Prepare an argument for lookup. When the geometry is the
+* detoasted copy of an out-of-line datum we note the TOAST
+* identity of that datum: two arguments with the same identity
+* are the same value, whatever their size, and comparing them
+* doesn't require reading them. As we are only handed the
+* detoasted geometry, the identity is kept only when there is no
+* doubt about which argument it comes from: no other argument
+* of that raw size may have been passed in line.
+*/
+static void
+GeomCacheArgInit(FunctionCallInfoData* fcinfo, uint32 varlena_args, const GSERIALIZED* g, GeomCacheArg* arg)
+{
+	int i;
+
+	arg->geom = g;
+	arg->size = g ? VARSIZE(g) : 0;
+	arg->toastrelid = InvalidOid;
+	arg->valueid = InvalidOid;
+
+	if ( ! g )
+		return;
+
+	for ( i = 0; i < PG_NARGS() && i < 32; i++ )
+	{
+		struct varlena* raw;
+		struct varatt_external toast_pointer;
+
+		if ( ! (varlena_args & (1u << i)) || PG_ARGISNULL(i) )
+			continue;
+
+		raw = (struct varlena*)DatumGetPointer(PG_GETARG_DATUM(i));
+
+		/* Not a copy, or maybe a copy of something that isn't out of line */
+		if ( (const void*)raw == (const void*)g ||
+		     ( toast_raw_datum_size(PointerGetDatum(raw)) == arg->size &&
+		       ! VARATT_IS_EXTERNAL_ONDISK(raw) ) )
+		{
+			arg->toastrelid = InvalidOid;
+			arg->valueid = InvalidOid;
+			return;
+		}
+
+		if ( ! VARATT_IS_EXTERNAL_ONDISK(raw) ||
+		     toast_raw_datum_size(PointerGetDatum(raw)) != arg->size )
+			continue;
+
+		VARATT_EXTERNAL_GET_POINTER(toast_pointer, raw);
+
+		/* Two different out-of-line values of that size, can't tell */
+		if ( OidIsValid(arg->valueid) &&
+		     ( arg->toastrelid != toast_pointer.va_toastrelid ||
+		       arg->valueid != toast_pointer.va_valueid ) )
+		{
+			arg->toastrelid = InvalidOid;
+			arg->valueid = InvalidOid;
+			return;
+		}
+		arg->toastrelid = toast_pointer.va_toastrelid;
+		arg->valueid = toast_pointer.va_valueid;
+	}
+}
+
+/**
+* Does the cached geometry match the argument? Sizes are
+* compared first, then TOAST identities, then bytes. The
+* argument identity is remembered on a byte match, so that the
+* next rows carrying the same out-of-line datum skip reading it.
+*/
+static int
+GeomCacheKeyMatch(GeomCacheKey* key, const GSERIALIZED* geom, GeomCacheArg* arg)
+{
+	if ( ! arg->geom || ! geom || key->size != arg->size )
+		return LW_FALSE;
+
+	/* Same out-of-line datum */
+	if ( OidIsValid(arg->valueid) &&
+	     key->valueid == arg->valueid &&
+	     key->toastrelid == arg->toastrelid )
+		return LW_TRUE;
+
+	if ( memcmp(geom, arg->geom, arg->size) != 0 )
+		return LW_FALSE;
+
+	if ( OidIsValid(arg->valueid) )
+	{
+		key->toastrelid = arg->toastrelid;
+		key->valueid = arg->valueid;
+	}
+	return LW_TRUE;
+}
+
+/**
+* Copy the argument geometry into a cache slot, along with
+* its key.
+*/
+static void
+GeomCacheKeyCopy(FunctionCallInfoData* fcinfo, GSERIALIZED** geom, GeomCacheKey* key, GeomCacheArg* arg)
+{
+	if ( *geom ) pfree(*geom);
+	*geom = MemoryContextAlloc(FIContext(fcinfo), arg->size);
+	memcpy(*geom, arg->geom, arg->size);
+
+	key->size = arg->size;
+	key->hashed = LW_FALSE;
+	key->hash = 0;
+	key->toastrelid = arg->toastrelid;
+	key->valueid = arg->valueid;
+	key->shared_id = 0;
+}
+
+/**
+* The content hash of a cached geometry, computed the first
+* time the session cache is searched for it.
+*/
+static uint64
+GeomCacheKeyHash(GeomCacheKey* key, const GSERIALIZED* geom)
+{
+	if ( ! key->hashed )
+	{
+		key->hash = GeomCacheHash(geom, key->size);
+		key->hashed = LW_TRUE;
+	}
+	return key->hash;
+}
+
+static Size
+SessionGeomCacheLimit(void)
+{
+	return (Size)postgis_session_geom_cache_mem * 1024;
+}
+
+/**
+* Drop a session cache entry with its tree.
+*/
+static void
+SessionGeomCacheEvict(SessionGeomCacheEntry* entry)
+{
+	SessionGeomCacheTag tag = entry->tag;
+
+	dlist_delete(&(entry->lru));
+	entry->methods->GeomIndexFreer(entry->cache);
+	MemoryContextDelete(entry->context);
+	SessionGeomCacheCharge -= entry->charge;
+	SessionGeomCacheEntries--;
+	SessionGeomCacheStats.evictions++;
+	hash_search(SessionGeomCacheHash, &tag, HASH_REMOVE, NULL);
+}
+
+/**
+* Evict least recently used entries until the cache fits in
+* the given charge. Also empties the cache once it is disabled.
+*/
+static void
+SessionGeomCacheTrim(Size limit)
+{
+	while ( SessionGeomCacheCharge > limit && ! dlist_is_empty(&SessionGeomCacheLRU) )
+		SessionGeomCacheEvict(dlist_tail_element(SessionGeomCacheEntry, lru, &SessionGeomCacheLRU));
+}
+
+/**
+* Find the session entry holding the tree for the given key
+* and geometry. The geometry bytes are only compared when the
+* key isn't already known to match that entry.
+*/
+static SessionGeomCacheEntry*
+SessionGeomCacheFind(int type, GeomCacheKey* key, const GSERIALIZED* geom)
+{
+	SessionGeomCacheTag tag;
+	SessionGeomCacheEntry* entry;
+
+	if ( ! SessionGeomCacheHash )
+		return NULL;
+
+	memset(&tag, 0, sizeof(SessionGeomCacheTag));
+	tag.type = type;
+	tag.hash = GeomCacheKeyHash(key, geom);
+	entry = (SessionGeomCacheEntry*)hash_search(SessionGeomCacheHash, &tag, HASH_FIND, NULL);
+	if ( ! entry )
+		return NULL;
+
+	if ( key->shared_id != entry->id )
+	{
+		if ( VARSIZE(entry->geom) != key->size ||
+		     memcmp(entry->geom, geom, key->size) != 0 )
+			return NULL;
+		key->shared_id = entry->id;
+	}
+
+	dlist_move_head(&SessionGeomCacheLRU, &(entry->lru));
+	return entry;
+}
+
+/**
+* Build the tree of a geometry into a new session entry. The
+* entry is built in a context under the function call context,
+* so that nothing leaks if the build fails or errors out, and
+* moved under the session context once complete. Returns NULL
+* if no tree could be built or if it would not fit.
+*/
+static SessionGeomCacheEntry*
+SessionGeomCacheAdd(FunctionCallInfoData* fcinfo, const GeomCacheMethods* cache_methods, GeomCacheKey* key, const GSERIALIZED* geom)
+{
+	SessionGeomCacheTag tag;
+	SessionGeomCacheEntry* entry;
+	MemoryContext context, old_context;
+	GSERIALIZED* copy;
+	LWGEOM* lwgeom;
+	GeomCache* cache;
+	Size charge = key->size * SESSION_GEOM_CACHE_CHARGE_FACTOR;
+	bool found;
+
+	if ( charge + SessionGeomCachePinnedCharge > SessionGeomCacheLimit() )
+		return NULL;
+
+	context = AllocSetContextCreate(FIContext(fcinfo),
+	                                "PostGIS Session Geometry Cache Entry",
+	                                ALLOCSET_DEFAULT_MINSIZE,
+	                                ALLOCSET_DEFAULT_INITSIZE,
+	                                ALLOCSET_DEFAULT_MAXSIZE);
+	old_context = MemoryContextSwitchTo(context);
+	copy = palloc(key->size);
+	memcpy(copy, geom, key->size);
+	lwgeom = lwgeom_from_gserialized(copy);
+	cache = cache_methods->GeomCacheAllocator();
+	cache->type = cache_methods->entry_number;
+
+	cache->build_geom = copy;
+
+	/* Can't build a tree on a NULL or empty */
+	if ( (!lwgeom) || lwgeom_is_empty(lwgeom) ||
+	     ! cache_methods->GeomIndexBuilder(lwgeom, cache) )
+	{
+		MemoryContextSwitchTo(old_context);
+		MemoryContextDelete(context);
+		return NULL;
+	}
+	cache->build_geom = NULL;
+	MemoryContextSwitchTo(old_context);
+
+	/* First time through? Set up the session context and hash */
+	if ( ! SessionGeomCacheHash )
+	{
+		HASHCTL ctl;
+
+		SessionGeomCacheContext = AllocSetContextCreate(TopMemoryContext,
+		                                "PostGIS Session Geometry Cache",
+		                                ALLOCSET_DEFAULT_MINSIZE,
+		                                ALLOCSET_DEFAULT_INITSIZE,
+		                                ALLOCSET_DEFAULT_MAXSIZE);
+		memset(&ctl, 0, sizeof(HASHCTL));
+		ctl.keysize = sizeof(SessionGeomCacheTag);
+		ctl.entrysize = sizeof(SessionGeomCacheEntry);
+		ctl.hash = tag_hash;
+		ctl.hcxt = SessionGeomCacheContext;
+		SessionGeomCacheHash = hash_create("PostGIS Session Geometry Cache Hash",
+		                                   SESSION_GEOM_CACHE_HASH_SIZE, &ctl,
+		                                   (HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT));
+	}
+
+	/* A different geometry with the same hash gives way */
+	memset(&tag, 0, sizeof(SessionGeomCacheTag));
+	tag.type = cache_methods->entry_number;
+	tag.hash = GeomCacheKeyHash(key, geom);
+	entry = (SessionGeomCacheEntry*)hash_search(SessionGeomCacheHash, &tag, HASH_FIND, NULL);
+	if ( entry && entry->id == SessionGeomCachePinnedId )
+	{
+		MemoryContextDelete(context);
+		return NULL;
+	}
+	if ( entry )
+		SessionGeomCacheEvict(entry);
+
+	/* Make room */
+	SessionGeomCacheTrim(SessionGeomCacheLimit() - charge);
+
+	entry = (SessionGeomCacheEntry*)hash_search(SessionGeomCacheHash, &tag, HASH_ENTER, &found);
+	entry->id = SessionGeomCacheNextId++;
+	entry->methods = cache_methods;
+	entry->context = context;
+	entry->geom = copy;
+	entry->cache = cache;
+	entry->charge = charge;
+	MemoryContextSetParent(context, SessionGeomCacheContext);
+	dlist_push_head(&SessionGeomCacheLRU, &(entry->lru));
+	SessionGeomCacheCharge += charge;
+	SessionGeomCacheEntries++;
+	SessionGeomCacheStats.misses++;
+
+	key->shared_id = entry->id;
+	return entry;
+}
+
+/**
+* Return the session cache tree for the argument-th argument of
+* a call site entry, or NULL if there is none. With build set,
+* a missing tree is built.
+*
+* Session entries are shared by all call sites and arguments, so
+* what is returned is the copy kept by the call site entry, with
+* its own argument number.
+*/
+static GeomCache*
+SessionGeomCacheGet(FunctionCallInfoData* fcinfo, const GeomCacheMethods* cache_methods, GeomCache* cache, int argnum, int build)
+{
+	SessionGeomCacheEntry* entry;
+	GeomCacheKey* key = argnum == 1 ? &(cache->key1) : &(cache->key2);
+	const GSERIALIZED* geom = argnum == 1 ? cache->geom1 : cache->geom2;
+
+	if ( cache->shared )
+		cache->shared->argnum = 0;
+
+	entry = SessionGeomCacheFind(cache_methods->entry_number, key, geom);
+	if ( entry )
+		SessionGeomCacheStats.hits++;
+	else if ( build )
+		entry = SessionGeomCacheAdd(fcinfo, cache_methods, key, geom);
+
+	if ( ! entry )
+		return NULL;
+
+	if ( ! cache->shared )
+		cache->shared = MemoryContextAlloc(FIContext(fcinfo), cache_methods->cache_size);
+	memcpy(cache->shared, entry->cache, cache_methods->cache_size);
+	cache->shared->argnum = argnum;
+	SessionGeomCacheReturnedId = entry->id;
+	SessionGeomCacheReturnedCharge = entry->charge;
+	return cache->shared;
+}
+
+/**
+* Which argument the tree of a call site entry is for, be it
+* its own or one from the session cache, 0 if it has none.
+*/
+static int
+GeomCacheTreeArgnum(const GeomCache* cache)
+{
+	if ( cache->argnum )
+		return cache->argnum;
+	return cache->shared ? cache->shared->argnum : 0;
+}
+
+/**
+* Get the list of GeomCache entries of the given type off the
+* statement, allocating a new empty one if we don't have one
+* already. The list size is fixed at allocation time.
+*/
+static GeomCacheList*
+GetGeomCacheList(FunctionCallInfoData* fcinfo, int entry_number)
+{
+	GenericCacheCollection* generic_cache = GetGenericCacheCollection(fcinfo);
+	GeomCacheList* list = (GeomCacheList*)(generic_cache->entry[entry_number]);
+
+	if ( ! list )
+	{
+		int size = postgis_geom_cache_size;
+		if ( size < 1 ) size = 1;
+
+		/* Allocate in the upper context */
+		list = MemoryContextAllocZero(FIContext(fcinfo),
+		              offsetof(GeomCacheList, entry) + size * sizeof(GeomCache*));
+		list->type = entry_number;
+		list->size = size;
+		list->count = 0;
+		list->varlena_args = GeomCacheVarlenaArgs(fcinfo);
+
+		/* Store the pointer in GenericCache */
+		generic_cache->entry[entry_number] = (GenericCache*)list;
+	}
+	return list;
+}
+
+/**
+* Move the n-th entry of the list to the front, making it
+* the most recently used one.
+*/
+static void
+GeomCacheListTouch(GeomCacheList* list, int n)
+{
+	GeomCache* cache = list->entry[n];
+	if ( n > 0 )
+	{
+		memmove(&(list->entry[1]), &(list->entry[0]), n * sizeof(GeomCache*));
+		list->entry[0] = cache;
+	}
+}
+
+/**
+* Free the index/tree and the supporting geometries of an
+* entry, leaving the cache keys allocated for reuse.
+*/
+static void
+GeomCacheClear(const GeomCacheMethods* cache_methods, GeomCache* cache)
+{
+	if ( cache->argnum )
+	{
+		cache_methods->GeomIndexFreer(cache);
+		cache->argnum = 0;
+	}
+	if ( cache->shared )
+		cache->shared->argnum = 0;
+	if ( cache->lwgeom1 )
+	{
+		lwgeom_free(cache->lwgeom1);
+		cache->lwgeom1 = 0;
+	}
+	if ( cache->lwgeom2 )
+	{
+		lwgeom_free(cache->lwgeom2);
+		cache->lwgeom2 = 0;
+	}
+}
+
 /**
 * Get an appropriate (based on the entry type number)
 * GeomCache entry from the generic cache if one exists.
 * Returns a cache pointer if there is a cache hit and we have an
 * index built and ready to use. Returns NULL otherwise.
+*
+* Every call site keeps up to postgis.geom_cache_size entries
+* of each type. On a miss the least recently used entry is
+* recycled to hold the new arguments.
+*
+* g1 and g2 must be (detoasted) arguments of the call, as
+* their TOAST identity is read off the call arguments.
 */
 GeomCache*
 GetGeomCache(FunctionCallInfoData* fcinfo, const GeomCacheMethods* cache_methods, const GSERIALIZED* g1, const GSERIALIZED* g2)
 {
-	GeomCache* cache;
+	GeomCache* cache = NULL;
+	GeomCacheList* list;
+	GeomCacheArg arg1, arg2;
 	int cache_hit = 0;
+	int i;
 	MemoryContext old_context;
-	const GSERIALIZED *geom;
-	GenericCacheCollection* generic_cache = GetGenericCacheCollection(fcinfo);
+	const GSERIALIZED *geom = NULL;
 	int entry_number = cache_methods->entry_number;
 
 	Assert(entry_number >= 0);
 	Assert(entry_number < NUM_CACHE_ENTRIES);
 
-	cache = (GeomCache*)(generic_cache->entry[entry_number]);
+	/* Shrink or empty the session cache after a change of setting */
+	if ( SessionGeomCacheCharge > SessionGeomCacheLimit() )
+		SessionGeomCacheTrim(SessionGeomCacheLimit());
 
-	if ( ! cache )
+	list = GetGeomCacheList(fcinfo, entry_number);
+	GeomCacheArgInit(fcinfo, list->varlena_args, g1, &arg1);
+	GeomCacheArgInit(fcinfo, list->varlena_args, g2, &arg2);
+
+	/* Look for a hit on either argument, most recently used entries first */
+	for ( i = 0; i < list->count; i++ )
+	{
+		cache = list->entry[i];
+
+		/* Cache hit on the first argument */
+		if ( g1 &&
+		     GeomCacheTreeArgnum(cache) != 2 &&
+		     GeomCacheKeyMatch(&(cache->key1), cache->geom1, &arg1) )
+		{
+			cache_hit = 1;
+			geom = cache->geom1;
+			break;
+		}
+		/* Cache hit on second argument */
+		else if ( g2 &&
+		          GeomCacheTreeArgnum(cache) != 1 &&
+		          GeomCacheKeyMatch(&(cache->key2), cache->geom2, &arg2) )
+		{
+			cache_hit = 2;
+			geom = cache->geom2;
+			break;
+		}
+	}
+
+	if ( cache_hit )
+	{
+		GeomCacheStats[entry_number].hits++;
+	}
+	/* No cache hit, take a fresh entry if there is room left */
+	else if ( list->count < list->size )
 	{
+		GeomCacheStats[entry_number].misses++;
 		old_context = MemoryContextSwitchTo(FIContext(fcinfo));
 		/* Allocate in the upper context */
 		cache = cache_methods->GeomCacheAllocator();
 		MemoryContextSwitchTo(old_context);
-		/* Store the pointer in GenericCache */
 		cache->type = entry_number;
-		generic_cache->entry[entry_number] = (GenericCache*)cache;
+		i = list->count++;
+		list->entry[i] = cache;
 	}
-
-	/* Cache hit on the first argument */
-	if ( g1 &&
-	     cache->argnum != 2 &&
-	     cache->geom1_size == VARSIZE(g1) &&
-	     memcmp(cache->geom1, g1, cache->geom1_size) == 0 )
-	{
-		cache_hit = 1;
-		geom = cache->geom1;
-
-	}
-	/* Cache hit on second argument */
-	else if ( g2 &&
-	          cache->argnum != 1 &&
-	          cache->geom2_size == VARSIZE(g2) &&
-	          memcmp(cache->geom2, g2, cache->geom2_size) == 0 )
+	/* No cache hit and no room, recycle the least recently used entry. */
+	/* If it has a tree, free it. */
+	else
 	{
-		cache_hit = 2;
-		geom = cache->geom2;
+		GeomCacheStats[entry_number].misses++;
+		GeomCacheStats[entry_number].evictions++;
+		i = list->count - 1;
+		cache = list->entry[i];
+		GeomCacheClear(cache_methods, cache);
 	}
-	/* No cache hit. If we have a tree, free it. */
-	else
+	GeomCacheListTouch(list, i);
+
+	/* Cache hit, with the session cache enabled: the tree lives there */
+	if ( cache_hit && ! cache->argnum && postgis_session_geom_cache_mem > 0 )
 	{
-		cache_hit = 0;
-		if ( cache->argnum )
-		{
-			cache_methods->GeomIndexFreer(cache);
-			cache->argnum = 0;
-		}
-		if ( cache->lwgeom1 )
-		{
-			lwgeom_free(cache->lwgeom1);
-			cache->lwgeom1 = 0;
-		}
-		if ( cache->lwgeom2 )
-		{
-			lwgeom_free(cache->lwgeom2);
-			cache->lwgeom2 = 0;
-		}
+		GeomCache* shared = SessionGeomCacheGet(fcinfo, cache_methods, cache, cache_hit, LW_TRUE);
+
+		/* Otherwise the tree doesn't fit, build it here as usual */
+		if ( shared )
+			return shared;
 	}
 
 	/* Cache hit, but no tree built yet, build it! */
@@ -204,7 +774,9 @@ GetGeomCache(FunctionCallInfoData* fcinfo, const GeomCacheMethods* cache_methods
 			MemoryContextSwitchTo(old_context);
 			return NULL;
 		}
+		cache->build_geom = geom;
 		rv = cache_methods->GeomIndexBuilder(lwgeom, cache);
+		cache->build_geom = NULL;
 		MemoryContextSwitchTo(old_context);
 
 		/* Something went awry in the tree build phase */
@@ -221,22 +793,97 @@ GetGeomCache(FunctionCallInfoData* fcinfo, const GeomCacheMethods* cache_methods
 
 	/* Argument one didn't match, so copy the new value in. */
 	if ( g1 && cache_hit != 1 )
-	{
-		if ( cache->geom1 ) pfree(cache->geom1);
-		cache->geom1_size = VARSIZE(g1);
-		cache->geom1 = MemoryContextAlloc(FIContext(fcinfo), cache->geom1_size);
-		memcpy(cache->geom1, g1, cache->geom1_size);
-	}
+		GeomCacheKeyCopy(fcinfo, &(cache->geom1), &(cache->key1), &arg1);
+
 	/* Argument two didn't match, so copy the new value in. */
 	if ( g2 && cache_hit != 2 )
+		GeomCacheKeyCopy(fcinfo, &(cache->geom2), &(cache->key2), &arg2);
+
+	/* A first sighting here may be a known tree in the session cache */
+	if ( ! cache_hit && postgis_session_geom_cache_mem > 0 )
 	{
-		if ( cache->geom2 ) pfree(cache->geom2);
-		cache->geom2_size = VARSIZE(g2);
-		cache->geom2 = MemoryContextAlloc(FIContext(fcinfo), cache->geom2_size);
-		memcpy(cache->geom2, g2, cache->geom2_size);
+		GeomCache* shared = NULL;
+		if ( g1 )
+			shared = SessionGeomCacheGet(fcinfo, cache_methods, cache, 1, LW_FALSE);
+		if ( ! shared && g2 )
+			shared = SessionGeomCacheGet(fcinfo, cache_methods, cache, 2, LW_FALSE);
+		return shared;
 	}
 
 	return NULL;
 }
 
+/**
+* Look up each argument of a call on its own, for callers that
+* use a tree on both sides: the trees of a join's outer and inner
+* geometries are then both kept once they repeat. On return
+* cache1 and cache2 hold the entries with a tree for the first
+* and the second argument, or NULL. Either argument may be NULL
+* to skip its lookup.
+*
+* The first tree is held while the second argument is looked up,
+* so it must not be recycled to make room: the call site list
+* needs two entries for that, and the session cache entry of the
+* first tree is pinned.
+*/
+void
+GetGeomCachePair(FunctionCallInfoData* fcinfo, const GeomCacheMethods* cache_methods, const GSERIALIZED* g1, const GSERIALIZED* g2, GeomCache** cache1, GeomCache** cache2)
+{
+	GeomCacheList* list = GetGeomCacheList(fcinfo, cache_methods->entry_number);
+
+	*cache1 = NULL;
+	*cache2 = NULL;
+	SessionGeomCachePinnedId = 0;
+	SessionGeomCachePinnedCharge = 0;
+
+	if ( g1 )
+	{
+		SessionGeomCacheReturnedId = 0;
+		*cache1 = GetGeomCache(fcinfo, cache_methods, g1, NULL);
+	}
+
+	if ( ! g2 || ( *cache1 && list->size < 2 ) )
+		return;
+
+	if ( *cache1 && SessionGeomCacheReturnedId )
+	{
+		SessionGeomCachePinnedId = SessionGeomCacheReturnedId;
+		SessionGeomCachePinnedCharge = SessionGeomCacheReturnedCharge;
+	}
+	*cache2 = GetGeomCache(fcinfo, cache_methods, NULL, g2);
+	SessionGeomCachePinnedId = 0;
+	SessionGeomCachePinnedCharge = 0;
+}
+
+/**
+* Read the backend-wide usage counters of a cache entry type.
+*/
+const GeomCacheCounters*
+GetGeomCacheCounters(int entry_number)
+{
+	Assert(entry_number >= 0);
+	Assert(entry_number < NUM_CACHE_ENTRIES);
+	return &(GeomCacheStats[entry_number]);
+}
 
+/**
+* Zero the backend-wide usage counters of all cache entry types.
+*/
+void
+ResetGeomCacheCounters(void)
+{
+	memset(GeomCacheStats, 0, sizeof(GeomCacheStats));
+	memset(&SessionGeomCacheStats, 0, sizeof(SessionGeomCacheStats));
+}
+
+/**
+* Read the counters, number of entries and charged memory of
+* the session cache.
+*/
+void
+GetSessionGeomCacheUsage(GeomCacheCounters* counters, int* entries, Size* charge)
+{
+	*counters = SessionGeomCacheStats;
+	*entries = SessionGeomCacheEntries;
+	*charge = SessionGeomCacheCharge;
+}
@@ -23,33 +23,74 @@
 
 #define PROJ_CACHE_ENTRY 0
 #define PREP_CACHE_ENTRY 1
-#define RTREE_CACHE_ENTRY 2
 #define CIRC_CACHE_ENTRY 3
 #define RECT_CACHE_ENTRY 4
+#define PIP_CACHE_ENTRY 5
 
 #define NUM_CACHE_ENTRIES 16
 
+/*
+* Number of geometries-with-trees kept per call site and per
+* tree type, settable through the postgis.geom_cache_size GUC.
+*/
+#define GEOM_CACHE_SIZE_DEFAULT 8
+#define GEOM_CACHE_SIZE_MAX 1024
+
+extern int postgis_geom_cache_size;
 
 /*
-* A generic GeomCache just needs space for the cache type,
-* the cache keys (GSERIALIZED geometries), the key sizes,
-* and the argument number the cached index/tree is going
-* to refer to.
+* Memory, in kB, of the session-wide cache of prepared/indexed
+* geometries (postgis.session_geom_cache_mem), 0 to disable it.
+* Entries are charged an estimate of their footprint, that many
+* times the size of their serialized geometry.
+*/
+#define SESSION_GEOM_CACHE_CHARGE_FACTOR 4
+
+extern int postgis_session_geom_cache_mem;
+
+/*
+* What we know about a cached geometry to tell whether an
+* argument is the same value without reading all of it: its
+* size and, when the value came from an out-of-line TOAST
+* datum, the identity of that datum. The hash of its contents
+* is only computed to look it up in the session cache.
 */
 typedef struct {
+	size_t                      size;
+	int                         hashed;
+	uint64                      hash;
+	Oid                         toastrelid;
+	Oid                         valueid;
+	uint64                      shared_id; /* Session cache entry known to hold the same geometry */
+} GeomCacheKey;
+
+/*
+* A generic GeomCache just needs space for the cache type,
+* the cache keys (GSERIALIZED geometries), the key sizes
+* and hashes, and the argument number the cached index/tree
+* is going to refer to.
+*
+* A call site entry whose tree lives in the session cache keeps
+* a copy of the shared cache object in shared, with the argument
+* number of this call site: the shared object itself may serve
+* either argument of any call site.
+*/
+typedef struct GeomCache {
 	int                         type;
 	GSERIALIZED*                geom1;
 	GSERIALIZED*                geom2;
-	size_t                      geom1_size;
-	size_t                      geom2_size;
+	GeomCacheKey                key1;
+	GeomCacheKey                key2;
 	LWGEOM*                     lwgeom1;
 	LWGEOM*                     lwgeom2;
 	int32                       argnum;
+	const GSERIALIZED*          build_geom; /* Serialized geometry being indexed, while in GeomIndexBuilder */
+	struct GeomCache*           shared; /* Copy of the session cache tree this entry uses, or NULL */
 } GeomCache;
 
 /*
 * Other specific geometry cache types are the
-* RTreeGeomCache - lwgeom_rtree.h
+* PipGeomCache - lwgeom_rtree.h
 * PrepGeomCache - lwgeom_geos_prepared.h
 */
 
@@ -98,12 +139,32 @@ typedef struct
 	int (*GeomIndexBuilder)(const LWGEOM* lwgeom, GeomCache* cache); /* Build an index/tree and add it to your cache */
 	int (*GeomIndexFreer)(GeomCache* cache); /* Free the index/tree in your cache */
 	GeomCache* (*GeomCacheAllocator)(void); /* Allocate the kind of cache object you use (GeomCache+some extra space) */
+	size_t cache_size; /* Size of the kind of cache object you use, to copy session cache trees */
 } GeomCacheMethods;
 
+/*
+* Backend-wide usage counters of the geometries-with-trees
+* caches, one set per cache entry type.
+*/
+typedef struct
+{
+	int64 hits;      /* Argument found in the cache */
+	int64 misses;    /* Argument not found, copied into a cache slot */
+	int64 evictions; /* Least recently used slot recycled for a miss */
+} GeomCacheCounters;
+
 /*
 * Cache retrieval functions
 */
 PROJ4PortalCache*  GetPROJ4SRSCache(FunctionCallInfoData *fcinfo);
 GeomCache*         GetGeomCache(FunctionCallInfoData *fcinfo, const GeomCacheMethods* cache_methods, const GSERIALIZED* g1, const GSERIALIZED* g2);
+void               GetGeomCachePair(FunctionCallInfoData *fcinfo, const GeomCacheMethods* cache_methods, const GSERIALIZED* g1, const GSERIALIZED* g2, GeomCache** cache1, GeomCache** cache2);
+
+/*
+* Cache usage counters
+*/
+const GeomCacheCounters* GetGeomCacheCounters(int entry_number);
+void               ResetGeomCacheCounters(void);
+void               GetSessionGeomCacheUsage(GeomCacheCounters* counters, int* entries, Size* charge);
 
 #endif /* LWGEOM_CACHE_H_ */
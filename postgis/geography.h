@@ -37,3 +37,10 @@ void geography_valid_type(uint8_t type);
 /* Expand the embedded bounding box in a #GSERIALIZED */
 GSERIALIZED* gserialized_expand(GSERIALIZED *g, double distance);
 
+/* Builtin planar SRID best suited to work on data inside a geocentric box */
+int geography_gbox_bestsrid(const GBOX *gbox);
+
+/* Algorithms of the spheroidal ST_Area(geography), see postgis.geography_area_algorithm */
+#define GEOGRAPHY_AREA_GEODESIC 0
+#define GEOGRAPHY_AREA_AUTHALIC 1
+extern int postgis_geography_area_algorithm;
@@ -0,0 +1,179 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#include "postgres.h"
+#include "catalog/pg_type.h"
+#include "utils/array.h"
+
+#include "../postgis_config.h"
+
+#include "liblwgeom.h"         /* For standard geometry types. */
+#include "lwgeom_pg.h"       /* For debugging macros. */
+#include "geography.h"	     /* For utility functions. */
+#include "lwgeodetic_cell.h"
+
+Datum geography_cell_id(PG_FUNCTION_ARGS);
+Datum geography_cell_covering(PG_FUNCTION_ARGS);
+Datum geography_cell_interior_covering(PG_FUNCTION_ARGS);
+Datum geography_cell_range_min(PG_FUNCTION_ARGS);
+Datum geography_cell_range_max(PG_FUNCTION_ARGS);
+Datum geography_cell_boundary(PG_FUNCTION_ARGS);
+
+/*
+* Cell ids travel as bigint. Cells of the last two faces come out
+* negative, which keeps the descendants of a cell contiguous all
+* the same.
+*/
+#define CellIdGetDatum(id) Int64GetDatum((int64)(id))
+#define PG_GETARG_CELL_ID(n) ((CELL_ID)PG_GETARG_INT64(n))
+#define PG_RETURN_CELL_ID(id) PG_RETURN_INT64((int64)(id))
+
+static int
+geography_cell_level_arg(FunctionCallInfo fcinfo, int n)
+{
+	int level = PG_GETARG_INT32(n);
+	if ( level < 0 || level > CELL_MAX_LEVEL )
+		elog(ERROR, "cell level must be between 0 and %d", CELL_MAX_LEVEL);
+	return level;
+}
+
+static CELL_ID
+geography_cell_arg(FunctionCallInfo fcinfo, int n)
+{
+	CELL_ID id = PG_GETARG_CELL_ID(n);
+	if ( ! cell_is_valid(id) )
+		elog(ERROR, "%lld is not a cell id", (long long)id);
+	return id;
+}
+
+/*
+** geography_cell_id(GSERIALIZED *g, int level)
+** returns the id of the cell of the given level holding a point
+*/
+PG_FUNCTION_INFO_V1(geography_cell_id);
+Datum geography_cell_id(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED *g = PG_GETARG_GSERIALIZED_P(0);
+	int level = geography_cell_level_arg(fcinfo, 1);
+	POINT4D pt;
+	POINT2D p;
+
+	if ( gserialized_get_type(g) != POINTTYPE )
+		elog(ERROR, "%s: argument is not a point", __func__);
+
+	/* Empty points are in no cell */
+	if ( ! gserialized_peek_first_point(g, &pt) )
+	{
+		PG_FREE_IF_COPY(g, 0);
+		PG_RETURN_NULL();
+	}
+	PG_FREE_IF_COPY(g, 0);
+
+	p.x = pt.x;
+	p.y = pt.y;
+	PG_RETURN_CELL_ID(cell_from_point(&p, level));
+}
+
+static Datum
+geography_cell_covering_array(FunctionCallInfo fcinfo, int interior)
+{
+	GSERIALIZED *g = PG_GETARG_GSERIALIZED_P(0);
+	int max_level = geography_cell_level_arg(fcinfo, 1);
+	int max_cells = PG_GETARG_INT32(2);
+	LWGEOM *lwgeom;
+	CELL_ID *cells;
+	uint32_t ncells, i;
+	Datum *elems;
+	ArrayType *result;
+
+	if ( max_cells < 1 )
+		elog(ERROR, "max_cells must be at least 1");
+
+	lwgeom = lwgeom_from_gserialized(g);
+	if ( LW_FAILURE == lwgeom_cell_covering(lwgeom, max_level, max_cells, interior, &cells, &ncells) )
+		elog(ERROR, "%s: unable to cover geometry", __func__);
+	lwgeom_free(lwgeom);
+	PG_FREE_IF_COPY(g, 0);
+
+	if ( ! ncells )
+		PG_RETURN_ARRAYTYPE_P(construct_empty_array(INT8OID));
+
+	elems = palloc(ncells * sizeof(Datum));
+	for ( i = 0; i < ncells; i++ )
+		elems[i] = CellIdGetDatum(cells[i]);
+	lwfree(cells);
+
+	result = construct_array(elems, ncells, INT8OID, sizeof(int64), FLOAT8PASSBYVAL, 'd');
+	pfree(elems);
+	PG_RETURN_ARRAYTYPE_P(result);
+}
+
+/*
+** geography_cell_covering(GSERIALIZED *g, int max_level, int max_cells)
+** returns the ids of cells covering the geography
+*/
+PG_FUNCTION_INFO_V1(geography_cell_covering);
+Datum geography_cell_covering(PG_FUNCTION_ARGS)
+{
+	return geography_cell_covering_array(fcinfo, LW_FALSE);
+}
+
+/*
+** geography_cell_interior_covering(GSERIALIZED *g, int max_level, int max_cells)
+** returns the ids of cells inside the (multi)polygon
+*/
+PG_FUNCTION_INFO_V1(geography_cell_interior_covering);
+Datum geography_cell_interior_covering(PG_FUNCTION_ARGS)
+{
+	return geography_cell_covering_array(fcinfo, LW_TRUE);
+}
+
+/*
+** geography_cell_range_min(int8 cell), geography_cell_range_max(int8 cell)
+** return the first and last leaf cell ids inside a cell
+*/
+PG_FUNCTION_INFO_V1(geography_cell_range_min);
+Datum geography_cell_range_min(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_CELL_ID(cell_range_min(geography_cell_arg(fcinfo, 0)));
+}
+
+PG_FUNCTION_INFO_V1(geography_cell_range_max);
+Datum geography_cell_range_max(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_CELL_ID(cell_range_max(geography_cell_arg(fcinfo, 0)));
+}
+
+/*
+** geography_cell_boundary(int8 cell)
+** returns the polygon of a cell
+*/
+PG_FUNCTION_INFO_V1(geography_cell_boundary);
+Datum geography_cell_boundary(PG_FUNCTION_ARGS)
+{
+	CELL_ID id = geography_cell_arg(fcinfo, 0);
+	LWGEOM *lwgeom = lwpoly_as_lwgeom(cell_to_lwpoly(id, SRID_DEFAULT));
+	GSERIALIZED *g;
+
+	lwgeom_add_bbox(lwgeom);
+	g = geography_serialize(lwgeom);
+	lwgeom_free(lwgeom);
+	PG_RETURN_POINTER(g);
+}
@@ -0,0 +1,208 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "utils/array.h"
+#include "access/htup_details.h"
+
+#include "../postgis_config.h"
+
+#include "liblwgeom.h"         /* For standard geometry types. */
+#include "lwgeom_pg.h"       /* For debugging macros. */
+#include "lwgeom_transform.h" /* For the spheroid of the SRID. */
+#include "lwgeodetic_knn.h"
+
+Datum geography_nearest_neighbors(PG_FUNCTION_ARGS);
+
+typedef struct
+{
+	CIRC_KNN_PAIR *pairs;
+	uint32_t npairs;
+	uint32_t i;
+	double radius; /* of the sphere, to turn radians into meters */
+} GEOGRAPHY_KNN_STATE;
+
+/*
+* Deserialize the geographies of an array, NULL for NULL elements.
+* The geometries point into the array. All must share one SRID,
+* kept in *srid as soon as there is one.
+*/
+static LWGEOM **
+geography_knn_array(ArrayType *array, uint32_t *ngeoms, int *srid)
+{
+	ArrayIterator iterator;
+	Datum value;
+	bool isnull;
+	uint32_t n = 0;
+	LWGEOM **geoms = palloc(sizeof(LWGEOM*) * (ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array)) + 1));
+
+#if POSTGIS_PGSQL_VERSION >= 95
+	iterator = array_create_iterator(array, 0, NULL);
+#else
+	iterator = array_create_iterator(array, 0);
+#endif
+	while( array_iterate(iterator, &value, &isnull) )
+	{
+		GSERIALIZED *g;
+
+		if ( isnull )
+		{
+			geoms[n++] = NULL;
+			continue;
+		}
+
+		g = (GSERIALIZED *)DatumGetPointer(value);
+		if ( *srid == SRID_UNKNOWN )
+			*srid = gserialized_get_srid(g);
+		else
+			error_if_srid_mismatch(*srid, gserialized_get_srid(g));
+		geoms[n++] = lwgeom_from_gserialized(g);
+	}
+	array_free_iterator(iterator);
+
+	*ngeoms = n;
+	return geoms;
+}
+
+static void
+geography_knn_array_free(LWGEOM **geoms, uint32_t ngeoms)
+{
+	uint32_t i;
+	for ( i = 0; i < ngeoms; i++ )
+	{
+		if ( geoms[i] )
+			lwgeom_free(geoms[i]);
+	}
+	pfree(geoms);
+}
+
+/*
+* Find all the pairs up front, into the memory of the whole call.
+*/
+static void
+geography_knn_join(FunctionCallInfo fcinfo, GEOGRAPHY_KNN_STATE *state, MemoryContext mcxt)
+{
+	ArrayType *probes = PG_GETARG_ARRAYTYPE_P(0);
+	ArrayType *candidates = PG_GETARG_ARRAYTYPE_P(1);
+	int32 k = PG_GETARG_INT32(2);
+	double max_distance = -1.0;
+	LWGEOM **probe_geoms, **candidate_geoms;
+	uint32_t nprobes, ncandidates;
+	int srid = SRID_UNKNOWN;
+	CIRC_KNN_INDEX *index;
+	MemoryContext oldcontext;
+	SPHEROID s;
+	int rv;
+
+	if ( k < 1 )
+		elog(ERROR, "%s: k must be at least 1", __func__);
+
+	if ( PG_NARGS() > 3 && ! PG_ARGISNULL(3) )
+	{
+		max_distance = PG_GETARG_FLOAT8(3);
+		if ( max_distance < 0.0 )
+			elog(ERROR, "%s: max_distance must not be negative", __func__);
+	}
+
+	probe_geoms = geography_knn_array(probes, &nprobes, &srid);
+	candidate_geoms = geography_knn_array(candidates, &ncandidates, &srid);
+
+	/* Nothing at all to measure */
+	if ( srid == SRID_UNKNOWN )
+		srid = SRID_DEFAULT;
+
+	/* Sphere of the spheroid, like the <-> operator */
+	spheroid_init_from_srid(fcinfo, srid, &s);
+	s.a = s.b = s.radius;
+	state->radius = s.radius;
+	if ( max_distance >= 0.0 )
+		max_distance /= s.radius;
+
+	index = circ_knn_index_new((const LWGEOM**)candidate_geoms, ncandidates);
+	if ( ! index )
+		elog(ERROR, "%s: interrupted", __func__);
+
+	oldcontext = MemoryContextSwitchTo(mcxt);
+	rv = circ_knn_join(index, (const LWGEOM**)probe_geoms, nprobes, k, max_distance, &(state->pairs), &(state->npairs));
+	MemoryContextSwitchTo(oldcontext);
+
+	circ_knn_index_free(index);
+	if ( rv == LW_FAILURE )
+		elog(ERROR, "%s: interrupted", __func__);
+	geography_knn_array_free(probe_geoms, nprobes);
+	geography_knn_array_free(candidate_geoms, ncandidates);
+}
+
+/*
+** geography_nearest_neighbors(geography[] probes, geography[] candidates, int k [, float8 max_distance])
+** returns the k candidates nearest to each probe, as rows of
+** (probe, candidate, distance), positions counting from 1
+*/
+PG_FUNCTION_INFO_V1(geography_nearest_neighbors);
+Datum geography_nearest_neighbors(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *funcctx;
+	GEOGRAPHY_KNN_STATE *state;
+
+	if ( SRF_IS_FIRSTCALL() )
+	{
+		MemoryContext oldcontext;
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		state = palloc0(sizeof(GEOGRAPHY_KNN_STATE));
+		funcctx->user_fctx = state;
+
+		if ( get_call_result_type(fcinfo, 0, &funcctx->tuple_desc) != TYPEFUNC_COMPOSITE )
+		{
+			ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("set-valued function called in context that cannot accept a set")));
+		}
+		BlessTupleDesc(funcctx->tuple_desc);
+
+		MemoryContextSwitchTo(oldcontext);
+
+		/* No probes, no candidates or no k, no neighbours */
+		if ( ! PG_ARGISNULL(0) && ! PG_ARGISNULL(1) && ! PG_ARGISNULL(2) )
+			geography_knn_join(fcinfo, state, funcctx->multi_call_memory_ctx);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	state = funcctx->user_fctx;
+
+	if ( state->i < state->npairs )
+	{
+		const CIRC_KNN_PAIR *pair = state->pairs + state->i++;
+		Datum values[3];
+		bool isnull[3] = {false, false, false};
+		HeapTuple tuple;
+
+		values[0] = Int32GetDatum(pair->probe + 1);
+		values[1] = Int32GetDatum(pair->candidate + 1);
+		values[2] = Float8GetDatum(pair->distance * state->radius);
+		tuple = heap_form_tuple(funcctx->tuple_desc, values, isnull);
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+	}
+
+	SRF_RETURN_DONE(funcctx);
+}
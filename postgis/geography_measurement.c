@@ -64,6 +64,30 @@ Datum geography_perimeter(PG_FUNCTION_ARGS);
 Datum geography_project(PG_FUNCTION_ARGS);
 Datum geography_azimuth(PG_FUNCTION_ARGS);
 Datum geography_segmentize(PG_FUNCTION_ARGS);
+Datum geography_densify(PG_FUNCTION_ARGS);
+
+/*
+* Distance between two point arguments, read off their serialized
+* forms without building geometries, boxes or trees. Returns
+* LW_FAILURE unless both arguments are non-empty points.
+*/
+static int
+geography_point_distance(const GSERIALIZED *g1, const GSERIALIZED *g2, const SPHEROID *s, double tolerance, double *distance)
+{
+	POINT4D pt1, pt2;
+	POINT2D p1, p2;
+
+	if ( ! gserialized_peek_first_point(g1, &pt1) ||
+	     ! gserialized_peek_first_point(g2, &pt2) )
+		return LW_FAILURE;
+
+	p1.x = pt1.x;
+	p1.y = pt1.y;
+	p2.x = pt2.x;
+	p2.y = pt2.y;
+	*distance = point2d_distance_spheroid(&p1, &p2, s, tolerance);
+	return LW_SUCCESS;
+}
 
 
 PG_FUNCTION_INFO_V1(geography_distance_knn);
@@ -91,6 +115,14 @@ Datum geography_distance_knn(PG_FUNCTION_ARGS)
 	if ( ! use_spheroid )
 		s.a = s.b = s.radius;
 
+	/* Point/point, the common recheck of nearest neighbour searches */
+	if ( LW_SUCCESS == geography_point_distance(g1, g2, &s, tolerance, &distance) )
+	{
+		PG_FREE_IF_COPY(g1, 0);
+		PG_FREE_IF_COPY(g2, 1);
+		PG_RETURN_FLOAT8(distance);
+	}
+
 	lwgeom1 = lwgeom_from_gserialized(g1);
 	lwgeom2 = lwgeom_from_gserialized(g2);
 
@@ -235,8 +267,10 @@ Datum geography_distance(PG_FUNCTION_ARGS)
 		PG_RETURN_NULL();
 	}
 
-	/* Do the brute force calculation if the cached calculation doesn't tick over */
-	if ( LW_FAILURE == geography_distance_cache(fcinfo, g1, g2, &s, &distance) )
+	/* Points need no trees, so measure them directly. Otherwise do the */
+	/* brute force calculation if the cached calculation doesn't tick over */
+	if ( LW_FAILURE == geography_point_distance(g1, g2, &s, FP_TOLERANCE, &distance) &&
+	     LW_FAILURE == geography_distance_cache(fcinfo, g1, g2, &s, &distance) )
 	{
 		/* default to using tree-based distance calculation at all times */
 		/* in standard distance call. */
@@ -312,8 +346,13 @@ Datum geography_dwithin(PG_FUNCTION_ARGS)
 		PG_RETURN_BOOL(false);
 	}
 
+	/* Points go straight to the distance calculation */
+	if ( LW_SUCCESS == geography_point_distance(g1, g2, &s, tolerance, &distance) )
+	{
+		dwithin = (distance <= tolerance);
+	}
 	/* Do the brute force calculation if the cached calculation doesn't tick over */
-	if ( LW_FAILURE == geography_dwithin_cache(fcinfo, g1, g2, &s, tolerance, &dwithin) )
+	else if ( LW_FAILURE == geography_dwithin_cache(fcinfo, g1, g2, &s, tolerance, &dwithin) )
 	{
 		LWGEOM* lwgeom1 = lwgeom_from_gserialized(g1);
 		LWGEOM* lwgeom2 = lwgeom_from_gserialized(g2);
@@ -491,6 +530,9 @@ Datum geography_expand(PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(g_out);
 }
 
+/* Set by the postgis.geography_area_algorithm GUC */
+int postgis_geography_area_algorithm = GEOGRAPHY_AREA_GEODESIC;
+
 /*
 ** geography_area(GSERIALIZED *g)
 ** returns double area in meters square
@@ -546,7 +588,9 @@ Datum geography_area(PG_FUNCTION_ARGS)
 		s.a = s.b = s.radius;
 
 	/* Calculate the area */
-	if ( use_spheroid )
+	if ( use_spheroid && postgis_geography_area_algorithm == GEOGRAPHY_AREA_AUTHALIC )
+		area = lwgeom_area_spheroid_authalic(lwgeom, &s);
+	else if ( use_spheroid )
 		area = lwgeom_area_spheroid(lwgeom, &s);
 	else
 		area = lwgeom_area_sphere(lwgeom, &s);
@@ -767,74 +811,22 @@ Datum geography_covers(PG_FUNCTION_ARGS)
 }
 
 /*
-** geography_bestsrid(GSERIALIZED *g, GSERIALIZED *g) returns int
-** Utility function. Returns negative SRID numbers that match to the
-** numbers handled in code by the transform(lwgeom, srid) function.
-** UTM, polar stereographic and mercator as fallback. To be used
-** in wrapping existing geometry functions in SQL to provide access
-** to them in the geography module.
+** Best planar SRID for working on data inside a geocentric box, one of
+** the builtin SRIDs handled by the transform(lwgeom, srid) function.
+** Lambert azimuthal at the poles, UTM, zoned LAEA and mercator as
+** fallback.
 */
-PG_FUNCTION_INFO_V1(geography_bestsrid);
-Datum geography_bestsrid(PG_FUNCTION_ARGS)
+int
+geography_gbox_bestsrid(const GBOX *gbox)
 {
-	GBOX gbox, gbox1, gbox2;
-	GSERIALIZED *g1 = NULL;
-	GSERIALIZED *g2 = NULL;
-	int empty1 = LW_FALSE;
-	int empty2 = LW_FALSE;
 	double xwidth, ywidth;
 	POINT2D center;
 
-	Datum d1 = PG_GETARG_DATUM(0);
-	Datum d2 = PG_GETARG_DATUM(1);
-
-	/* Get our geometry objects loaded into memory. */
-	g1 = (GSERIALIZED*)PG_DETOAST_DATUM(d1);
-	/* Synchronize our box types */
-	gbox1.flags = g1->flags;
-	/* Calculate if the geometry is empty. */
-	empty1 = gserialized_is_empty(g1);
-	/* Calculate a geocentric bounds for the objects */
-	if ( ! empty1 && gserialized_get_gbox_p(g1, &gbox1) == LW_FAILURE )
-		elog(ERROR, "Error in geography_bestsrid calling gserialized_get_gbox_p(g1, &gbox1)");
-
-	POSTGIS_DEBUGF(4, "calculated gbox = %s", gbox_to_string(&gbox1));
-
-	/* If we have a unique second argument, fill in all the necessary variables. */
-	if ( d1 != d2 )
-	{
-		g2 = (GSERIALIZED*)PG_DETOAST_DATUM(d2);
-		gbox2.flags = g2->flags;
-		empty2 = gserialized_is_empty(g2);
-		if ( ! empty2 && gserialized_get_gbox_p(g2, &gbox2) == LW_FAILURE )
-			elog(ERROR, "Error in geography_bestsrid calling gserialized_get_gbox_p(g2, &gbox2)");
-	}
-	/*
-	** If no unique second argument, copying the box for the first
-	** argument will give us the right answer for all subsequent tests.
-	*/
-	else
-	{
-		gbox = gbox2 = gbox1;
-	}
-
-	/* Both empty? We don't have an answer. */
-	if ( empty1 && empty2 )
-		PG_RETURN_NULL();
-
-	/* One empty? We can use the other argument values as infill. Otherwise merge the boxen */
-	if ( empty1 )
-		gbox = gbox2;
-	else if ( empty2 )
-		gbox = gbox1;
-	else
-		gbox_union(&gbox1, &gbox2, &gbox);
-
-	gbox_centroid(&gbox, &center);
+	gbox_centroid(gbox, &center);
 
 	/* Width and height in degrees */
-	xwidth = 180.0 * gbox_angular_width(&gbox)  / M_PI;
-	ywidth = 180.0 * gbox_angular_height(&gbox) / M_PI;
+	xwidth = 180.0 * gbox_angular_width(gbox)  / M_PI;
+	ywidth = 180.0 * gbox_angular_height(gbox) / M_PI;
 
 	POSTGIS_DEBUGF(2, "xwidth %g", xwidth);
 	POSTGIS_DEBUGF(2, "ywidth %g", ywidth);
@@ -843,13 +835,13 @@ Datum geography_bestsrid(PG_FUNCTION_ARGS)
 	/* Are these data arctic? Lambert Azimuthal Equal Area North. */
 	if ( center.y > 70.0 && ywidth < 45.0 )
 	{
-		PG_RETURN_INT32(SRID_NORTH_LAMBERT);
+		return SRID_NORTH_LAMBERT;
 	}
 
 	/* Are these data antarctic? Lambert Azimuthal Equal Area South. */
 	if ( center.y < -70.0 && ywidth < 45.0 )
 	{
-		PG_RETURN_INT32(SRID_SOUTH_LAMBERT);
+		return SRID_SOUTH_LAMBERT;
 	}
 
 	/*
@@ -867,12 +859,12 @@ Datum geography_bestsrid(PG_FUNCTION_ARGS)
 		/* Are these data below the equator? UTM South. */
 		if ( center.y < 0.0 )
 		{
-			PG_RETURN_INT32( SRID_SOUTH_UTM_START + zone );
+			return SRID_SOUTH_UTM_START + zone;
 		}
 		/* Are these data above the equator? UTM North. */
 		else
 		{
-			PG_RETURN_INT32( SRID_NORTH_UTM_START + zone );
+			return SRID_NORTH_UTM_START + zone;
 		}
 	}
 
@@ -906,7 +898,7 @@ Datum geography_bestsrid(PG_FUNCTION_ARGS)
 		/* Did we fit into an appropriate xzone? */
 		if ( xzone != -1 )
 		{
-			PG_RETURN_INT32(SRID_LAEA_START + 20 * yzone + xzone);
+			return SRID_LAEA_START + 20 * yzone + xzone;
 		}
 	}
 
@@ -914,8 +906,72 @@ Datum geography_bestsrid(PG_FUNCTION_ARGS)
 	** Running out of options... fall-back to Mercator
 	** and hope for the best.
 	*/
-	PG_RETURN_INT32(SRID_WORLD_MERCATOR);
+	return SRID_WORLD_MERCATOR;
+}
+
+/*
+** geography_bestsrid(GSERIALIZED *g, GSERIALIZED *g) returns int
+** Utility function. Returns negative SRID numbers that match to the
+** numbers handled in code by the transform(lwgeom, srid) function.
+** UTM, polar stereographic and mercator as fallback. To be used
+** in wrapping existing geometry functions in SQL to provide access
+** to them in the geography module.
+*/
+PG_FUNCTION_INFO_V1(geography_bestsrid);
+Datum geography_bestsrid(PG_FUNCTION_ARGS)
+{
+	GBOX gbox, gbox1, gbox2;
+	GSERIALIZED *g1 = NULL;
+	GSERIALIZED *g2 = NULL;
+	int empty1 = LW_FALSE;
+	int empty2 = LW_FALSE;
+
+	Datum d1 = PG_GETARG_DATUM(0);
+	Datum d2 = PG_GETARG_DATUM(1);
+
+	/* Get our geometry objects loaded into memory. */
+	g1 = (GSERIALIZED*)PG_DETOAST_DATUM(d1);
+	/* Synchronize our box types */
+	gbox1.flags = g1->flags;
+	/* Calculate if the geometry is empty. */
+	empty1 = gserialized_is_empty(g1);
+	/* Calculate a geocentric bounds for the objects */
+	if ( ! empty1 && gserialized_get_gbox_p(g1, &gbox1) == LW_FAILURE )
+		elog(ERROR, "Error in geography_bestsrid calling gserialized_get_gbox_p(g1, &gbox1)");
+
+	POSTGIS_DEBUGF(4, "calculated gbox = %s", gbox_to_string(&gbox1));
+
+	/* If we have a unique second argument, fill in all the necessary variables. */
+	if ( d1 != d2 )
+	{
+		g2 = (GSERIALIZED*)PG_DETOAST_DATUM(d2);
+		gbox2.flags = g2->flags;
+		empty2 = gserialized_is_empty(g2);
+		if ( ! empty2 && gserialized_get_gbox_p(g2, &gbox2) == LW_FAILURE )
+			elog(ERROR, "Error in geography_bestsrid calling gserialized_get_gbox_p(g2, &gbox2)");
+	}
+	/*
+	** If no unique second argument, copying the box for the first
+	** argument will give us the right answer for all subsequent tests.
+	*/
+	else
+	{
+		gbox = gbox2 = gbox1;
+	}
+
+	/* Both empty? We don't have an answer. */
+	if ( empty1 && empty2 )
+		PG_RETURN_NULL();
 
+	/* One empty? We can use the other argument values as infill. Otherwise merge the boxen */
+	if ( empty1 )
+		gbox = gbox2;
+	else if ( empty2 )
+		gbox = gbox1;
+	else
+		gbox_union(&gbox1, &gbox2, &gbox);
+
+	PG_RETURN_INT32(geography_gbox_bestsrid(&gbox));
 }
 
 /*
@@ -1109,4 +1165,82 @@ Datum geography_segmentize(PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(g2);
 }
 
+/*
+** geography_densify(GSERIALIZED *g1, double max_deviation)
+** returns densified geometry whose edges, drawn straight in
+** longitude/latitude, stray no more than max from the great circles
+*/
+PG_FUNCTION_INFO_V1(geography_densify);
+Datum geography_densify(PG_FUNCTION_ARGS)
+{
+	LWGEOM *lwgeom1 = NULL;
+	LWGEOM *lwgeom2 = NULL;
+	GSERIALIZED *g1 = NULL;
+	GSERIALIZED *g2 = NULL;
+	double max_deviation;
+	uint32_t type1;
+
+	/* Get our geometry object loaded into memory. */
+	g1 = PG_GETARG_GSERIALIZED_P(0);
+	type1 = gserialized_get_type(g1);
+
+	/* Convert max_deviation from metric units to radians */
+	max_deviation = PG_GETARG_FLOAT8(1) / WGS84_RADIUS;
+
+	/* A NaN deviation is never met, and would halve edges for ever */
+	if ( ! (max_deviation > 0.0) )
+		elog(ERROR, "%s: maximum deviation must be positive", __func__);
+
+	/* We can't densify points or points, reflect them back */
+	if ( type1 == POINTTYPE || type1 == MULTIPOINTTYPE || gserialized_is_empty(g1) )
+		PG_RETURN_POINTER(g1);
+
+	lwgeom1 = lwgeom_from_gserialized(g1);
+	lwgeom2 = lwgeom_densify_sphere(lwgeom1, max_deviation);
+
+	/* Recalculate the boxes of the geodetic result */
+	lwgeom_set_geodetic(lwgeom2, true);
+	lwgeom_drop_bbox(lwgeom2);
+	g2 = geography_serialize(lwgeom2);
+
+	lwgeom_free(lwgeom1);
+	lwgeom_free(lwgeom2);
+	PG_FREE_IF_COPY(g1, 0);
+
+	PG_RETURN_POINTER(g2);
+}
+
 
+
+/*
+** geography_add_tree_index(GSERIALIZED *g1)
+** returns the geography with a packed tree of its edges stored
+** alongside, which distance calculations use instead of building one
+*/
+PG_FUNCTION_INFO_V1(geography_add_tree_index);
+Datum geography_add_tree_index(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED *g1 = PG_GETARG_GSERIALIZED_P(0);
+	GSERIALIZED *g2 = gserialized_add_index(g1);
+	PG_FREE_IF_COPY(g1, 0);
+	PG_RETURN_POINTER(g2);
+}
+
+/*
+** geography_drop_tree_index(GSERIALIZED *g1)
+** returns the geography without its stored tree
+*/
+PG_FUNCTION_INFO_V1(geography_drop_tree_index);
+Datum geography_drop_tree_index(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED *g1 = PG_GETARG_GSERIALIZED_P(0);
+	GSERIALIZED *g2;
+
+	/* Nothing to drop, reflect it back */
+	if ( ! gserialized_index_size(g1) )
+		PG_RETURN_POINTER(g1);
+
+	g2 = gserialized_drop_index(g1);
+	PG_FREE_IF_COPY(g1, 0);
+	PG_RETURN_POINTER(g2);
+}
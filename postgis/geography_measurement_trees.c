@@ -46,7 +46,7 @@ static int
 CircTreeBuilder(const LWGEOM* lwgeom, GeomCache* cache)
 {
 	CircTreeGeomCache* circ_cache = (CircTreeGeomCache*)cache;
-	CIRC_NODE* tree = lwgeom_calculate_circ_tree(lwgeom);
+	CIRC_NODE* tree = gserialized_get_circ_tree(cache->build_geom, lwgeom);
 
 	if ( circ_cache->index )
 	{
@@ -86,13 +86,28 @@ static GeomCacheMethods CircTreeCacheMethods =
 	CIRC_CACHE_ENTRY,
 	CircTreeBuilder,
 	CircTreeFreer,
-	CircTreeAllocator
+	CircTreeAllocator,
+	sizeof(CircTreeGeomCache)
 };
 
-static CircTreeGeomCache*
-GetCircTreeGeomCache(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const GSERIALIZED* g2)
+/*
+* Cached trees of the two arguments of a call, looked up each on
+* its own so that both sides of a join keep their trees. Points
+* are cheaper to index than to look up, and are left out.
+*/
+static void
+GetCircTreeGeomCachePair(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const GSERIALIZED* g2, CIRC_NODE** tree1, CIRC_NODE** tree2)
 {
-	return (CircTreeGeomCache*)GetGeomCache(fcinfo, &CircTreeCacheMethods, g1, g2);
+	GeomCache* cache1;
+	GeomCache* cache2;
+
+	GetGeomCachePair(fcinfo, &CircTreeCacheMethods,
+	                 gserialized_get_type(g1) == POINTTYPE ? NULL : g1,
+	                 gserialized_get_type(g2) == POINTTYPE ? NULL : g2,
+	                 &cache1, &cache2);
+
+	*tree1 = cache1 && cache1->argnum == 1 ? ((CircTreeGeomCache*)cache1)->index : NULL;
+	*tree2 = cache2 && cache2->argnum == 2 ? ((CircTreeGeomCache*)cache2)->index : NULL;
 }
 
 
@@ -155,7 +170,10 @@ CircTreePIP(const CIRC_NODE* tree1, const GSERIALIZED* g1, const POINT4D* in_poi
 static int
 geography_distance_cache_tolerance(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const GSERIALIZED* g2, const SPHEROID* s, double tolerance, double* distance)
 {
-	CircTreeGeomCache* tree_cache = NULL;
+	const GSERIALIZED* g[2];
+	CIRC_NODE* tree[2];
+	LWGEOM* lwgeom[2] = { NULL, NULL }; /* Set when the tree is our own */
+	int i;
 
 	int type1 = gserialized_get_type(g1);
 	int type2 = gserialized_get_type(g2);
@@ -166,80 +184,54 @@ geography_distance_cache_tolerance(FunctionCallInfoData* fcinfo, const GSERIALIZ
 	if ( type1 == POINTTYPE && type2 == POINTTYPE )
 		return LW_FAILURE;
 
-	/* Fetch/build our cache, if appropriate, etc... */
-	tree_cache = GetCircTreeGeomCache(fcinfo, g1, g2);
+	/* Fetch/build our caches, if appropriate, etc... */
+	GetCircTreeGeomCachePair(fcinfo, g1, g2, &tree[0], &tree[1]);
 
-	/* OK, we have an index at the ready! Use it for the one tree argument and */
-	/* fill in the other tree argument */
-	if ( tree_cache && tree_cache->gcache.argnum && tree_cache->index )
+	/* No index at the ready, leave it to the uncached calculation, */
+	/* unless an argument brings its own tree along */
+	if ( ! tree[0] && ! tree[1] &&
+	     ! gserialized_index_size(g1) && ! gserialized_index_size(g2) )
+		return LW_FAILURE;
+
+	/* We need to dynamically build (or map) a tree for the uncached side of the function call */
+	g[0] = g1;
+	g[1] = g2;
+	for ( i = 0; i < 2; i++ )
 	{
-		CIRC_NODE* circtree_cached = tree_cache->index;
-		CIRC_NODE* circtree = NULL;
-		const GSERIALIZED* g_cached;
-		const GSERIALIZED* g;
-		LWGEOM* lwgeom = NULL;
-		int geomtype_cached;
-		int geomtype;
-		POINT4D p4d;
+		if ( tree[i] )
+			continue;
+		lwgeom[i] = lwgeom_from_gserialized(g[i]);
+		tree[i] = gserialized_get_circ_tree(g[i], lwgeom[i]);
+	}
 
-		/* We need to dynamically build a tree for the uncached side of the function call */
-		if ( tree_cache->gcache.argnum == 1 )
-		{
-			g_cached = g1;
-			g = g2;
-			geomtype_cached = type1;
-			geomtype = type2;
-		}
-		else if ( tree_cache->gcache.argnum == 2 )
-		{
-			g_cached = g2;
-			g = g1;
-			geomtype_cached = type2;
-			geomtype = type1;
-		}
-		else
-		{
-			lwpgerror("geography_distance_cache this cannot happen!");
-			return LW_FAILURE;
-		}
+	/* A point of one argument inside the other polygonal one */
+	*distance = -1.0;
+	for ( i = 0; i < 2; i++ )
+	{
+		POINT2D p2d;
+		POINT4D p4d;
 
-		lwgeom = lwgeom_from_gserialized(g);
-		if ( geomtype_cached == POLYGONTYPE || geomtype_cached == MULTIPOLYGONTYPE )
+		circ_tree_get_point(tree[1 - i], &p2d);
+		p4d.x = p2d.x;
+		p4d.y = p2d.y;
+		if ( CircTreePIP(tree[i], g[i], &p4d) )
 		{
-			lwgeom_startpoint(lwgeom, &p4d);
-			if ( CircTreePIP(circtree_cached, g_cached, &p4d) )
-			{
-				*distance = 0.0;
-				lwgeom_free(lwgeom);
-				return LW_SUCCESS;
-			}
+			*distance = 0.0;
+			break;
 		}
+	}
 
-		circtree = lwgeom_calculate_circ_tree(lwgeom);
-		if ( geomtype == POLYGONTYPE || geomtype == MULTIPOLYGONTYPE )
-		{
-			POINT2D p2d;
-			circ_tree_get_point(circtree_cached, &p2d);
-			p4d.x = p2d.x;
-			p4d.y = p2d.y;
-			if ( CircTreePIP(circtree, g, &p4d) )
-			{
-				*distance = 0.0;
-				circ_tree_free(circtree);
-				lwgeom_free(lwgeom);
-				return LW_SUCCESS;
-			}
-		}
+	if ( *distance < 0.0 )
+		*distance = circ_tree_distance_tree(tree[0], tree[1], s, tolerance);
 
-		*distance = circ_tree_distance_tree(circtree_cached, circtree, s, tolerance);
-		circ_tree_free(circtree);
-		lwgeom_free(lwgeom);
-		return LW_SUCCESS;
-	}
-	else
+	for ( i = 0; i < 2; i++ )
 	{
-		return LW_FAILURE;
+		if ( ! lwgeom[i] )
+			continue;
+		circ_tree_free(tree[i]);
+		lwgeom_free(lwgeom[i]);
 	}
+	return LW_SUCCESS;
 }
 
 
@@ -278,8 +270,8 @@ geography_tree_distance(const GSERIALIZED* g1, const GSERIALIZED* g2, const SPHE
 
 	lwgeom1 = lwgeom_from_gserialized(g1);
 	lwgeom2 = lwgeom_from_gserialized(g2);
-	circ_tree1 = lwgeom_calculate_circ_tree(lwgeom1);
-	circ_tree2 = lwgeom_calculate_circ_tree(lwgeom2);
+	circ_tree1 = gserialized_get_circ_tree(g1, lwgeom1);
+	circ_tree2 = gserialized_get_circ_tree(g2, lwgeom2);
 	lwgeom_startpoint(lwgeom1, &pt1);
 	lwgeom_startpoint(lwgeom2, &pt2);
 
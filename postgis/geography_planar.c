@@ -0,0 +1,200 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "../postgis_config.h"
+
+#include "liblwgeom.h"         /* For standard geometry types. */
+#include "lwgeom_pg.h"       /* For debugging macros. */
+#include "geography.h"	     /* For utility functions. */
+#include "lwgeom_geos.h"     /* For the planar buffer. */
+#include "lwgeom_transform.h" /* For the projection cache. */
+
+/*
+* Geography operations done by the planar geometry functions in a
+* local projection, the one _ST_BestSRID would choose. They replace
+* SQL wrappers going through ST_Transform: the projections are looked
+* up once per call in the cache of the calling function, so rows
+* falling into the same zone share them, and the coordinates are
+* transformed in bulk, in place, without intermediate geometries.
+*/
+
+Datum geography_buffer(PG_FUNCTION_ARGS);
+Datum geography_intersection(PG_FUNCTION_ARGS);
+
+typedef struct
+{
+	int srid;          /* builtin SRID of the local projection */
+	projPJ pj_plane;   /* local planar projection */
+	projPJ pj_out;     /* projection of the results, always SRID_DEFAULT */
+} GEOGRAPHY_PLANE;
+
+static void
+geography_plane_init(FunctionCallInfo fcinfo, const GBOX *gbox, GEOGRAPHY_PLANE *plane)
+{
+	plane->srid = geography_gbox_bestsrid(gbox);
+
+	if ( GetProjectionsUsingFCInfo(fcinfo, plane->srid, SRID_DEFAULT, &plane->pj_plane, &plane->pj_out) == LW_FAILURE )
+		elog(ERROR, "Failure reading projections from spatial_ref_sys.");
+}
+
+/*
+* Geography to planar geometry, in place, so the geometry must not
+* point into the argument datums. The geocentric box does not make
+* sense in the plane and goes away.
+*/
+static void
+geography_plane_project(FunctionCallInfo fcinfo, const GEOGRAPHY_PLANE *plane, LWGEOM *lwgeom)
+{
+	projPJ pj_geog, pj_plane;
+
+	if ( GetProjectionsUsingFCInfo(fcinfo, lwgeom->srid, plane->srid, &pj_geog, &pj_plane) == LW_FAILURE )
+		elog(ERROR, "Failure reading projections from spatial_ref_sys.");
+
+	lwgeom_drop_bbox(lwgeom);
+	lwgeom_set_geodetic(lwgeom, LW_FALSE);
+	if ( ! lwgeom_transform(lwgeom, pj_geog, pj_plane) )
+		elog(ERROR, "%s: unable to project geography", __func__);
+	lwgeom->srid = plane->srid;
+}
+
+/*
+* Planar geometry back to a SRID_DEFAULT geography, as the
+* geography(geometry) cast does it.
+*/
+static GSERIALIZED *
+geography_plane_unproject(const GEOGRAPHY_PLANE *plane, LWGEOM *lwgeom)
+{
+	if ( ! lwgeom_transform(lwgeom, plane->pj_plane, plane->pj_out) )
+		elog(ERROR, "%s: unable to unproject geometry", __func__);
+	lwgeom->srid = SRID_DEFAULT;
+
+	geography_valid_type(lwgeom->type);
+	lwgeom_nudge_geodetic(lwgeom);
+	if ( lwgeom_force_geodetic(lwgeom) == LW_TRUE )
+	{
+		ereport(NOTICE, (
+		        errmsg_internal("Coordinate values were coerced into range [-180 -90, 180 90] for GEOGRAPHY" ))
+		);
+	}
+	lwgeom_drop_bbox(lwgeom);
+	lwgeom_set_geodetic(lwgeom, LW_TRUE);
+	return geography_serialize(lwgeom);
+}
+
+/*
+** geography_buffer(GSERIALIZED *g, float8 distance [, cstring params])
+** returns the buffer of a geography, in meters, computed in the best
+** local projection
+*/
+PG_FUNCTION_INFO_V1(geography_buffer);
+Datum geography_buffer(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED *g = PG_GETARG_GSERIALIZED_P_COPY(0);
+	Datum distance = PG_GETARG_DATUM(1);
+	GEOGRAPHY_PLANE plane;
+	GSERIALIZED *g_plane, *g_result;
+	LWGEOM *lwgeom;
+	GBOX gbox;
+	Datum d;
+
+	/* Empties have no best SRID, and so no buffer */
+	if ( gserialized_is_empty(g) )
+		PG_RETURN_NULL();
+
+	gbox.flags = g->flags;
+	if ( gserialized_get_gbox_p(g, &gbox) == LW_FAILURE )
+		elog(ERROR, "%s: unable to calculate bounding box", __func__);
+
+	geography_plane_init(fcinfo, &gbox, &plane);
+
+	lwgeom = lwgeom_from_gserialized(g);
+	geography_plane_project(fcinfo, &plane, lwgeom);
+	g_plane = geometry_serialize(lwgeom);
+	lwgeom_free(lwgeom);
+	PG_FREE_IF_COPY(g, 0);
+
+	if ( PG_NARGS() > 2 )
+		d = DirectFunctionCall3(buffer, PointerGetDatum(g_plane), distance, PG_GETARG_DATUM(2));
+	else
+		d = DirectFunctionCall2(buffer, PointerGetDatum(g_plane), distance);
+	pfree(g_plane);
+
+	lwgeom = lwgeom_from_gserialized((GSERIALIZED*)DatumGetPointer(d));
+	g_result = geography_plane_unproject(&plane, lwgeom);
+	lwgeom_free(lwgeom);
+	PG_RETURN_POINTER(g_result);
+}
+
+/*
+** geography_intersection(GSERIALIZED *g1, GSERIALIZED *g2)
+** returns the intersection of two geographies, computed in the best
+** local projection for the both of them
+*/
+PG_FUNCTION_INFO_V1(geography_intersection);
+Datum geography_intersection(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED *g1 = PG_GETARG_GSERIALIZED_P_COPY(0);
+	GSERIALIZED *g2 = PG_GETARG_GSERIALIZED_P_COPY(1);
+	int empty1 = gserialized_is_empty(g1);
+	int empty2 = gserialized_is_empty(g2);
+	GEOGRAPHY_PLANE plane;
+	GSERIALIZED *g_result;
+	LWGEOM *lwgeom1, *lwgeom2, *lwresult;
+	GBOX gbox, gbox1, gbox2;
+
+	/* Both empty? There is no best SRID. */
+	if ( empty1 && empty2 )
+		PG_RETURN_NULL();
+
+	gbox1.flags = g1->flags;
+	gbox2.flags = g2->flags;
+	if ( ( ! empty1 && gserialized_get_gbox_p(g1, &gbox1) == LW_FAILURE ) ||
+	     ( ! empty2 && gserialized_get_gbox_p(g2, &gbox2) == LW_FAILURE ) )
+		elog(ERROR, "%s: unable to calculate bounding box", __func__);
+
+	if ( empty1 )
+		gbox = gbox2;
+	else if ( empty2 )
+		gbox = gbox1;
+	else
+		gbox_union(&gbox1, &gbox2, &gbox);
+
+	geography_plane_init(fcinfo, &gbox, &plane);
+
+	lwgeom1 = lwgeom_from_gserialized(g1);
+	lwgeom2 = lwgeom_from_gserialized(g2);
+	geography_plane_project(fcinfo, &plane, lwgeom1);
+	geography_plane_project(fcinfo, &plane, lwgeom2);
+
+	lwresult = lwgeom_intersection(lwgeom1, lwgeom2);
+	if ( ! lwresult )
+		elog(ERROR, "%s: lwgeom_intersection returned NULL", __func__);
+	lwgeom_free(lwgeom1);
+	lwgeom_free(lwgeom2);
+	PG_FREE_IF_COPY(g1, 0);
+	PG_FREE_IF_COPY(g2, 1);
+
+	g_result = geography_plane_unproject(&plane, lwresult);
+	lwgeom_free(lwresult);
+	PG_RETURN_POINTER(g_result);
+}
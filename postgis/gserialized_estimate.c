@@ -87,6 +87,7 @@ dimensionality cases. (2D geometry) &&& (3D column), etc.
 #include "access/heapam.h"
 #include "catalog/pg_type.h"
 #include "access/relscan.h"
+#include "catalog/pg_class.h"
 
 #include "executor/spi.h"
 #include "fmgr.h"
@@ -105,6 +106,11 @@ dimensionality cases. (2D geometry) &&& (3D column), etc.
 #if POSTGIS_PGSQL_VERSION >= 93
 	#include "access/htup_details.h"
 #endif
+#if POSTGIS_PGSQL_VERSION < 110
+	#include "catalog/pg_inherits_fn.h"
+#else
+	#include "catalog/pg_inherits.h"
+#endif
 
 #include "stringbuffer.h"
 #include "liblwgeom.h"
@@ -214,6 +220,18 @@ Datum geometry_estimated_extent(PG_FUNCTION_ARGS);
 #define FALLBACK_ND_SEL 0.2
 #define FALLBACK_ND_JOINSEL 0.3
 
+/**
+* Histogram cells holding more than ND_REFINE_FACTOR times the
+* average count of the occupied cells (and at least
+* ND_REFINE_MIN_FEATURES features) get their own finer
+* sub-histogram, so that skewed data (dense downtowns in
+* sparse countrysides) is not smeared across a whole cell.
+* At most ND_REFINE_MAX_CELLS cells, the densest ones, are refined.
+*/
+#define ND_REFINE_FACTOR 4.0
+#define ND_REFINE_MIN_FEATURES 10
+#define ND_REFINE_MAX_CELLS 100
+
 /**
 * N-dimensional box type for calculations, to avoid doing
 * explicit axis conversions from GBOX in all calculations
@@ -272,10 +290,32 @@ typedef struct ND_STATS_T
 	/* now always equal histogram_features */
 	float4 cells_covered;
 
-	/* Variable length # of floats for histogram */
+	/* Are mean feature widths per cell stored after the counts? (0/1) */
+	float4 cell_extents;
+
+	/* How many dense cells carry a refined sub-histogram? */
+	float4 refined_cells;
+
+	/* Size of the refined sub-histograms in each dimension */
+	float4 refine_size;
+
+	/*
+	* Variable length # of floats for histogram:
+	*  o histogram_cells feature counts
+	*  o if cell_extents, histogram_cells * ndims mean widths
+	*    of the (clipped) features that fell into each cell
+	*  o refined_cells entries of the cell index followed by the
+	*    refine_size^ndims sub-cell counts, sorted by cell index
+	*/
 	float4 value[1];
 } ND_STATS;
 
+/**
+* Number of floats in the #ND_STATS header written by PostGIS
+* releases that stored neither cell extents nor refined cells.
+*/
+#define ND_STATS_OLD_HEADER_SIZE (offsetof(ND_STATS, cell_extents) / sizeof(float4))
+
 
 
 
@@ -498,7 +538,10 @@ nd_stats_to_json(const ND_STATS *nd_stats)
 	stringbuffer_aprintf(sb, "\"not_null_features\":%d,", (int)roundf(nd_stats->not_null_features));
 	stringbuffer_aprintf(sb, "\"histogram_features\":%d,", (int)roundf(nd_stats->histogram_features));
 	stringbuffer_aprintf(sb, "\"histogram_cells\":%d,", (int)roundf(nd_stats->histogram_cells));
-	stringbuffer_aprintf(sb, "\"cells_covered\":%d", (int)roundf(nd_stats->cells_covered));
+	stringbuffer_aprintf(sb, "\"cells_covered\":%d,", (int)roundf(nd_stats->cells_covered));
+	stringbuffer_aprintf(sb, "\"cell_extents\":%s,", nd_stats->cell_extents ? "true" : "false");
+	stringbuffer_aprintf(sb, "\"refined_cells\":%d,", (int)roundf(nd_stats->refined_cells));
+	stringbuffer_aprintf(sb, "\"refine_size\":%d", (int)roundf(nd_stats->refine_size));
 	stringbuffer_append(sb, "}");
 
 	str = stringbuffer_getstringcopy(sb);
@@ -871,6 +914,218 @@ nd_increment(ND_IBOX *ibox, int ndims, int *counter)
 	return true;
 }
 
+/**
+* Return the ndims mean feature widths stored for the histogram
+* cell at position vdx in the values array, or NULL if the stats
+* do not carry cell extents.
+*/
+static inline const float4 *
+nd_stats_cell_widths(const ND_STATS *stats, int vdx)
+{
+	int ncells = (int)roundf(stats->histogram_cells);
+	int ndims = (int)roundf(stats->ndims);
+
+	if ( ! stats->cell_extents || vdx < 0 )
+		return NULL;
+
+	return stats->value + ncells + vdx * ndims;
+}
+
+/**
+* Largest mean feature width over all the histogram cells, in each
+* dimension. Zero everywhere for stats without cell extents.
+*/
+static void
+nd_stats_max_widths(const ND_STATS *stats, double *max_width)
+{
+	int ncells = (int)roundf(stats->histogram_cells);
+	int ndims = (int)roundf(stats->ndims);
+	int d, i;
+
+	for ( d = 0; d < ND_DIMS; d++ )
+		max_width[d] = 0.0;
+
+	if ( ! stats->cell_extents )
+		return;
+
+	for ( i = 0; i < ncells; i++ )
+	{
+		const float4 *widths = nd_stats_cell_widths(stats, i);
+		for ( d = 0; d < ndims; d++ )
+			max_width[d] = Max(max_width[d], widths[d]);
+	}
+}
+
+/**
+* Number of sub-cells in each refined histogram cell.
+*/
+static inline int
+nd_stats_refined_subcells(const ND_STATS *stats)
+{
+	int rsize = (int)roundf(stats->refine_size);
+	int ndims = (int)roundf(stats->ndims);
+	int d, nsub = 1;
+
+	for ( d = 0; d < ndims; d++ )
+		nsub *= rsize;
+
+	return nsub;
+}
+
+/**
+* Return the sub-cell counts of the refined histogram cell at
+* position vdx in the values array, or NULL if that cell has
+* not been refined.
+*/
+static const float4 *
+nd_stats_refined_cell(const ND_STATS *stats, int vdx)
+{
+	int ncells = (int)roundf(stats->histogram_cells);
+	int ndims = (int)roundf(stats->ndims);
+	int nrefined = (int)roundf(stats->refined_cells);
+	int stride, lo, hi;
+	const float4 *refined;
+
+	if ( nrefined <= 0 || vdx < 0 )
+		return NULL;
+
+	stride = 1 + nd_stats_refined_subcells(stats);
+	refined = stats->value + ncells;
+	if ( stats->cell_extents )
+		refined += ncells * ndims;
+
+	/* Entries are sorted on cell index, so we can bisect */
+	lo = 0;
+	hi = nrefined - 1;
+	while ( lo <= hi )
+	{
+		int mid = (lo + hi) / 2;
+		int idx = (int)roundf(refined[mid * stride]);
+
+		if ( idx == vdx )
+			return refined + mid * stride + 1;
+		else if ( idx < vdx )
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return NULL;
+}
+
+/**
+* Which sub-cells of a histogram cell split rsize ways in each
+* dimension does this ND_BOX overlap? Like #nd_box_overlap, but
+* for the refined sub-histogram of one cell.
+*/
+static void
+nd_cell_subcell_overlap(const ND_BOX *nd_cell, int rsize, int ndims, const ND_BOX *nd_box, ND_IBOX *nd_ibox)
+{
+	int d;
+
+	memset(nd_ibox, 0, sizeof(ND_IBOX));
+	for ( d = 0; d < ndims; d++ )
+	{
+		double width = nd_cell->max[d] - nd_cell->min[d];
+
+		/* Degenerate cell? Then every sub-cell is in play */
+		if ( width <= 0 )
+		{
+			nd_ibox->min[d] = 0;
+			nd_ibox->max[d] = rsize - 1;
+			continue;
+		}
+		nd_ibox->min[d] = floor(rsize * (nd_box->min[d] - nd_cell->min[d]) / width);
+		nd_ibox->max[d] = floor(rsize * (nd_box->max[d] - nd_cell->min[d]) / width);
+
+		/* Push any out-of range values into range */
+		nd_ibox->min[d] = Max(nd_ibox->min[d], 0);
+		nd_ibox->max[d] = Min(nd_ibox->max[d], rsize - 1);
+	}
+}
+
+/**
+* Set the bounds of the sub-cell at (i,j,k,l) of a histogram cell
+* split rsize ways in each dimension, and return the position of
+* that sub-cell in the sub-histogram values.
+*/
+static int
+nd_cell_subcell(const ND_BOX *nd_cell, int rsize, int ndims, const int *at, ND_BOX *nd_sub)
+{
+	int d;
+	int accum = 1, vdx = 0;
+
+	nd_box_init(nd_sub);
+	for ( d = 0; d < ndims; d++ )
+	{
+		double sub_size = (nd_cell->max[d] - nd_cell->min[d]) / rsize;
+		nd_sub->min[d] = nd_cell->min[d] + (at[d]+0) * sub_size;
+		nd_sub->max[d] = nd_cell->min[d] + (at[d]+1) * sub_size;
+		vdx += at[d] * accum;
+		accum *= rsize;
+	}
+	return vdx;
+}
+
+/**
+* Pro-rated count of a refined histogram cell: the sum of its
+* sub-cell counts, each scaled by the proportion of the sub-cell
+* covered by the search box.
+*/
+static double
+nd_refined_cell_count(const ND_STATS *stats, const float4 *subcells, const ND_BOX *nd_cell, const ND_BOX *nd_box)
+{
+	int ndims = (int)roundf(stats->ndims);
+	int rsize = (int)roundf(stats->refine_size);
+	ND_IBOX nd_ibox;
+	int at[ND_DIMS];
+	int d;
+	double total = 0.0;
+
+	nd_cell_subcell_overlap(nd_cell, rsize, ndims, nd_box, &nd_ibox);
+	for ( d = 0; d < ndims; d++ )
+		at[d] = nd_ibox.min[d];
+
+	do
+	{
+		ND_BOX nd_sub;
+		int sdx = nd_cell_subcell(nd_cell, rsize, ndims, at, &nd_sub);
+		total += subcells[sdx] * nd_box_ratio(nd_box, &nd_sub, ndims);
+	}
+	while ( nd_increment(&nd_ibox, ndims, at) );
+
+	return total;
+}
+
+/**
+* Turn a float4 array read from the system catalogs into an
+* #ND_STATS, converting histograms written by older releases
+* (which had no cell extents or refinements) to the current layout.
+*/
+static ND_STATS*
+nd_stats_from_numbers(const float4 *numbers, int nnumbers)
+{
+	ND_STATS *nd_stats;
+	int old_header = ND_STATS_OLD_HEADER_SIZE;
+
+	if ( nnumbers > old_header )
+	{
+		/* The histogram_cells count sits at the same place in both layouts */
+		int ncells = (int)roundf(numbers[offsetof(ND_STATS, histogram_cells) / sizeof(float4)]);
+		if ( nnumbers == old_header + ncells )
+		{
+			POSTGIS_DEBUG(2, "converting stats from the pre-2.5 layout");
+			nd_stats = palloc0(sizeof(ND_STATS) + (ncells - 1) * sizeof(float4));
+			memcpy(nd_stats, numbers, sizeof(float4) * old_header);
+			memcpy(nd_stats->value, numbers + old_header, sizeof(float4) * ncells);
+			return nd_stats;
+		}
+	}
+
+	nd_stats = palloc(sizeof(float4) * nnumbers);
+	memcpy(nd_stats, numbers, sizeof(float4) * nnumbers);
+	return nd_stats;
+}
+
 static ND_STATS*
 pg_nd_stats_from_tuple(HeapTuple stats_tuple, int mode)
 {
@@ -897,8 +1152,7 @@ pg_nd_stats_from_tuple(HeapTuple stats_tuple, int mode)
 		}
 
 		/* Clone the stats here so we can release the attstatsslot immediately */
-		nd_stats = palloc(sizeof(float) * nvalues);
-		memcpy(nd_stats, floatptr, sizeof(float) * nvalues);
+		nd_stats = nd_stats_from_numbers(floatptr, nvalues);
 
 		/* Clean up */
 		free_attstatsslot(0, NULL, 0, floatptr, nvalues);
@@ -914,8 +1168,7 @@ pg_nd_stats_from_tuple(HeapTuple stats_tuple, int mode)
 		}
 
 		/* Clone the stats here so we can release the attstatsslot immediately */
-		nd_stats = palloc(sizeof(float4) * sslot.nnumbers);
-		memcpy(nd_stats, sslot.numbers, sizeof(float4) * sslot.nnumbers);
+		nd_stats = nd_stats_from_numbers(sslot.numbers, sslot.nnumbers);
 
 		free_attstatsslot(&sslot);
 	}
@@ -1001,6 +1254,126 @@ pg_get_nd_stats_by_name(const Oid table_oid, const text *att_text, int mode, boo
 	return pg_get_nd_stats(table_oid, att_num, mode, only_parent);
 }
 
+/**
+* Chance that two points, placed anywhere in [a1, b1] and [a2, b2]
+* respectively, are no more than reach apart.
+*/
+static double
+nd_interval_reach_probability(double a1, double b1, double a2, double b2, double reach)
+{
+	double len1 = b1 - a1;
+	double len2 = b2 - a2;
+	double x[6], area = 0.0;
+	int i, j, n = 0;
+
+	/* Degenerate intervals: a point against an interval, or two points */
+	if ( len1 <= 0 && len2 <= 0 )
+		return fabs(a1 - a2) <= reach ? 1.0 : 0.0;
+	if ( len1 <= 0 )
+		return Max(0.0, Min(a1 + reach, b2) - Max(a1 - reach, a2)) / len2;
+	if ( len2 <= 0 )
+		return Max(0.0, Min(a2 + reach, b1) - Max(a2 - reach, a1)) / len1;
+
+	/*
+	 * The length of [x-reach, x+reach] inside [a2, b2] is piecewise
+	 * linear in x, with breaks at a2 +/- reach and b2 +/- reach, so
+	 * integrating it over [a1, b1] with the trapezoid rule is exact.
+	 */
+	x[n++] = a1;
+	x[n++] = b1;
+	if ( a2 - reach > a1 && a2 - reach < b1 ) x[n++] = a2 - reach;
+	if ( a2 + reach > a1 && a2 + reach < b1 ) x[n++] = a2 + reach;
+	if ( b2 - reach > a1 && b2 - reach < b1 ) x[n++] = b2 - reach;
+	if ( b2 + reach > a1 && b2 + reach < b1 ) x[n++] = b2 + reach;
+
+	/* Insertion sort of the few breaks we have */
+	for ( i = 1; i < n; i++ )
+	{
+		double tmp = x[i];
+		for ( j = i; j > 0 && x[j-1] > tmp; j-- )
+			x[j] = x[j-1];
+		x[j] = tmp;
+	}
+
+	for ( i = 1; i < n; i++ )
+	{
+		double f0 = Max(0.0, Min(x[i-1] + reach, b2) - Max(x[i-1] - reach, a2));
+		double f1 = Max(0.0, Min(x[i] + reach, b2) - Max(x[i] - reach, a2));
+		area += (x[i] - x[i-1]) * (f0 + f1) / 2;
+	}
+
+	return area / (len1 * len2);
+}
+
+/**
+* Expected number of pairs of features, one from a cell of each
+* histogram, whose boxes (grown by expand) interact. Features are
+* taken to be spread evenly over their cell, or over the sub-cells
+* of a refined cell, with the mean width recorded for their cell.
+*/
+static double
+nd_cells_join_count(const ND_STATS *s1, int vdx1, const ND_BOX *nd_cell1,
+                    const ND_STATS *s2, int vdx2, const ND_BOX *nd_cell2,
+                    double expand)
+{
+	int ndims1 = (int)roundf(s1->ndims);
+	int ndims2 = (int)roundf(s2->ndims);
+	int ndims = Min(ndims1, ndims2);
+	const float4 *widths1 = nd_stats_cell_widths(s1, vdx1);
+	const float4 *widths2 = nd_stats_cell_widths(s2, vdx2);
+	const float4 *sub1 = nd_stats_refined_cell(s1, vdx1);
+	const float4 *sub2 = nd_stats_refined_cell(s2, vdx2);
+	int rsize1 = sub1 ? (int)roundf(s1->refine_size) : 1;
+	int rsize2 = sub2 ? (int)roundf(s2->refine_size) : 1;
+	double reach[ND_DIMS];
+	ND_IBOX ibox1, ibox2;
+	int at1[ND_DIMS], at2[ND_DIMS];
+	double total = 0.0;
+	int d;
+
+	for ( d = 0; d < ndims; d++ )
+		reach[d] = expand + (widths1[d] + widths2[d]) / 2;
+
+	/* Walk all the sub-cells of each side (just the one for unrefined cells) */
+	memset(&ibox1, 0, sizeof(ND_IBOX));
+	memset(at1, 0, sizeof(int) * ND_DIMS);
+	for ( d = 0; d < ndims1; d++ )
+		ibox1.max[d] = rsize1 - 1;
+
+	do
+	{
+		ND_BOX part1;
+		int sdx1 = nd_cell_subcell(nd_cell1, rsize1, ndims1, at1, &part1);
+		double val1 = sub1 ? sub1[sdx1] : s1->value[vdx1];
+
+		if ( val1 <= 0 )
+			continue;
+
+		memset(&ibox2, 0, sizeof(ND_IBOX));
+		memset(at2, 0, sizeof(int) * ND_DIMS);
+		for ( d = 0; d < ndims2; d++ )
+			ibox2.max[d] = rsize2 - 1;
+
+		do
+		{
+			ND_BOX part2;
+			int sdx2 = nd_cell_subcell(nd_cell2, rsize2, ndims2, at2, &part2);
+			double val2 = sub2 ? sub2[sdx2] : s2->value[vdx2];
+			double prob = 1.0;
+
+			for ( d = 0; d < ndims && prob > 0 && val2 > 0; d++ )
+				prob *= nd_interval_reach_probability(part1.min[d], part1.max[d], part2.min[d], part2.max[d], reach[d]);
+
+			if ( val2 > 0 )
+				total += val1 * val2 * prob;
+		}
+		while ( nd_increment(&ibox2, ndims2, at2) );
+	}
+	while ( nd_increment(&ibox1, ndims1, at1) );
+
+	return total;
+}
+
 /**
 * Given two statistics histograms, what is the selectivity
 * of a join driven by the && or &&& operator?
@@ -1013,9 +1386,16 @@ pg_get_nd_stats_by_name(const Oid table_oid, const text *att_text, int mode, boo
 * of one histogram, and multiply the cell value by the
 * proportion of the cells in the other histogram the cell
 * overlaps: val += val1 * ( val2 * overlap_ratio )
+*
+* When both histograms carry mean feature widths per cell, we
+* instead use the chance that a feature of each cell, placed
+* anywhere in its cell, meets the other: two boxes interact when
+* their centers are closer than the sum of their half-widths
+* (plus the expand distance of a g1 && ST_Expand(g2, d) clause)
+* in every dimension. Refined cells are paired sub-cell by sub-cell.
 */
 static float8
-estimate_join_selectivity(const ND_STATS *s1, const ND_STATS *s2)
+estimate_join_selectivity(const ND_STATS *s1, const ND_STATS *s2, double expand)
 {
 	int ncells1, ncells2;
 	int ndims1, ndims2, ndims;
@@ -1034,7 +1414,10 @@ estimate_join_selectivity(const ND_STATS *s1, const ND_STATS *s2)
 	double width2[ND_DIMS];
 	double cellsize2[ND_DIMS];
 	int size1[ND_DIMS];
+	double max_width1[ND_DIMS];
+	double max_width2[ND_DIMS];
 	int d;
+	bool extents;
 	double val = 0;
 	float8 selectivity;
 
@@ -1079,6 +1462,16 @@ estimate_join_selectivity(const ND_STATS *s1, const ND_STATS *s2)
 	extent1 = s1->extent;
 	extent2 = s2->extent;
 
+	/* Can we work from feature sizes, or only from cell overlaps? */
+	extents = s1->cell_extents && s2->cell_extents;
+
+	/* Expanded join? Then the extents have to meet after expansion. */
+	for ( d = 0; d < ndims; d++ )
+	{
+		extent2.min[d] -= expand;
+		extent2.max[d] += expand;
+	}
+
 	/* If relation stats do not intersect, join is very very selective. */
 	if ( ! nd_box_intersects(&extent1, &extent2, ndims) )
 	{
@@ -1088,8 +1481,15 @@ estimate_join_selectivity(const ND_STATS *s1, const ND_STATS *s2)
 
 	/*
 	 * First find the index range of the part of the smaller
-	 * histogram that overlaps the larger one.
+	 * histogram that overlaps the larger one, allowing for
+	 * the features of the smaller one reaching out of their cells.
 	 */
+	nd_stats_max_widths(s1, max_width1);
+	for ( d = 0; d < ndims; d++ )
+	{
+		extent2.min[d] -= max_width1[d] / 2;
+		extent2.max[d] += max_width1[d] / 2;
+	}
 	if ( ! nd_box_overlap(s1, &extent2, &ibox1) )
 	{
 		POSTGIS_DEBUG(3, "could not calculate overlap of relations");
@@ -1114,13 +1514,16 @@ estimate_join_selectivity(const ND_STATS *s1, const ND_STATS *s2)
 		size2[d] = (int)roundf(s2->size[d]);
 		cellsize2[d] = width2[d] / size2[d];
 	}
+	nd_stats_max_widths(s2, max_width2);
 
 	/* For each affected cell of s1... */
 	do
 	{
 		double val1;
+		const float4 *widths1;
+		int vdx1 = nd_stats_value_index(s1, at1);
 		/* Construct the bounds of this cell */
-		ND_BOX nd_cell1;
+		ND_BOX nd_cell1, nd_search;
 		nd_box_init(&nd_cell1);
 		for ( d = 0; d < ndims1; d++ )
 		{
@@ -1128,8 +1531,20 @@ estimate_join_selectivity(const ND_STATS *s1, const ND_STATS *s2)
 			nd_cell1.max[d] = min1[d] + (at1[d]+1) * cellsize1[d];
 		}
 
+		/* Grow the cell by as far as its features can reach */
+		widths1 = nd_stats_cell_widths(s1, vdx1);
+		nd_search = nd_cell1;
+		for ( d = 0; d < ndims1; d++ )
+		{
+			double reach = expand;
+			if ( extents )
+				reach += (widths1[d] + max_width2[d]) / 2;
+			nd_search.min[d] -= reach;
+			nd_search.max[d] += reach;
+		}
+
 		/* Find the cells of s2 that cell1 overlaps.. */
-		nd_box_overlap(s2, &nd_cell1, &ibox2);
+		nd_box_overlap(s2, &nd_search, &ibox2);
 
 		/* Initialize counter */
 		for ( d = 0; d < ndims2; d++ )
@@ -1140,13 +1555,18 @@ estimate_join_selectivity(const ND_STATS *s1, const ND_STATS *s2)
 		POSTGIS_DEBUGF(3, "at1 %d,%d  %s", at1[0], at1[1], nd_box_to_json(&nd_cell1, ndims1));
 
 		/* Get the value at this cell */
-		val1 = s1->value[nd_stats_value_index(s1, at1)];
+		val1 = s1->value[vdx1];
+
+		/* No features here, nothing to join */
+		if ( extents && val1 <= 0 )
+			continue;
 
 		/* For each overlapped cell of s2... */
 		do
 		{
 			double ratio2;
 			double val2;
+			int vdx2 = nd_stats_value_index(s2, at2);
 
 			/* Construct the bounds of this cell */
 			ND_BOX nd_cell2;
@@ -1159,11 +1579,19 @@ estimate_join_selectivity(const ND_STATS *s1, const ND_STATS *s2)
 
 			POSTGIS_DEBUGF(3, "  at2 %d,%d  %s", at2[0], at2[1], nd_box_to_json(&nd_cell2, ndims2));
 
+			val2 = s2->value[vdx2];
+			if ( extents )
+			{
+				/* Expected number of meeting pairs of features of the two cells */
+				val += nd_cells_join_count(s1, vdx1, &nd_cell1, s2, vdx2, &nd_cell2, expand);
+				POSTGIS_DEBUGF(3, "  val1 %.6g  val2 %.6g  val %.6g", val1, val2, val);
+				continue;
+			}
+
 			/* Calculate overlap ratio of the cells */
-			ratio2 = nd_box_ratio(&nd_cell1, &nd_cell2, Max(ndims1, ndims2));
+			ratio2 = nd_box_ratio(&nd_search, &nd_cell2, Max(ndims1, ndims2));
 
 			/* Multiply the cell counts, scaled by overlap ratio */
-			val2 = s2->value[nd_stats_value_index(s2, at2)];
 			POSTGIS_DEBUGF(3, "  val1 %.6g  val2 %.6g  ratio %.6g", val1, val2, ratio2);
 			val += val1 * (val2 * ratio2);
 		}
@@ -1245,6 +1673,49 @@ Datum gserialized_gist_joinsel_2d(PG_FUNCTION_ARGS)
 	));
 }
 
+/**
+* Read an argument of a join clause: either a plain column
+* reference, or ST_Expand(column, distance) as found in the
+* inlined form of ST_DWithin. Returns NULL for anything else.
+*/
+static Var *
+gserialized_joinsel_arg(Node *arg, double *expand)
+{
+	*expand = 0.0;
+
+	if ( IsA(arg, Var) )
+		return (Var*) arg;
+
+	if ( IsA(arg, FuncExpr) )
+	{
+		FuncExpr *fexpr = (FuncExpr*) arg;
+		Node *geom_arg, *dist_arg;
+		Const *dist;
+		char *func_name;
+
+		if ( list_length(fexpr->args) != 2 )
+			return NULL;
+
+		geom_arg = (Node*) linitial(fexpr->args);
+		dist_arg = (Node*) lsecond(fexpr->args);
+		if ( ! IsA(geom_arg, Var) || ! IsA(dist_arg, Const) )
+			return NULL;
+
+		dist = (Const*) dist_arg;
+		if ( dist->constisnull || dist->consttype != FLOAT8OID )
+			return NULL;
+
+		func_name = get_func_name(fexpr->funcid);
+		if ( ! func_name || strcmp(func_name, "st_expand") != 0 )
+			return NULL;
+
+		*expand = Max(DatumGetFloat8(dist->constvalue), 0.0);
+		return (Var*) geom_arg;
+	}
+
+	return NULL;
+}
+
 /**
 * Join selectivity of the && operator. The selectivity
 * is the ratio of the number of rows we think will be
@@ -1265,6 +1736,7 @@ Datum gserialized_gist_joinsel(PG_FUNCTION_ARGS)
 	Node *arg1, *arg2;
 	Var *var1, *var2;
 	Oid relid1, relid2;
+	double expand1, expand2;
 
 	ND_STATS *stats1, *stats2;
 	float8 selectivity;
@@ -1279,12 +1751,11 @@ Datum gserialized_gist_joinsel(PG_FUNCTION_ARGS)
 	/* Find Oids of the geometry columns we are working with */
 	arg1 = (Node*) linitial(args);
 	arg2 = (Node*) lsecond(args);
-	var1 = (Var*) arg1;
-	var2 = (Var*) arg2;
+	var1 = gserialized_joinsel_arg(arg1, &expand1);
+	var2 = gserialized_joinsel_arg(arg2, &expand2);
 
-	/* We only do column joins right now, no functional joins */
-	/* TODO: handle g1 && ST_Expand(g2) */
-	if (!IsA(arg1, Var) || !IsA(arg2, Var))
+	/* We only do column joins, or g1 && ST_Expand(g2, d) joins */
+	if ( ! var1 || ! var2 )
 	{
 		elog(DEBUG1, "%s called with arguments that are not column references", __func__);
 		PG_RETURN_FLOAT8(DEFAULT_ND_JOINSEL);
@@ -1313,7 +1784,7 @@ Datum gserialized_gist_joinsel(PG_FUNCTION_ARGS)
 		PG_RETURN_FLOAT8(DEFAULT_ND_JOINSEL);
 	}
 
-	selectivity = estimate_join_selectivity(stats1, stats2);
+	selectivity = estimate_join_selectivity(stats1, stats2, expand1 + expand2);
 	POSTGIS_DEBUGF(2, "got selectivity %g", selectivity);
 
 	pfree(stats1);
@@ -1380,6 +1851,13 @@ compute_gserialized_stats_mode(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfu
 	int stats_slot;                     /* What slot is this data going into? (2D vs ND) */
 	int stats_kind;                     /* And this is what? (2D vs ND) */
 
+	double *cell_widths;                /* Sum of clipped feature widths per cell and dimension */
+	int    *refined_index;              /* Position of each refined cell in refined_counts, or -1 */
+	double *refined_counts;             /* Sub-histograms of the refined cells */
+	int    refine_size;                 /* Sub-histogram size in each dimension */
+	int    refine_subcells;             /* Number of sub-cells per refined cell */
+	int    refined_cells = 0;           /* Number of refined cells */
+
 	/* Initialize sum and stddev */
 	nd_box_init(&sum);
 	nd_box_init(&stddev);
@@ -1675,6 +2153,9 @@ compute_gserialized_stats_mode(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfu
 	for ( d = 0; d < ndims; d++ )
 		nd_stats->size[d] = histo_size[d];
 
+	/* Room to sum up the widths of the features falling in each cell */
+	cell_widths = palloc0(sizeof(double) * histo_cells * ndims);
+
 	/*
 	 * Fourth scan:
 	 *  o fill histogram values with the proportion of
@@ -1687,13 +2168,17 @@ compute_gserialized_stats_mode(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfu
 	 * up the values in the histogram, we could get the
 	 * histogram feature count.
 	 *
+	 *  o sum up the widths of the part of each feature
+	 *    falling in each cell, weighted by the same proportion,
+	 *    so we can work out the mean feature size per cell
+	 *
 	 */
 	for ( i = 0; i < notnull_cnt; i++ )
 	{
 		const ND_BOX *nd_box;
 		ND_IBOX nd_ibox;
 		int at[ND_DIMS];
-		int d;
+		int d, vdx;
 		double num_cells = 0;
 		double tmp_volume = 1.0;
 		double min[ND_DIMS] = {0.0, 0.0, 0.0, 0.0};
@@ -1750,8 +2235,16 @@ compute_gserialized_stats_mode(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfu
 			 * 0.5 added on.
 			 */
 			ratio = nd_box_ratio(&nd_cell, nd_box, nd_stats->ndims);
-			nd_stats->value[nd_stats_value_index(nd_stats, at)] += ratio;
+			vdx = nd_stats_value_index(nd_stats, at);
+			nd_stats->value[vdx] += ratio;
 			num_cells += ratio;
+
+			/* Width of the part of the feature that falls in this cell */
+			for ( d = 0; d < nd_stats->ndims && ratio > 0; d++ )
+			{
+				double clipped = Min(nd_box->max[d], nd_cell.max[d]) - Max(nd_box->min[d], nd_cell.min[d]);
+				cell_widths[vdx * ndims + d] += ratio * Max(clipped, 0.0);
+			}
 			POSTGIS_DEBUGF(3, "               ratio (%.8g)  num_cells (%.8g)", ratio, num_cells);
 			POSTGIS_DEBUGF(3, "               at (%d, %d, %d, %d)", at[0], at[1], at[2], at[3]);
 		}
@@ -1780,6 +2273,158 @@ compute_gserialized_stats_mode(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfu
 	nd_stats->histogram_cells = histo_cells;
 	nd_stats->cells_covered = total_cell_count;
 
+	/*
+	 * Find the dense cells: those holding many times the count of the
+	 * average occupied cell. Those get refined into a sub-histogram,
+	 * the densest ones first, so skewed data keeps its shape inside
+	 * the cells where most of the features live.
+	 */
+	refine_size = (ndims == 2) ? 4 : 2;
+	refine_subcells = (int)pow((double)refine_size, (double)ndims);
+	refined_index = palloc(sizeof(int) * histo_cells);
+	{
+		int occupied = 0;
+		double threshold;
+		int *candidates = palloc(sizeof(int) * histo_cells);
+		int ncandidates = 0;
+
+		for ( i = 0; i < histo_cells; i++ )
+		{
+			refined_index[i] = -1;
+			if ( nd_stats->value[i] > 0 )
+				occupied++;
+		}
+		threshold = Max(ND_REFINE_FACTOR * total_cell_count / Max(occupied, 1), ND_REFINE_MIN_FEATURES);
+
+		for ( i = 0; i < histo_cells; i++ )
+		{
+			if ( nd_stats->value[i] > threshold )
+				candidates[ncandidates++] = i;
+		}
+
+		/* Too many? Keep the densest ones. */
+		while ( ncandidates > ND_REFINE_MAX_CELLS )
+		{
+			int k, sparsest = 0;
+			for ( k = 1; k < ncandidates; k++ )
+			{
+				if ( nd_stats->value[candidates[k]] < nd_stats->value[candidates[sparsest]] )
+					sparsest = k;
+			}
+			memmove(candidates + sparsest, candidates + sparsest + 1, sizeof(int) * (ncandidates - sparsest - 1));
+			ncandidates--;
+		}
+
+		/* Candidates are in cell order, which is the order we store them in */
+		for ( i = 0; i < ncandidates; i++ )
+			refined_index[candidates[i]] = refined_cells++;
+
+		pfree(candidates);
+	}
+	POSTGIS_DEBUGF(3, " refined_cells: %d", refined_cells);
+
+	/*
+	 * Fifth scan:
+	 *  o fill the sub-histograms of the refined cells, the same
+	 *    way as the main histogram
+	 */
+	refined_counts = palloc0(sizeof(double) * Max(refined_cells, 1) * refine_subcells);
+	for ( i = 0; refined_cells && i < notnull_cnt; i++ )
+	{
+		const ND_BOX *nd_box = sample_boxes[i];
+		ND_IBOX nd_ibox;
+		int at[ND_DIMS];
+
+		if ( ! nd_box ) continue; /* Skip Null'ed out hard deviants */
+
+		vacuum_delay_point();
+
+		nd_box_overlap(nd_stats, nd_box, &nd_ibox);
+		memset(at, 0, sizeof(int)*ND_DIMS);
+		for ( d = 0; d < ndims; d++ )
+			at[d] = nd_ibox.min[d];
+
+		do
+		{
+			ND_BOX nd_cell;
+			ND_IBOX sub_ibox;
+			int sub_at[ND_DIMS];
+			int rdx = refined_index[nd_stats_value_index(nd_stats, at)];
+
+			if ( rdx < 0 ) continue;
+
+			nd_box_init(&nd_cell);
+			for ( d = 0; d < ndims; d++ )
+			{
+				double cellsize = (nd_stats->extent.max[d] - nd_stats->extent.min[d]) / nd_stats->size[d];
+				nd_cell.min[d] = nd_stats->extent.min[d] + (at[d]+0) * cellsize;
+				nd_cell.max[d] = nd_stats->extent.min[d] + (at[d]+1) * cellsize;
+			}
+
+			nd_cell_subcell_overlap(&nd_cell, refine_size, ndims, nd_box, &sub_ibox);
+			for ( d = 0; d < ndims; d++ )
+				sub_at[d] = sub_ibox.min[d];
+
+			do
+			{
+				ND_BOX nd_sub;
+				int sdx = nd_cell_subcell(&nd_cell, refine_size, ndims, sub_at, &nd_sub);
+				refined_counts[rdx * refine_subcells + sdx] += nd_box_ratio(&nd_sub, nd_box, ndims);
+			}
+			while ( nd_increment(&sub_ibox, ndims, sub_at) );
+		}
+		while ( nd_increment(&nd_ibox, ndims, at) );
+	}
+
+	/*
+	 * Now that we know how many cells got refined, re-create the
+	 * histogram with room for the cell extents and sub-histograms
+	 * after the cell counts.
+	 */
+	{
+		ND_STATS *nd_stats_full;
+		float4 *widths, *refined;
+		size_t counts_size = nd_stats_size;
+
+		nd_stats_size += sizeof(float4) * histo_cells * ndims;
+		nd_stats_size += sizeof(float4) * refined_cells * (1 + refine_subcells);
+
+		old_context = MemoryContextSwitchTo(stats->anl_context);
+		nd_stats_full = palloc0(nd_stats_size);
+		MemoryContextSwitchTo(old_context);
+
+		memcpy(nd_stats_full, nd_stats, counts_size);
+		pfree(nd_stats);
+		nd_stats = nd_stats_full;
+
+		nd_stats->cell_extents = 1;
+		nd_stats->refined_cells = refined_cells;
+		nd_stats->refine_size = refine_size;
+
+		/* Mean width of the features in each cell */
+		widths = nd_stats->value + histo_cells;
+		for ( i = 0; i < histo_cells; i++ )
+		{
+			if ( nd_stats->value[i] <= 0 ) continue;
+			for ( d = 0; d < ndims; d++ )
+				widths[i * ndims + d] = cell_widths[i * ndims + d] / nd_stats->value[i];
+		}
+
+		/* Sub-histograms, keyed by cell index */
+		refined = widths + histo_cells * ndims;
+		for ( i = 0; i < histo_cells; i++ )
+		{
+			int k, rdx = refined_index[i];
+			if ( rdx < 0 ) continue;
+			*refined++ = i;
+			for ( k = 0; k < refine_subcells; k++ )
+				*refined++ = refined_counts[rdx * refine_subcells + k];
+		}
+	}
+	pfree(cell_widths);
+	pfree(refined_index);
+	pfree(refined_counts);
+
 	/* Put this histogram data into the right slot/kind */
 	if ( mode == 2 )
 	{
@@ -1908,6 +2553,13 @@ Datum gserialized_analyze_nd(PG_FUNCTION_ARGS)
 * we need "only" sum up the values * the proportion of each cell
 * in the histogram that falls within the search box, then
 * divide by the number of features that generated the histogram.
+*
+* Features are not points though: a feature of width w hits the
+* search box when its center lies within w/2 of it. So when the
+* stats carry the mean feature width of each cell, the search box
+* is grown by half that width before working out the proportion
+* of the cell it covers. Cells with a refined sub-histogram that
+* are only partly covered are pro-rated sub-cell by sub-cell.
 */
 static float8
 estimate_selectivity(const GBOX *box, const ND_STATS *nd_stats, int mode)
@@ -1920,8 +2572,10 @@ estimate_selectivity(const GBOX *box, const ND_STATS *nd_stats, int mode)
 	double cell_size[ND_DIMS];
 	double min[ND_DIMS];
 	double max[ND_DIMS];
+	double max_width[ND_DIMS];
 	double total_count = 0.0;
 	int ndims_max;
+	ND_BOX search_box;
 
 	/* Calculate the overlap of the box on the histogram */
 	if ( ! nd_stats )
@@ -1970,8 +2624,20 @@ estimate_selectivity(const GBOX *box, const ND_STATS *nd_stats, int mode)
 		return 1.0;
 	}
 
+	/*
+	 * Cells beyond the box can still hold features reaching into
+	 * it, so widen the cells we visit by the largest feature half-width
+	 */
+	nd_stats_max_widths(nd_stats, max_width);
+	search_box = nd_box;
+	for ( d = 0; d < nd_stats->ndims; d++ )
+	{
+		search_box.min[d] -= max_width[d] / 2;
+		search_box.max[d] += max_width[d] / 2;
+	}
+
 	/* Calculate the overlap of the box on the histogram */
-	if ( ! nd_box_overlap(nd_stats, &nd_box, &nd_ibox) )
+	if ( ! nd_box_overlap(nd_stats, &search_box, &nd_ibox) )
 	{
 		POSTGIS_DEBUG(3, " search box overlap with stats histogram failed");
 		return FALLBACK_ND_SEL;
@@ -1995,6 +2661,9 @@ estimate_selectivity(const GBOX *box, const ND_STATS *nd_stats, int mode)
 	{
 		float cell_count, ratio;
 		ND_BOX nd_cell = { {0.0, 0.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 0.0} };
+		ND_BOX nd_hit = nd_box;
+		const float4 *widths, *subcells;
+		int vdx = nd_stats_value_index(nd_stats, at);
 
 		/* We have to pro-rate partially overlapped cells. */
 		for ( d = 0; d < nd_stats->ndims; d++ )
@@ -2003,11 +2672,27 @@ estimate_selectivity(const GBOX *box, const ND_STATS *nd_stats, int mode)
 			nd_cell.max[d] = min[d] + (at[d]+1) * cell_size[d];
 		}
 
-		ratio = nd_box_ratio(&nd_box, &nd_cell, nd_stats->ndims);
-		cell_count = nd_stats->value[nd_stats_value_index(nd_stats, at)];
+		/* Grow the box by the half-width of the features in this cell */
+		widths = nd_stats_cell_widths(nd_stats, vdx);
+		for ( d = 0; widths && d < nd_stats->ndims; d++ )
+		{
+			nd_hit.min[d] -= widths[d] / 2;
+			nd_hit.max[d] += widths[d] / 2;
+		}
+
+		ratio = nd_box_ratio(&nd_hit, &nd_cell, nd_stats->ndims);
+		cell_count = nd_stats->value[vdx];
+
+		/* Partly covered dense cell? Use its sub-histogram. */
+		subcells = NULL;
+		if ( ratio > 0.0 && ratio < 1.0 )
+			subcells = nd_stats_refined_cell(nd_stats, vdx);
 
 		/* Add the pro-rated count for this cell to the overall total */
-		total_count += cell_count * ratio;
+		if ( subcells )
+			total_count += nd_refined_cell_count(nd_stats, subcells, &nd_cell, &nd_hit);
+		else
+			total_count += cell_count * ratio;
 		POSTGIS_DEBUGF(4, " cell (%d,%d), cell value %.6f, ratio %.6f", at[0], at[1], cell_count, ratio);
 	}
 	while ( nd_increment(&nd_ibox, nd_stats->ndims, at) );
@@ -2141,7 +2826,7 @@ Datum _postgis_gserialized_joinsel(PG_FUNCTION_ARGS)
 	}
 
 	/* Do the estimation */
-	selectivity = estimate_join_selectivity(nd_stats1, nd_stats2);
+	selectivity = estimate_join_selectivity(nd_stats1, nd_stats2, 0.0);
 
 	pfree(nd_stats1);
 	pfree(nd_stats2);
@@ -2277,6 +2962,123 @@ Datum gserialized_gist_sel(PG_FUNCTION_ARGS)
 
 
 
+/**
+* The 2D extent of a histogram, as a new box.
+*/
+static GBOX *
+nd_stats_extent_to_gbox(const ND_STATS *nd_stats)
+{
+	GBOX *gbox = palloc(sizeof(GBOX));
+	FLAGS_SET_GEODETIC(gbox->flags, 0);
+	FLAGS_SET_Z(gbox->flags, 0);
+	FLAGS_SET_M(gbox->flags, 0);
+	gbox->xmin = nd_stats->extent.min[0];
+	gbox->xmax = nd_stats->extent.max[0];
+	gbox->ymin = nd_stats->extent.min[1];
+	gbox->ymax = nd_stats->extent.max[1];
+	return gbox;
+}
+
+/**
+* Estimated 2D extent of a single relation: the union of the
+* boxes at the head of its spatial index if it has one, else
+* the extent of its statistics. NULL if neither is available.
+*/
+static GBOX *
+relation_estimated_extent(Oid tbl_oid, text *col, bool only_parent)
+{
+	GBOX *gbox = NULL;
+	ND_STATS *nd_stats;
+	char relkind = get_rel_relkind(tbl_oid);
+
+	/* Read the extent from the head of the spatial index, if there is one */
+	if ( relkind == RELKIND_RELATION || relkind == RELKIND_MATVIEW )
+	{
+		int key_type;
+		Oid idx_oid = table_get_spatial_index(tbl_oid, col, &key_type);
+		if (!idx_oid)
+			elog(DEBUG2, "index for \"%s.%s\" does not exist", get_rel_name(tbl_oid), text_to_cstring(col));
+		gbox = spatial_index_read_extent(idx_oid, key_type);
+	}
+	if ( gbox )
+		return gbox;
+
+	/* Fall back to reading the stats, if no index answer */
+	/* Estimated extent only returns 2D bounds, so use mode 2 */
+	nd_stats = pg_get_nd_stats_by_name(tbl_oid, col, 2, only_parent);
+	if ( ! nd_stats )
+		return NULL;
+
+	gbox = nd_stats_extent_to_gbox(nd_stats);
+	pfree(nd_stats);
+	return gbox;
+}
+
+/**
+* True if the last VACUUM or ANALYZE found the relation empty
+* (or it was never looked at).
+*/
+static bool
+relation_is_empty(Oid rel_oid)
+{
+	HeapTuple tp;
+	bool empty = true;
+
+	tp = SearchSysCache1(RELOID, ObjectIdGetDatum(rel_oid));
+	if ( HeapTupleIsValid(tp) )
+	{
+		Form_pg_class reltup = (Form_pg_class) GETSTRUCT(tp);
+		empty = reltup->reltuples <= 0 && reltup->relpages == 0;
+		ReleaseSysCache(tp);
+	}
+	return empty;
+}
+
+/**
+* Estimated extent of an inheritance tree or partitioned table,
+* merging the extents of every member. Used when the parent has
+* no whole-tree statistics, as partitioned parents usually don't
+* (autovacuum never analyzes them). Members with rows but neither
+* an index nor statistics are skipped with a warning.
+*/
+static GBOX *
+inheritance_estimated_extent(Oid tbl_oid, text *col)
+{
+	List *rels = find_all_inheritors(tbl_oid, AccessShareLock, NULL);
+	ListCell *lc;
+	GBOX *gbox = NULL;
+
+	foreach(lc, rels)
+	{
+		Oid rel_oid = lfirst_oid(lc);
+		GBOX *rel_box;
+
+#if POSTGIS_PGSQL_VERSION >= 100
+		/* Partitioned tables hold no rows of their own */
+		if ( get_rel_relkind(rel_oid) == RELKIND_PARTITIONED_TABLE )
+			continue;
+#endif
+
+		rel_box = relation_estimated_extent(rel_oid, col, true);
+		if ( ! rel_box )
+		{
+			if ( ! relation_is_empty(rel_oid) )
+				elog(WARNING, "stats for \"%s.%s\" do not exist", get_rel_name(rel_oid), text_to_cstring(col));
+			continue;
+		}
+
+		if ( gbox )
+		{
+			gbox_merge(rel_box, gbox);
+			pfree(rel_box);
+		}
+		else
+			gbox = rel_box;
+	}
+	list_free(rels);
+	return gbox;
+}
+
 /**
  * Return the estimated extent of the table
  * looking at gathered statistics (or NULL if
@@ -2289,11 +3091,10 @@ Datum gserialized_estimated_extent(PG_FUNCTION_ARGS)
 	char *tbl = NULL;
 	text *col = NULL;
 	char *nsp_tbl = NULL;
-	Oid tbl_oid, idx_oid;
+	Oid tbl_oid;
 	ND_STATS *nd_stats;
 	GBOX *gbox = NULL;
 	bool only_parent = false;
-	int key_type;
 
 	if ( PG_NARGS() == 4 )
 	{
@@ -2331,36 +3132,29 @@ Datum gserialized_estimated_extent(PG_FUNCTION_ARGS)
 		PG_RETURN_NULL();
 	}
 
-#if 1
-	/* Read the extent from the head of the spatial index, if there is one */
-	idx_oid = table_get_spatial_index(tbl_oid, col, &key_type);
-	if (!idx_oid)
-		elog(DEBUG2, "index for \"%s.%s\" does not exist", tbl, text_to_cstring(col));
-	gbox = spatial_index_read_extent(idx_oid, key_type);
-#endif
-
-	/* Fall back to reading the stats, if no index answer */
-	if (!gbox)
+	if ( ! only_parent && has_subclass(tbl_oid) )
 	{
-		/* Estimated extent only returns 2D bounds, so use mode 2 */
-		nd_stats = pg_get_nd_stats_by_name(tbl_oid, col, 2, only_parent);
-
-		/* Error out on no stats */
-		if ( ! nd_stats ) {
-			elog(WARNING, "stats for \"%s.%s\" do not exist", tbl, text_to_cstring(col));
-			PG_RETURN_NULL();
+		/*
+		 * Whole-tree stats from an ANALYZE of the parent cover every
+		 * member at once; without them, merge the members' extents.
+		 */
+		nd_stats = pg_get_nd_stats_by_name(tbl_oid, col, 2, false);
+		if ( nd_stats )
+		{
+			gbox = nd_stats_extent_to_gbox(nd_stats);
+			pfree(nd_stats);
 		}
+		else
+			gbox = inheritance_estimated_extent(tbl_oid, col);
+	}
+	else
+		gbox = relation_estimated_extent(tbl_oid, col, only_parent);
 
-		/* Construct the box */
-		gbox = palloc(sizeof(GBOX));
-		FLAGS_SET_GEODETIC(gbox->flags, 0);
-		FLAGS_SET_Z(gbox->flags, 0);
-		FLAGS_SET_M(gbox->flags, 0);
-		gbox->xmin = nd_stats->extent.min[0];
-		gbox->xmax = nd_stats->extent.max[0];
-		gbox->ymin = nd_stats->extent.min[1];
-		gbox->ymax = nd_stats->extent.max[1];
-		pfree(nd_stats);
+	/* Error out on no stats */
+	if ( ! gbox )
+	{
+		elog(WARNING, "stats for \"%s.%s\" do not exist", tbl, text_to_cstring(col));
+		PG_RETURN_NULL();
 	}
 
 	PG_RETURN_POINTER(gbox);
@@ -2487,8 +3281,9 @@ spatial_index_read_extent(Oid idx_oid, int key_type)
 	if (!idx_oid)
 		return NULL;
 
-	idx_rel = index_open(idx_oid, AccessExclusiveLock);
+	idx_rel = index_open(idx_oid, AccessShareLock);
 	buffer = ReadBuffer(idx_rel, GIST_ROOT_BLKNO);
+	LockBuffer(buffer, GIST_SHARE);
 	page = (Page) BufferGetPage(buffer);
 	offset = FirstOffsetNumber;
 	offset_max = PageGetMaxOffsetNumber(page);
@@ -2498,8 +3293,8 @@ spatial_index_read_extent(Oid idx_oid, int key_type)
 		IndexTuple ituple;
 		if (!iid)
 		{
-			ReleaseBuffer(buffer);
-			index_close(idx_rel, AccessExclusiveLock);
+			UnlockReleaseBuffer(buffer);
+			index_close(idx_rel, AccessShareLock);
 			return NULL;
 		}
 		ituple = (IndexTuple) PageGetItem(page, iid);
@@ -2530,8 +3325,8 @@ spatial_index_read_extent(Oid idx_oid, int key_type)
 		offset++;
 	}
 
-	ReleaseBuffer(buffer);
-	index_close(idx_rel, AccessExclusiveLock);
+	UnlockReleaseBuffer(buffer);
+	index_close(idx_rel, AccessShareLock);
 
 	if (key_type == STATISTIC_SLOT_2D && bounds_2df)
 	{
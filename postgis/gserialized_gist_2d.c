@@ -98,6 +98,11 @@ Datum gserialized_gist_picksplit_2d(PG_FUNCTION_ARGS);
 Datum gserialized_gist_union_2d(PG_FUNCTION_ARGS);
 Datum gserialized_gist_same_2d(PG_FUNCTION_ARGS);
 Datum gserialized_gist_distance_2d(PG_FUNCTION_ARGS);
+#if POSTGIS_PGSQL_VERSION >= 95
+Datum gserialized_gist_fetch_2d(PG_FUNCTION_ARGS);
+Datum gserialized_gist_compress_box2df(PG_FUNCTION_ARGS);
+Datum gserialized_gist_consistent_box2df(PG_FUNCTION_ARGS);
+#endif
 
 /*
 ** GiST 2D operator prototypes
@@ -126,6 +131,11 @@ Datum gserialized_overlaps_box2df_geom_2d(PG_FUNCTION_ARGS);
 Datum gserialized_overlaps_box2df_box2df_2d(PG_FUNCTION_ARGS);
 #endif
 
+#if POSTGIS_PGSQL_VERSION >= 95
+Datum gserialized_to_box2df(PG_FUNCTION_ARGS);
+Datum box2df_to_box2d(PG_FUNCTION_ARGS);
+#endif
+
 /*
 ** true/false test function type
 */
@@ -1477,6 +1487,112 @@ Datum gserialized_gist_same_2d(PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(result);
 }
 
+#if POSTGIS_PGSQL_VERSION >= 95
+/***********************************************************************
+* GiST 2-D support for indexes built directly over BOX2DF values.
+*
+* The geometry opclass stores a lossy BOX2DF key, so it cannot give the
+* original geometry back and index-only scans are impossible. An index on
+* the box2df(geom) expression stores exactly the value it was given, so
+* the key can be handed back through the 'fetch' support function and
+* bounding box queries (counts, extents) can be answered from the index
+* alone, plus any INCLUDE columns on servers that support them.
+*/
+
+/*
+** Return the float index box of a geometry, or NULL for EMPTY.
+*/
+PG_FUNCTION_INFO_V1(gserialized_to_box2df);
+Datum gserialized_to_box2df(PG_FUNCTION_ARGS)
+{
+	BOX2DF box;
+
+	if ( gserialized_datum_get_box2df_p(PG_GETARG_DATUM(0), &box) == LW_FAILURE )
+		PG_RETURN_NULL();
+
+	box2df_validate(&box);
+	PG_RETURN_POINTER(box2df_copy(&box));
+}
+
+/*
+** Widen a float index box back into a box2d.
+*/
+PG_FUNCTION_INFO_V1(box2df_to_box2d);
+Datum box2df_to_box2d(PG_FUNCTION_ARGS)
+{
+	BOX2DF *box = (BOX2DF*)PG_GETARG_POINTER(0);
+	GBOX gbox;
+
+	if ( box2df_is_empty(box) )
+		PG_RETURN_NULL();
+
+	box2df_to_gbox_p(box, &gbox);
+	PG_RETURN_POINTER(gbox_copy(&gbox));
+}
+
+/*
+** GiST support function. The input is already a BOX2DF and is stored
+** as it is, so the leaf keys are exact and fetch returns the indexed
+** value.
+*/
+PG_FUNCTION_INFO_V1(gserialized_gist_compress_box2df);
+Datum gserialized_gist_compress_box2df(PG_FUNCTION_ARGS)
+{
+	POSTGIS_DEBUG(4, "[GIST] 'compress_box2df' function called");
+	PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+}
+
+/*
+** GiST support function. Same as gserialized_gist_consistent_2d, but the
+** query argument is a BOX2DF rather than a geometry.
+*/
+PG_FUNCTION_INFO_V1(gserialized_gist_consistent_box2df);
+Datum gserialized_gist_consistent_box2df(PG_FUNCTION_ARGS)
+{
+	GISTENTRY *entry = (GISTENTRY*) PG_GETARG_POINTER(0);
+	BOX2DF *query = (BOX2DF*) PG_GETARG_POINTER(1);
+	StrategyNumber strategy = (StrategyNumber) PG_GETARG_UINT16(2);
+	bool *recheck = (bool *) PG_GETARG_POINTER(4);
+	bool result;
+
+	/* Keys are exact, there is never anything to recheck. */
+	*recheck = false;
+
+	POSTGIS_DEBUG(4, "[GIST] 'consistent_box2df' function called");
+
+	if ( query == NULL || DatumGetPointer(entry->key) == NULL )
+		PG_RETURN_BOOL(false);
+
+	if (GIST_LEAF(entry))
+		result = gserialized_gist_consistent_leaf_2d(
+		             (BOX2DF*)DatumGetPointer(entry->key), query, strategy);
+	else
+		result = gserialized_gist_consistent_internal_2d(
+		             (BOX2DF*)DatumGetPointer(entry->key), query, strategy);
+
+	PG_RETURN_BOOL(result);
+}
+
+/*
+** GiST support function. Reconstruct the indexed value from a leaf key,
+** enabling index-only scans. For BOX2DF indexes the key is the value.
+*/
+PG_FUNCTION_INFO_V1(gserialized_gist_fetch_2d);
+Datum gserialized_gist_fetch_2d(PG_FUNCTION_ARGS)
+{
+	GISTENTRY *entry_in = (GISTENTRY*)PG_GETARG_POINTER(0);
+	GISTENTRY *entry_out = palloc(sizeof(GISTENTRY));
+
+	POSTGIS_DEBUG(4, "[GIST] 'fetch' function called");
+
+	gistentryinit(*entry_out,
+	              PointerGetDatum(box2df_copy((BOX2DF*)DatumGetPointer(entry_in->key))),
+	              entry_in->rel, entry_in->page, entry_in->offset, false);
+
+	PG_RETURN_POINTER(entry_out);
+}
+#endif /* POSTGIS_PGSQL_VERSION >= 95 */
+
 #if KOROTKOV_SPLIT > 0
 /*
  * Adjust BOX2DF b boundaries with insertion of addon.
@@ -136,8 +136,8 @@ Datum lwgeom_hash(PG_FUNCTION_ARGS)
 	/* Point to just the type/coordinate part of buffer */
 	size_t hsz1 = gserialized_header_size(g1);
 	uint8_t *b1 = (uint8_t*)g1 + hsz1;
-	/* Calculate size of type/coordinate buffer */
-	size_t sz1 = VARSIZE(g1);
+	/* Calculate size of type/coordinate buffer, leaving out any index */
+	size_t sz1 = VARSIZE(g1) - gserialized_index_size(g1);
 	size_t bsz1 = sz1 - hsz1;
 	/* Calculate size of srid/type/coordinate buffer */
 	int srid = gserialized_get_srid(g1);
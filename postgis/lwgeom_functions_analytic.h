@@ -23,14 +23,12 @@
  **********************************************************************/
 
 
-#include "lwgeom_rtree.h"
+#include "liblwgeom.h"
 
 /*
 ** Public prototypes for analytic functions.
 */
 
-int point_in_polygon_rtree(RTREE_NODE **root, int ringCount, LWPOINT *point);
-int point_in_multipolygon_rtree(RTREE_NODE **root, int polyCount, int *ringCounts, LWPOINT *point);
 int point_in_polygon(LWPOLY *polygon, LWPOINT *point);
 int point_in_multipolygon(LWMPOLY *mpolygon, LWPOINT *pont);
 
@@ -34,6 +34,8 @@
 #include "../postgis_config.h"
 #include "liblwgeom.h"
 #include "lwgeom_pg.h"
+#include "lwgeom_cache.h"
+#include "lwgeom_rectree.h"
 
 #include <math.h>
 #include <float.h>
@@ -55,6 +57,7 @@ Datum postgis_lib_version(PG_FUNCTION_ARGS);
 Datum postgis_svn_version(PG_FUNCTION_ARGS);
 Datum postgis_libxml_version(PG_FUNCTION_ARGS);
 Datum postgis_lib_build_date(PG_FUNCTION_ARGS);
+Datum _postgis_geom_cache_stats(PG_FUNCTION_ARGS);
 Datum LWGEOM_length2d_linestring(PG_FUNCTION_ARGS);
 Datum LWGEOM_length_linestring(PG_FUNCTION_ARGS);
 Datum LWGEOM_perimeter2d_poly(PG_FUNCTION_ARGS);
@@ -234,6 +237,51 @@ Datum postgis_libxml_version(PG_FUNCTION_ARGS)
 	PG_RETURN_TEXT_P(result);
 }
 
+/**
+* Report the backend-wide hit/miss/eviction counters of the
+* prepared geometry and tree caches, and the usage of the session
+* cache, as JSON text, optionally zeroing the counters afterwards.
+*/
+PG_FUNCTION_INFO_V1(_postgis_geom_cache_stats);
+Datum _postgis_geom_cache_stats(PG_FUNCTION_ARGS)
+{
+	static const struct {
+		int entry_number;
+		const char *name;
+	} caches[] = {
+		{ PREP_CACHE_ENTRY, "prepared" },
+		{ CIRC_CACHE_ENTRY, "circtree" },
+		{ RECT_CACHE_ENTRY, "recttree" },
+		{ PIP_CACHE_ENTRY, "pip" }
+	};
+	bool reset = PG_NARGS() > 0 && PG_GETARG_BOOL(0);
+	GeomCacheCounters session;
+	int session_entries;
+	Size session_charge;
+	char buf[1024];
+	size_t len;
+	int i;
+
+	len = snprintf(buf, sizeof(buf), "{\"size\":%d", postgis_geom_cache_size);
+	for ( i = 0; i < (int)(sizeof(caches) / sizeof(caches[0])); i++ )
+	{
+		const GeomCacheCounters *c = GetGeomCacheCounters(caches[i].entry_number);
+		len += snprintf(buf + len, sizeof(buf) - len,
+		                ",\"%s\":{\"hits\":" INT64_FORMAT ",\"misses\":" INT64_FORMAT ",\"evictions\":" INT64_FORMAT "}",
+		                caches[i].name, c->hits, c->misses, c->evictions);
+	}
+	GetSessionGeomCacheUsage(&session, &session_entries, &session_charge);
+	snprintf(buf + len, sizeof(buf) - len,
+	         ",\"session\":{\"mem\":%d,\"entries\":%d,\"bytes\":%lu,\"hits\":" INT64_FORMAT ",\"misses\":" INT64_FORMAT ",\"evictions\":" INT64_FORMAT "}}",
+	         postgis_session_geom_cache_mem, session_entries, (unsigned long)session_charge,
+	         session.hits, session.misses, session.evictions);
+
+	if ( reset )
+		ResetGeomCacheCounters();
+
+	PG_RETURN_TEXT_P(cstring_to_text(buf));
+}
+
 /** number of points in an object */
 PG_FUNCTION_INFO_V1(LWGEOM_npoints);
 Datum LWGEOM_npoints(PG_FUNCTION_ARGS)
@@ -735,8 +783,8 @@ Datum LWGEOM_dwithin(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom1 = PG_GETARG_GSERIALIZED_P(0);
 	GSERIALIZED *geom2 = PG_GETARG_GSERIALIZED_P(1);
 	double tolerance = PG_GETARG_FLOAT8(2);
-	LWGEOM *lwgeom1 = lwgeom_from_gserialized(geom1);
-	LWGEOM *lwgeom2 = lwgeom_from_gserialized(geom2);
+	LWGEOM *lwgeom1, *lwgeom2;
+	int within;
 
 	if ( tolerance < 0 )
 	{
@@ -744,8 +792,18 @@ Datum LWGEOM_dwithin(PG_FUNCTION_ARGS)
 		PG_RETURN_NULL();
 	}
 
-	error_if_srid_mismatch(lwgeom1->srid, lwgeom2->srid);
+	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
+
+	/* Linear and areal pairs are walked on their (cached) rect trees */
+	if ( RectTreeDWithin(fcinfo, geom1, geom2, tolerance, &within) == LW_SUCCESS )
+	{
+		PG_FREE_IF_COPY(geom1, 0);
+		PG_FREE_IF_COPY(geom2, 1);
+		PG_RETURN_BOOL(within);
+	}
 
+	lwgeom1 = lwgeom_from_gserialized(geom1);
+	lwgeom2 = lwgeom_from_gserialized(geom2);
 	mindist = lwgeom_mindistance2d_tolerance(lwgeom1,lwgeom2,tolerance);
 
 	PG_FREE_IF_COPY(geom1, 0);
@@ -30,6 +30,7 @@
 /* PostgreSQL */
 #include "postgres.h"
 #include "funcapi.h"
+#include "catalog/pg_type.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -43,6 +44,7 @@
 #include "lwgeom_geos.h"
 #include "liblwgeom.h"
 #include "lwgeom_rtree.h"
+#include "lwgeom_rectree.h"
 #include "lwgeom_geos_prepared.h"
 
 #include "float.h" /* for DBL_DIG */
@@ -70,6 +72,8 @@ Datum geos_intersects(PG_FUNCTION_ARGS);
 Datum crosses(PG_FUNCTION_ARGS);
 Datum contains(PG_FUNCTION_ARGS);
 Datum containsproperly(PG_FUNCTION_ARGS);
+Datum ST_ContainsPointsArray(PG_FUNCTION_ARGS);
+Datum ST_ContainsPoints(PG_FUNCTION_ARGS);
 Datum covers(PG_FUNCTION_ARGS);
 Datum overlaps(PG_FUNCTION_ARGS);
 Datum isvalid(PG_FUNCTION_ARGS);
@@ -132,16 +136,16 @@ is_point(const GSERIALIZED* g)
 }
 
 /* utility function that checks a LWPOINT and a GSERIALIZED poly against
- * a cache.  Serialized poly may be a multipart.
+ * a cached grid index.  Serialized poly may be a multipart.
  */
 static int
-pip_short_circuit(RTREE_POLY_CACHE* poly_cache, LWPOINT* point, GSERIALIZED* gpoly)
+pip_short_circuit(PIP_INDEX* pip_index, LWPOINT* point, GSERIALIZED* gpoly)
 {
 	int result;
 
-	if ( poly_cache && poly_cache->ringIndices )
+	if ( pip_index )
 	{
-        result = point_in_multipolygon_rtree(poly_cache->ringIndices, poly_cache->polyCount, poly_cache->ringCounts, point);
+		result = pip_index_contains_point(pip_index, getPoint2d_cp(point->point, 0));
 	}
 	else
 	{
@@ -160,6 +164,251 @@ pip_short_circuit(RTREE_POLY_CACHE* poly_cache, LWPOINT* point, GSERIALIZED* gpo
 	return result;
 }
 
+/* utility function that locates all the points of a POINTARRAY with
+ * respect to a GSERIALIZED poly in one pass, writing -1/0/1 per point
+ * in pip_results as pip_short_circuit does.
+ */
+static void
+pip_short_circuit_points(PIP_INDEX* pip_index, POINTARRAY* points, GSERIALIZED* gpoly, int* pip_results)
+{
+	if ( pip_index )
+	{
+		pip_index_locate_points(pip_index, points, pip_results);
+	}
+	else
+	{
+		LWGEOM* poly = lwgeom_from_gserialized(gpoly);
+		pip_locate_points(poly, points, pip_results);
+		lwgeom_free(poly);
+	}
+}
+
+/* Gather the non-empty points of a multipoint in one 2D POINTARRAY */
+static POINTARRAY*
+lwmpoint_to_ptarray2d(const LWMPOINT* mpoint)
+{
+	POINTARRAY* points = ptarray_construct_empty(0, 0, mpoint->ngeoms);
+	POINT4D pt;
+	uint32_t i;
+
+	for (i = 0; i < mpoint->ngeoms; i++)
+	{
+		if ( lwgeom_is_empty((LWGEOM*)mpoint->geoms[i]) )
+			continue;
+		getPoint4d_p(mpoint->geoms[i]->point, 0, &pt);
+		ptarray_append_point(points, &pt, LW_TRUE);
+	}
+	return points;
+}
+
+/*
+ * Dimension of the interior, or of the boundary, of a geometry as
+ * a DE-9IM matrix character, from its type alone: 'F' when empty,
+ * '?' when the type does not tell (the boundary of a line depends
+ * on whether it is closed).
+ */
+static char
+relate_dimension(const GSERIALIZED* g, int boundary)
+{
+	if ( gserialized_is_empty(g) )
+		return 'F';
+
+	switch ( gserialized_get_type(g) )
+	{
+	case POINTTYPE:
+	case MULTIPOINTTYPE:
+		return boundary ? 'F' : '0';
+	case LINETYPE:
+	case MULTILINETYPE:
+		return boundary ? '?' : '1';
+	case POLYGONTYPE:
+	case MULTIPOLYGONTYPE:
+		return boundary ? '1' : '2';
+	default:
+		return '?';
+	}
+}
+
+/*
+ * Fill the DE-9IM matrix of two geometries as far as it can be
+ * known without GEOS, leaving '?' in the other cells:
+ *  - disjoint bounding boxes or an empty argument leave nothing
+ *    in the intersections, and only the dimensions of the
+ *    arguments in the exterior cells;
+ *  - two points are equal or disjoint;
+ *  - a point is inside, on the boundary of, or outside of a
+ *    polygon, as told by the cached point-in-polygon index.
+ * The exterior/exterior cell is always '2'.
+ */
+static void
+relate_bbox_matrix(FunctionCallInfo fcinfo, GSERIALIZED* geom1, GSERIALIZED* geom2, char* im)
+{
+	GBOX box1, box2;
+	int type1 = gserialized_get_type(geom1);
+	int type2 = gserialized_get_type(geom2);
+
+	strcpy(im, "????????2");
+
+	if ( gserialized_is_empty(geom1) || gserialized_is_empty(geom2) ||
+	     ( gserialized_get_gbox_p(geom1, &box1) &&
+	       gserialized_get_gbox_p(geom2, &box2) &&
+	       gbox_overlaps_2d(&box1, &box2) == LW_FALSE ) )
+	{
+		im[0] = im[1] = im[3] = im[4] = 'F';
+		im[2] = relate_dimension(geom1, LW_FALSE);
+		im[5] = relate_dimension(geom1, LW_TRUE);
+		im[6] = relate_dimension(geom2, LW_FALSE);
+		im[7] = relate_dimension(geom2, LW_TRUE);
+		return;
+	}
+
+	if ( type1 == POINTTYPE && type2 == POINTTYPE )
+	{
+		LWGEOM* lwgeom1 = lwgeom_from_gserialized(geom1);
+		LWGEOM* lwgeom2 = lwgeom_from_gserialized(geom2);
+		const POINT2D* p1 = getPoint2d_cp(lwgeom_as_lwpoint(lwgeom1)->point, 0);
+		const POINT2D* p2 = getPoint2d_cp(lwgeom_as_lwpoint(lwgeom2)->point, 0);
+
+		if ( p1->x == p2->x && p1->y == p2->y )
+			strcpy(im, "0FFFFFFF2");
+		else
+			strcpy(im, "FF0FFF0F2");
+
+		lwgeom_free(lwgeom1);
+		lwgeom_free(lwgeom2);
+		return;
+	}
+
+	if ( (type1 == POINTTYPE && is_poly(geom2)) || (is_poly(geom1) && type2 == POINTTYPE) )
+	{
+		GSERIALIZED* gpoly  = is_poly(geom1) ? geom1 : geom2;
+		GSERIALIZED* gpoint = is_poly(geom1) ? geom2 : geom1;
+		PIP_INDEX* cache = GetPipIndexCache(fcinfo, gpoly);
+		LWGEOM* point = lwgeom_from_gserialized(gpoint);
+		int pip_result = pip_short_circuit(cache, lwgeom_as_lwpoint(point), gpoly);
+		lwgeom_free(point);
+
+		/* Matrix of the point against the polygon */
+		if ( pip_result == 1 )
+			strcpy(im, "0FFFFF212");
+		else if ( pip_result == 0 )
+			strcpy(im, "F0FFFF212");
+		else
+			strcpy(im, "FF0FFF212");
+
+		/* Transposed when the polygon comes first */
+		if ( gpoly == geom1 )
+		{
+			char c;
+			c = im[1]; im[1] = im[3]; im[3] = c;
+			c = im[2]; im[2] = im[6]; im[6] = c;
+			c = im[5]; im[5] = im[7]; im[7] = c;
+		}
+	}
+}
+
+/*
+ * Whether a DE-9IM matrix, possibly partially known, matches a
+ * pattern: LW_TRUE, LW_FALSE, or -1 when it depends on unknown
+ * cells or the pattern is not one this code understands.
+ */
+static int
+relate_matrix_match(const char* im, const char* patt)
+{
+	int unknown = LW_FALSE;
+	int i;
+
+	if ( strlen(patt) != 9 || strspn(patt, "TF*012") != 9 )
+		return -1;
+
+	for ( i = 0; i < 9; i++ )
+	{
+		if ( patt[i] == '*' )
+			continue;
+		if ( im[i] == '?' )
+		{
+			unknown = LW_TRUE;
+			continue;
+		}
+		if ( patt[i] == 'T' ? im[i] == 'F' : im[i] != patt[i] )
+			return LW_FALSE;
+	}
+
+	return unknown ? -1 : LW_TRUE;
+}
+
+/*
+ * Answer a predicate, defined as matching any of a NULL terminated
+ * list of DE-9IM patterns, from the bounding boxes and the simple
+ * point cases of its arguments: LW_TRUE, LW_FALSE, or -1 when
+ * GEOS has to be asked.
+ */
+static int
+relate_bbox_filter(FunctionCallInfo fcinfo, GSERIALIZED* geom1, GSERIALIZED* geom2, const char* const* patterns)
+{
+	char im[10];
+	int result = LW_FALSE;
+
+	relate_bbox_matrix(fcinfo, geom1, geom2, im);
+
+	for ( ; *patterns; patterns++ )
+	{
+		int match = relate_matrix_match(im, *patterns);
+		if ( match == LW_TRUE )
+			return LW_TRUE;
+		if ( match == -1 )
+			result = -1;
+	}
+
+	return result;
+}
+
+/* DE-9IM patterns of the predicates, as GEOS defines them */
+static const char* const intersects_patterns[] = { "T********", "*T*******", "***T*****", "****T****", NULL };
+static const char* const disjoint_patterns[] = { "FF*FF****", NULL };
+static const char* const touches_patterns[] = { "FT*******", "F**T*****", "F***T****", NULL };
+static const char* const contains_patterns[] = { "T*****FF*", NULL };
+static const char* const containsproperly_patterns[] = { "T**FF*FF*", NULL };
+static const char* const covers_patterns[] = { "T*****FF*", "*T****FF*", "***T**FF*", "****T*FF*", NULL };
+static const char* const coveredby_patterns[] = { "T*F**F***", "*TF**F***", "**FT*F***", "**F*TF***", NULL };
+static const char* const equals_patterns[] = { "T*F**FFF*", NULL };
+
+/*
+ * Crosses and overlaps patterns depend on the dimensions of the
+ * arguments. Returns NULL when the predicate can not hold for
+ * these dimensions, and sets *known to LW_FALSE when a dimension
+ * is not known from the types.
+ */
+static const char*
+crosses_pattern(const GSERIALIZED* geom1, const GSERIALIZED* geom2, int* known)
+{
+	char dim1 = relate_dimension(geom1, LW_FALSE);
+	char dim2 = relate_dimension(geom2, LW_FALSE);
+
+	*known = (dim1 != '?' && dim1 != 'F' && dim2 != '?' && dim2 != 'F');
+	if ( dim1 < dim2 )
+		return "T*T******";
+	if ( dim1 > dim2 )
+		return "T*****T**";
+	if ( dim1 == '1' )
+		return "0********";
+	return NULL;
+}
+
+static const char*
+overlaps_pattern(const GSERIALIZED* geom1, const GSERIALIZED* geom2, int* known)
+{
+	char dim1 = relate_dimension(geom1, LW_FALSE);
+	char dim2 = relate_dimension(geom2, LW_FALSE);
+
+	*known = (dim1 != '?' && dim1 != 'F' && dim2 != '?' && dim2 != 'F');
+	if ( dim1 != dim2 )
+		return NULL;
+	if ( dim1 == '1' )
+		return "1*T***T**";
+	return "T*T***T**";
+}
+
 /**
  *  @brief Compute the Hausdorff distance thanks to the corresponding GEOS function
  *  @example hausdorffdistance {@link #hausdorffdistance} - SELECT st_hausdorffdistance(
@@ -1714,7 +1963,8 @@ Datum overlaps(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom2;
 	GEOSGeometry *g1, *g2;
 	bool result;
-	GBOX box1, box2;
+	const char* pattern;
+	int known;
 
 	geom1 = PG_GETARG_GSERIALIZED_P(0);
 	geom2 = PG_GETARG_GSERIALIZED_P(1);
@@ -1727,16 +1977,26 @@ Datum overlaps(PG_FUNCTION_ARGS)
 		PG_RETURN_BOOL(false);
 
 	/*
-	 * short-circuit 1: if geom2 bounding box does not overlap
-	 * geom1 bounding box we can prematurely return FALSE.
+	 * short-circuit 1: overlaps needs arguments of the same dimension,
+	 * and the bounding boxes or point cases may settle it.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
+	pattern = overlaps_pattern(geom1, geom2, &known);
+	if ( known )
 	{
-		if ( ! gbox_overlaps_2d(&box1, &box2) )
-		{
+		const char* patterns[2];
+		int filtered;
+
+		if ( ! pattern )
 			PG_RETURN_BOOL(false);
-		}
+		patterns[0] = pattern;
+		patterns[1] = NULL;
+		filtered = relate_bbox_filter(fcinfo, geom1, geom2, patterns);
+		if ( filtered != -1 )
+			PG_RETURN_BOOL(filtered);
+	}
+	else if ( relate_bbox_filter(fcinfo, geom1, geom2, intersects_patterns) == LW_FALSE )
+	{
+		PG_RETURN_BOOL(false);
 	}
 
 	initGEOS(lwpgnotice, lwgeom_geos_error);
@@ -1772,6 +2032,7 @@ Datum contains(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom1;
 	GSERIALIZED *geom2;
 	GEOSGeometry *g1, *g2;
+	int filtered;
 	GBOX box1, box2;
 	int result;
 	PrepGeomCache *prep_cache;
@@ -1801,6 +2062,14 @@ Datum contains(PG_FUNCTION_ARGS)
 		}
 	}
 
+	/*
+	 * short-circuit 1b: two points, or a point and a polygon, have a
+	 * DE-9IM matrix known without GEOS.
+	 */
+	filtered = relate_bbox_filter(fcinfo, geom1, geom2, contains_patterns);
+	if ( filtered != -1 )
+		PG_RETURN_BOOL(filtered);
+
 	/*
 	** short-circuit 2: if geom2 is a point and geom1 is a polygon
 	** call the point-in-polygon function.
@@ -1809,7 +2078,7 @@ Datum contains(PG_FUNCTION_ARGS)
 	{
 		GSERIALIZED* gpoly  = is_poly(geom1) ? geom1 : geom2;
 		GSERIALIZED* gpoint = is_point(geom1) ? geom1 : geom2;
-		RTREE_POLY_CACHE* cache = GetRtreeCache(fcinfo, gpoly);
+		PIP_INDEX* cache = GetPipIndexCache(fcinfo, gpoly);
 		int retval;
 
 		POSTGIS_DEBUG(3, "Point in Polygon test requested...short-circuiting.");
@@ -1824,22 +2093,26 @@ Datum contains(PG_FUNCTION_ARGS)
 		else if (gserialized_get_type(gpoint) == MULTIPOINTTYPE)
 		{
 			LWMPOINT* mpoint = lwgeom_as_lwmpoint(lwgeom_from_gserialized(gpoint));
+			POINTARRAY* points = lwmpoint_to_ptarray2d(mpoint);
+			int* pip_results = palloc(sizeof(int) * (points->npoints + 1));
 			uint32_t i;
 			int found_completely_inside = LW_FALSE;
 
+			/* Locate all the points in one pass */
+			pip_short_circuit_points(cache, points, gpoly, pip_results);
+
 			retval = LW_TRUE;
-			for (i = 0; i < mpoint->ngeoms; i++)
+			for (i = 0; i < points->npoints; i++)
 			{
 				/* We need to find at least one point that's completely inside the
 				 * polygons (pip_result == 1).  As long as we have one point that's
 				 * completely inside, we can have as many as we want on the boundary
 				 * itself. (pip_result == 0)
 				 */
-				int pip_result = pip_short_circuit(cache, mpoint->geoms[i], gpoly);
-				if (pip_result == 1)
+				if (pip_results[i] == 1)
 					found_completely_inside = LW_TRUE;
 
-				if (pip_result == -1) /* completely outside */
+				if (pip_results[i] == -1) /* completely outside */
 				{
 					retval = LW_FALSE;
 					break;
@@ -1847,6 +2120,8 @@ Datum contains(PG_FUNCTION_ARGS)
 			}
 
 			retval = retval && found_completely_inside;
+			pfree(pip_results);
+			ptarray_free(points);
 			lwmpoint_free(mpoint);
 		}
 		else
@@ -1909,12 +2184,169 @@ Datum contains(PG_FUNCTION_ARGS)
 
 }
 
+/*
+* Shared body of the ST_ContainsPoints variants: one boolean per
+* element of points, true when it lies strictly inside gpoly, NULL
+* for NULL elements and false for empty ones.
+*/
+static ArrayType*
+contains_points(FunctionCallInfo fcinfo, GSERIALIZED* gpoly, LWGEOM** elems, int nelems)
+{
+	Datum* results = palloc(sizeof(Datum) * nelems);
+	bool* nulls = palloc(sizeof(bool) * nelems);
+	int* pip_results;
+	POINTARRAY* points;
+	POINT4D pt;
+	int i, n, lbound = 1;
+	ArrayType* array;
+
+	points = ptarray_construct_empty(0, 0, nelems);
+	for (i = 0; i < nelems; i++)
+	{
+		nulls[i] = (elems[i] == NULL);
+		results[i] = BoolGetDatum(false);
+		if ( elems[i] && ! lwgeom_is_empty(elems[i]) )
+		{
+			lwpoint_getPoint4d_p(lwgeom_as_lwpoint(elems[i]), &pt);
+			ptarray_append_point(points, &pt, LW_TRUE);
+		}
+	}
+
+	if ( points->npoints > 0 && ! gserialized_is_empty(gpoly) )
+	{
+		pip_results = palloc(sizeof(int) * points->npoints);
+		pip_short_circuit_points(GetPipIndexCache(fcinfo, gpoly), points, gpoly, pip_results);
+
+		for (i = 0, n = 0; i < nelems; i++)
+		{
+			if ( elems[i] && ! lwgeom_is_empty(elems[i]) )
+				results[i] = BoolGetDatum(pip_results[n++] == 1);
+		}
+		pfree(pip_results);
+	}
+	ptarray_free(points);
+
+	array = construct_md_array(results, nulls, 1, &nelems, &lbound, BOOLOID, 1, true, 'c');
+	pfree(results);
+	pfree(nulls);
+	return array;
+}
+
+static void
+error_if_not_poly(GSERIALIZED* gpoly, const char* funcname)
+{
+	if ( ! is_poly(gpoly) )
+		elog(ERROR, "%s: first argument must be a Polygon or MultiPolygon", funcname);
+}
+
+/**
+* ST_ContainsPoints(polygon, points[]) - classify an array of points
+* against a polygon in one call, sharing the polygon's
+* point-in-polygon index across the whole array.
+*/
+PG_FUNCTION_INFO_V1(ST_ContainsPointsArray);
+Datum ST_ContainsPointsArray(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED* gpoly = PG_GETARG_GSERIALIZED_P(0);
+	ArrayType* array = PG_GETARG_ARRAYTYPE_P(1);
+	ArrayIterator iterator;
+	Datum value;
+	bool isnull;
+	LWGEOM** elems;
+	ArrayType* result;
+	int nelems, i = 0;
+
+	error_if_not_poly(gpoly, "ST_ContainsPoints");
+
+	nelems = ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array));
+	if ( nelems == 0 )
+		PG_RETURN_ARRAYTYPE_P(construct_empty_array(BOOLOID));
+
+	elems = palloc(sizeof(LWGEOM*) * nelems);
+
+#if POSTGIS_PGSQL_VERSION >= 95
+	iterator = array_create_iterator(array, 0, NULL);
+#else
+	iterator = array_create_iterator(array, 0);
+#endif
+
+	while( array_iterate(iterator, &value, &isnull) )
+	{
+		GSERIALIZED* gpoint;
+
+		elems[i] = NULL;
+		if ( ! isnull )
+		{
+			gpoint = (GSERIALIZED*)DatumGetPointer(value);
+			if ( gserialized_get_type(gpoint) != POINTTYPE )
+				elog(ERROR, "ST_ContainsPoints: array elements must be Points");
+			error_if_srid_mismatch(gserialized_get_srid(gpoly), gserialized_get_srid(gpoint));
+			elems[i] = lwgeom_from_gserialized(gpoint);
+		}
+		i++;
+	}
+	array_free_iterator(iterator);
+
+	result = contains_points(fcinfo, gpoly, elems, nelems);
+
+	for (i = 0; i < nelems; i++)
+		if ( elems[i] ) lwgeom_free(elems[i]);
+	pfree(elems);
+
+	PG_FREE_IF_COPY(gpoly, 0);
+	PG_RETURN_ARRAYTYPE_P(result);
+}
+
+/**
+* ST_ContainsPoints(polygon, multipoint) - as above, one boolean per
+* component of the multipoint.
+*/
+PG_FUNCTION_INFO_V1(ST_ContainsPoints);
+Datum ST_ContainsPoints(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED* gpoly = PG_GETARG_GSERIALIZED_P(0);
+	GSERIALIZED* gpoints = PG_GETARG_GSERIALIZED_P(1);
+	LWGEOM* lwpoints;
+	LWGEOM** elems;
+	ArrayType* result;
+	int nelems;
+
+	error_if_not_poly(gpoly, "ST_ContainsPoints");
+	if ( ! is_point(gpoints) )
+		elog(ERROR, "ST_ContainsPoints: second argument must be a Point or MultiPoint");
+	error_if_srid_mismatch(gserialized_get_srid(gpoly), gserialized_get_srid(gpoints));
+
+	lwpoints = lwgeom_from_gserialized(gpoints);
+	if ( lwpoints->type == MULTIPOINTTYPE )
+	{
+		LWMPOINT* mpoint = lwgeom_as_lwmpoint(lwpoints);
+		elems = (LWGEOM**)mpoint->geoms;
+		nelems = mpoint->ngeoms;
+	}
+	else
+	{
+		elems = &lwpoints;
+		nelems = 1;
+	}
+
+	if ( nelems == 0 )
+		result = construct_empty_array(BOOLOID);
+	else
+		result = contains_points(fcinfo, gpoly, elems, nelems);
+
+	lwgeom_free(lwpoints);
+	PG_FREE_IF_COPY(gpoly, 0);
+	PG_FREE_IF_COPY(gpoints, 1);
+	PG_RETURN_ARRAYTYPE_P(result);
+}
+
 PG_FUNCTION_INFO_V1(containsproperly);
 Datum containsproperly(PG_FUNCTION_ARGS)
 {
 	GSERIALIZED *				geom1;
 	GSERIALIZED *				geom2;
 	bool 					result;
+	int filtered;
 	GBOX 			box1, box2;
 	PrepGeomCache *	prep_cache;
 
@@ -1939,6 +2371,14 @@ Datum containsproperly(PG_FUNCTION_ARGS)
 			PG_RETURN_BOOL(false);
 	}
 
+	/*
+	 * short-circuit 1b: two points, or a point and a polygon, have a
+	 * DE-9IM matrix known without GEOS.
+	 */
+	filtered = relate_bbox_filter(fcinfo, geom1, geom2, containsproperly_patterns);
+	if ( filtered != -1 )
+		PG_RETURN_BOOL(filtered);
+
 	initGEOS(lwpgnotice, lwgeom_geos_error);
 
 	prep_cache = GetPrepGeomCache( fcinfo, geom1, 0 );
@@ -1994,6 +2434,7 @@ Datum covers(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom1;
 	GSERIALIZED *geom2;
 	int result;
+	int filtered;
 	GBOX box1, box2;
 	PrepGeomCache *prep_cache;
 
@@ -2019,6 +2460,15 @@ Datum covers(PG_FUNCTION_ARGS)
 			PG_RETURN_BOOL(false);
 		}
 	}
+
+	/*
+	 * short-circuit 1b: two points, or a point and a polygon, have a
+	 * DE-9IM matrix known without GEOS.
+	 */
+	filtered = relate_bbox_filter(fcinfo, geom1, geom2, covers_patterns);
+	if ( filtered != -1 )
+		PG_RETURN_BOOL(filtered);
+
 	/*
 	 * short-circuit 2: if geom2 is a point and geom1 is a polygon
 	 * call the point-in-polygon function.
@@ -2027,7 +2477,7 @@ Datum covers(PG_FUNCTION_ARGS)
 	{
 		GSERIALIZED* gpoly  = is_poly(geom1) ? geom1 : geom2;
 		GSERIALIZED* gpoint = is_point(geom1) ? geom1 : geom2;
-		RTREE_POLY_CACHE* cache = GetRtreeCache(fcinfo, gpoly);
+		PIP_INDEX* cache = GetPipIndexCache(fcinfo, gpoly);
 		int retval;
 
 		POSTGIS_DEBUG(3, "Point in Polygon test requested...short-circuiting.");
@@ -2138,6 +2588,7 @@ Datum coveredby(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom2;
 	GEOSGeometry *g1, *g2;
 	int result;
+	int filtered;
 	GBOX box1, box2;
 	char *patt = "**F**F***";
 
@@ -2165,6 +2616,15 @@ Datum coveredby(PG_FUNCTION_ARGS)
 
 		POSTGIS_DEBUG(3, "bounding box short-circuit missed.");
 	}
+
+	/*
+	 * short-circuit 1b: two points, or a point and a polygon, have a
+	 * DE-9IM matrix known without GEOS.
+	 */
+	filtered = relate_bbox_filter(fcinfo, geom1, geom2, coveredby_patterns);
+	if ( filtered != -1 )
+		PG_RETURN_BOOL(filtered);
+
 	/*
 	 * short-circuit 2: if geom1 is a point and geom2 is a polygon
 	 * call the point-in-polygon function.
@@ -2173,7 +2633,7 @@ Datum coveredby(PG_FUNCTION_ARGS)
 	{
 		GSERIALIZED* gpoly  = is_poly(geom1) ? geom1 : geom2;
 		GSERIALIZED* gpoint = is_point(geom1) ? geom1 : geom2;
-		RTREE_POLY_CACHE* cache = GetRtreeCache(fcinfo, gpoly);
+		PIP_INDEX* cache = GetPipIndexCache(fcinfo, gpoly);
 		int retval;
 
 		POSTGIS_DEBUG(3, "Point in Polygon test requested...short-circuiting.");
@@ -2255,7 +2715,8 @@ Datum crosses(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom2;
 	GEOSGeometry *g1, *g2;
 	int result;
-	GBOX box1, box2;
+	const char* pattern;
+	int known;
 
 	geom1 = PG_GETARG_GSERIALIZED_P(0);
 	geom2 = PG_GETARG_GSERIALIZED_P(1);
@@ -2268,16 +2729,26 @@ Datum crosses(PG_FUNCTION_ARGS)
 		PG_RETURN_BOOL(false);
 
 	/*
-	 * short-circuit 1: if geom2 bounding box does not overlap
-	 * geom1 bounding box we can prematurely return FALSE.
+	 * short-circuit 1: crosses holds only for some pairs of dimensions,
+	 * and the bounding boxes or point cases may settle it.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
+	pattern = crosses_pattern(geom1, geom2, &known);
+	if ( known )
 	{
-		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
-		{
+		const char* patterns[2];
+		int filtered;
+
+		if ( ! pattern )
 			PG_RETURN_BOOL(false);
-		}
+		patterns[0] = pattern;
+		patterns[1] = NULL;
+		filtered = relate_bbox_filter(fcinfo, geom1, geom2, patterns);
+		if ( filtered != -1 )
+			PG_RETURN_BOOL(filtered);
+	}
+	else if ( relate_bbox_filter(fcinfo, geom1, geom2, intersects_patterns) == LW_FALSE )
+	{
+		PG_RETURN_BOOL(false);
 	}
 
 	initGEOS(lwpgnotice, lwgeom_geos_error);
@@ -2313,7 +2784,7 @@ Datum geos_intersects(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom1;
 	GSERIALIZED *geom2;
 	int result;
-	GBOX box1, box2;
+	int filtered;
 	PrepGeomCache *prep_cache;
 
 	geom1 = PG_GETARG_GSERIALIZED_P(0);
@@ -2328,16 +2799,12 @@ Datum geos_intersects(PG_FUNCTION_ARGS)
 
 	/*
 	 * short-circuit 1: if geom2 bounding box does not overlap
-	 * geom1 bounding box we can prematurely return FALSE.
+	 * geom1 bounding box, or the arguments are points, or a point
+	 * and a polygon, the DE-9IM matrix is known without GEOS.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
-	{
-		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
-		{
-			PG_RETURN_BOOL(false);
-		}
-	}
+	filtered = relate_bbox_filter(fcinfo, geom1, geom2, intersects_patterns);
+	if ( filtered != -1 )
+		PG_RETURN_BOOL(filtered);
 
 	/*
 	 * short-circuit 2: if the geoms are a point and a polygon,
@@ -2347,7 +2814,7 @@ Datum geos_intersects(PG_FUNCTION_ARGS)
 	{
 		GSERIALIZED* gpoly  = is_poly(geom1) ? geom1 : geom2;
 		GSERIALIZED* gpoint = is_point(geom1) ? geom1 : geom2;
-		RTREE_POLY_CACHE* cache = GetRtreeCache(fcinfo, gpoly);
+		PIP_INDEX* cache = GetPipIndexCache(fcinfo, gpoly);
 		int retval;
 
 		POSTGIS_DEBUG(3, "Point in Polygon test requested...short-circuiting.");
@@ -2392,6 +2859,20 @@ Datum geos_intersects(PG_FUNCTION_ARGS)
 	initGEOS(lwpgnotice, lwgeom_geos_error);
 	prep_cache = GetPrepGeomCache( fcinfo, geom1, geom2 );
 
+	/*
+	 * short-circuit 3: linear and areal pairs are walked
+	 * on their rect trees, without GEOS, unless an argument
+	 * repeated from earlier calls has its prepared geometry
+	 * cached, which answers without indexing the other one.
+	 */
+	if ( ! (prep_cache && prep_cache->prepared_geom) &&
+	     RectTreeIntersects(fcinfo, geom1, geom2, &result) == LW_SUCCESS )
+	{
+		PG_FREE_IF_COPY(geom1, 0);
+		PG_FREE_IF_COPY(geom2, 1);
+		PG_RETURN_BOOL(result);
+	}
+
 	if ( prep_cache && prep_cache->prepared_geom )
 	{
 		if ( prep_cache->gcache.argnum == 1 )
@@ -2449,7 +2930,7 @@ Datum touches(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom2;
 	GEOSGeometry *g1, *g2;
 	bool result;
-	GBOX box1, box2;
+	int filtered;
 
 	geom1 = PG_GETARG_GSERIALIZED_P(0);
 	geom2 = PG_GETARG_GSERIALIZED_P(1);
@@ -2463,16 +2944,12 @@ Datum touches(PG_FUNCTION_ARGS)
 
 	/*
 	 * short-circuit 1: if geom2 bounding box does not overlap
-	 * geom1 bounding box we can prematurely return FALSE.
+	 * geom1 bounding box, or the arguments are points, or a point
+	 * and a polygon, the DE-9IM matrix is known without GEOS.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-			gserialized_get_gbox_p(geom2, &box2) )
-	{
-		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
-		{
-			PG_RETURN_BOOL(false);
-		}
-	}
+	filtered = relate_bbox_filter(fcinfo, geom1, geom2, touches_patterns);
+	if ( filtered != -1 )
+		PG_RETURN_BOOL(filtered);
 
 	initGEOS(lwpgnotice, lwgeom_geos_error);
 
@@ -2509,7 +2986,7 @@ Datum disjoint(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom2;
 	GEOSGeometry *g1, *g2;
 	bool result;
-	GBOX box1, box2;
+	int filtered;
 
 	geom1 = PG_GETARG_GSERIALIZED_P(0);
 	geom2 = PG_GETARG_GSERIALIZED_P(1);
@@ -2523,16 +3000,12 @@ Datum disjoint(PG_FUNCTION_ARGS)
 
 	/*
 	 * short-circuit 1: if geom2 bounding box does not overlap
-	 * geom1 bounding box we can prematurely return TRUE.
+	 * geom1 bounding box, or the arguments are points, or a point
+	 * and a polygon, the DE-9IM matrix is known without GEOS.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
-	{
-		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
-		{
-			PG_RETURN_BOOL(true);
-		}
-	}
+	filtered = relate_bbox_filter(fcinfo, geom1, geom2, disjoint_patterns);
+	if ( filtered != -1 )
+		PG_RETURN_BOOL(filtered);
 
 	initGEOS(lwpgnotice, lwgeom_geos_error);
 
@@ -2568,6 +3041,8 @@ Datum relate_pattern(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom1;
 	GSERIALIZED *geom2;
 	char *patt;
+	const char *patterns[2];
+	int filtered;
 	bool result;
 	GEOSGeometry *g1, *g2;
 	size_t i;
@@ -2575,11 +3050,36 @@ Datum relate_pattern(PG_FUNCTION_ARGS)
 	geom1 = PG_GETARG_GSERIALIZED_P(0);
 	geom2 = PG_GETARG_GSERIALIZED_P(1);
 
-	/* TODO handle empty */
-
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
 
+	patt =  DatumGetCString(DirectFunctionCall1(textout,
+	                        PointerGetDatum(PG_GETARG_DATUM(2))));
+
+	/*
+	** Need to make sure 't' and 'f' are upper-case before handing to GEOS
+	*/
+	for ( i = 0; i < strlen(patt); i++ )
+	{
+		if ( patt[i] == 't' ) patt[i] = 'T';
+		if ( patt[i] == 'f' ) patt[i] = 'F';
+	}
+
+	/*
+	 * short-circuit: empty arguments, disjoint bounding boxes, two
+	 * points, or a point and a polygon may settle the pattern.
+	 */
+	patterns[0] = patt;
+	patterns[1] = NULL;
+	filtered = relate_bbox_filter(fcinfo, geom1, geom2, patterns);
+	if ( filtered != -1 )
+	{
+		pfree(patt);
+		PG_FREE_IF_COPY(geom1, 0);
+		PG_FREE_IF_COPY(geom2, 1);
+		PG_RETURN_BOOL(filtered);
+	}
+
 	initGEOS(lwpgnotice, lwgeom_geos_error);
 
 	g1 = POSTGIS2GEOS(geom1);
@@ -2593,18 +3093,6 @@ Datum relate_pattern(PG_FUNCTION_ARGS)
 		    "Second argument geometry could not be converted to GEOS");
 	}
 
-	patt =  DatumGetCString(DirectFunctionCall1(textout,
-	                        PointerGetDatum(PG_GETARG_DATUM(2))));
-
-	/*
-	** Need to make sure 't' and 'f' are upper-case before handing to GEOS
-	*/
-	for ( i = 0; i < strlen(patt); i++ )
-	{
-		if ( patt[i] == 't' ) patt[i] = 'T';
-		if ( patt[i] == 'f' ) patt[i] = 'F';
-	}
-
 	result = GEOSRelatePattern(g1,g2,patt);
 	GEOSGeom_destroy(g1);
 	GEOSGeom_destroy(g2);
@@ -2629,11 +3117,10 @@ Datum relate_full(PG_FUNCTION_ARGS)
 	char *relate_str;
 	text *result;
 	int bnr = GEOSRELATE_BNR_OGC;
+	char im[10];
 
 	POSTGIS_DEBUG(2, "in relate_full()");
 
-	/* TODO handle empty */
-
 	geom1 = PG_GETARG_GSERIALIZED_P(0);
 	geom2 = PG_GETARG_GSERIALIZED_P(1);
 
@@ -2645,6 +3132,19 @@ Datum relate_full(PG_FUNCTION_ARGS)
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
 
+	/*
+	 * short-circuit: two points, a point and a polygon, and empty or
+	 * far apart arguments of known boundaries have a matrix known
+	 * without GEOS.
+	 */
+	relate_bbox_matrix(fcinfo, geom1, geom2, im);
+	if ( ! strchr(im, '?') )
+	{
+		PG_FREE_IF_COPY(geom1, 0);
+		PG_FREE_IF_COPY(geom2, 1);
+		PG_RETURN_TEXT_P(cstring_to_text(im));
+	}
+
 	initGEOS(lwpgnotice, lwgeom_geos_error);
 
 	g1 = POSTGIS2GEOS(geom1 );
@@ -2687,6 +3187,7 @@ Datum ST_Equals(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom2;
 	GEOSGeometry *g1, *g2;
 	bool result;
+	int filtered;
 	GBOX box1, box2;
 
 	geom1 = PG_GETARG_GSERIALIZED_P(0);
@@ -2720,6 +3221,14 @@ Datum ST_Equals(PG_FUNCTION_ARGS)
 	    PG_RETURN_BOOL(true);
 	}
 
+	/*
+	 * short-circuit 1b: two points, or a point and a polygon, have a
+	 * DE-9IM matrix known without GEOS.
+	 */
+	filtered = relate_bbox_filter(fcinfo, geom1, geom2, equals_patterns);
+	if ( filtered != -1 )
+		PG_RETURN_BOOL(filtered);
+
 	initGEOS(lwpgnotice, lwgeom_geos_error);
 
 	g1 = POSTGIS2GEOS(geom1);
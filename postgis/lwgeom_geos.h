@@ -39,6 +39,7 @@ GEOSGeometry * POSTGIS2GEOS(GSERIALIZED *g);
 GEOSGeometry** ARRAY2GEOS(ArrayType* array, uint32_t nelems, int* is3d, int* srid);
 LWGEOM** ARRAY2LWGEOM(ArrayType* array, uint32_t nelems, int* is3d, int* srid);
 
+Datum buffer(PG_FUNCTION_ARGS);
 Datum geos_intersects(PG_FUNCTION_ARGS);
 Datum geos_intersection(PG_FUNCTION_ARGS);
 Datum geos_difference(PG_FUNCTION_ARGS);
@@ -443,7 +443,8 @@ static GeomCacheMethods PrepGeomCacheMethods =
 	PREP_CACHE_ENTRY,
 	PrepGeomCacheBuilder,
 	PrepGeomCacheCleaner,
-	PrepGeomCacheAllocator
+	PrepGeomCacheAllocator,
+	sizeof(PrepGeomCache)
 };
 
 
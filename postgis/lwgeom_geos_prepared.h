@@ -51,7 +51,7 @@
 * Note that the first 6 entries are part of the common GeomCache
 * structure and have to remain in order to allow the overall caching
 * system to share code (the cache checking code is common between
-* prepared geometry, circtrees, recttrees, and rtrees).
+* prepared geometry, circtrees, recttrees, and pip indexes).
 */
 typedef struct {
 	GeomCache                   gcache;
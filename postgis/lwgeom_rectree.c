@@ -31,6 +31,7 @@
 #include "lwgeom_pg.h"
 #include "lwtree.h"
 #include "lwgeom_cache.h"
+#include "lwgeom_rectree.h"
 
 
 /* Prototypes */
@@ -102,7 +103,8 @@ static GeomCacheMethods RectTreeCacheMethods =
 	RECT_CACHE_ENTRY,
 	RectTreeBuilder,
 	RectTreeFreer,
-	RectTreeAllocator
+	RectTreeAllocator,
+	sizeof(RectTreeGeomCache)
 };
 
 static RectTreeGeomCache *
@@ -112,6 +114,143 @@ GetRectTreeGeomCache(FunctionCallInfoData *fcinfo, const GSERIALIZED *g1, const
 }
 
 
+/**********************************************************************
+* GEOS-free intersects and distance tests
+**********************************************************************/
+
+/*
+* Types the rect tree tests answer for, the same as GEOS would.
+* Collections and curves are left to the other methods.
+*/
+static int
+RectTreeHandlesType(const GSERIALIZED *g)
+{
+	switch (gserialized_get_type(g))
+	{
+		case POINTTYPE:
+		case LINETYPE:
+		case POLYGONTYPE:
+		case MULTIPOINTTYPE:
+		case MULTILINETYPE:
+		case MULTIPOLYGONTYPE:
+			return LW_TRUE;
+		default:
+			return LW_FALSE;
+	}
+}
+
+/*
+* Trees of both arguments of a call. The tree of an argument
+* found in the cache is borrowed, the others are built for the
+* call, along with the LWGEOM they point into.
+*/
+typedef struct {
+	RECT_NODE *tree[2];
+	LWGEOM    *lwgeom[2]; /* Set when the tree is our own */
+} RectTreePair;
+
+static int
+RectTreePairBuild(FunctionCallInfoData *fcinfo, const GSERIALIZED *g1, const GSERIALIZED *g2, RectTreePair *pair)
+{
+	RectTreeGeomCache *tree_cache;
+	const GSERIALIZED *g[2];
+	int i, argnum = 0;
+
+	if ( ! (RectTreeHandlesType(g1) && RectTreeHandlesType(g2)) )
+		return LW_FAILURE;
+
+	/* Two points? Nothing to index */
+	if ( gserialized_get_type(g1) == POINTTYPE && gserialized_get_type(g2) == POINTTYPE )
+		return LW_FAILURE;
+
+	if ( gserialized_is_empty(g1) || gserialized_is_empty(g2) )
+		return LW_FAILURE;
+
+	tree_cache = GetRectTreeGeomCache(fcinfo, g1, g2);
+	if ( tree_cache && tree_cache->gcache.argnum && tree_cache->index )
+		argnum = tree_cache->gcache.argnum;
+
+	g[0] = g1;
+	g[1] = g2;
+	for ( i = 0; i < 2; i++ )
+	{
+		if ( argnum == i + 1 )
+		{
+			pair->tree[i] = tree_cache->index;
+			pair->lwgeom[i] = NULL;
+		}
+		else
+		{
+			pair->lwgeom[i] = lwgeom_from_gserialized(g[i]);
+			pair->tree[i] = rect_tree_from_lwgeom(pair->lwgeom[i]);
+		}
+	}
+	return LW_SUCCESS;
+}
+
+static void
+RectTreePairFree(RectTreePair *pair)
+{
+	int i;
+	for ( i = 0; i < 2; i++ )
+	{
+		if ( ! pair->lwgeom[i] )
+			continue;
+		if ( pair->tree[i] )
+			rect_tree_free(pair->tree[i]);
+		lwgeom_free(pair->lwgeom[i]);
+	}
+}
+
+int
+RectTreeIntersects(FunctionCallInfoData *fcinfo, const GSERIALIZED *g1, const GSERIALIZED *g2, int *result)
+{
+	RectTreePair pair;
+	int rv = LW_FAILURE;
+
+	if ( RectTreePairBuild(fcinfo, g1, g2, &pair) == LW_FAILURE )
+		return LW_FAILURE;
+
+	/* No tree for some argument made only of empty parts */
+	if ( pair.tree[0] && pair.tree[1] )
+	{
+		*result = rect_tree_intersects_tree(pair.tree[0], pair.tree[1]);
+		rv = LW_SUCCESS;
+	}
+	RectTreePairFree(&pair);
+
+	if ( rv == LW_SUCCESS && *result < 0 )
+		elog(ERROR, "%s: interrupted", __func__);
+
+	return rv;
+}
+
+int
+RectTreeDWithin(FunctionCallInfoData *fcinfo, const GSERIALIZED *g1, const GSERIALIZED *g2, double tolerance, int *result)
+{
+	RectTreePair pair;
+	double distance = 0.0;
+	int rv = LW_FAILURE;
+
+	if ( RectTreePairBuild(fcinfo, g1, g2, &pair) == LW_FAILURE )
+		return LW_FAILURE;
+
+	/* The search stops as soon as it is under the tolerance */
+	if ( pair.tree[0] && pair.tree[1] )
+	{
+		distance = rect_tree_distance_tree(pair.tree[0], pair.tree[1], tolerance);
+		*result = distance <= tolerance;
+		rv = LW_SUCCESS;
+	}
+	RectTreePairFree(&pair);
+
+	if ( rv == LW_SUCCESS && distance < 0.0 )
+		elog(ERROR, "%s: interrupted", __func__);
+
+	return rv;
+}
+
+
 /**********************************************************************
 * ST_DistanceRectTree
 **********************************************************************/
@@ -0,0 +1,43 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * PostGIS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PostGIS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PostGIS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ *
+ * Copyright (C) 2018 Paul Ramsey
+ *
+ **********************************************************************/
+
+#ifndef _LWGEOM_RECTREE_H
+#define _LWGEOM_RECTREE_H 1
+
+#include "liblwgeom.h"
+#include "lwgeom_cache.h"
+
+/**
+* Intersection and distance tests run on the rect trees of the
+* arguments, without GEOS, the tree of a repeated argument coming
+* from the RECT_CACHE_ENTRY cache. Only (multi)points, (multi)lines
+* and (multi)polygons are handled, and only when neither argument
+* is empty: the functions return LW_FAILURE otherwise, and the
+* caller is to use another method. On LW_SUCCESS the answer is
+* in *result.
+*/
+int RectTreeIntersects(FunctionCallInfoData *fcinfo, const GSERIALIZED *g1, const GSERIALIZED *g2, int *result);
+int RectTreeDWithin(FunctionCallInfoData *fcinfo, const GSERIALIZED *g1, const GSERIALIZED *g2, double tolerance, int *result);
+
+#endif /* !defined _LWGEOM_RECTREE_H */
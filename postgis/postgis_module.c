@@ -35,6 +35,8 @@
 #include "lwgeom_pg.h"
 #include "geos_c.h"
 #include "lwgeom_backend_api.h"
+#include "lwgeom_cache.h"
+#include "geography.h"
 
 /*
  * This is required for builds against pgsql
@@ -42,8 +44,15 @@
 PG_MODULE_MAGIC;
 
 static pqsigfunc coreIntHandler = 0;
+
 static void handleInterrupt(int sig);
 
+static const struct config_enum_entry geography_area_algorithm_options[] = {
+  {"geodesic", GEOGRAPHY_AREA_GEODESIC, false},
+  {"authalic", GEOGRAPHY_AREA_AUTHALIC, false},
+  {NULL, 0, false}
+};
+
 #ifdef WIN32
 static void interruptCallback() {
   if (UNBLOCKED_SIGNAL_QUEUE())
@@ -101,6 +110,59 @@ _PG_init(void)
    );
 #endif
 
+  /* Skip the definition when an already loaded copy of the */
+  /* library (during an upgrade) owns the GUC, see #2382 */
+  if ( ! postgis_guc_find_option("postgis.geom_cache_size") )
+  {
+    DefineCustomIntVariable(
+      "postgis.geom_cache_size", /* name */
+      "Sets the number of prepared/indexed geometries cached per function call.", /* short_desc */
+      "Each call site keeps that many geometries with their prepared or tree index, recycling the least recently used one.", /* long_desc */
+      &postgis_geom_cache_size, /* valueAddr */
+      GEOM_CACHE_SIZE_DEFAULT, /* bootValue */
+      1, GEOM_CACHE_SIZE_MAX, /* min-max */
+      PGC_USERSET, /* GucContext context */
+      0, /* int flags */
+      NULL, /* GucIntCheckHook check_hook */
+      NULL, /* GucIntAssignHook assign_hook */
+      NULL  /* GucShowHook show_hook */
+     );
+  }
+
+  if ( ! postgis_guc_find_option("postgis.session_geom_cache_mem") )
+  {
+    DefineCustomIntVariable(
+      "postgis.session_geom_cache_mem", /* name */
+      "Sets the memory of the session cache of prepared/indexed geometries.", /* short_desc */
+      "Prepared and indexed geometries are kept across statements within that much memory, keyed by content. Zero disables the cache.", /* long_desc */
+      &postgis_session_geom_cache_mem, /* valueAddr */
+      0, /* bootValue */
+      0, MAX_KILOBYTES, /* min-max */
+      PGC_USERSET, /* GucContext context */
+      GUC_UNIT_KB, /* int flags */
+      NULL, /* GucIntCheckHook check_hook */
+      NULL, /* GucIntAssignHook assign_hook */
+      NULL  /* GucShowHook show_hook */
+     );
+  }
+
+  if ( ! postgis_guc_find_option("postgis.geography_area_algorithm") )
+  {
+    DefineCustomEnumVariable(
+      "postgis.geography_area_algorithm", /* name */
+      "Sets the algorithm of ST_Area(geography) on the spheroid.", /* short_desc */
+      "geodesic integrates along the geodesic edges; authalic sums the rings on the sphere of equal area, faster on rings of short edges and within about 1e-8 of geodesic there.", /* long_desc */
+      &postgis_geography_area_algorithm, /* valueAddr */
+      GEOGRAPHY_AREA_GEODESIC, /* bootValue */
+      geography_area_algorithm_options, /* options */
+      PGC_USERSET, /* GucContext context */
+      0, /* int flags */
+      NULL, /* GucEnumCheckHook check_hook */
+      NULL, /* GucEnumAssignHook assign_hook */
+      NULL  /* GucShowHook show_hook */
+     );
+  }
+
     /* install PostgreSQL handlers */
     pg_install_lwgeom_handlers();
 
@@ -206,3 +206,26 @@ select '4.b box',_postgis_index_extent('test', 'geom2');
 -- select '6.b null', _postgis_index_extent('test', 'geom2');
 drop table test cascade;
 
+
+--
+-- Inheritance trees without whole-tree stats merge their members
+--
+create table p2(g geometry);
+create table p2c1() inherits (p2);
+create table p2c2() inherits (p2);
+insert into p2c1 values ('Point(0 0)'::geometry), ('Point(1 1)'::geometry);
+insert into p2c2 values ('Point(10 10)'::geometry), ('Point(11 12)'::geometry);
+analyze p2c1;
+create index p2c2_g_idx on p2c2 using gist (g);
+
+-- stats of p2c1 and index of p2c2
+with e as ( select ST_EstimatedExtent('p2','g') as e )
+select '7.a merged', round(st_xmin(e.e)::numeric, 2), round(st_xmax(e.e)::numeric, 2),
+round(st_ymin(e.e)::numeric, 2), round(st_ymax(e.e)::numeric, 2) from e;
+
+-- parent only has nothing
+with e as ( select ST_EstimatedExtent('public','p2','g','t') as e )
+select '7.b parent', round(st_xmin(e.e)::numeric, 2), round(st_xmax(e.e)::numeric, 2),
+round(st_ymin(e.e)::numeric, 2), round(st_ymax(e.e)::numeric, 2) from e;
+
+drop table p2 cascade;
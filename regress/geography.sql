@@ -121,6 +121,12 @@ SELECT 'segmentize_geography2', st_dwithin(st_pointn(st_segmentize('linestring(1
 SELECT 'segmentize_geography_3667', abs(ST_Length(geog) - ST_Length(ST_Segmentize(geog, 30000))) < 0.00001
   FROM (SELECT ST_GeographyFromText('LINESTRING(38.769917 10.780694, 38.769917 9.106194)') As geog) AS f;
 
+-- Densify against the deviation from the great circles
+SELECT 'densify_geography_1', ST_NPoints(ST_Densify('LINESTRING(10 -50,10 70)'::geography, 100)::geometry);
+SELECT 'densify_geography_2', ST_NPoints(d::geometry) BETWEEN 3 AND ST_NPoints(ST_Segmentize(g, 100000)::geometry), abs(ST_Length(d, false) - ST_Length(g, false)) < 0.001
+  FROM (SELECT g, ST_Densify(g, 10000) AS d FROM (SELECT 'LINESTRING(-74 40.6,139.8 35.6)'::geography AS g) AS f) AS f;
+SELECT 'densify_geography_3', ST_Densify('LINESTRING(10 -50,10 70)'::geography, 'NaN');
+
 -- typmod checks
 select 'typmod_point_4326', geography_typmod_out(geography_typmod_in('{Point,4326}'));
 select 'typmod_point_0', geography_typmod_out(geography_typmod_in('{Point,0}'));
@@ -143,5 +149,33 @@ select 'dwithin_poly_poly_1', ST_DWithin('POLYGON((0 0, -2 -2, -3 0, 0 0))'::geo
 select 'dwithin_poly_poly_2', ST_DWithin('POLYGON((0 0, -2 -2, -3 0, 0 0))'::geography, 'POLYGON((1 1, 2 2, 3 0, 1 1))'::geography, 300000);
 select 'dwithin_poly_poly_3', ST_DWithin('POLYGON((1 1, -2 -2, -3 0, 1 1))'::geography, 'POLYGON((1 1, 2 2, 3 0, 1 1))'::geography, 300000);
 
+-- Point/point and point/multipoint distances, against the uncached calculation
+select 'distance_pt_pt_1', abs(ST_Distance('POINT(-71.06 42.36)'::geography, 'POINT(2.35 48.86)'::geography) - _ST_DistanceUnCached('POINT(-71.06 42.36)'::geography, 'POINT(2.35 48.86)'::geography)) < 0.0001;
+select 'distance_pt_pt_2', abs(ST_Distance('POINT(-71.06 42.36)'::geography, 'POINT(2.35 48.86)'::geography, false) - _ST_DistanceUnCached('POINT(-71.06 42.36)'::geography, 'POINT(2.35 48.86)'::geography, false)) < 0.0001;
+select 'distance_pt_pt_3', ST_Distance('POINT(1 1)'::geography, 'POINT EMPTY'::geography);
+select 'distance_pt_mpt_1', abs(ST_Distance('POINT(-71.06 42.36)'::geography, 'MULTIPOINT(2.35 48.86,-0.13 51.51,139.69 35.69)'::geography) - _ST_DistanceUnCached('POINT(-71.06 42.36)'::geography, 'POINT(-0.13 51.51)'::geography)) < 0.0001;
+select 'dwithin_pt_pt_3', ST_DWithin('POINT(0 0)'::geography, 'POINT(0 1)'::geography, 110574.4), ST_DWithin('POINT(0 0)'::geography, 'POINT(0 1)'::geography, 110574.3);
+
+-- Authalic areas, against the geodesic ones
+SET postgis.geography_area_algorithm = authalic;
+select 'area_authalic_1', abs(ST_Area(g) - 89.868413479309585) < 1e-6 FROM (SELECT 'POLYGON((-122.848227067007 42.5007249610493,-122.848309475585 42.5007179884263,-122.848327688675 42.500835880696,-122.848245279942 42.5008428533324,-122.848227067007 42.5007249610493))'::geography AS g) AS f;
+select 'area_authalic_2', abs(ST_Area(g) - 2486.7223259210587) < 1e-6 FROM (SELECT 'POLYGON((179.9995 -60.0002,-179.9995 -60.0002,-179.9995 -59.9998,179.9995 -59.9998,179.9995 -60.0002))'::geography AS g) AS f;
+select 'area_authalic_3', abs(ST_Area('POLYGON((8.5 2,8.5 1,9.5 1,9.5 2,8.5 2))'::geography) - 12305128751.0429) < 0.1;
+RESET postgis.geography_area_algorithm;
+
+-- Buffers and intersections in the local projection, against the ST_Transform round trip
+select 'buffer_geography_1', ST_NPoints(b::geometry) = ST_NPoints(r) AND ST_HausdorffDistance(b::geometry, r) < 1e-9 FROM (SELECT ST_Buffer(g, 1000) AS b, ST_Transform(ST_Buffer(ST_Transform(g::geometry, _ST_BestSRID(g)), 1000), 4326) AS r FROM (SELECT 'POINT(-71.06 42.36)'::geography AS g) AS f) AS f;
+select 'buffer_geography_2', ST_NPoints(b::geometry) = ST_NPoints(r) AND ST_HausdorffDistance(b::geometry, r) < 1e-9 FROM (SELECT ST_Buffer(g, 500, 'quad_segs=2 endcap=flat') AS b, ST_Transform(ST_Buffer(ST_Transform(g::geometry, _ST_BestSRID(g)), 500, 'quad_segs=2 endcap=flat'), 4326) AS r FROM (SELECT 'LINESTRING(10 50,11 50.5,12 50)'::geography AS g) AS f) AS f;
+select 'buffer_geography_3', ST_NPoints(b::geometry) = ST_NPoints(r) AND ST_HausdorffDistance(b::geometry, r) < 1e-9 FROM (SELECT ST_Buffer(g, 2000, 3) AS b, ST_Transform(ST_Buffer(ST_Transform(g::geometry, _ST_BestSRID(g)), 2000, 3), 4326) AS r FROM (SELECT 'POLYGON((20 80,30 80,30 82,20 82,20 80))'::geography AS g) AS f) AS f;
+select 'buffer_geography_empty', ST_Buffer('POINT EMPTY'::geography, 10) IS NULL;
+select 'intersection_geography_1', ST_NPoints(i::geometry) = ST_NPoints(r) AND ST_HausdorffDistance(i::geometry, r) < 1e-9 FROM (SELECT ST_Intersection(g1, g2) AS i, ST_Transform(ST_Intersection(ST_Transform(g1::geometry, _ST_BestSRID(g1, g2)), ST_Transform(g2::geometry, _ST_BestSRID(g1, g2))), 4326) AS r FROM (SELECT 'POLYGON((0 0,2 0,2 2,0 2,0 0))'::geography AS g1, 'LINESTRING(-1 1,3 1.5)'::geography AS g2) AS f) AS f;
+select 'intersection_geography_2', ST_AsText(ST_Intersection('POLYGON((0 0,1 0,1 1,0 1,0 0))'::geography, 'POINT EMPTY'::geography));
+
+-- Nearest neighbours of arrays of geographies, on the sphere like <->
+select 'knn_geography_1', probe, candidate, round(distance) FROM ST_NearestNeighbors(ARRAY['POINT(0 0)'::geography, 'POINT(10 10)', NULL], ARRAY['POINT(0 1)'::geography, 'POINT(10 11)', 'POINT(0 2)', 'POINT EMPTY'], 2);
+select 'knn_geography_2', probe, candidate, round(distance) FROM ST_NearestNeighbors(ARRAY['POINT(0 0)'::geography, 'POINT(10 10)'], ARRAY['POINT(0 1)'::geography, 'POINT(10 11)', 'POINT(0 2)'], 3, 200000);
+select 'knn_geography_3', count(*) FROM ST_NearestNeighbors(ARRAY['POINT(0 0)'::geography], ARRAY[]::geography[]);
+select 'knn_geography_4', bool_and(abs(n.distance - (p <-> c)) < 0.001) FROM (SELECT array_agg(ST_Point(x, x % 7)::geography ORDER BY x) AS probes, array_agg(ST_Point(x + 0.5, x % 5)::geography ORDER BY x) AS candidates FROM generate_series(1, 50) AS x) AS f, ST_NearestNeighbors(probes, candidates, 3) AS n, LATERAL (SELECT probes[n.probe] AS p, candidates[n.candidate] AS c) AS g;
+
 -- Clean up spatial_ref_sys
 DELETE FROM spatial_ref_sys WHERE srid IN (4269, 4326);
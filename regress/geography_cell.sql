@@ -0,0 +1,46 @@
+-- Hierarchical cells on the sphere, and coverings of geographies by them
+SELECT 'face', ST_CellId('POINT(0 0)'::geography, 0), ST_CellId('POINT(0 -90)'::geography, 0);
+SELECT 'range', ST_CellRangeMin(ST_CellId('POINT(0 0)'::geography, 0)), ST_CellRangeMax(ST_CellId('POINT(0 0)'::geography, 0));
+SELECT 'leaf', ST_CellId('POINT(2.35 48.86)'::geography) BETWEEN ST_CellRangeMin(ST_CellId('POINT(2.35 48.86)'::geography, 10))
+                                                       AND ST_CellRangeMax(ST_CellId('POINT(2.35 48.86)'::geography, 10));
+SELECT 'negative', ST_CellId('POINT(-120 -60)'::geography) BETWEEN ST_CellRangeMin(ST_CellId('POINT(-120 -60)'::geography, 3))
+                                                           AND ST_CellRangeMax(ST_CellId('POINT(-120 -60)'::geography, 3));
+SELECT 'boundary', ST_NPoints(ST_CellBoundary(ST_CellId('POINT(2.35 48.86)'::geography, 8))::geometry),
+       ST_Covers(ST_CellBoundary(ST_CellId('POINT(2.35 48.86)'::geography, 8)), 'POINT(2.35 48.86)'::geography);
+SELECT 'empty', ST_CellId('POINT EMPTY'::geography) IS NULL, ST_CellCovering('POLYGON EMPTY'::geography);
+
+-- Number of cells covering a polygon with a hole, and inside it
+SELECT 'covering', array_length(ST_CellCovering(g, 7), 1), array_length(ST_CellInteriorCovering(g, 7), 1)
+FROM (SELECT 'POLYGON((-5 40,10 40,10 52,-5 52,-5 40),(0 44,4 44,4 48,0 48,0 44))'::geography AS g) p;
+SELECT 'line', ST_CellInteriorCovering('LINESTRING(0 0,1 1)'::geography);
+
+-- Past max_cells the cells are left coarser
+SELECT 'capped', array_length(ST_CellCovering(g, 12, 50), 1) <= 50, array_length(ST_CellCovering(g, 12), 1) <= 1024,
+       array_length(ST_CellInteriorCovering(g, 12, 50), 1) <= 50
+FROM (SELECT 'POLYGON((-5 40,10 40,10 52,-5 52,-5 40),(0 44,4 44,4 48,0 48,0 44))'::geography AS g) p;
+
+-- Point in polygon join on cell ranges, points in interior cells
+-- need no recheck
+CREATE TABLE cell_points AS
+SELECT x * 0.5 AS x, y * 0.5 AS y, ST_CellId(ST_MakePoint(x * 0.5, y * 0.5)::geography) AS cell
+FROM generate_series(-16, 26) x, generate_series(74, 110) y;
+CREATE INDEX cell_points_idx ON cell_points (cell);
+CREATE TABLE cell_polygon AS
+SELECT 'POLYGON((-5 40,10 40,10 52,-5 52,-5 40),(0 44,4 44,4 48,0 48,0 44))'::geography AS g;
+
+SELECT 'join', count(DISTINCT (p.x, p.y)) = (SELECT count(*) FROM cell_points p, cell_polygon g WHERE ST_Covers(g.g, ST_MakePoint(p.x, p.y)::geography))
+FROM cell_polygon g, unnest(ST_CellCovering(g.g, 9)) c, cell_points p
+WHERE p.cell BETWEEN ST_CellRangeMin(c) AND ST_CellRangeMax(c)
+  AND ST_Covers(g.g, ST_MakePoint(p.x, p.y)::geography);
+SELECT 'interior', count(*) > 0, bool_and(ST_Covers(g.g, ST_MakePoint(p.x, p.y)::geography))
+FROM cell_polygon g, unnest(ST_CellInteriorCovering(g.g, 9)) c, cell_points p
+WHERE p.cell BETWEEN ST_CellRangeMin(c) AND ST_CellRangeMax(c);
+
+DROP TABLE cell_points;
+DROP TABLE cell_polygon;
+
+-- Errors
+SELECT ST_CellId('POINT(0 0)'::geography, 31);
+SELECT ST_CellId('LINESTRING(0 0,1 1)'::geography);
+SELECT ST_CellRangeMin(0);
+SELECT ST_CellCovering('POINT(0 0)'::geography, 12, 0);
@@ -0,0 +1,42 @@
+-- Geographies carrying their own tree of edges, used by the
+-- distance calculations instead of building one
+CREATE TABLE tree_index (id integer, g geography, gi geography);
+INSERT INTO tree_index SELECT id, g, ST_AddTreeIndex(g) FROM (VALUES
+  (1, 'POLYGON((0 0,10 0,10 10,0 10,0 0),(2 2,2 3,3 3,3 2,2 2))'::geography),
+  (2, 'MULTIPOLYGON(((20 20,21 20,21 21,20 21,20 20)),((30 30,31 30,31 31,30 30)))'),
+  (3, 'LINESTRING(-5 -5,-4 -3,-2 -4)'),
+  (4, 'MULTIPOINT(50 50,51 51)'),
+  (5, 'POINT(1 1)'),
+  (6, 'POLYGON EMPTY')) v(id, g);
+
+-- Points and empties are not indexed
+SELECT 'size', id, pg_column_size(gi) > pg_column_size(g) FROM tree_index ORDER BY id;
+
+-- The index is not part of the value
+SELECT 'equal', id, g = gi, ST_AsText(gi) = ST_AsText(g), ST_AsText(ST_AddTreeIndex(gi)) = ST_AsText(g)
+FROM tree_index ORDER BY id;
+SELECT 'drop', id, pg_column_size(ST_DropTreeIndex(gi)) = pg_column_size(g) FROM tree_index ORDER BY id;
+SELECT 'typmod', ST_AsText(ST_AddTreeIndex('SRID=4326;LINESTRING(0 0,1 1)'::geography)::geography(LineString, 4326));
+
+CREATE TABLE tree_index_probe (q geography);
+INSERT INTO tree_index_probe VALUES
+  ('POINT(5 5)'), ('POINT(2.5 2.5)'), ('POINT(50.5 50.5)'),
+  ('LINESTRING(11 11,19 19)'), ('LINESTRING(-4.5 -3,-4 -5)'),
+  ('POLYGON((-1 -1,-1 -2,-2 -2,-1 -1))'), ('POLYGON((4 4,4 6,6 6,6 4,4 4))');
+
+-- Same answers with and without the index, on first sight and cached
+SELECT 'dist', count(*) FROM tree_index t, tree_index_probe p
+WHERE abs(ST_Distance(t.gi, p.q) - _ST_DistanceUnCached(t.g, p.q)) > 0.01;
+SELECT 'dist_rev', count(*) FROM tree_index t, tree_index_probe p
+WHERE abs(ST_Distance(p.q, t.gi) - _ST_DistanceUnCached(p.q, t.g)) > 0.01;
+SELECT 'tree', count(*) FROM tree_index t, tree_index_probe p
+WHERE _ST_DistanceTree(t.gi, p.q) <> _ST_DistanceTree(t.g, p.q);
+SELECT 'intersects',
+  sum(CASE WHEN ST_Intersects(t.gi, p.q) <> ST_Intersects(t.g, p.q) THEN 1 ELSE 0 END),
+  sum(CASE WHEN ST_Intersects(t.gi, p.q) THEN 1 ELSE 0 END)
+FROM tree_index t, tree_index_probe p;
+SELECT 'dwithin', count(*) FROM tree_index t, tree_index_probe p, generate_series(1, 3) s
+WHERE ST_DWithin(t.gi, p.q, s * 100000) <> _ST_DWithinUnCached(t.g, p.q, s * 100000);
+
+DROP TABLE tree_index;
+DROP TABLE tree_index_probe;
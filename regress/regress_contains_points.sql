@@ -0,0 +1,45 @@
+-- ST_ContainsPoints: batch point-in-polygon classification
+
+SELECT 'array', ST_ContainsPoints('POLYGON((0 0,10 0,10 10,0 10,0 0))',
+  ARRAY['POINT(5 5)'::geometry, 'POINT(10 5)', NULL, 'POINT EMPTY', 'POINT(20 5)', 'POINT(0 0)']);
+SELECT 'multipoint', ST_ContainsPoints('POLYGON((0 0,10 0,10 10,0 10,0 0))', 'MULTIPOINT(1 1,11 11,5 10)');
+SELECT 'point', ST_ContainsPoints('POLYGON((0 0,10 0,10 10,0 10,0 0))', 'POINT(1 1)');
+SELECT 'empty_array', ST_ContainsPoints('POLYGON((0 0,10 0,10 10,0 10,0 0))', '{}'::geometry[]);
+SELECT 'empty_poly', ST_ContainsPoints('POLYGON EMPTY', ARRAY['POINT(5 5)'::geometry, NULL]);
+SELECT 'hole', ST_ContainsPoints('POLYGON((0 0,10 0,10 10,0 10,0 0),(2 2,2 8,8 8,8 2,2 2))',
+  'MULTIPOINT(1 1,5 5,2 5,9 9)');
+SELECT 'multipolygon', ST_ContainsPoints('MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(2 2,2 8,8 8,8 2,2 2)),((3 3,7 3,7 7,3 7,3 3)),((20 0,30 0,25 10,20 0)))',
+  'MULTIPOINT(1 1,2.5 2.5,5 5,3 5,25 5,15 5)');
+
+-- Agreement with the GEOS relate matrix over a lattice, for small
+-- batches (direct crossing count) and a large one (grid index), on
+-- three rows so the later ones go through the cached index
+WITH poly AS (
+  SELECT ST_Difference(ST_Buffer('POINT(0 0)'::geometry, 10, 8),
+                       ST_Buffer('POINT(2 1)'::geometry, 3, 2)) AS g
+), pts AS (
+  SELECT 'column' AS batch, array_agg(ST_MakePoint(x * 0.5, y * 0.5) ORDER BY y) AS a
+  FROM generate_series(-25, 25) x, generate_series(-25, 25) y
+  GROUP BY x
+  UNION ALL
+  SELECT 'lattice', array_agg(ST_MakePoint(x * 0.5, y * 0.5) ORDER BY x, y)
+  FROM generate_series(-25, 25) x, generate_series(-25, 25) y
+)
+SELECT 'agree', batch, r, count(*),
+       count(*) FILTER (WHERE c <> ST_Relate(g, p, 'T*****FF*'))
+FROM poly, pts, generate_series(1, 3) r,
+     LATERAL unnest(ST_ContainsPoints(g, a), a) AS u(c, p)
+GROUP BY batch, r ORDER BY batch, r;
+
+-- The multipoint fast path of ST_Contains locates all the points
+-- in one pass
+SELECT 'contains_mpoint', ST_Contains('POLYGON((0 0,10 0,10 10,0 10,0 0),(2 2,2 8,8 8,8 2,2 2))', g)
+FROM (VALUES ('MULTIPOINT(1 1,10 5)'::geometry), ('MULTIPOINT(0 0,10 5)'),
+             ('MULTIPOINT(1 1,5 5)'), ('MULTIPOINT(1 1,9 9,1 9)')) AS v(g);
+SELECT 'within_mpoint', ST_Within('MULTIPOINT(1 1,9 9)', 'POLYGON((0 0,10 0,10 10,0 10,0 0))');
+
+-- Errors
+SELECT 'err_poly', ST_ContainsPoints('LINESTRING(0 0,10 10)', ARRAY['POINT(5 5)'::geometry]);
+SELECT 'err_elem', ST_ContainsPoints('POLYGON((0 0,10 0,10 10,0 10,0 0))', ARRAY['LINESTRING(0 0,1 1)'::geometry]);
+SELECT 'err_mpoint', ST_ContainsPoints('POLYGON((0 0,10 0,10 10,0 10,0 0))', 'LINESTRING(0 0,1 1)');
+SELECT 'err_srid', ST_ContainsPoints('SRID=4326;POLYGON((0 0,10 0,10 10,0 10,0 0))', ARRAY['POINT(5 5)'::geometry]);
@@ -0,0 +1,103 @@
+-- Counters of the prepared geometry and tree caches, and the
+-- postgis.geom_cache_size setting.
+-- Three polygons alternate on the first argument, so a single
+-- entry cache keeps missing while a larger one warms up.
+
+SET postgis.geom_cache_size = 4;
+SELECT 'reset', _postgis_geom_cache_stats(true) IS NOT NULL;
+
+-- Polygon/polygon containment goes through the prepared geometry cache
+SELECT 'prep4', count(*) FROM generate_series(1, 30) s
+WHERE ST_Contains(ST_MakeEnvelope(-10 - s % 3, -10, 10, 10),
+                  ST_MakeEnvelope(s * 0.1, 0, s * 0.1 + 1, 1));
+
+-- Polygon/polygon intersection goes through the prepared geometry
+-- cache too, the rect trees are only used on the first sight of
+-- each polygon
+SELECT 'rect4', count(*) FROM generate_series(1, 30) s
+WHERE ST_Intersects(ST_MakeEnvelope(-10 - s % 3, -10, 10, 10),
+                    ST_MakeEnvelope(s * 0.1, 0, s * 0.1 + 1, 1));
+
+-- Polygon/polygon distance goes through the rect tree cache
+SELECT 'dwithin4', count(*) FROM generate_series(1, 30) s
+WHERE ST_DWithin(ST_MakeEnvelope(-10 - s % 3, -10, 10, 10),
+                 ST_MakeEnvelope(s * 0.1, 0, s * 0.1 + 1, 1), 1);
+
+-- Polygon/point goes through the point-in-polygon index cache
+SELECT 'pip4', count(*) FROM generate_series(1, 30) s
+WHERE ST_Intersects(ST_MakeEnvelope(-10 - s % 3, -10, 10, 10),
+                    ST_MakePoint(s * 0.1, 0.5));
+
+SELECT 'stats4', _postgis_geom_cache_stats(true);
+
+SET postgis.geom_cache_size = 1;
+
+SELECT 'prep1', count(*) FROM generate_series(1, 30) s
+WHERE ST_Contains(ST_MakeEnvelope(-10 - s % 3, -10, 10, 10),
+                  ST_MakeEnvelope(s * 0.1, 0, s * 0.1 + 1, 1));
+
+SELECT 'rect1', count(*) FROM generate_series(1, 30) s
+WHERE ST_Intersects(ST_MakeEnvelope(-10 - s % 3, -10, 10, 10),
+                    ST_MakeEnvelope(s * 0.1, 0, s * 0.1 + 1, 1));
+
+SELECT 'stats1', _postgis_geom_cache_stats();
+
+-- Polygon stored out of line, recognized by its TOAST pointer
+SET postgis.geom_cache_size = 4;
+CREATE TABLE geom_cache_toasted (id integer, geom geometry);
+ALTER TABLE geom_cache_toasted ALTER COLUMN geom SET STORAGE EXTERNAL;
+INSERT INTO geom_cache_toasted VALUES
+  (1, ST_Buffer('POINT(0 0)'::geometry, 10, 64)),
+  (2, ST_Buffer('POINT(100 0)'::geometry, 10, 64));
+SELECT 'reset', _postgis_geom_cache_stats(true) IS NOT NULL;
+
+SELECT 'toasted', t.id, count(*) FROM geom_cache_toasted t, generate_series(1, 30) s
+WHERE ST_Intersects(t.geom, ST_MakePoint(s * 0.1 + 100 * (t.id - 1), 0))
+GROUP BY t.id ORDER BY t.id;
+
+SELECT 'stats_toasted', _postgis_geom_cache_stats();
+
+DROP TABLE geom_cache_toasted;
+-- Session cache: the second run of the statement finds the
+-- trees built by the first one
+SET postgis.session_geom_cache_mem = '1MB';
+SELECT 'reset', _postgis_geom_cache_stats(true) IS NOT NULL;
+
+SELECT 'session_first', count(*) FROM generate_series(1, 30) s
+WHERE ST_Intersects(ST_MakeEnvelope(-10 - s % 3, -10, 10, 10),
+                    ST_MakeEnvelope(s * 0.1, 0, s * 0.1 + 1, 1));
+SELECT 'session_second', count(*) FROM generate_series(1, 30) s
+WHERE ST_Intersects(ST_MakeEnvelope(-10 - s % 3, -10, 10, 10),
+                    ST_MakeEnvelope(s * 0.1, 0, s * 0.1 + 1, 1));
+
+-- entries, hits (24 in the first run, 30 in the second), builds
+SELECT 'session', j->'session'->>'entries', j->'session'->>'hits', j->'session'->>'misses'
+FROM (SELECT _postgis_geom_cache_stats()::json AS j) s;
+
+-- Disabling the cache empties it
+SET postgis.session_geom_cache_mem = 0;
+SELECT 'session_off', count(*) FROM generate_series(1, 30) s
+WHERE ST_Intersects(ST_MakeEnvelope(-10 - s % 3, -10, 10, 10),
+                    ST_MakeEnvelope(s * 0.1, 0, s * 0.1 + 1, 1));
+SELECT 'session_off', _postgis_geom_cache_stats()::json->'session'->>'entries';
+
+RESET postgis.session_geom_cache_mem;
+
+-- Geography distances look their arguments up one by one, so the
+-- trees of the polygons varying on every row are kept as well as
+-- those of the repeated ones
+SET postgis.geom_cache_size = 8;
+SELECT 'reset', _postgis_geom_cache_stats(true) IS NOT NULL;
+
+SELECT 'geog_pair', count(*) FROM generate_series(0, 23) s
+WHERE _ST_DWithin(ST_MakeEnvelope(s / 6, 0, s / 6 + 0.5, 0.5)::geography,
+                  ST_MakeEnvelope(s % 3, 1, s % 3 + 0.5, 1.5)::geography, 60000, true);
+SELECT 'geog_pair', _postgis_geom_cache_stats()::json->'circtree';
+
+SELECT 'geog_dist', count(*) FROM generate_series(0, 23) s
+WHERE abs(ST_Distance(ST_MakeEnvelope(s / 6, 0, s / 6 + 0.5, 0.5)::geography,
+                      ST_MakeEnvelope(s % 3, 1, s % 3 + 0.5, 1.5)::geography) -
+          _ST_DistanceUnCached(ST_MakeEnvelope(s / 6, 0, s / 6 + 0.5, 0.5)::geography,
+                               ST_MakeEnvelope(s % 3, 1, s % 3 + 0.5, 1.5)::geography)) > 0.01;
+
+RESET postgis.geom_cache_size;
@@ -0,0 +1,69 @@
+--- build a larger database
+\i regress_lots_of_points.sql
+
+--- Test the GiST opclass over box2df expressions
+
+CREATE OR REPLACE FUNCTION qnodes(q text) RETURNS text
+LANGUAGE 'plpgsql' AS
+$$
+DECLARE
+  exp TEXT;
+  mat TEXT[];
+  ret TEXT[];
+BEGIN
+  FOR exp IN EXECUTE 'EXPLAIN ' || q
+  LOOP
+    mat := regexp_matches(exp, ' *(?:-> *)?(.*Scan)');
+    IF mat IS NOT NULL THEN
+      ret := array_append(ret, mat[1]);
+    END IF;
+  END LOOP;
+  RETURN array_to_string(ret,',');
+END;
+$$;
+
+-- conversions
+SELECT 'box2df', box2d(box2df('LINESTRING(0 0, 1 1)'::geometry));
+SELECT 'box2df_empty', box2df('POINT EMPTY'::geometry) IS NULL;
+SELECT 'box2df_overlaps', box2df('POINT(0 0)'::geometry) && box2df('LINESTRING(0 0, 1 1)'::geometry);
+SELECT 'box2df_within', box2df('POINT(2 2)'::geometry) @ box2df('LINESTRING(0 0, 1 1)'::geometry);
+SELECT 'box2df_contains', box2df('LINESTRING(0 0, 1 1)'::geometry) ~ box2df('POINT(0.5 0.5)'::geometry);
+
+CREATE INDEX test_box2df_idx ON test USING gist (box2df(the_geom));
+VACUUM ANALYZE test;
+
+set enable_seqscan = off;
+set enable_bitmapscan = off;
+set enable_indexscan = on;
+
+SELECT 'scan_idx', qnodes('select count(*) from test where box2df(the_geom) && box2df(''BOX(125 125,135 135)''::box2d::geometry)');
+SELECT 'overlaps', count(*) FROM test WHERE box2df(the_geom) && box2df('BOX(125 125,135 135)'::box2d::geometry);
+SELECT 'within', count(*) FROM test WHERE box2df(the_geom) @ box2df('BOX(125 125,135 135)'::box2d::geometry);
+SELECT 'extent', ST_Covers(ST_Extent(box2d(box2df(the_geom)))::geometry, ST_Extent(the_geom)::geometry) FROM test WHERE box2df(the_geom) && box2df('BOX(125 125,135 135)'::box2d::geometry);
+
+-- keys are stored unchanged, infinite boxes are found
+CREATE TABLE test_inf AS
+SELECT ST_MakePoint('Infinity'::float8, 0) AS g UNION ALL SELECT 'POINT(0 0)'::geometry;
+CREATE INDEX test_inf_idx ON test_inf USING gist (box2df(g));
+SELECT 'infinite', count(*) FROM test_inf WHERE box2df(g) && box2df(ST_MakePoint('Infinity'::float8, 0));
+
+-- same results without the index
+set enable_seqscan = on;
+set enable_indexscan = off;
+set enable_indexonlyscan = off;
+
+SELECT 'scan_seq', qnodes('select count(*) from test where box2df(the_geom) && box2df(''BOX(125 125,135 135)''::box2d::geometry)');
+SELECT 'overlaps', count(*) FROM test WHERE box2df(the_geom) && box2df('BOX(125 125,135 135)'::box2d::geometry);
+SELECT 'within', count(*) FROM test WHERE box2df(the_geom) @ box2df('BOX(125 125,135 135)'::box2d::geometry);
+SELECT 'infinite', count(*) FROM test_inf WHERE box2df(g) && box2df(ST_MakePoint('Infinity'::float8, 0));
+
+-- cleanup
+DROP INDEX test_box2df_idx;
+DROP TABLE test;
+DROP TABLE test_inf;
+DROP FUNCTION qnodes(text);
+
+set enable_indexscan = on;
+set enable_indexonlyscan = on;
+set enable_bitmapscan = on;
+set enable_seqscan = on;
@@ -0,0 +1,71 @@
+-- ST_Intersects and ST_DWithin on linear and areal pairs are
+-- answered on rect trees, without GEOS. The answers have to match
+-- the GEOS intersection matrix and ST_Distance.
+-- ST_Intersects uses the cached prepared geometry of an argument
+-- repeated from an earlier row instead, so each pair it checks
+-- is moved away from the others for no argument to repeat.
+
+CREATE TABLE rectree_shapes (id integer, g geometry);
+INSERT INTO rectree_shapes VALUES
+  (1, 'LINESTRING(0 0, 1 1)'),
+  (2, 'LINESTRING(1 1, 2 0)'), -- touches 1 at an end
+  (3, 'LINESTRING(0 0.5, 2 0.5)'),
+  (4, 'LINESTRING(2 0, 4 0)'),
+  (5, 'LINESTRING(3 0, 5 0)'), -- overlaps 4
+  (6, 'POLYGON((0 0, 10 0, 10 10, 0 10, 0 0),(2 2, 8 2, 8 8, 2 8, 2 2))'),
+  (7, 'LINESTRING(4 4, 5 5)'), -- in the hole of 6
+  (8, 'MULTILINESTRING((20 20, 30 30),(1 5, 1 6))'), -- second part inside 6
+  (9, 'MULTIPOLYGON(((20 20, 21 20, 21 21, 20 20)),((3 3, 4 3, 4 4, 3 3)))'), -- second part in the hole of 6
+  (10, 'POLYGON((10 0, 12 0, 12 2, 10 2, 10 0))'), -- shares an edge with 6
+  (11, 'MULTIPOINT(5 5, 1 1)'),
+  (12, 'LINESTRING(2 5, 8 5)'); -- spans the hole of 6
+
+SELECT 'intersects', id1, id2
+FROM (
+  SELECT a.id AS id1, b.id AS id2,
+         ST_Translate(a.g, 100 * (12 * a.id + b.id), 0) AS g1,
+         ST_Translate(b.g, 100 * (12 * a.id + b.id), 0) AS g2
+  FROM rectree_shapes a, rectree_shapes b
+  OFFSET 0
+) pairs
+WHERE ST_Intersects(g1, g2) <> NOT ST_Relate(g1, g2, 'FF*FF****')
+ORDER BY 2, 3;
+SELECT 'intersects_count', count(*)
+FROM rectree_shapes a, rectree_shapes b
+WHERE ST_Intersects(a.g, b.g);
+
+SELECT 'dwithin', a.id, b.id, d
+FROM rectree_shapes a, rectree_shapes b, (VALUES (0), (0.5), (1), (2)) t(d)
+WHERE ST_DWithin(a.g, b.g, d) <> (ST_Distance(a.g, b.g) <= d)
+ORDER BY 2, 3, 4;
+SELECT 'dwithin_count', d, count(*)
+FROM rectree_shapes a, rectree_shapes b, (VALUES (0), (0.5), (1), (2)) t(d)
+WHERE ST_DWithin(a.g, b.g, d)
+GROUP BY d ORDER BY d;
+
+-- The same polygon on every row, its prepared geometry comes
+-- from the cache
+SELECT 'cached', count(*)
+FROM rectree_shapes a, generate_series(0, 120) s
+WHERE a.id = 6 AND ST_Intersects(a.g,
+  ST_MakeLine(ST_MakePoint(s / 10.0, -1), ST_MakePoint(s / 10.0, 1 + s / 20.0)));
+
+WITH poly AS (
+  SELECT ST_Difference(ST_Buffer('POINT(0 0)'::geometry, 10, 8),
+                       ST_Buffer('POINT(2 1)'::geometry, 3, 2)) AS g
+), lines AS (
+  SELECT ST_MakeLine(ST_MakePoint(x, y), ST_MakePoint(x + 1.5, y + 0.5)) AS g,
+         100 * (25 * (x + 12) + y + 12) AS dx
+  FROM generate_series(-12, 12) x, generate_series(-12, 12) y
+), pairs AS (
+  SELECT poly.g AS pg, lines.g AS lg,
+         ST_Translate(poly.g, dx, 0) AS pgt,
+         ST_Translate(lines.g, dx, 0) AS lgt
+  FROM poly, lines
+)
+SELECT 'lattice', count(*)
+FROM pairs
+WHERE ST_Intersects(pgt, lgt) <> NOT ST_Relate(pgt, lgt, 'FF*FF****')
+   OR ST_DWithin(lg, pg, 0.5) <> (ST_Distance(lg, pg) <= 0.5);
+
+DROP TABLE rectree_shapes;
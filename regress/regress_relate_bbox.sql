@@ -0,0 +1,24 @@
+-- Predicates short-circuited on bounding boxes, empty arguments,
+-- point pairs and points in polygons, against their intersection
+-- matrix definitions
+SELECT id, ST_Relate(a, b),
+  ST_Intersects(a, b), ST_Disjoint(a, b), ST_Touches(a, b),
+  ST_Crosses(a, b), ST_Overlaps(a, b), ST_Equals(a, b),
+  ST_Contains(a, b), ST_ContainsProperly(a, b), ST_Within(a, b),
+  ST_Covers(a, b), ST_CoveredBy(a, b),
+  ST_Relate(a, b, 'FF*FF****'), ST_Relate(a, b, 't*f**f***')
+FROM (VALUES
+  (1, 'POINT(1 1)'::geometry, 'POINT(1 1)'::geometry), -- points
+  (2, 'POINT(1 1)'::geometry, 'POINT(2 2)'::geometry),
+  (3, 'POINT(5 5)'::geometry, 'POLYGON((0 0,10 0,10 10,0 10,0 0))'::geometry), -- point in polygon
+  (4, 'POINT(0 5)'::geometry, 'POLYGON((0 0,10 0,10 10,0 10,0 0))'::geometry), -- on its boundary
+  (5, 'POINT(8 8)'::geometry, 'POLYGON((0 0,10 0,0 10,0 0))'::geometry), -- outside, within its box
+  (6, 'POLYGON((0 0,10 0,10 10,0 10,0 0))'::geometry, 'POINT(5 5)'::geometry), -- polygon first
+  (7, 'POLYGON((0 0,10 0,10 10,0 10,0 0))'::geometry, 'POINT(0 5)'::geometry),
+  (8, 'POLYGON((0 0,10 0,10 10,0 10,0 0))'::geometry, 'POLYGON((20 20,30 20,30 30,20 30,20 20))'::geometry), -- disjoint boxes
+  (9, 'MULTIPOINT(20 20,25 25)'::geometry, 'POLYGON((0 0,10 0,10 10,0 10,0 0))'::geometry),
+  (10, 'LINESTRING(20 0,30 10)'::geometry, 'POLYGON((0 0,10 0,10 10,0 10,0 0))'::geometry),
+  (11, 'POINT EMPTY'::geometry, 'POLYGON((0 0,10 0,10 10,0 10,0 0))'::geometry), -- empty arguments
+  (12, 'POLYGON((0 0,10 0,10 10,0 10,0 0))'::geometry, 'POLYGON EMPTY'::geometry)
+) AS t(id, a, b)
+ORDER BY id;
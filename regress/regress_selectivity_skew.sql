@@ -0,0 +1,88 @@
+-- Selectivity estimates on skewed data: a dense "downtown"
+-- in the middle of a sparse "countryside".
+-- Tables are small enough for ANALYZE to sample every row.
+
+create table skewed_points as
+  select ST_MakePoint(50 + (i % 40) * 0.025, 50 + (i / 40) * 0.025) as g
+  from generate_series(0, 1599) i
+  union all
+  select ST_MakePoint((i % 20) * 5 + 2.5, (i / 20) * 5 + 2.5)
+  from generate_series(0, 399) i;
+
+create table skewed_polygons as
+  select ST_MakeEnvelope(50 + (i % 30) * 0.05, 50 + (i / 30) * 0.05,
+                         50.2 + (i % 30) * 0.05, 50.2 + (i / 30) * 0.05) as g
+  from generate_series(0, 899) i
+  union all
+  select ST_MakeEnvelope((i % 20) * 5 + 1, (i / 20) * 5 + 1,
+                         (i % 20) * 5 + 4, (i / 20) * 5 + 4)
+  from generate_series(0, 399) i;
+
+analyze skewed_points;
+analyze skewed_polygons;
+
+-- Is the estimated row count within a factor of two of the actual one?
+CREATE OR REPLACE FUNCTION skew_sel_ok(tbl regclass, q geometry) RETURNS boolean
+LANGUAGE 'plpgsql' AS
+$$
+DECLARE
+  actual float8;
+  total float8;
+  estimated float8;
+BEGIN
+  EXECUTE 'SELECT count(*) FROM ' || tbl || ' WHERE g && $1' INTO actual USING q;
+  EXECUTE 'SELECT count(*) FROM ' || tbl INTO total;
+  estimated := _postgis_selectivity(tbl, 'g', q) * total;
+  RETURN estimated BETWEEN actual / 2 AND actual * 2;
+END;
+$$;
+
+CREATE OR REPLACE FUNCTION skew_joinsel_ok(tbl1 regclass, tbl2 regclass) RETURNS boolean
+LANGUAGE 'plpgsql' AS
+$$
+DECLARE
+  actual float8;
+  total1 float8;
+  total2 float8;
+  estimated float8;
+BEGIN
+  EXECUTE 'SELECT count(*) FROM ' || tbl1 || ' a, ' || tbl2 || ' b WHERE a.g && b.g' INTO actual;
+  EXECUTE 'SELECT count(*) FROM ' || tbl1 INTO total1;
+  EXECUTE 'SELECT count(*) FROM ' || tbl2 INTO total2;
+  estimated := _postgis_join_selectivity(tbl1, 'g', tbl2, 'g') * total1 * total2;
+  RETURN estimated BETWEEN actual / 2 AND actual * 2;
+END;
+$$;
+
+-- The downtown cells got refined
+select 'stats_refined', (_postgis_stats('skewed_points', 'g')::json->>'refined_cells')::int > 0;
+
+-- Boxes in and around downtown
+select 'sel_points_01', skew_sel_ok('skewed_points', ST_MakeEnvelope(49.99, 49.99, 50.49, 50.49));
+select 'sel_points_02', skew_sel_ok('skewed_points', ST_MakeEnvelope(50.11, 50.11, 50.41, 50.41));
+select 'sel_points_03', skew_sel_ok('skewed_points', ST_MakeEnvelope(49.9, 49.9, 51.1, 51.1));
+select 'sel_points_04', skew_sel_ok('skewed_points', ST_MakeEnvelope(50.51, 50.21, 60, 50.61));
+select 'sel_polygons_01', skew_sel_ok('skewed_polygons', ST_MakeEnvelope(49.99, 49.99, 50.49, 50.49));
+select 'sel_polygons_02', skew_sel_ok('skewed_polygons', ST_MakeEnvelope(50.11, 50.11, 50.41, 50.41));
+select 'sel_polygons_03', skew_sel_ok('skewed_polygons', ST_MakeEnvelope(49.9, 49.9, 51.1, 51.1));
+select 'sel_polygons_04', skew_sel_ok('skewed_polygons', ST_MakeEnvelope(50.51, 50.21, 60, 50.61));
+
+-- Boxes in the countryside
+select 'sel_points_05', skew_sel_ok('skewed_points', ST_MakeEnvelope(10, 10, 40, 40));
+select 'sel_polygons_05', skew_sel_ok('skewed_polygons', ST_MakeEnvelope(10, 10, 40, 40));
+
+-- ST_DWithin and ST_Intersects search boxes
+select 'sel_dwithin_01', skew_sel_ok('skewed_points', ST_Expand('POINT(50.5 50.5)'::geometry, 0.3));
+select 'sel_dwithin_02', skew_sel_ok('skewed_polygons', ST_Expand('POINT(50.5 50.5)'::geometry, 0.3));
+select 'sel_dwithin_03', skew_sel_ok('skewed_polygons', ST_Expand('POINT(52.5 52.5)'::geometry, 1.2));
+select 'sel_intersects_01', skew_sel_ok('skewed_polygons', ST_Buffer('POINT(50.5 50.5)'::geometry, 0.3));
+
+-- Joins
+select 'joinsel_01', skew_joinsel_ok('skewed_points', 'skewed_polygons');
+select 'joinsel_02', skew_joinsel_ok('skewed_polygons', 'skewed_polygons');
+
+-- Clean
+drop function skew_sel_ok(regclass, geometry);
+drop function skew_joinsel_ok(regclass, regclass);
+drop table if exists skewed_points;
+drop table if exists skewed_polygons;
@@ -0,0 +1,64 @@
+--
+-- Per-row overhead of the geometry cache lookups for a large
+-- geometry repeated on every row, such as the boundary of a big
+-- country tested against many points.
+--
+-- Usage: psql -f profile_geom_cache.sql <database with postgis>
+--
+-- For each polygon size the same point-in-polygon join is timed
+-- twice: against a polygon stored out of line in a table (the
+-- cache recognizes the TOAST datum and skips the comparison) and
+-- against the same polygon computed in the query (byte comparison
+-- of the whole value on every row, as before). The difference per
+-- row with the small polygon is the cost of the lookup itself.
+--
+
+\set ON_ERROR_STOP 1
+SET client_min_messages = NOTICE;
+
+DROP TABLE IF EXISTS profile_geom_cache_poly;
+CREATE TEMP TABLE profile_geom_cache_poly (npoints integer, geom geometry);
+ALTER TABLE profile_geom_cache_poly ALTER COLUMN geom SET STORAGE EXTERNAL;
+
+-- Circles of 1k, 16k and 128k vertices (16kB to 2MB)
+INSERT INTO profile_geom_cache_poly
+SELECT n, ST_Buffer('POINT(0 0)'::geometry, 100, n / 4)
+FROM unnest(ARRAY[1024, 16384, 131072]) n;
+
+DROP TABLE IF EXISTS profile_geom_cache_pts;
+CREATE TEMP TABLE profile_geom_cache_pts AS
+SELECT ST_MakePoint(random() * 200 - 100, random() * 200 - 100) AS geom
+FROM generate_series(1, 100000);
+
+DO $$
+DECLARE
+	r record;
+	t0 timestamptz;
+	stored interval;
+	computed interval;
+	nrows integer;
+	cnt integer;
+BEGIN
+	SELECT count(*) INTO nrows FROM profile_geom_cache_pts;
+	FOR r IN SELECT npoints, ST_MemSize(geom) AS size FROM profile_geom_cache_poly ORDER BY npoints
+	LOOP
+		t0 := clock_timestamp();
+		SELECT count(*) INTO cnt
+		FROM profile_geom_cache_poly c, profile_geom_cache_pts p
+		WHERE c.npoints = r.npoints AND _ST_Intersects(c.geom, p.geom);
+		stored := clock_timestamp() - t0;
+
+		t0 := clock_timestamp();
+		SELECT count(*) INTO cnt
+		FROM profile_geom_cache_pts p
+		WHERE _ST_Intersects(ST_Buffer('POINT(0 0)'::geometry, 100, r.npoints / 4), p.geom);
+		computed := clock_timestamp() - t0;
+
+		RAISE NOTICE '% vertices, % bytes: stored %us/row, computed %us/row',
+			r.npoints, r.size,
+			round((extract(epoch FROM stored) * 1e6 / nrows)::numeric, 3),
+			round((extract(epoch FROM computed) * 1e6 / nrows)::numeric, 3);
+	END LOOP;
+	RAISE NOTICE '%', _postgis_geom_cache_stats();
+END
+$$;